@@ -20,6 +20,9 @@
 #include <soul/sense/msg/body_parts.h>
 #include <soul/messaging/list.h>
 
+#include <cstdint>
+#include <utility>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -54,16 +57,17 @@ public:
    * @param face_landmarks The person's latest face landmarks.
    * @param body_parts The person's latest body part pose state.
    */
-  explicit PersonState(std::int64_t id, const soul::sense::msg::FaceEncoding face_encoding,
-                       const soul::sense::msg::FaceDetection face_detection,
-                       const soul::sense::msg::FaceLandmarks face_landmarks,
-                       const soul::sense::msg::BodyParts body_parts)
+  explicit PersonState(std::int64_t id, soul::sense::msg::FaceEncoding face_encoding,
+                       soul::sense::msg::FaceDetection face_detection, soul::sense::msg::FaceLandmarks face_landmarks,
+                       soul::sense::msg::BodyParts body_parts)
     : id_(id)
-    , face_encoding_(face_encoding)
-    , face_detection_(face_detection)
-    , face_landmarks_(face_landmarks)
-    , body_parts_(body_parts)
+    , face_encoding_(std::move(face_encoding))
+    , face_detection_(std::move(face_detection))
+    , face_landmarks_(std::move(face_landmarks))
+    , body_parts_(std::move(body_parts))
   {
+    // The person state is the end of its face encoding's trace.
+    inheritTrace(*this, face_encoding_);
   }
 
   /**
@@ -79,7 +83,7 @@ public:
    * @brief Get the person's latest face encoding.
    * @return face encoding.
    */
-  soul::sense::msg::FaceEncoding getFaceEncoding(void) const
+  const soul::sense::msg::FaceEncoding& getFaceEncoding(void) const
   {
     return face_encoding_;
   }
@@ -88,7 +92,7 @@ public:
    * @brief Get the person's latest face detection.
    * @return face detection.
    */
-  soul::sense::msg::FaceDetection getFaceDetection(void) const
+  const soul::sense::msg::FaceDetection& getFaceDetection(void) const
   {
     return face_detection_;
   }
@@ -97,7 +101,7 @@ public:
    * @brief Get the person's latest face landmarks.
    * @return face landmarks.
    */
-  soul::sense::msg::FaceLandmarks getFaceLandmarks(void) const
+  const soul::sense::msg::FaceLandmarks& getFaceLandmarks(void) const
   {
     return face_landmarks_;
   }
@@ -106,7 +110,7 @@ public:
    * @brief Get the person's body parts.
    * @return the person's body parts.
    */
-  soul::sense::msg::BodyParts getBodyParts(void) const
+  const soul::sense::msg::BodyParts& getBodyParts(void) const
   {
     return body_parts_;
   }
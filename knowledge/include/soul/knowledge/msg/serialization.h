@@ -0,0 +1,102 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_KNOWLEDGE_MSG_SERIALIZATION_H_
+#define SOUL_KNOWLEDGE_MSG_SERIALIZATION_H_
+
+/*
+ * Binary serialization of the knowledge messages (see soul/messaging/serialization.h).
+ *
+ * Layouts, version 1:
+ *
+ *   PersonState  uint64 id, then the face encoding, face detection, face
+ *                landmarks and body parts, each with its schema header.
+ *
+ * Knowledge types are numbered from 0x200.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/knowledge/msg/person_state.h>
+#include <soul/messaging/serialization.h>
+#include <soul/sense/msg/serialization.h>
+
+#include <cstdint>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+template <>
+struct SerialSchema<knowledge::msg::PersonState>
+{
+  static constexpr std::uint32_t type = 0x200;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+namespace knowledge
+{
+namespace msg
+{
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write a person state.
+ * @param writer Writer.
+ * @param person Person state.
+ */
+inline void serializeFields(SerialWriter& writer, const PersonState& person)
+{
+  writer.write(static_cast<std::uint64_t>(person.getId()));
+  serializeMessage(writer, person.getFaceEncoding());
+  serializeMessage(writer, person.getFaceDetection());
+  serializeMessage(writer, person.getFaceLandmarks());
+  serializeMessage(writer, person.getBodyParts());
+}
+
+/**
+ * @brief Read a person state without copying the face image's pixels.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Person state.
+ */
+inline PersonState deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<PersonState>)
+{
+  (void)version;
+
+  const auto id = reader.read<std::uint64_t>();
+  auto face_encoding = deserializeMessage<sense::msg::FaceEncoding>(reader);
+  auto face_detection = deserializeMessage<sense::msg::FaceDetection>(reader);
+  auto face_landmarks = deserializeMessage<sense::msg::FaceLandmarks>(reader);
+  auto body_parts = deserializeMessage<sense::msg::BodyParts>(reader);
+
+  return PersonState(static_cast<std::int64_t>(id), std::move(face_encoding), std::move(face_detection),
+                     std::move(face_landmarks), std::move(body_parts));
+}
+
+/**
+ * @brief Add the knowledge messages, and lists of them, to a codec registry.
+ * @param registry Registry.
+ */
+inline void addKnowledgeSchemas(SerialCodecRegistry& registry)
+{
+  registry.addWithList<PersonState>();
+}
+
+}  // namespace msg
+}  // namespace knowledge
+}  // namespace soul
+
+#endif  // SOUL_KNOWLEDGE_MSG_SERIALIZATION_H_
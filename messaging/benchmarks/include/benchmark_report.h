@@ -0,0 +1,174 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_BENCHMARK_REPORT_H_
+#define SOUL_MESSAGING_BENCHMARK_REPORT_H_
+
+/*
+ * Benchmark result output.
+ *
+ * Writes benchmark rows as a table for people, or as JSON or CSV for the
+ * scripts that track regressions across machines.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Output formats.
+ */
+enum class ReportFormat
+{
+  table,  ///< Aligned columns for reading.
+  json,   ///< One JSON document.
+  csv,    ///< Header line plus one line per row.
+};
+
+/**
+ * @brief One benchmark measurement.
+ */
+struct BenchmarkRow
+{
+  std::string suite;         ///< What was varied.
+  std::string backend;       ///< Queue backend.
+  int producers = 1;         ///< Producer threads.
+  int topics = 1;            ///< Topics the producers spread over.
+  int subscribers = 1;       ///< Subscribers per topic.
+  std::size_t messages = 0;  ///< Messages sent.
+  double seconds = 0;        ///< Wall time from the first send to the last callback.
+  double msgs_per_sec = 0;   ///< Sent messages per second.
+  double p50_us = 0;         ///< Median send to callback latency.
+  double p99_us = 0;         ///< 99th percentile latency.
+  double p999_us = 0;        ///< 99.9th percentile latency.
+  double max_us = 0;         ///< Worst latency.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Fill in a row's throughput and latency figures.
+ * @param row Row with the setup fields and messages filled in.
+ * @param seconds Wall time.
+ * @param latencies_us Latencies in microseconds. Sorted in place.
+ */
+inline void summarise(BenchmarkRow& row, const double seconds, std::vector<double>& latencies_us)
+{
+  std::sort(latencies_us.begin(), latencies_us.end());
+
+  row.seconds = seconds;
+  row.msgs_per_sec = seconds > 0 ? row.messages / seconds : 0;
+  row.p50_us = percentile(latencies_us, 0.5);
+  row.p99_us = percentile(latencies_us, 0.99);
+  row.p999_us = percentile(latencies_us, 0.999);
+  row.max_us = latencies_us.empty() ? 0 : latencies_us.back();
+}
+
+/**
+ * @brief Write one row in the chosen format. Call writeHeader() first and writeFooter() last.
+ * @param out Where to write.
+ * @param format Output format.
+ * @param row Row.
+ * @param first Whether this is the first row.
+ */
+inline void writeRow(std::FILE* out, const ReportFormat format, const BenchmarkRow& row, const bool first)
+{
+  switch (format)
+  {
+    case ReportFormat::table:
+      std::fprintf(out, "%-10s %-7s %4d %6d %5d %10zu %12.0f %9.1f %9.1f %9.1f %9.1f\n", row.suite.c_str(),
+                   row.backend.c_str(), row.producers, row.topics, row.subscribers, row.messages, row.msgs_per_sec,
+                   row.p50_us, row.p99_us, row.p999_us, row.max_us);
+      break;
+
+    case ReportFormat::json:
+      std::fprintf(out,
+                   "%s    {\"suite\": \"%s\", \"backend\": \"%s\", \"producers\": %d, \"topics\": %d, "
+                   "\"subscribers\": %d, \"messages\": %zu, \"seconds\": %.6f, \"msgs_per_sec\": %.1f, "
+                   "\"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f}",
+                   first ? "" : ",\n", row.suite.c_str(), row.backend.c_str(), row.producers, row.topics,
+                   row.subscribers, row.messages, row.seconds, row.msgs_per_sec, row.p50_us, row.p99_us, row.p999_us,
+                   row.max_us);
+      break;
+
+    case ReportFormat::csv:
+      std::fprintf(out, "%s,%s,%d,%d,%d,%zu,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f\n", row.suite.c_str(), row.backend.c_str(),
+                   row.producers, row.topics, row.subscribers, row.messages, row.seconds, row.msgs_per_sec,
+                   row.p50_us, row.p99_us, row.p999_us, row.max_us);
+      break;
+  }
+
+  std::fflush(out);
+}
+
+/**
+ * @brief Write what comes before the rows.
+ * @param out Where to write.
+ * @param format Output format.
+ * @param benchmark Benchmark name.
+ */
+inline void writeHeader(std::FILE* out, const ReportFormat format, const std::string& benchmark)
+{
+  const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+
+  switch (format)
+  {
+    case ReportFormat::table:
+      std::fprintf(out, "%s, %u hardware threads\n", benchmark.c_str(), std::thread::hardware_concurrency());
+      std::fprintf(out, "%-10s %-7s %4s %6s %5s %10s %12s %9s %9s %9s %9s\n", "suite", "backend", "prod", "topics",
+                   "subs", "messages", "msgs/s", "p50 us", "p99 us", "p99.9 us", "max us");
+      break;
+
+    case ReportFormat::json:
+      std::fprintf(out, "{\n  \"benchmark\": \"%s\",\n  \"timestamp\": %lld,\n  \"hardware_threads\": %u,\n",
+                   benchmark.c_str(), static_cast<long long>(now), std::thread::hardware_concurrency());
+      std::fprintf(out, "  \"results\": [\n");
+      break;
+
+    case ReportFormat::csv:
+      std::fprintf(out, "suite,backend,producers,topics,subscribers,messages,seconds,msgs_per_sec,p50_us,p99_us,"
+                        "p999_us,max_us\n");
+      break;
+  }
+}
+
+/**
+ * @brief Write what comes after the rows.
+ * @param out Where to write.
+ * @param format Output format.
+ */
+inline void writeFooter(std::FILE* out, const ReportFormat format)
+{
+  if (format == ReportFormat::json)
+    std::fprintf(out, "\n  ]\n}\n");
+
+  std::fflush(out);
+}
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_BENCHMARK_REPORT_H_
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_BENCHMARK_STATS_H_
+#define SOUL_MESSAGING_BENCHMARK_STATS_H_
+
+/*
+ * Summary statistics shared by the messaging benchmarks.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get a percentile from sorted samples.
+ * @param sorted Sorted samples.
+ * @param p Percentile in [0, 1].
+ * @return Sample at the percentile.
+ */
+inline double percentile(const std::vector<double>& sorted, const double p)
+{
+  if (sorted.empty())
+    return 0;
+
+  const auto index = static_cast<std::size_t>(p * (sorted.size() - 1));
+  return sorted[index];
+}
+
+/**
+ * @brief Print a histogram of latencies with power of 2 microsecond buckets.
+ * @param latencies_us Latencies in microseconds.
+ */
+inline void printHistogram(const std::vector<double>& latencies_us)
+{
+  const int buckets = 16;
+  std::vector<std::size_t> counts(buckets, 0);
+
+  for (const auto latency : latencies_us)
+  {
+    int bucket = 0;
+    while (bucket < buckets - 1 && latency >= (1 << bucket))
+      ++bucket;
+
+    ++counts[bucket];
+  }
+
+  for (int i = 0; i < buckets; ++i)
+  {
+    if (counts[i] == 0)
+      continue;
+
+    const double share = latencies_us.empty() ? 0.0 : 100.0 * counts[i] / latencies_us.size();
+
+    if (i == buckets - 1)
+      std::printf("  >= %6d us %10zu %6.2f%%\n", 1 << (i - 1), counts[i], share);
+    else
+      std::printf("  <  %6d us %10zu %6.2f%%\n", 1 << i, counts[i], share);
+  }
+}
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_BENCHMARK_STATS_H_
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message queue benchmark.
+ *
+ * Pushes the 250k message load from the sense manager message test through a
+ * MessageManager once per queue backend and reports the throughput and the
+ * send-to-callback latency distribution.
+ *
+ * Usage: messaging_queue_benchmark [producers] [messages]
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/manager.h>
+#include "benchmark_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+using BenchClock = std::chrono::steady_clock;
+
+/** Message that remembers when it was sent. */
+struct BenchMessage : public MessageInterface
+{
+  BenchClock::time_point sent;
+};
+
+/** Results of one benchmark run. */
+struct BenchResult
+{
+  double seconds = 0;                ///< Wall time from the first send to the last callback.
+  std::vector<double> latencies_us;  ///< Send to callback latency of every message.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Send messages from several producer threads and deliver them on this thread.
+ * @param options Queue options for the topic.
+ * @param producers Number of producer threads.
+ * @param messages Total number of messages to send.
+ * @return Timing results.
+ */
+BenchResult runBenchmark(const QueueOptions& options, const int producers, const int messages)
+{
+  MessageManager msgman;
+  BenchResult result;
+  result.latencies_us.reserve(messages);
+
+  std::vector<TopicHandle> topics;
+  for (int i = 0; i < producers; ++i)
+  {
+    MessagePublisher pub("producer" + std::to_string(i));
+    pub.queue = options;
+    topics.push_back(msgman.publish("bench", pub));
+  }
+
+  msgman.subscribe("bench", "consumer", [&](std::shared_ptr<MessageInterface> msg) {
+    const auto now = BenchClock::now();
+    const auto& bench_msg = static_cast<const BenchMessage&>(*msg);
+    result.latencies_us.push_back(std::chrono::duration<double, std::micro>(now - bench_msg.sent).count());
+
+    if (static_cast<int>(result.latencies_us.size()) == messages)
+      msgman.setWork(false);
+  });
+
+  const int per_producer = messages / producers;
+  const auto start = BenchClock::now();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; ++i)
+  {
+    const int count = i == producers - 1 ? messages - per_producer * (producers - 1) : per_producer;
+
+    threads.emplace_back([&msgman, &topics, i, count]() {
+      for (int j = 0; j < count; ++j)
+      {
+        auto msg = std::make_shared<BenchMessage>();
+        msg->sent = BenchClock::now();
+        msgman.send(topics[i], std::move(msg));
+      }
+    });
+  }
+
+  while (msgman.waitForWork())
+    msgman.notify();
+
+  result.seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+  for (auto& t : threads)
+    t.join();
+
+  return result;
+}
+
+/**
+ * @brief Print one result row.
+ * @param name Backend name.
+ * @param result Timing results.
+ */
+void report(const char name[], BenchResult& result)
+{
+  auto& latencies = result.latencies_us;
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("%-8s %12.0f %10.1f %10.1f %10.1f %10.1f\n", name, latencies.size() / result.seconds,
+              percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999),
+              latencies.empty() ? 0.0 : latencies.back());
+}
+
+}  // namespace soul
+
+///////////////////////////////////////////////////////////////////////////////
+// MAIN                                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  using namespace soul;
+
+  const int producers = argc > 1 ? std::max(1, std::atoi(argv[1])) : 4;
+  const int messages = argc > 2 ? std::max(1, std::atoi(argv[2])) : 250000;
+
+  std::printf("%d producers, %d messages\n", producers, messages);
+  std::printf("%-8s %12s %10s %10s %10s %10s\n", "backend", "msgs/s", "p50 us", "p99 us", "p99.9 us", "max us");
+
+  QueueOptions locked;
+  locked.backend = QueueBackend::locked;
+  auto locked_result = runBenchmark(locked, producers, messages);
+  report("locked", locked_result);
+
+  QueueOptions ring;
+  ring.backend = QueueBackend::ring;
+  ring.capacity = 4096;
+  ring.overflow = OverflowPolicy::block;
+  auto ring_result = runBenchmark(ring, producers, messages);
+  report("ring", ring_result);
+
+  return 0;
+}
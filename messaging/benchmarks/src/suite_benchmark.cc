@@ -0,0 +1,395 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Messaging benchmark suite.
+ *
+ * Runs the MessageManager through a set of scenarios, once per queue backend:
+ *
+ *   throughput  several producers sending as fast as they can
+ *   latency     one message in flight at a time, so no queueing delay
+ *   fanout      one topic with a growing number of subscribers
+ *   topics      the same load spread over a growing number of topics
+ *   producers   the same load sent from a growing number of threads
+ *   recording   the throughput run with a recorder writing every message
+ *
+ * Latency is measured from send() to the last subscriber's callback on the
+ * topic. Results go to stdout or a file as a table, JSON or CSV.
+ *
+ * Usage: messaging_suite_benchmark [--suite name|all] [--messages N] [--format table|json|csv] [--output file]
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/manager.h>
+#include <soul/messaging/recorder.h>
+#include "benchmark_report.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+using BenchClock = std::chrono::steady_clock;
+
+/** Message that remembers when it was sent. */
+struct BenchMessage : public MessageInterface
+{
+  BenchClock::time_point sent;
+};
+
+/** One benchmark run. */
+struct Scenario
+{
+  std::string suite;         ///< Suite the run belongs to.
+  QueueOptions queue;        ///< Queue options for every topic.
+  int producers = 1;         ///< Producer threads.
+  int topics = 1;            ///< Topics. Each producer sends to every topic in turn.
+  int subscribers = 1;       ///< Subscribers per topic.
+  std::size_t messages = 0;  ///< Messages sent in total.
+  bool paced = false;        ///< Wait for each message to be delivered before sending the next.
+  bool record = false;       ///< Record every topic to a file while running.
+};
+
+/** Command line settings. */
+struct Settings
+{
+  std::string suite = "all";                  ///< Suite to run.
+  std::size_t messages = 100000;              ///< Messages per run.
+  ReportFormat format = ReportFormat::table;  ///< Output format.
+  std::string output;                         ///< Output file. Empty for stdout.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get a backend's name.
+ * @param backend Backend.
+ * @return Name.
+ */
+const char* backendName(const QueueBackend backend)
+{
+  switch (backend)
+  {
+    case QueueBackend::ring:
+      return "ring";
+
+    case QueueBackend::latest:
+      return "latest";
+
+    default:
+      return "locked";
+  }
+}
+
+/**
+ * @brief Run one scenario. Producers send on their own threads, callbacks run on this thread.
+ * @param scenario Scenario.
+ * @return Results.
+ */
+BenchmarkRow run(const Scenario& scenario)
+{
+  MessageManager msgman;
+
+  BenchmarkRow row;
+  row.suite = scenario.suite;
+  row.backend = backendName(scenario.queue.backend);
+  row.producers = scenario.producers;
+  row.topics = scenario.topics;
+  row.subscribers = scenario.subscribers;
+  row.messages = scenario.messages;
+
+  std::vector<double> latencies_us;
+  latencies_us.reserve(scenario.messages);
+
+  std::atomic<std::size_t> delivered(0);
+  std::size_t callbacks = 0;
+
+  // handles[p][t] is producer p's handle for topic t.
+  std::vector<std::vector<Topic<BenchMessage>>> handles(scenario.producers);
+
+  for (int t = 0; t < scenario.topics; ++t)
+  {
+    const auto msg_id = "bench" + std::to_string(t);
+
+    for (int p = 0; p < scenario.producers; ++p)
+    {
+      MessagePublisher pub("producer" + std::to_string(p));
+      pub.queue = scenario.queue;
+      handles[p].push_back(msgman.publish<BenchMessage>(msg_id, pub));
+    }
+
+    // Every subscriber does the same small amount of work so fan-out cost is visible. The last one records latency,
+    // since a message is only fully delivered once it has run.
+    for (int s = 0; s < scenario.subscribers - 1; ++s)
+    {
+      msgman.subscribe<BenchMessage>(msg_id, "subscriber" + std::to_string(s),
+                                     [&callbacks](std::shared_ptr<const BenchMessage>) { ++callbacks; });
+    }
+
+    msgman.subscribe<BenchMessage>(msg_id, "recorder", [&](std::shared_ptr<const BenchMessage> msg) {
+      const auto now = BenchClock::now();
+      latencies_us.push_back(std::chrono::duration<double, std::micro>(now - msg->sent).count());
+      ++callbacks;
+
+      if (++delivered == scenario.messages)
+        msgman.setWork(false);
+    });
+  }
+
+  // The recorder subscribes last, so its enqueue cost is on top of the latency measured above.
+  const std::string recording = "messaging_suite_benchmark.rec";
+  std::unique_ptr<MessageRecorder> recorder;
+
+  if (scenario.record)
+  {
+    MessageCodec codec;
+    codec.size = [](const MessageInterface&) { return sizeof(BenchClock::time_point); };
+    codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+      std::memcpy(dst, &static_cast<const BenchMessage&>(msg).sent, sizeof(BenchClock::time_point));
+    };
+
+    recorder = std::make_unique<MessageRecorder>(msgman, recording);
+    for (int t = 0; t < scenario.topics; ++t)
+      recorder->record("bench" + std::to_string(t), codec);
+  }
+
+  const std::size_t per_producer = scenario.messages / scenario.producers;
+  const auto start = BenchClock::now();
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < scenario.producers; ++p)
+  {
+    const auto count = p == scenario.producers - 1 ? scenario.messages - per_producer * p : per_producer;
+    const auto& topics = handles[p];
+
+    threads.emplace_back([&msgman, &delivered, &topics, &scenario, count]() {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        const auto before = delivered.load();
+
+        auto msg = std::make_shared<BenchMessage>();
+        msg->sent = BenchClock::now();
+        msgman.send(topics[i % topics.size()], std::move(msg));
+
+        if (scenario.paced)
+        {
+          while (delivered.load() == before)
+            std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  while (msgman.waitForWork())
+    msgman.notify();
+
+  const auto seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+  for (auto& t : threads)
+    t.join();
+
+  if (callbacks != scenario.messages * scenario.subscribers)
+  {
+    std::fprintf(stderr, "%s/%s: expected %zu callbacks, got %zu\n", row.suite.c_str(), row.backend.c_str(),
+                 scenario.messages * scenario.subscribers, callbacks);
+  }
+
+  if (recorder)
+  {
+    recorder->close();
+
+    if (recorder->getDropped() > 0)
+    {
+      std::fprintf(stderr, "%s/%s: recorder dropped %llu messages\n", row.suite.c_str(), row.backend.c_str(),
+                   static_cast<unsigned long long>(recorder->getDropped()));
+    }
+
+    std::remove(recording.c_str());
+  }
+
+  summarise(row, seconds, latencies_us);
+  return row;
+}
+
+/**
+ * @brief Build the scenarios for the selected suite, once per queue backend.
+ * @param settings Command line settings.
+ * @return Scenarios.
+ */
+std::vector<Scenario> scenarios(const Settings& settings)
+{
+  std::vector<Scenario> list;
+
+  const auto add = [&](const std::string& suite, const int producers, const int topics, const int subscribers,
+                       const std::size_t messages, const bool paced, const bool record = false) {
+    if (settings.suite != "all" && settings.suite != suite)
+      return;
+
+    for (const auto backend : { QueueBackend::locked, QueueBackend::ring })
+    {
+      Scenario scenario;
+      scenario.suite = suite;
+      scenario.queue.backend = backend;
+      scenario.queue.capacity = backend == QueueBackend::ring ? 4096 : 0;
+      scenario.queue.overflow = OverflowPolicy::block;  // Every message is counted, so producers wait for space.
+      scenario.producers = producers;
+      scenario.topics = topics;
+      scenario.subscribers = subscribers;
+      scenario.messages = messages;
+      scenario.paced = paced;
+      scenario.record = record;
+      list.push_back(scenario);
+    }
+  };
+
+  const auto n = settings.messages;
+
+  add("throughput", 4, 1, 1, n, false);
+
+  // Each paced message costs a thread handoff, so fewer of them.
+  add("latency", 1, 1, 1, std::max<std::size_t>(1, n / 10), true);
+
+  for (const int subscribers : { 1, 2, 4, 8, 16, 32 })
+    add("fanout", 1, 1, subscribers, n, false);
+
+  for (const int topics : { 1, 10, 100, 1000 })
+    add("topics", 1, topics, 1, n, false);
+
+  for (const int producers : { 1, 2, 4, 8 })
+    add("producers", producers, 1, 1, n, false);
+
+  add("recording", 4, 1, 1, n, false, true);
+
+  return list;
+}
+
+/**
+ * @brief Parse the command line.
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @param settings Filled in from the arguments.
+ * @return False if the arguments are invalid.
+ */
+bool parse(const int argc, char* argv[], Settings& settings)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+
+    if (i + 1 >= argc)
+      return false;
+
+    const std::string value = argv[++i];
+
+    if (arg == "--suite")
+    {
+      settings.suite = value;
+    }
+    else if (arg == "--messages")
+    {
+      const long messages = std::atol(value.c_str());
+      if (messages <= 0)
+        return false;
+      settings.messages = static_cast<std::size_t>(messages);
+    }
+    else if (arg == "--format")
+    {
+      if (value == "table")
+        settings.format = ReportFormat::table;
+      else if (value == "json")
+        settings.format = ReportFormat::json;
+      else if (value == "csv")
+        settings.format = ReportFormat::csv;
+      else
+        return false;
+    }
+    else if (arg == "--output")
+    {
+      settings.output = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace soul
+
+///////////////////////////////////////////////////////////////////////////////
+// MAIN                                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  using namespace soul;
+
+  Settings settings;
+  if (!parse(argc, argv, settings))
+  {
+    std::fprintf(stderr, "Usage: %s [--suite throughput|latency|fanout|topics|producers|recording|all] "
+                         "[--messages N] [--format table|json|csv] [--output file]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  const auto list = scenarios(settings);
+  if (list.empty())
+  {
+    std::fprintf(stderr, "Unknown suite %s\n", settings.suite.c_str());
+    return 1;
+  }
+
+  std::FILE* out = stdout;
+  if (!settings.output.empty())
+  {
+    out = std::fopen(settings.output.c_str(), "w");
+    if (out == nullptr)
+    {
+      std::fprintf(stderr, "Cannot open %s: %s\n", settings.output.c_str(), std::strerror(errno));
+      return 1;
+    }
+  }
+
+  writeHeader(out, settings.format, "messaging_suite_benchmark");
+
+  bool first = true;
+  for (const auto& scenario : list)
+  {
+    writeRow(out, settings.format, run(scenario), first);
+    first = false;
+  }
+
+  writeFooter(out, settings.format);
+
+  if (out != stdout)
+    std::fclose(out);
+
+  return 0;
+}
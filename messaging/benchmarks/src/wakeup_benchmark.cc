@@ -0,0 +1,105 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Event loop wakeup benchmark.
+ *
+ * Sends single messages with idle gaps in between, so the event loop is asleep
+ * in waitForWork() every time a message arrives, and prints a histogram of the
+ * send-to-callback latency.
+ *
+ * Usage: messaging_wakeup_benchmark [messages] [gap_us]
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/manager.h>
+#include "benchmark_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+using BenchClock = std::chrono::steady_clock;
+
+/** Message that remembers when it was sent. */
+struct BenchMessage : public MessageInterface
+{
+  BenchClock::time_point sent;
+};
+
+}  // namespace soul
+
+///////////////////////////////////////////////////////////////////////////////
+// MAIN                                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  using namespace soul;
+
+  const int messages = argc > 1 ? std::max(1, std::atoi(argv[1])) : 2000;
+  const int gap_us = argc > 2 ? std::max(0, std::atoi(argv[2])) : 500;
+
+  MessageManager msgman;
+  auto topic = msgman.publish("bench", "producer");
+
+  std::vector<double> latencies_us;
+  latencies_us.reserve(messages);
+  std::atomic<int> received(0);
+
+  msgman.subscribe("bench", "consumer", [&](std::shared_ptr<MessageInterface> msg) {
+    const auto now = BenchClock::now();
+    const auto& bench_msg = static_cast<const BenchMessage&>(*msg);
+    latencies_us.push_back(std::chrono::duration<double, std::micro>(now - bench_msg.sent).count());
+    ++received;
+  });
+
+  std::thread loop([&msgman]() {
+    while (msgman.waitForWork())
+      msgman.notify();
+  });
+
+  for (int i = 0; i < messages; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(gap_us));
+
+    auto msg = std::make_shared<BenchMessage>();
+    msg->sent = BenchClock::now();
+    msgman.send(topic, std::move(msg));
+
+    // Keep exactly one message in flight so every send finds the loop asleep.
+    while (received <= i)
+      std::this_thread::yield();
+  }
+
+  msgman.setWork(false);
+  loop.join();
+
+  std::sort(latencies_us.begin(), latencies_us.end());
+
+  std::printf("%d messages, %d us apart\n", messages, gap_us);
+  std::printf("p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", percentile(latencies_us, 0.5),
+              percentile(latencies_us, 0.99), percentile(latencies_us, 0.999), latencies_us.back());
+  printHistogram(latencies_us);
+
+  return 0;
+}
@@ -0,0 +1,423 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_BRIDGE_H_
+#define SOUL_MESSAGING_BRIDGE_H_
+
+/*
+ * Message bridge.
+ *
+ * Exports topics to other processes over a Unix-domain or TCP socket. The
+ * subscriber callback only pushes the message onto a lock-free queue. An I/O
+ * thread encodes each message once with its topic's codec and queues the frame
+ * for every connected client. Client sockets are non-blocking and each client
+ * has a bounded backlog: frames for a client that has fallen that far behind
+ * are dropped and counted, so a slow or stuck client holds up neither the
+ * event loop nor the other clients.
+ *
+ * Whatever has queued up for a client since the I/O thread last woke goes out
+ * in one sendmsg() call, and TCP sockets have Nagle's algorithm turned off, so
+ * a burst leaves in as few packets as possible without waiting on
+ * acknowledgements.
+ *
+ * Stream layout, all integers little-endian:
+ *
+ *   BridgeHello          Once, on connect.
+ *   frame*               BridgeFrameHeader, then size bytes of payload.
+ *
+ * Topic frames carry the topic name and come before the first message frame
+ * on the topic. Message frames carry the message as the topic's codec encodes
+ * it. Frames are never cut short: a client gets a whole frame or none of it.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/codec.h>
+#include <soul/messaging/manager.h>
+#include <soul/messaging/metrics.h>
+#include <soul/messaging/ring_buffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Bridge protocol version. */
+constexpr std::uint32_t bridge_version_ = 1;
+
+/** Magic at the start of a bridge stream. */
+constexpr char bridge_magic_[8] = { 'S', 'O', 'U', 'L', 'B', 'R', 'G', '\0' };
+
+/**
+ * @brief What a frame holds.
+ */
+enum class BridgeFrameKind : std::uint32_t
+{
+  topic = 0,    ///< Topic name for the topic number.
+  message = 1,  ///< Encoded message.
+};
+
+/** Start of a bridge stream. */
+struct BridgeHello
+{
+  char magic[8];           ///< bridge_magic_.
+  std::uint32_t version;   ///< bridge_version_.
+  std::uint32_t reserved;  ///< 0.
+};
+
+/** Start of a frame. */
+struct BridgeFrameHeader
+{
+  std::uint64_t size;         ///< Payload bytes that follow.
+  std::uint32_t kind;         ///< BridgeFrameKind.
+  std::uint32_t topic;        ///< Topic number.
+  std::int64_t timestamp_ns;  ///< Capture time of the message, nanoseconds since the epoch. 0 if it had none.
+};
+
+/**
+ * @brief Bridge configuration.
+ */
+struct BridgeOptions
+{
+  /** Subscriber name the bridge uses. Also labels its metrics. */
+  std::string name = "bridge";
+
+  /** Messages waiting for the I/O thread. Messages beyond that are dropped and counted. */
+  std::size_t queue_capacity = 4096;
+
+  /** Frame bytes waiting for a client before further frames for it are dropped. A lone frame always fits. */
+  std::size_t client_backlog = 8 << 20;
+
+  /** Kernel send buffer of client sockets (SO_SNDBUF). 0 keeps the system default. */
+  int socket_buffer_size = 0;
+};
+
+/**
+ * @brief A message received from a bridge.
+ */
+struct BridgeMessage
+{
+  std::string msg_id;                        ///< Topic.
+  std::int64_t timestamp_ns = 0;             ///< Capture time, 0 if the message had none.
+  std::size_t size = 0;                      ///< Encoded size.
+  std::shared_ptr<const std::uint8_t> data;  ///< Encoded message, 8 byte aligned. Also the lease to decode it with.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Exports topics over a socket. Thread safe.
+ */
+class MessageBridge final
+{
+public:
+  /**
+   * @brief Constructor. Starts listening and starts the I/O thread.
+   * @param msgman Messaging manager to export from. Must outlive the bridge.
+   * @param address "unix:<path>" or "tcp:<host>:<port>". Port 0 picks a free port. An existing socket file at the
+   * path is replaced.
+   * @param options Configuration.
+   * @throws std::runtime_error if the address is malformed or can't be listened on.
+   */
+  MessageBridge(MessageManager& msgman, const std::string& address, const BridgeOptions& options = BridgeOptions());
+
+  /** Destructor. Closes the bridge. */
+  ~MessageBridge();
+
+  MessageBridge(const MessageBridge&) = delete;
+  MessageBridge& operator=(const MessageBridge&) = delete;
+
+  /**
+   * @brief Start exporting a topic.
+   * @param msg_id Topic.
+   * @param codec Codec for the messages on the topic.
+   * @throws std::runtime_error if the topic is already exported, the codec is incomplete or the bridge is closed.
+   */
+  void exportTopic(const std::string& msg_id, MessageCodec codec);
+
+  /**
+   * @brief Stop exporting, disconnect the clients and stop listening. Frames the clients haven't taken yet are lost.
+   * Further calls do nothing. Must not be called from a subscriber callback.
+   */
+  void close(void);
+
+  /**
+   * @brief Get the address the bridge listens on, with the port filled in for TCP.
+   * @return Address.
+   */
+  const std::string& getAddress(void) const;
+
+  /**
+   * @brief Get the number of connected clients.
+   * @return Clients.
+   */
+  std::size_t getClients(void) const;
+
+  /**
+   * @brief Get the number of messages sent, once per client that got them.
+   * @return Messages.
+   */
+  std::uint64_t getSent(void) const;
+
+  /**
+   * @brief Get the number of messages dropped, once per client that missed them.
+   * @return Messages.
+   */
+  std::uint64_t getDropped(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** An exported topic. */
+  struct Topic
+  {
+    std::string msg_id;    ///< Topic.
+    std::uint32_t number;  ///< Topic number on the stream.
+    MessageCodec codec;    ///< Codec.
+  };
+
+  /** A message waiting for the I/O thread. */
+  struct Pending
+  {
+    Topic* topic = nullptr;                 ///< Topic it came on.
+    std::shared_ptr<MessageInterface> msg;  ///< Message.
+  };
+
+  /** Bytes of a frame, or of the stream header, shared by every client it is queued for. */
+  using Frame = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+  /** A frame waiting to be sent to a client. */
+  struct Queued
+  {
+    Frame frame;   ///< Frame.
+    bool message;  ///< Whether it is a message frame.
+  };
+
+  /** A connected client. I/O thread only. */
+  struct Client
+  {
+    int fd = -1;                ///< Socket.
+    std::deque<Queued> frames;  ///< Frames waiting to be sent.
+    std::size_t offset = 0;     ///< Bytes of the first frame already sent.
+    std::size_t backlog = 0;    ///< Bytes waiting to be sent.
+    bool closed = false;        ///< Whether the client has gone.
+  };
+
+  /**
+   * @brief Hand a message to the I/O thread. Called on the event loop.
+   * @param topic Topic it came on.
+   * @param msg Message.
+   */
+  void enqueue(Topic* topic, std::shared_ptr<MessageInterface> msg);
+
+  /**
+   * @brief Wake the I/O thread, unless a wake-up is already on its way.
+   */
+  void wake(void);
+
+  /**
+   * @brief Serve the clients until stopped.
+   */
+  void run(void);
+
+  /**
+   * @brief Accept every client waiting to connect.
+   */
+  void accept(void);
+
+  /**
+   * @brief Queue topic frames for the topics exported since the last call, for every client.
+   */
+  void announceTopics(void);
+
+  /**
+   * @brief Encode a message into a frame.
+   * @param pending Message.
+   * @return Frame, or nullptr if the codec failed.
+   */
+  Frame makeFrame(const Pending& pending);
+
+  /**
+   * @brief Queue a frame for a client. Message frames are dropped instead if the client is too far behind.
+   * @param client Client.
+   * @param frame Frame.
+   * @param message Whether it is a message frame.
+   */
+  void queueFrame(Client& client, const Frame& frame, const bool message);
+
+  /**
+   * @brief Send as much of a client's frames as its socket takes. Marks the client closed on errors.
+   * @param client Client.
+   */
+  void flush(Client& client);
+
+  /**
+   * @brief Read and discard what a client sent. Marks the client closed when it has hung up.
+   * @param client Client.
+   */
+  void drain(Client& client);
+
+  /**
+   * @brief Start listening.
+   * @param address Address.
+   */
+  void listen(const std::string& address);
+
+  /**
+   * @brief Release what the constructor has set up so far and complain.
+   * @param what What is wrong.
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] void fail(const std::string& what);
+
+  /** Messaging manager. */
+  MessageManager& msgman_;
+
+  /** Configuration. */
+  const BridgeOptions options_;
+
+  /** Address listened on. */
+  std::string address_;
+
+  /** Socket file to remove on close, for Unix-domain sockets. */
+  std::string unix_path_;
+
+  /** Whether client sockets are TCP. */
+  bool tcp_;
+
+  /** Listening socket. */
+  int listen_fd_;
+
+  /** eventfd that wakes the I/O thread. */
+  int wake_fd_;
+
+  /** Lock for topics_ and closed_. */
+  std::mutex lock_;
+
+  /** Exported topics, in topic number order. */
+  std::vector<std::unique_ptr<Topic>> topics_;
+
+  /** Whether close() has been called. */
+  bool closed_;
+
+  /** Messages on their way to the I/O thread. */
+  RingBuffer<Pending> queue_;
+
+  /** Whether wake_fd_ has been written since the I/O thread last looked. Saves a syscall per message. */
+  std::atomic<bool> wake_pending_;
+
+  /** Tells the I/O thread to finish. */
+  std::atomic<bool> stop_;
+
+  /** Connected clients. */
+  MetricGauge& clients_gauge_;
+
+  /** Messages sent. */
+  MetricCounter& sent_;
+
+  /** Messages dropped. */
+  MetricCounter& dropped_;
+
+  /** Topic frames of the topics announced so far. I/O thread only. */
+  std::vector<Frame> topic_frames_;
+
+  /** Connected clients. I/O thread only. */
+  std::vector<std::unique_ptr<Client>> clients_;
+
+  /** Number of connected clients, for getClients(). */
+  std::atomic<std::size_t> client_count_;
+
+  /** I/O thread. */
+  std::thread thread_;
+};
+
+/**
+ * @brief Receives messages from a bridge. A minimal client for tests and for other processes to build on. Not thread
+ * safe.
+ */
+class MessageBridgeClient final
+{
+public:
+  /**
+   * @brief Constructor. Connects and reads the stream header.
+   * @param address Address the bridge listens on (see MessageBridge).
+   * @throws std::runtime_error if the bridge can't be reached or doesn't speak the protocol.
+   */
+  explicit MessageBridgeClient(const std::string& address);
+
+  /** Destructor. Disconnects. */
+  ~MessageBridgeClient();
+
+  MessageBridgeClient(const MessageBridgeClient&) = delete;
+  MessageBridgeClient& operator=(const MessageBridgeClient&) = delete;
+
+  /**
+   * @brief Receive the next message.
+   * @param msg Receives the message.
+   * @param timeout Longest time to wait for a message to start arriving.
+   * @return Whether a message arrived in time.
+   * @throws std::runtime_error if the bridge hung up, stalled mid-frame or sent something malformed.
+   */
+  bool read(BridgeMessage& msg, const std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Get the socket, e.g. to poll() it alongside others.
+   * @return Socket.
+   */
+  int getFd(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Read exactly a number of bytes.
+   * @param dst Where to put them.
+   * @param size Number of bytes.
+   * @param timeout Longest time to wait for each part to arrive.
+   * @param start Whether this starts a frame, in which case nothing arriving isn't an error.
+   * @return Whether the bytes arrived. Only false if start is set.
+   */
+  bool readBytes(void* dst, const std::size_t size, const std::chrono::milliseconds timeout, const bool start);
+
+  /**
+   * @brief Disconnect and complain.
+   * @param what What is wrong.
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] void fail(const std::string& what);
+
+  /** Bridge address. */
+  const std::string address_;
+
+  /** Socket. */
+  int fd_;
+
+  /** Topic names by topic number. */
+  std::map<std::uint32_t, std::string> topics_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_BRIDGE_H_
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_CODEC_H_
+#define SOUL_MESSAGING_CODEC_H_
+
+/*
+ * Message codec.
+ *
+ * Turns one message type into bytes and back, for anything that moves
+ * messages out of the process or onto disk: the shared memory transport, the
+ * recorder and the replay.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/interface.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Converts one message type to and from a buffer.
+ */
+struct MessageCodec
+{
+  /** Number of bytes encode() writes for a message. */
+  std::function<std::size_t(const MessageInterface& msg)> size;
+
+  /** Write a message into a buffer with room for size(msg) bytes. */
+  std::function<void(const MessageInterface& msg, std::uint8_t* dst)> encode;
+
+  /**
+   * Build a message from a buffer. The buffer is read-only and stays valid for as long as the lease is alive, so
+   * zero-copy messages must keep the lease with them. The buffer may come from another process: check every length
+   * and offset in it against size, and throw std::runtime_error to reject it.
+   */
+  std::function<std::shared_ptr<MessageInterface>(const std::uint8_t* src, const std::size_t size,
+                                                   std::shared_ptr<const void> lease)>
+      decode;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_CODEC_H_
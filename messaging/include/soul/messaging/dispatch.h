@@ -0,0 +1,225 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_DISPATCH_H_
+#define SOUL_MESSAGING_DISPATCH_H_
+
+/*
+ * Subscriber dispatch.
+ *
+ * Pooled subscribers get their callbacks run on a dispatch executor instead of
+ * the thread calling MessageManager::notify(). Each pooled subscriber has a
+ * strand that feeds its messages to the executor one batch at a time, so
+ * different subscribers run concurrently while each one still sees its
+ * messages in order.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/interface.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// INTERFACE                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Runs subscriber callbacks for the messaging manager. Implement this to plug in a different thread pool.
+ */
+class DispatchExecutor
+{
+public:
+  /** Virtual destructor. */
+  virtual ~DispatchExecutor() = default;
+
+  /**
+   * @brief Queue a task to run. Tasks may run concurrently and in any order.
+   * @param task Task to run.
+   */
+  virtual void post(std::function<void()> task) = 0;
+
+  /**
+   * @brief Block until every posted task has finished. Must not be called from a task.
+   */
+  virtual void drain(void) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Serialises one subscriber's callbacks on an executor.
+ */
+class DispatchStrand : public std::enable_shared_from_this<DispatchStrand>
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param cb Subscriber callback.
+   */
+  explicit DispatchStrand(MessageReceivedCb cb);
+
+  /**
+   * @brief Constructor for batch subscribers. Messages that queued up while the callback was busy arrive together.
+   * @param batch_cb Subscriber callback.
+   */
+  explicit DispatchStrand(MessageBatchCb batch_cb);
+
+  /**
+   * @brief Queue messages for the subscriber and schedule the strand on the executor if it isn't already.
+   * @param executor Executor to run the callbacks on.
+   * @param msgs Messages in the order they should be delivered.
+   */
+  void post(DispatchExecutor& executor, const std::vector<std::shared_ptr<MessageInterface>>& msgs);
+
+  /**
+   * @brief Block until every message posted so far has been delivered. Must not be called from the strand's callback.
+   */
+  void drain(void);
+
+  /**
+   * @brief Drain, then destroy the callback on this thread. A finished task may still hold the strand for a moment,
+   * and without this it would be the one to destroy the callback, possibly after the subscriber's code is gone.
+   * Messages posted afterwards are discarded. Must not be called from the strand's callback.
+   */
+  void close(void);
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Deliver queued messages until there are none left.
+   */
+  void run(void);
+
+  /** Subscriber callback. */
+  MessageReceivedCb cb_;
+
+  /** Batch subscriber callback. Used instead of cb_ if set. */
+  MessageBatchCb batch_cb_;
+
+  /** Lock for pending_, scheduled_ and closed_. */
+  std::mutex lock_;
+
+  /** Messages waiting to be delivered. */
+  std::vector<std::shared_ptr<MessageInterface>> pending_;
+
+  /** Whether a run() task is queued or running. */
+  bool scheduled_;
+
+  /** Whether close() has dropped the callbacks. */
+  bool closed_;
+
+  /** Signalled when the strand runs out of messages. */
+  std::condition_variable idle_cond_;
+};
+
+/**
+ * @brief Fixed size thread pool. Each worker has its own task deque and steals from the others when it runs dry.
+ */
+class WorkStealingPool : public DispatchExecutor
+{
+public:
+  /**
+   * @brief Constructor. Starts the workers.
+   * @param workers Number of worker threads. 0 uses the number of hardware threads.
+   */
+  explicit WorkStealingPool(const std::size_t workers = 0);
+
+  /** Destructor. Finishes the queued tasks and stops the workers. */
+  ~WorkStealingPool() override;
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  /**
+   * @brief Queue a task. Tasks posted from a worker go on that worker's deque, other tasks are spread round robin.
+   * @param task Task to run.
+   */
+  void post(std::function<void()> task) override;
+
+  /**
+   * @brief Block until every posted task has finished.
+   */
+  void drain(void) override;
+
+  /**
+   * @brief Get the number of worker threads.
+   * @return Number of workers.
+   */
+  std::size_t getWorkerCount(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Per worker task deque. The owner pops from the back, thieves take from the front. */
+  struct Worker
+  {
+    std::mutex lock;                            ///< Deque lock.
+    std::deque<std::function<void()>> tasks;  ///< Queued tasks.
+  };
+
+  /**
+   * @brief Worker thread body.
+   * @param index Index of the worker.
+   */
+  void workerLoop(const std::size_t index);
+
+  /**
+   * @brief Take a task from a worker's own deque, or steal one.
+   * @param index Index of the worker.
+   * @param task Receives the task.
+   * @return True if a task was found.
+   */
+  bool popTask(const std::size_t index, std::function<void()>& task);
+
+  /** Worker deques. */
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  /** Worker threads. */
+  std::vector<std::thread> threads_;
+
+  /** Round robin counter for tasks posted from outside the pool. */
+  std::atomic<std::size_t> next_;
+
+  /** Lock for the counters and stop flag. */
+  std::mutex state_lock_;
+
+  /** Wakes idle workers. */
+  std::condition_variable work_cond_;
+
+  /** Wakes drain(). */
+  std::condition_variable drained_cond_;
+
+  /** Number of tasks sitting in the deques. */
+  std::size_t queued_;
+
+  /** Number of tasks posted but not yet finished. */
+  std::size_t unfinished_;
+
+  /** Whether the workers should exit. */
+  bool stop_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_DISPATCH_H_
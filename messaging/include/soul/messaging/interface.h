@@ -19,6 +19,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 
@@ -37,6 +39,11 @@ struct MessageInterface;
 /** Callback function to invoke to notify subscribers of messages of new messages. */
 using MessageReceivedCb = std::function<void(std::shared_ptr<MessageInterface>)>;
 
+class MessageBatch;
+
+/** Callback for subscribers that take all the messages notify() drained from a topic in one call. */
+using MessageBatchCb = std::function<void(const MessageBatch&)>;
+
 /** Function that can send Soul messages. */
 using MessageSenderFn =
     std::function<void(const std::string msg_id, const std::string plugin_name, std::shared_ptr<MessageInterface>)>;
@@ -57,8 +64,109 @@ struct MessageInterface
    */
   virtual ~MessageInterface() = default;
 
-  /** Time stamp. */
+  /** Time stamp. Sensor messages set it to the capture time. */
   std::chrono::system_clock::time_point timestamp;
+
+  /**
+   * Trace the message belongs to. 0 until the message is sent while tracing is on, then a new ID. Copy it with
+   * inheritTrace() to put a message on the trace of the one it was derived from. The tracer sets it atomically, so
+   * only write it before the message is sent.
+   */
+  std::uint64_t trace_id = 0;
+};
+
+/**
+ * @brief Put a message on the trace of the message it was derived from, e.g., a face detection on its image's trace.
+ * Messages with the same capture time are not linked otherwise, since unrelated ones can share it.
+ * @param derived Derived message.
+ * @param source Message it was computed from.
+ */
+inline void inheritTrace(MessageInterface& derived, const MessageInterface& source)
+{
+  derived.timestamp = source.timestamp;
+  derived.trace_id = source.trace_id;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Messages handed to a batch subscriber, oldest first. A view of the messaging manager's storage: it is only
+ * valid during the callback, so copy out the messages you want to keep.
+ */
+class MessageBatch
+{
+public:
+  /** Element type. */
+  using value_type = std::shared_ptr<MessageInterface>;
+
+  /** Iterator type. */
+  using const_iterator = const value_type*;
+
+  /**
+   * @brief Constructor.
+   * @param data First message.
+   * @param size Number of messages.
+   */
+  MessageBatch(const value_type* data, const std::size_t size) : data_(data), size_(size)
+  {
+  }
+
+  /**
+   * @brief Get the number of messages.
+   * @return Number of messages.
+   */
+  std::size_t size(void) const
+  {
+    return size_;
+  }
+
+  /**
+   * @brief Indicate whether the batch is empty.
+   * @return True if there are no messages.
+   */
+  bool empty(void) const
+  {
+    return size_ == 0;
+  }
+
+  /**
+   * @brief Access a message.
+   * @param i Index, oldest first.
+   * @return Message.
+   */
+  const value_type& operator[](const std::size_t i) const
+  {
+    return data_[i];
+  }
+
+  /**
+   * @brief Get an iterator to the oldest message.
+   * @return Iterator.
+   */
+  const_iterator begin(void) const
+  {
+    return data_;
+  }
+
+  /**
+   * @brief Get an iterator past the newest message.
+   * @return Iterator.
+   */
+  const_iterator end(void) const
+  {
+    return data_ + size_;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** First message. */
+  const value_type* data_;
+
+  /** Number of messages. */
+  std::size_t size_;
 };
 
 }  // namespace soul
@@ -15,6 +15,10 @@
 
 #include <soul/messaging/interface.h>
 
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -34,22 +38,28 @@ namespace soul
  * @tparam T Message type you want to turn into a list message.
  */
 template <typename T>
-class ListMessage : MessageInterface
+class ListMessage : public MessageInterface
 {
 public:
   /**
-   * @brief Constructor.
+   * @brief Constructor. Lists of messages go on the trace of their first item, so a list derived from a capture stays
+   * on that capture's trace.
    * @param items The items to send.
    */
-  explicit ListMessage(const std::vector<T> items) : items_(items)
+  explicit ListMessage(std::vector<T> items) : items_(std::move(items))
   {
+    if constexpr (std::is_base_of<MessageInterface, T>::value)
+    {
+      if (!items_.empty())
+        inheritTrace(*this, items_.front());
+    }
   }
 
   /**
    * @brief Get the items.
    * @return the items.
    */
-  std::vector<T> getItems() const
+  const std::vector<T>& getItems() const
   {
     return items_;
   }
@@ -24,17 +24,29 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/messaging/dispatch.h>
 #include <soul/messaging/interface.h>
 #include <soul/messaging/message_publisher.h>
 #include <soul/messaging/message_subscriber.h>
+#include <soul/messaging/message_topic.h>
+#include <soul/messaging/metrics.h>
+#include <soul/messaging/notifier.h>
 #include <soul/messaging/queue.h>
+#include <soul/messaging/topic.h>
+#include <soul/messaging/topic_handle.h>
+#include <soul/messaging/trace.h>
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -49,6 +61,9 @@ namespace soul
 // CUSTOM DEFINITIONS                                                        //
 ///////////////////////////////////////////////////////////////////////////////
 
+/** Signature for the callback invoked when a new subscriber appears on a msg_id. */
+using SubscriptionCb = std::function<void(const std::string& msg_id, const std::string& subscriber_name)>;
+
 ///////////////////////////////////////////////////////////////////////////////
 // CLASS DEFINITION                                                          //
 ///////////////////////////////////////////////////////////////////////////////
@@ -59,6 +74,9 @@ public:
   /** Constructor */
   explicit MessageManager();
 
+  /** Destructor. Waits for pooled callbacks that are still running. */
+  ~MessageManager();
+
   /**
    * @brief Clear all queues, publishers, and subscribers.  This helps with
    * controlling cleanup. We need to destruct any objects that might have been
@@ -66,6 +84,12 @@ public:
    */
   void clear(void);
 
+  /**
+   * @brief Get the number of messages each queue's overflow policy has dropped.
+   * @return Map from msg_id to the number of dropped messages.
+   */
+  std::unordered_map<std::string, std::uint64_t> getDropped(void);
+
   /**
    * @brief Get a list of publishers.
    * @return List of publishers.
@@ -73,7 +97,22 @@ public:
   std::vector<MessagePublisher> getPublishers(void);
 
   /**
-   * @brief Notify all subscribers.
+   * @brief Get a message sending function bound to this manager. Plugins get given this.
+   * @return Message sending function.
+   */
+  MessageSenderFn getSender(void);
+
+  /**
+   * @brief Get a message sending function that sends on handles publish() returned, so a plugin's sends skip the
+   * manager lock and the publisher lookups. Sends the handles don't cover take the same path as getSender().
+   * @param handles Handles for the topics the plugin publishes to.
+   * @return Message sending function.
+   */
+  MessageSenderFn getSender(const std::vector<TopicHandle>& handles);
+
+  /**
+   * @brief Notify the subscribers of topics with pending messages. Pooled subscribers are handed to the dispatch
+   * executor, so their callbacks may still be running when this returns. Direct subscribers are called on this thread.
    */
   void notify(void);
 
@@ -82,16 +121,147 @@ public:
    * message queue if it doesn't already exist.
    * @param msg_id Name of the messaging queue.
    * @param pub Publishing information.
+   * @return Handle that lets pub send to msg_id without any further lookups.
    */
-  void publish(const std::string msg_id, const MessagePublisher pub);
+  TopicHandle publish(const std::string msg_id, const MessagePublisher pub);
+
+  /**
+   * @brief Announce publication of T messages to a msg_id. The first typed publisher or subscriber fixes the type of
+   * the msg_id.
+   * @tparam T Message type.
+   * @param msg_id Name of the messaging queue.
+   * @param pub Publishing information.
+   * @return Typed handle for sending.
+   * @throws std::runtime_error if msg_id already carries a different type.
+   */
+  template <typename T>
+  Topic<T> publish(const std::string msg_id, const MessagePublisher pub)
+  {
+    return Topic<T>(registerPublisher(msg_id, pub, &typeid(T)));
+  }
 
   /**
    * @brief Announce subscription to a msg_id.
    * @param msg_id Name of the messaging queue.
    * @param plugin_name Name of the subscribing plugin.
    * @param cb Callback from subscriber for when a new message is received.
+   * @param mode Where the callback runs. Pooled callbacks for one subscriber still run one at a time, in order.
+   */
+  void subscribe(const std::string msg_id, const std::string plugin_name, MessageReceivedCb cb,
+                 const DispatchMode mode = DispatchMode::direct);
+
+  /**
+   * @brief Announce subscription to T messages on a msg_id. The callback gets the message without any casting.
+   * @tparam T Message type.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the subscribing plugin.
+   * @param cb Callback from subscriber for when a new message is received.
+   * @param mode Where the callback runs.
+   * @throws std::runtime_error if msg_id already carries a different type.
+   */
+  template <typename T>
+  void subscribe(const std::string msg_id, const std::string plugin_name, TypedMessageReceivedCb<T> cb,
+                 const DispatchMode mode = DispatchMode::direct)
+  {
+    static_assert(std::is_base_of<MessageInterface, T>::value, "Topic message types must derive from MessageInterface");
+
+    MessageReceivedCb untyped;
+
+    // Registration guarantees every message on the topic is a T.
+    if (cb != nullptr)
+      untyped = [cb](std::shared_ptr<MessageInterface> msg) { cb(std::static_pointer_cast<const T>(msg)); };
+
+    registerSubscriber(MessageSubscriber(msg_id, plugin_name, std::move(untyped), mode), &typeid(T));
+  }
+
+  /**
+   * @brief Announce subscription to a msg_id with a callback that takes every message notify() drained from the queue
+   * at once, e.g., to run a batched forward pass. Saves a callback and a shared pointer copy per message.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the subscribing plugin.
+   * @param cb Callback for new messages, oldest first.
+   * @param mode Where the callback runs. Pooled batches also take in messages that arrived while the last batch ran.
+   */
+  void subscribeBatch(const std::string msg_id, const std::string plugin_name, MessageBatchCb cb,
+                      const DispatchMode mode = DispatchMode::direct);
+
+  /**
+   * @brief Announce batch subscription to T messages on a msg_id. The callback gets the messages without any casting.
+   * @tparam T Message type.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the subscribing plugin.
+   * @param cb Callback for new messages, oldest first.
+   * @param mode Where the callback runs.
+   * @throws std::runtime_error if msg_id already carries a different type.
    */
-  void subscribe(const std::string msg_id, const std::string plugin_name, MessageReceivedCb cb);
+  template <typename T>
+  void subscribeBatch(const std::string msg_id, const std::string plugin_name, TypedMessageBatchCb<T> cb,
+                      const DispatchMode mode = DispatchMode::direct)
+  {
+    static_assert(std::is_base_of<MessageInterface, T>::value, "Topic message types must derive from MessageInterface");
+
+    MessageSubscriber sub(msg_id, plugin_name, nullptr, mode);
+
+    // Registration guarantees every message on the topic is a T.
+    if (cb != nullptr)
+      sub.batch_cb = [cb](const MessageBatch& batch) { cb(TypedMessageBatch<T>(batch)); };
+
+    registerSubscriber(std::move(sub), &typeid(T));
+  }
+
+  /**
+   * @brief Revoke a subscription. Once this returns the callback isn't running and won't be called again, so whatever
+   * it refers to (e.g., a plugin library) can go. Waits for a delivery in progress on the topic and for the
+   * subscriber's pooled messages; the event loop and other topics keep going meanwhile.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the subscribing plugin.
+   * @return False if plugin_name isn't subscribed to msg_id.
+   * @throws std::runtime_error if called from the thread running notify(), which would wait for itself.
+   */
+  bool unsubscribe(const std::string msg_id, const std::string plugin_name);
+
+  /**
+   * @brief Withdraw a publisher. Handles publish() returned for it become invalid, and sends on them or by name are
+   * refused. Queued messages are still delivered.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the publishing plugin.
+   * @return False if plugin_name doesn't publish to msg_id.
+   */
+  bool unpublish(const std::string msg_id, const std::string plugin_name);
+
+  /**
+   * @brief Set a callback to be called whenever a new subscriber subscribes, e.g., to start whatever publishes to it.
+   * It is called on the subscribing thread after the subscriber is registered, and may subscribe in turn.
+   * @param cb Callback. nullptr to remove it.
+   */
+  void setSubscriptionCallback(SubscriptionCb cb);
+
+  /**
+   * @brief Replace the executor used for pooled subscribers. The old executor is drained first.
+   * By default a WorkStealingPool is created when the first pooled subscriber subscribes.
+   * @param executor Executor to use.
+   */
+  void setExecutor(std::shared_ptr<DispatchExecutor> executor);
+
+  /**
+   * @brief Start or stop tracing. Pooled callbacks in progress are finished first. Swap tracers while no other thread
+   * is sending or notifying, e.g., before the plugins are activated or after the event loop stops.
+   * @param tracer Tracer to record to. nullptr stops tracing, which is the default.
+   */
+  void setTracer(std::shared_ptr<MessageTracer> tracer);
+
+  /**
+   * @brief Get the metrics registry. Always on: per topic message, drop and queue depth counts, and per subscriber
+   * callback times and errors. Other systems can add their own metrics to it.
+   * @return Registry.
+   */
+  std::shared_ptr<MetricsRegistry> getMetrics(void) const;
+
+  /**
+   * @brief Get the tracer, for recording work done on behalf of subscribers outside their callbacks.
+   * @return Tracer, or nullptr if tracing is off.
+   */
+  MessageTracer* getTracer(void) const;
 
   /**
    * @brief Put a message on the relevant message queue. This does not notify the subscribers.
@@ -102,13 +272,76 @@ public:
   void send(const std::string msg_id, const std::string plugin_name, std::shared_ptr<MessageInterface> msg);
 
   /**
-   * @brief Blocks until there is work in the queue to process or if the work flag is set to false.
+   * @brief Put a message on a message queue resolved by publish(). This does not notify the subscribers.
+   * @param topic Handle returned by publish().
+   * @param msg Shared pointer to the message.
+   * @throws std::runtime_error if the handle is invalid.
+   */
+  void send(const TopicHandle& topic, std::shared_ptr<MessageInterface> msg);
+
+  /**
+   * @brief Put a message on a typed topic. The type was checked when the topic was published, so this does no
+   * runtime type checks. This does not notify the subscribers.
+   * @param topic Topic returned by publish<T>().
+   * @param msg Shared pointer to the message.
+   * @throws std::runtime_error if the topic is invalid.
+   */
+  template <typename T>
+  void send(const Topic<T>& topic, std::shared_ptr<typename Topic<T>::message_type> msg)
+  {
+    if (!topic.valid())
+      throw std::runtime_error("Publication request with an invalid topic");
+
+    enqueue(topic.handle_, std::move(msg));
+  }
+
+  /**
+   * @brief Read the newest message on a latest-value topic (QueueBackend::latest) without consuming it, e.g., to sample
+   * camera frames at the consumer's own rate instead of subscribing.
+   * @param msg_id Name of the messaging queue.
+   * @return Newest message, or nullptr if none was sent yet or msg_id isn't a latest-value topic.
+   */
+  std::shared_ptr<MessageInterface> getLatest(const std::string& msg_id);
+
+  /**
+   * @brief Read the newest T message on a latest-value topic without consuming it.
+   * @tparam T Message type.
+   * @param msg_id Name of the messaging queue.
+   * @return Newest message, or nullptr if none was sent yet, msg_id isn't a latest-value topic or it isn't a T.
+   */
+  template <typename T>
+  std::shared_ptr<const T> getLatest(const std::string& msg_id)
+  {
+    return std::dynamic_pointer_cast<const T>(getLatest(msg_id));
+  }
+
+  /**
+   * @brief Drop the newest message a latest-value topic keeps for getLatest(), e.g., before unloading the plugin that
+   * sent it. Until the next send getLatest() returns nullptr. A message not delivered yet is still delivered.
+   * @param msg_id Name of the messaging queue.
+   */
+  void forgetLatest(const std::string& msg_id);
+
+  /**
+   * @brief Wait until the messages already sent to some topics have been handed to their subscribers, pooled ones
+   * included, e.g., after unpublishing a plugin that is about to be unloaded. The event loop must keep calling
+   * notify().
+   * @param msg_ids Topics.
+   * @param timeout Longest time to wait.
+   * @return False if messages were still queued or being delivered when the time ran out.
+   * @throws std::runtime_error if called from the thread running notify(), which would wait for itself.
+   */
+  bool waitForDelivery(const std::vector<std::string>& msg_ids, const std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Blocks until there is work in the queue to process or if the work flag is set to false. Sleeps without
+   * polling while idle and wakes as soon as a message is sent.
    * @return Always Return true so you can use it to condition a loop, except when the work flag has been set to false.
    */
   bool waitForWork(void);
 
   /**
-   * @brief Set the status that waitForWork will return when it unblocks.
+   * @brief Set the status that waitForWork will return when it unblocks. Wakes a blocked waitForWork.
    * @param flag Flag to set work flag to.
    */
   void setWork(const bool flag);
@@ -117,32 +350,150 @@ public:
 private:
 #endif
 
-  /** Default wait time for conditional variable release. */
-  std::chrono::milliseconds wait_time_;
-
-  /** Publisher list. Map from msg_id to set of publishers names. */
-  std::unordered_map<std::string, std::unordered_set<MessagePublisher, MessagePublisherHash>> publishers_;
+  /** Publisher list. Map from msg_id to a map from publisher name to its entry, which the handles share. */
+  std::unordered_map<std::string, std::unordered_map<std::string, std::shared_ptr<PublisherEntry>>> publishers_;
 
   /** Subscriber list. Map from msg_id to a set of subscribers. */
   std::unordered_map<std::string, std::unordered_set<MessageSubscriber, MessageSubscriberHash>> subscribers_;
 
-  /** Map from a msg_id to a message queue. */
-  std::unordered_map<std::string, MessageQueue> queue_;
+  /** Map from a msg_id to its topic. Topics are never removed until clear(), so pointers to them stay valid. */
+  std::unordered_map<std::string, MessageTopic> topics_;
 
   /** Map lock */
   std::mutex mlock_;
 
-  /** Lock for controlling queue access. */
-  std::mutex qlock_;
+  /** Topics with pending messages. */
+  std::vector<MessageTopic*> ready_;
 
-  /** Queue condition variable for notifying emptiness. */
-  std::condition_variable q_cond_var_;
+  /** Topics being processed by notify(). Kept around so its capacity is reused. */
+  std::vector<MessageTopic*> processing_;
+
+  /** Lock for ready_. */
+  std::mutex ready_lock_;
+
+  /** Wakes waitForWork when messages arrive or the work flag changes. */
+  Notifier notifier_;
 
   /** Number of messages in the queues. */
   std::atomic<std::int32_t> num_msgs_;
 
   /** Flag that will be returned by waitForWork. */
-  bool work_;
+  std::atomic<bool> work_;
+
+  /** Runs the pooled subscriber callbacks. Swapped under mlock_ with atomic_store, since notify() reads it unlocked. */
+  std::shared_ptr<DispatchExecutor> executor_;
+
+  /** Metrics registry. */
+  const std::shared_ptr<MetricsRegistry> metrics_;
+
+  /** ID of the collector that updates the metrics read on demand. */
+  std::size_t metrics_collector_;
+
+  /** Messages waiting in any queue. Updated on collection. */
+  MetricGauge& pending_metric_;
+
+  /** Owns the tracer. Guarded by mlock_. */
+  std::shared_ptr<MessageTracer> tracer_;
+
+  /** The tracer, for the send and delivery paths. Null while tracing is off, which costs them a single load. */
+  std::atomic<MessageTracer*> tracing_;
+
+  /** Called when a new subscriber subscribes. Guarded by mlock_. */
+  SubscriptionCb subscription_cb_;
+
+  /** Thread inside notify(), if any. */
+  std::atomic<std::thread::id> notify_thread_;
+
+  /** Number of threads in waitForDelivery(). notify() only signals delivered_cond_ while there are some. */
+  std::atomic<std::int32_t> delivery_waiters_;
+
+  /** Lock for delivered_cond_. */
+  std::mutex delivery_lock_;
+
+  /** Signalled when notify() finishes a pass while a thread waits for delivery. */
+  std::condition_variable delivered_cond_;
+
+  /**
+   * @brief Get a topic, creating it if needed. Caller must hold mlock_.
+   * @param msg_id Name of the messaging queue.
+   * @return Topic for msg_id.
+   */
+  MessageTopic& getTopic(const std::string& msg_id);
+
+  /**
+   * @brief Look up the handle for a publisher. Caller must hold mlock_.
+   * @param msg_id Name of the messaging queue.
+   * @param plugin_name Name of the publishing plugin.
+   * @return Handle for the publisher, or an invalid handle if plugin_name has not published to msg_id.
+   */
+  TopicHandle getTopicHandle(const std::string& msg_id, const std::string& plugin_name);
+
+  /**
+   * @brief Register a publisher.
+   * @param msg_id Name of the messaging queue.
+   * @param pub Publishing information.
+   * @param type Message type, or null for untyped publishers.
+   * @return Handle for the publisher.
+   */
+  TopicHandle registerPublisher(const std::string& msg_id, const MessagePublisher& pub, const std::type_info* type);
+
+  /**
+   * @brief Call a subscriber callback, recording its metrics and tracing it if tracing is on.
+   * @param sub Subscriber.
+   * @param msg Message.
+   */
+  void deliver(const MessageSubscriber& sub, const std::shared_ptr<MessageInterface>& msg);
+
+  /**
+   * @brief Call a batch subscriber callback, recording its metrics and tracing it if tracing is on.
+   * @param sub Subscriber.
+   * @param batch Messages.
+   */
+  void deliverBatch(const MessageSubscriber& sub, const MessageBatch& batch);
+
+  /**
+   * @brief Bring the metrics that are read on demand up to date.
+   */
+  void collectMetrics(void);
+
+  /**
+   * @brief Register a subscriber.
+   * @param sub Subscriber, with its msg_id, name, callback and dispatch mode set.
+   * @param type Message type, or null for untyped subscribers.
+   */
+  void registerSubscriber(MessageSubscriber sub, const std::type_info* type);
+
+  /**
+   * @brief Add a subscriber to a topic. Caller must hold mlock_.
+   * @param sub Subscriber, with its msg_id, name, callback and dispatch mode set. Its strand is set up here.
+   * @param type Message type, or null for untyped subscribers.
+   * @return True if the subscriber is new to the topic.
+   */
+  bool addSubscriber(MessageSubscriber& sub, const std::type_info* type);
+
+  /**
+   * @brief Fix a topic's message type, or check it against the one already fixed. Caller must hold mlock_.
+   * @param topic Topic.
+   * @param type Message type, or null to skip the check.
+   * @throws std::runtime_error on a mismatch.
+   */
+  void checkType(MessageTopic& topic, const std::type_info* type);
+
+  /**
+   * @brief Drop the messages that aren't of a late-typed topic's type, e.g., queued by an untyped publisher before a
+   * typed subscriber fixed the type.
+   * @param topic Late-typed topic.
+   * @param messages Messages taken off the topic's queue. Mistyped ones are removed.
+   */
+  void dropMistyped(const MessageTopic& topic, std::vector<std::shared_ptr<MessageInterface>>& messages);
+
+  /**
+   * @brief Trace a message if tracing is on, put it on a topic's queue and wake the event loop. Every send path ends
+   * here once the handle and message type are checked.
+   * @param handle Valid handle for the topic.
+   * @param msg Message.
+   */
+  void enqueue(const TopicHandle& handle, std::shared_ptr<MessageInterface> msg);
 };
 
 }  // namespace soul
@@ -13,6 +13,7 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/messaging/queue_options.h>
 #include <soul/messaging/type.h>
 
 #include <string>
@@ -56,8 +57,11 @@ struct MessagePublisher
    * @param id Message id.
    * @param n Publisher name.
    * @param t Message type.
+   * @param q Queue options to use if this publisher creates the message queue.
    */
-  MessagePublisher(const std::string id, const std::string n, const MessageType t) : msg_id(id), name(n), type(t)
+  MessagePublisher(const std::string id, const std::string n, const MessageType t,
+                   const QueueOptions q = QueueOptions())
+    : msg_id(id), name(n), type(t), queue(q)
   {
   }
 
@@ -69,6 +73,9 @@ struct MessagePublisher
 
   /** Message type. */
   MessageType type;
+
+  /** Queue options. Only used by the first publisher to a message ID. */
+  QueueOptions queue;
 };
 
 /**
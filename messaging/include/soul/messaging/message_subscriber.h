@@ -14,7 +14,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <soul/messaging/interface.h>
+#include <soul/messaging/metrics.h>
 
+#include <memory>
 #include <string>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -27,6 +29,26 @@ namespace soul
 // CUSTOM DEFINITIONS                                                        //
 ///////////////////////////////////////////////////////////////////////////////
 
+class DispatchStrand;
+
+/**
+ * @brief Where a subscriber's callback runs.
+ */
+enum class DispatchMode
+{
+  direct,  ///< On the thread calling MessageManager::notify().
+  pooled,  ///< On the messaging manager's dispatch executor, concurrently with other subscribers.
+};
+
+/**
+ * @brief Metrics of a subscriber. Owned by the messaging manager's metrics registry.
+ */
+struct SubscriberMetrics
+{
+  MetricHistogram* callback_time = nullptr;  ///< Time spent in the callback, per call.
+  MetricCounter* callback_errors = nullptr;  ///< Exceptions the callback threw.
+};
+
 /**
  * Message subscriber.
  */
@@ -40,8 +62,11 @@ struct MessageSubscriber
    * @param id Message id
    * @param n Subscriber name.
    * @param fn Message received callback function.
+   * @param mode Where the callback runs.
    */
-  MessageSubscriber(const std::string id, const std::string n, MessageReceivedCb fn) : msg_id(id), name(n), cb(fn)
+  MessageSubscriber(const std::string id, const std::string n, MessageReceivedCb fn,
+                    const DispatchMode mode = DispatchMode::direct)
+    : msg_id(id), name(n), cb(fn), dispatch(mode)
   {
   }
 
@@ -62,6 +87,18 @@ struct MessageSubscriber
 
   /** Callback function to invoke on a new message. */
   MessageReceivedCb cb;
+
+  /** Callback function to invoke with all new messages at once. Used instead of cb by batch subscribers. */
+  MessageBatchCb batch_cb;
+
+  /** Where the callback runs. */
+  DispatchMode dispatch = DispatchMode::direct;
+
+  /** Keeps pooled deliveries in order. Set up by the messaging manager. */
+  std::shared_ptr<DispatchStrand> strand;
+
+  /** Metrics. Set up by the messaging manager. */
+  SubscriberMetrics metrics;
 };
 
 /**
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_MESSAGE_TOPIC_H_
+#define SOUL_MESSAGING_MESSAGE_TOPIC_H_
+
+/*
+ * Message topic.
+ *
+ * Everything the messaging manager needs to deliver one msg_id: its queue and
+ * its resolved subscribers.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/message_subscriber.h>
+#include <soul/messaging/metrics.h>
+#include <soul/messaging/queue.h>
+#include <soul/messaging/rcu.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Subscribers of a topic. */
+using SubscriberList = std::vector<MessageSubscriber>;
+
+/**
+ * @brief Metrics of a topic. Owned by the messaging manager's metrics registry.
+ */
+struct TopicMetrics
+{
+  MetricCounter* sent = nullptr;       ///< Messages sent.
+  MetricCounter* delivered = nullptr;  ///< Messages notify() took off the queue.
+  MetricCounter* dropped = nullptr;    ///< Messages the queue dropped or replaced. Brought up to date on collection.
+  MetricGauge* depth = nullptr;        ///< Messages queued. Brought up to date on collection.
+  MetricGauge* depth_max = nullptr;    ///< Most messages notify() found queued at once.
+};
+
+/**
+ * @brief Message topic. Owned by the messaging manager.
+ */
+struct MessageTopic
+{
+  /** Message ID. */
+  std::string msg_id;
+
+  /** Message queue. Created by the first publisher, so it is null for topics that only have subscribers. */
+  std::unique_ptr<MessageQueue> queue;
+
+  /** Subscribers, in subscription order. The event loop reads them without locking while subscribers come and go. */
+  RcuCell<SubscriberList> subscribers;
+
+  /** Message type registered through the typed API, or null while the topic is untyped. */
+  std::atomic<const std::type_info*> type{ nullptr };
+
+  /** Set when the topic was typed after untyped publishers could send, so notify() checks each message's type. */
+  std::atomic<bool> late_typed{ false };
+
+  /** Set while the topic is on the manager's ready list. */
+  std::atomic<bool> ready{ false };
+
+  /** Metrics. Set up by the messaging manager. */
+  TopicMetrics metrics;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_MESSAGE_TOPIC_H_
@@ -0,0 +1,424 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_METRICS_H_
+#define SOUL_MESSAGING_METRICS_H_
+
+/*
+ * Metrics.
+ *
+ * Counters, gauges and duration histograms cheap enough to update on every
+ * message. Counters are split into per-thread stripes so concurrent senders
+ * don't fight over a cache line, and histograms are arrays of atomic power of
+ * two buckets. Metrics live in a registry, which can be read through a pull
+ * API or written in the Prometheus text format, e.g., periodically by a
+ * MetricsDumper for the node exporter's textfile collector.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Metric labels, e.g., { { "topic", "camera_frames" } }. */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief Kind of metric.
+ */
+enum class MetricKind
+{
+  counter,    ///< Count that only goes up.
+  gauge,      ///< Value that goes up and down.
+  histogram,  ///< Distribution of durations.
+};
+
+/** Stripes per counter. More than the threads that usually update one counter at once. */
+constexpr std::size_t metric_stripes_ = 8;
+
+/** Histogram buckets. Bucket i counts durations under 2^i ns, and at least 2^(i - 1) ns. */
+constexpr std::size_t metric_buckets_ = 65;
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASSES                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Count that only goes up. Lock-free, and each thread mostly updates its own stripe.
+ */
+class MetricCounter final
+{
+public:
+  /**
+   * @brief Add to the count.
+   * @param n Amount to add.
+   */
+  void add(const std::uint64_t n = 1)
+  {
+    stripes_[getStripe()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the count.
+   * @return Sum of the stripes.
+   */
+  std::uint64_t get(void) const
+  {
+    std::uint64_t sum = 0;
+    for (const auto& stripe : stripes_)
+      sum += stripe.value.load(std::memory_order_relaxed);
+
+    return sum;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Part of the count, on its own cache line. */
+  struct alignas(64) Stripe
+  {
+    std::atomic<std::uint64_t> value{ 0 };  ///< Count.
+  };
+
+  /**
+   * @brief Get the stripe the calling thread updates. Threads are dealt stripes round robin.
+   * @return Stripe index.
+   */
+  static std::size_t getStripe(void)
+  {
+    static std::atomic<std::size_t> next{ 0 };
+    thread_local const std::size_t stripe = next++ % metric_stripes_;
+    return stripe;
+  }
+
+  /** Count stripes. */
+  std::array<Stripe, metric_stripes_> stripes_;
+};
+
+/**
+ * @brief Value that goes up and down. Lock-free.
+ */
+class MetricGauge final
+{
+public:
+  /**
+   * @brief Set the value.
+   * @param value Value.
+   */
+  void set(const std::int64_t value)
+  {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Add to the value.
+   * @param n Amount to add. May be negative.
+   */
+  void add(const std::int64_t n)
+  {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Raise the value to at least a given value. Makes the gauge a high-water mark.
+   * @param value Value.
+   */
+  void raise(const std::int64_t value)
+  {
+    auto current = value_.load(std::memory_order_relaxed);
+    while (current < value && !value_.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  /**
+   * @brief Get the value.
+   * @return Value.
+   */
+  std::int64_t get(void) const
+  {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Value. */
+  std::atomic<std::int64_t> value_{ 0 };
+};
+
+/**
+ * @brief Distribution of durations in power of two buckets. Lock-free. Readers may see an observation in the count
+ * before it shows up in its bucket, which is fine for monitoring.
+ */
+class MetricHistogram final
+{
+public:
+  /**
+   * @brief Copy of a histogram.
+   */
+  struct Snapshot
+  {
+    std::array<std::uint64_t, metric_buckets_> buckets{};  ///< Observations per bucket.
+    std::uint64_t count = 0;                               ///< Observations.
+    std::chrono::nanoseconds sum{ 0 };                     ///< Sum of the observations.
+    std::chrono::nanoseconds max{ 0 };                     ///< Largest observation.
+
+    /**
+     * @brief Estimate a quantile.
+     * @param q Quantile, e.g., 0.99.
+     * @return Upper bound of the bucket the quantile falls in, capped at the largest observation. 0 if empty.
+     */
+    std::chrono::nanoseconds getQuantile(const double q) const;
+  };
+
+  /**
+   * @brief Record a duration.
+   * @param d Duration. Negative durations count as 0.
+   */
+  void observe(const std::chrono::nanoseconds d)
+  {
+    const auto ns = d.count() > 0 ? static_cast<std::uint64_t>(d.count()) : 0;
+    const auto bucket = ns == 0 ? 0 : 64 - static_cast<std::size_t>(__builtin_clzll(ns));
+
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    auto max = max_.load(std::memory_order_relaxed);
+    while (max < ns && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  /**
+   * @brief Copy the histogram.
+   * @return Snapshot.
+   */
+  Snapshot getSnapshot(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Observations per bucket. */
+  std::array<std::atomic<std::uint64_t>, metric_buckets_> buckets_{};
+
+  /** Observations. */
+  std::atomic<std::uint64_t> count_{ 0 };
+
+  /** Sum of the observations in nanoseconds. */
+  std::atomic<std::uint64_t> sum_{ 0 };
+
+  /** Largest observation in nanoseconds. */
+  std::atomic<std::uint64_t> max_{ 0 };
+};
+
+/**
+ * @brief Value of one metric, as read by MetricsRegistry::collect().
+ */
+struct MetricSample
+{
+  std::string name;                     ///< Metric name.
+  std::string help;                     ///< Description.
+  MetricKind kind = MetricKind::gauge;  ///< Kind of metric.
+  MetricLabels labels;                  ///< Labels.
+  double value = 0;                     ///< Counter or gauge value.
+  MetricHistogram::Snapshot histogram;  ///< Histogram value.
+};
+
+/**
+ * @brief Named metrics. Looking metrics up takes a lock, so look them up once and keep the reference: metrics are
+ * never removed, and updating them is lock-free. Thread safe.
+ */
+class MetricsRegistry final
+{
+public:
+  /** Constructor. */
+  MetricsRegistry();
+
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  /**
+   * @brief Get a counter, creating it if needed.
+   * @param name Metric name. Prometheus convention is to end counter names with _total.
+   * @param help Description. Only the first registration's is kept.
+   * @param labels Labels telling this counter apart from others with the same name.
+   * @return Counter.
+   * @throws std::runtime_error if the name is already used by another kind of metric.
+   */
+  MetricCounter& getCounter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+  /**
+   * @brief Get a gauge, creating it if needed.
+   * @param name Metric name.
+   * @param help Description. Only the first registration's is kept.
+   * @param labels Labels telling this gauge apart from others with the same name.
+   * @return Gauge.
+   * @throws std::runtime_error if the name is already used by another kind of metric.
+   */
+  MetricGauge& getGauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+  /**
+   * @brief Get a duration histogram, creating it if needed.
+   * @param name Metric name. Prometheus convention is to end duration names with _seconds.
+   * @param help Description. Only the first registration's is kept.
+   * @param labels Labels telling this histogram apart from others with the same name.
+   * @return Histogram.
+   * @throws std::runtime_error if the name is already used by another kind of metric.
+   */
+  MetricHistogram& getHistogram(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+  /**
+   * @brief Add a function that brings metrics up to date before they are read, for values that are cheaper to read
+   * when asked for than to track, like queue depths.
+   * @param collector Function to call. Runs on the thread reading the metrics.
+   * @return ID for removeCollector().
+   */
+  std::size_t addCollector(std::function<void()> collector);
+
+  /**
+   * @brief Remove a collector. Waits for it to finish if it is running.
+   * @param id ID from addCollector().
+   */
+  void removeCollector(const std::size_t id);
+
+  /**
+   * @brief Run the collectors and read every metric.
+   * @return Metrics sorted by name, then labels.
+   */
+  std::vector<MetricSample> collect(void);
+
+  /**
+   * @brief Run the collectors and write every metric in the Prometheus text format. Durations are in seconds.
+   * @param out Where to write.
+   */
+  void writePrometheus(std::ostream& out);
+
+  /**
+   * @brief Run the collectors and write every metric to a Prometheus text file. The file is replaced atomically, so
+   * scrapers never see half of it.
+   * @param path File path.
+   * @return False if the file couldn't be written.
+   */
+  bool writePrometheus(const std::string& path);
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Metrics with one name and their labels. */
+  struct Family
+  {
+    std::string help;                                                     ///< Description.
+    MetricKind kind = MetricKind::gauge;                                  ///< Kind of metric.
+    std::map<MetricLabels, std::unique_ptr<MetricCounter>> counters;      ///< Counters by labels.
+    std::map<MetricLabels, std::unique_ptr<MetricGauge>> gauges;          ///< Gauges by labels.
+    std::map<MetricLabels, std::unique_ptr<MetricHistogram>> histograms;  ///< Histograms by labels.
+  };
+
+  /**
+   * @brief Get a family, creating it if needed. Caller must hold lock_.
+   * @param name Metric name.
+   * @param help Description.
+   * @param kind Kind of metric.
+   * @return Family.
+   * @throws std::runtime_error if the name is already used by another kind of metric.
+   */
+  Family& getFamily(const std::string& name, const std::string& help, const MetricKind kind);
+
+  /** Lock for families_. */
+  std::mutex lock_;
+
+  /** Metrics by name. */
+  std::map<std::string, Family> families_;
+
+  /** Lock for collectors_ and next_collector_. Held while the collectors run. */
+  std::mutex collect_lock_;
+
+  /** Collectors by ID. */
+  std::map<std::size_t, std::function<void()>> collectors_;
+
+  /** Next collector ID. */
+  std::size_t next_collector_;
+};
+
+/**
+ * @brief Writes a registry to a Prometheus text file periodically, from its own thread.
+ */
+class MetricsDumper final
+{
+public:
+  /**
+   * @brief Constructor. Starts the thread.
+   * @param registry Metrics to write.
+   * @param path File path.
+   * @param period Time between writes.
+   */
+  MetricsDumper(std::shared_ptr<MetricsRegistry> registry, const std::string& path,
+                const std::chrono::milliseconds period);
+
+  /** Destructor. Stops the thread after writing the file one last time. */
+  ~MetricsDumper();
+
+  MetricsDumper(const MetricsDumper&) = delete;
+  MetricsDumper& operator=(const MetricsDumper&) = delete;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Write the file every period until stopped.
+   */
+  void run(void);
+
+  /** Metrics to write. */
+  const std::shared_ptr<MetricsRegistry> registry_;
+
+  /** File path. */
+  const std::string path_;
+
+  /** Time between writes. */
+  const std::chrono::milliseconds period_;
+
+  /** Lock for stop_. */
+  std::mutex lock_;
+
+  /** Signalled when the thread should stop. */
+  std::condition_variable stop_cond_;
+
+  /** Whether the thread should stop. */
+  bool stop_;
+
+  /** Writer thread. */
+  std::thread thread_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_METRICS_H_
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_NOTIFIER_H_
+#define SOUL_MESSAGING_NOTIFIER_H_
+
+/*
+ * Event notifier.
+ *
+ * Wakes a thread blocked on an eventfd. Notifying is a single atomic load
+ * unless somebody is actually asleep, so senders only pay for a syscall when
+ * the event loop is idle. Linux only.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Blocks waiting threads until a condition becomes true, without polling.
+ *
+ * Whoever makes the condition true must publish that change with a sequentially consistent store (for example an
+ * std::atomic increment) before calling notify(). The waiter announces itself the same way before its final check,
+ * so one of the two always sees the other and no wakeup is lost.
+ *
+ * Meant for a single waiting thread such as the messaging event loop. With several waiters a notify may only wake one.
+ */
+class Notifier
+{
+public:
+  /**
+   * @brief Constructor.
+   * @throws std::runtime_error if the eventfd can't be created.
+   */
+  explicit Notifier();
+
+  /** Destructor. */
+  ~Notifier();
+
+  Notifier(const Notifier&) = delete;
+  Notifier& operator=(const Notifier&) = delete;
+
+  /**
+   * @brief Wake the waiting thread if there is one.
+   */
+  void notify(void);
+
+  /**
+   * @brief Block until ready() returns true.
+   * @param ready Condition to wait for. Called again after every wakeup.
+   */
+  template <typename Predicate>
+  void wait(Predicate ready)
+  {
+    while (!ready())
+    {
+      waiters_.fetch_add(1);
+
+      // Recheck now that notifiers can see us, or a notify between the first check and here would be lost.
+      if (!ready())
+        block();
+
+      waiters_.fetch_sub(1);
+    }
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Sleep until notified.
+   */
+  void block(void);
+
+  /** eventfd the waiters sleep on. */
+  int fd_;
+
+  /** Number of threads that are about to block or are blocked. */
+  std::atomic<int> waiters_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_NOTIFIER_H_
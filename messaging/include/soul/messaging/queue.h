@@ -7,7 +7,10 @@
 
 /**
  * A thread safe message queue.
- * For now the queue sizes are unbounded.  In the future there might be queue size bounds.
+ * Queues are bounded by their capacity, except for locked queues with a zero
+ * capacity. The overflow policy decides what happens to messages pushed onto
+ * a full queue. Ring queues are lock-free. Latest-value queues hold just the
+ * newest message and keep it after it is popped, so consumers can sample it.
  *
  * Author: Tuan Chien
  */
@@ -17,11 +20,17 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <soul/messaging/interface.h>
+#include <soul/messaging/queue_options.h>
+#include <soul/messaging/ring_buffer.h>
 
+#include <chrono>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -41,19 +50,45 @@ class MessageQueue
 {
 public:
   /**
-   * @brief Add a new message to the queue.
+   * @brief Constructor.
+   * @param options Queue configuration.
+   * @throws std::runtime_error if a ring queue has no capacity.
+   */
+  explicit MessageQueue(const QueueOptions& options = QueueOptions());
+
+  MessageQueue(const MessageQueue&) = delete;
+  MessageQueue& operator=(const MessageQueue&) = delete;
+
+  /**
+   * @brief Add a new message to the queue, applying the overflow policy if the queue is full.
    * @param msg Message to add to the queue.
+   * @param wait Whether the block policy may wait for space. If false a full queue drops the message instead, e.g., on
+   * the thread that would have to drain it.
+   * @return Change in the number of queued messages. This is less than 1 if messages were dropped.
+   */
+  int push(std::shared_ptr<MessageInterface> msg, const bool wait = true);
+
+  /**
+   * @brief Get the newest message pushed to a latest-value queue, whether or not it has been popped.
+   * @return Newest message, or nullptr if there hasn't been one or this isn't a latest-value queue.
+   */
+  std::shared_ptr<MessageInterface> peek(void) const;
+
+  /**
+   * @brief Drop the copy of the newest message a latest-value queue keeps for peek(). A message that hasn't been
+   * popped yet is still delivered.
    */
-  void push(std::shared_ptr<MessageInterface> msg);
+  void forgetLatest(void);
 
   /**
-   * @brief Pop an element from the queue.
-   * @return Shared pointer to the message.
+   * @brief Pop an element from the queue. Locked queues block until there is one. Ring and latest-value queues have
+   * nothing to wait on, so they don't block: check size() or use popAll() instead.
+   * @return Shared pointer to the message, or nullptr if a ring or latest-value queue is empty.
    */
   std::shared_ptr<MessageInterface> pop(void);
 
   /**
-   * @brief Pop all elements off the queue.
+   * @brief Pop all elements off the queue. Ring queues are drained without taking a lock.
    * @return All elements in the queue.
    */
   std::vector<std::shared_ptr<MessageInterface>> popAll(void);
@@ -70,17 +105,79 @@ public:
    */
   std::size_t size(void);
 
+  /**
+   * @brief Get the queue configuration.
+   * @return Queue options.
+   */
+  const QueueOptions& getOptions(void) const;
+
+  /**
+   * @brief Get the number of messages dropped by the overflow policy.
+   * @return Number of dropped messages.
+   */
+  std::uint64_t getDropped(void) const;
+
 #ifndef HR_DEBUG
 private:
 #endif
+  /** Time to sleep between polls while a producer waits for space on a full ring queue. */
+  static constexpr std::chrono::microseconds ring_poll_time_{ 100 };
+
+  /** Queue configuration. */
+  const QueueOptions options_;
+
+  /** Ring buffer storage. Only allocated for ring queues. */
+  std::unique_ptr<RingBuffer<std::shared_ptr<MessageInterface>>> ring_;
+
+  /** Latest-value queues: newest message not popped yet, or null. Accessed with std::atomic_exchange and
+   * std::atomic_load, so pushes don't allocate. */
+  std::shared_ptr<MessageInterface> pending_;
+
+  /** Latest-value queues: newest message, kept for peek(). Accessed with std::atomic_load and std::atomic_store. */
+  std::shared_ptr<MessageInterface> latest_;
+
+  /** Number of messages dropped by the overflow policy. */
+  std::atomic<std::uint64_t> dropped_;
+
   /** Mutex lock to control sequential access. */
   std::mutex lock_;
 
   /** Condition variable for maintaining the lock through signalling. */
   std::condition_variable cond_;
 
+  /** Condition variable for producers blocked on a full queue. */
+  std::condition_variable space_cond_;
+
   /** Message queue. */
   std::queue<std::shared_ptr<MessageInterface>> queue_;
+
+  /**
+   * @brief Push onto the ring buffer, applying the overflow policy.
+   * @param msg Message to add to the queue.
+   * @param wait Whether the block policy may wait for space.
+   * @return Change in the number of queued messages.
+   */
+  int pushRing(std::shared_ptr<MessageInterface> msg, const bool wait);
+
+  /**
+   * @brief Replace the message in a latest-value queue.
+   * @param msg Message to add to the queue.
+   * @return Change in the number of queued messages.
+   */
+  int pushLatest(std::shared_ptr<MessageInterface> msg);
+
+  /**
+   * @brief Take the message out of a latest-value queue.
+   * @return Message, or nullptr if there is none.
+   */
+  std::shared_ptr<MessageInterface> popLatest(void);
+
+  /**
+   * @brief Wait for a full locked queue to have space, up to the block timeout.
+   * @param lock Lock held on lock_.
+   * @return True if there is space, false if the wait timed out.
+   */
+  bool waitForSpace(std::unique_lock<std::mutex>& lock);
 };
 
 }  // namespace soul
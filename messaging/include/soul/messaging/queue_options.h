@@ -0,0 +1,79 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_QUEUE_OPTIONS_H_
+#define SOUL_MESSAGING_QUEUE_OPTIONS_H_
+
+/*
+ * Per topic message queue options.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Block timeout that makes producers wait for as long as it takes. */
+constexpr std::chrono::milliseconds wait_forever_ = std::chrono::milliseconds::max();
+
+/**
+ * @brief Storage used by a message queue.
+ */
+enum class QueueBackend
+{
+  locked,  ///< Unbounded std::queue behind a mutex.
+  ring,    ///< Bounded lock-free ring buffer. Producers never serialise on a lock. Needs a capacity.
+  latest,  ///< One slot holding the newest message, which producers overwrite. Ignores capacity and overflow.
+};
+
+/**
+ * @brief What a bounded message queue does with a new message when it is full.
+ */
+enum class OverflowPolicy
+{
+  block,        ///< Wait for space up to the block timeout, then drop the new message. Never waits in notify().
+  drop_oldest,  ///< Drop the oldest queued message to make room.
+  drop_newest,  ///< Drop the new message.
+  keep_latest,  ///< Only ever keep the newest message. Ignores the capacity. Meant for sensor frames.
+};
+
+/**
+ * @brief Message queue configuration. The first publisher to a msg_id decides the options for that queue.
+ */
+struct QueueOptions
+{
+  /** Queue storage. */
+  QueueBackend backend = QueueBackend::locked;
+
+  /**
+   * Maximum number of queued messages. 0 leaves locked queues unbounded. Ring queues have no unbounded form, so they
+   * must be given one, which is rounded up to a power of 2.
+   */
+  std::size_t capacity = 0;
+
+  /**
+   * What to do with new messages when the queue is full. Blocking is opt in: only notify() drains the queues, so a
+   * producer waiting on the event loop stalls everything behind it.
+   */
+  OverflowPolicy overflow = OverflowPolicy::drop_newest;
+
+  /** How long a blocked producer waits for space before its message is dropped. */
+  std::chrono::milliseconds block_timeout = wait_forever_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_QUEUE_OPTIONS_H_
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_RCU_H_
+#define SOUL_MESSAGING_RCU_H_
+
+/**
+ * Read-copy-update cell.
+ *
+ * Holds a value that is read far more often than it changes, e.g., a topic's
+ * subscriber list. Readers take no lock: they announce themselves on one of
+ * two epoch counters and read the current version through a pointer. Writers
+ * copy the current version, change the copy and publish it with one atomic
+ * store. Old versions are freed once no reader can still be using them.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Value with lock-free reads and copy-on-write updates.
+ * @tparam T Value type. Must be copy constructible.
+ */
+template <typename T>
+class RcuCell
+{
+public:
+  /**
+   * @brief Keeps the version it was given alive until it goes out of scope. Readers should hold it briefly: it holds
+   * up synchronize().
+   */
+  class ReadGuard
+  {
+  public:
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    /** Destructor. Ends the read. */
+    ~ReadGuard()
+    {
+      readers_.fetch_sub(1);
+    }
+
+    /**
+     * @brief Access the value.
+     * @return Value.
+     */
+    const T& operator*() const
+    {
+      return *value_;
+    }
+
+    /**
+     * @brief Access the value.
+     * @return Pointer to the value.
+     */
+    const T* operator->() const
+    {
+      return value_;
+    }
+
+#ifndef HR_DEBUG
+  private:
+#endif
+    friend class RcuCell;
+
+    /**
+     * @brief Constructor.
+     * @param readers Reader count the read was announced on.
+     * @param value Version being read.
+     */
+    ReadGuard(std::atomic<std::size_t>& readers, const T* value) : readers_(readers), value_(value)
+    {
+    }
+
+    /** Reader count the read was announced on. */
+    std::atomic<std::size_t>& readers_;
+
+    /** Version being read. */
+    const T* value_;
+  };
+
+  /**
+   * @brief Constructor.
+   * @param value Initial value.
+   */
+  explicit RcuCell(T value = T()) : owned_(std::make_unique<T>(std::move(value))), epoch_(0)
+  {
+    current_.store(owned_.get());
+    readers_[0].store(0);
+    readers_[1].store(0);
+  }
+
+  RcuCell(const RcuCell&) = delete;
+  RcuCell& operator=(const RcuCell&) = delete;
+
+  /**
+   * @brief Read the current version. Lock-free, and safe to call from inside update()'s function or another read.
+   * @return Guard giving access to the version.
+   */
+  ReadGuard read(void) const
+  {
+    // Announce the read before loading the pointer, so a writer that sees no readers knows nobody has the old one.
+    auto& readers = readers_[epoch_.load() & 1];
+    readers.fetch_add(1);
+
+    return ReadGuard(readers, current_.load());
+  }
+
+  /**
+   * @brief Publish a changed copy of the current version. Never waits for readers: versions they may still be using
+   * are kept until a later update or synchronize() finds them unused.
+   * @param fn Function that changes the copy. Nothing is published if it throws.
+   */
+  void update(const std::function<void(T&)>& fn)
+  {
+    std::lock_guard<std::mutex> lg(write_lock_);
+
+    auto next = std::make_unique<T>(*owned_);
+    fn(*next);
+
+    retired_.push_back(std::move(owned_));
+    owned_ = std::move(next);
+    current_.store(owned_.get());
+
+    // Any reader of a retired version is still counted, so with no readers at all every retired version is unused.
+    if (readers_[0].load() == 0 && readers_[1].load() == 0)
+      retired_.clear();
+  }
+
+  /**
+   * @brief Wait until every read that started before this call has finished, then free the versions it replaced.
+   * Reads that start meanwhile don't hold it up. Must not be called while holding a ReadGuard for this cell.
+   */
+  void synchronize(void)
+  {
+    std::lock_guard<std::mutex> sync(sync_lock_);
+
+    std::vector<std::unique_ptr<T>> unused;
+
+    {
+      std::lock_guard<std::mutex> lg(write_lock_);
+      unused.swap(retired_);
+    }
+
+    // New reads go to the other counter after each flip, so each wait only covers reads already in progress. Two
+    // flips catch readers that loaded the epoch just before a flip but announced themselves after it.
+    for (int flip = 0; flip < 2; ++flip)
+    {
+      const auto epoch = epoch_.fetch_add(1);
+
+      while (readers_[epoch & 1].load() != 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Current version. Only written under write_lock_. */
+  std::unique_ptr<T> owned_;
+
+  /** Current version, for readers. */
+  std::atomic<const T*> current_;
+
+  /** Selects which reader count new reads announce themselves on. */
+  std::atomic<std::size_t> epoch_;
+
+  /** Reads in progress, by epoch parity. */
+  mutable std::atomic<std::size_t> readers_[2];
+
+  /** Replaced versions readers may still be using. Guarded by write_lock_. */
+  std::vector<std::unique_ptr<T>> retired_;
+
+  /** Serialises writers. Never held while waiting for readers, so readers may update. */
+  std::mutex write_lock_;
+
+  /** Serialises synchronize(). */
+  std::mutex sync_lock_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_RCU_H_
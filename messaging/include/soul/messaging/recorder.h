@@ -0,0 +1,369 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_RECORDER_H_
+#define SOUL_MESSAGING_RECORDER_H_
+
+/*
+ * Message recorder.
+ *
+ * Subscribes to topics and writes every message they carry to a file for
+ * offline debugging and replay. The subscriber callback only pushes the
+ * message onto a lock-free queue; a writer thread encodes it with the topic's
+ * codec and does all the disk I/O, so the event loop never waits for the disk.
+ * When the writer falls behind the queue fills up and further messages are
+ * dropped and counted.
+ *
+ * File layout, all integers little-endian:
+ *
+ *   RecordingFileHeader
+ *   chunk*               RecordingChunkHeader, then the records, optionally
+ *                        compressed as a whole, padded to 8 bytes.
+ *   index                RecordingIndexHeader, one topic record per topic,
+ *                        then a RecordingIndexEntry per chunk.
+ *   RecordingTrailer     Where the index starts.
+ *
+ * A record is a RecordingRecordHeader followed by its payload, padded to 8
+ * bytes. Topic records carry the topic name and come before the first message
+ * on the topic, so a file cut short by a crash can still be read chunk by
+ * chunk. Only the index and trailer are missing then.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/codec.h>
+#include <soul/messaging/manager.h>
+#include <soul/messaging/metrics.h>
+#include <soul/messaging/notifier.h>
+#include <soul/messaging/ring_buffer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Recording format version. */
+constexpr std::uint32_t recording_version_ = 1;
+
+/** Magic at the start of a recording. */
+constexpr char recording_magic_[8] = { 'S', 'O', 'U', 'L', 'R', 'E', 'C', '\0' };
+
+/** Magic at the end of a recording with an index. */
+constexpr char recording_index_magic_[8] = { 'S', 'O', 'U', 'L', 'I', 'D', 'X', '\0' };
+
+/** Magic at the start of each chunk. */
+constexpr std::uint32_t recording_chunk_magic_ = 0x4b4e4843;  // "CHNK"
+
+/** Magic at the start of the index. */
+constexpr std::uint32_t recording_index_header_magic_ = 0x58444e49;  // "INDX"
+
+/** Record payloads are padded to this. */
+constexpr std::size_t recording_alignment_ = 8;
+
+/**
+ * @brief How chunks are compressed.
+ */
+enum class RecordingCompression : std::uint32_t
+{
+  none = 0,  ///< Stored as is.
+  zlib = 1,  ///< zlib deflate stream.
+};
+
+/**
+ * @brief What a record holds.
+ */
+enum class RecordingRecordKind : std::uint32_t
+{
+  topic = 0,    ///< Topic name for the topic number.
+  message = 1,  ///< Encoded message.
+};
+
+/** Start of a recording. */
+struct RecordingFileHeader
+{
+  char magic[8];           ///< recording_magic_.
+  std::uint32_t version;   ///< recording_version_.
+  std::uint32_t reserved;  ///< 0.
+};
+
+/** Start of a chunk. */
+struct RecordingChunkHeader
+{
+  std::uint32_t magic;        ///< recording_chunk_magic_.
+  std::uint32_t compression;  ///< RecordingCompression of the data.
+  std::uint64_t stored_size;  ///< Bytes that follow in the file, without padding.
+  std::uint64_t raw_size;     ///< Bytes of records once decompressed.
+  std::int64_t start_ns;      ///< Earliest message time in the chunk, nanoseconds since the epoch.
+  std::int64_t end_ns;        ///< Latest message time in the chunk.
+  std::uint32_t records;      ///< Records in the chunk, topic records included.
+  std::uint32_t reserved;     ///< 0.
+};
+
+/** Start of a record. */
+struct RecordingRecordHeader
+{
+  std::uint32_t kind;         ///< RecordingRecordKind.
+  std::uint32_t topic;        ///< Topic number.
+  std::int64_t timestamp_ns;  ///< Capture time of the message, 0 if it had none.
+  std::int64_t received_ns;   ///< When the recorder got the message.
+  std::uint64_t size;         ///< Payload bytes, without padding.
+};
+
+/** Start of the index. */
+struct RecordingIndexHeader
+{
+  std::uint32_t magic;   ///< recording_index_header_magic_.
+  std::uint32_t topics;  ///< Topic records that follow.
+  std::uint64_t chunks;  ///< Index entries that follow the topic records.
+};
+
+/** Where a chunk is. */
+struct RecordingIndexEntry
+{
+  std::uint64_t offset;    ///< File offset of the chunk header.
+  std::int64_t start_ns;   ///< Earliest message time in the chunk.
+  std::int64_t end_ns;     ///< Latest message time in the chunk.
+  std::uint32_t records;   ///< Records in the chunk.
+  std::uint32_t reserved;  ///< 0.
+};
+
+/** End of a recording with an index. */
+struct RecordingTrailer
+{
+  std::uint64_t index_offset;  ///< File offset of the index header.
+  char magic[8];               ///< recording_index_magic_.
+};
+
+/**
+ * @brief Recorder configuration.
+ */
+struct RecorderOptions
+{
+  /** Subscriber name the recorder uses. Also labels its metrics. */
+  std::string name = "recorder";
+
+  /** Messages waiting for the writer thread. Messages beyond that are dropped and counted. */
+  std::size_t queue_capacity = 4096;
+
+  /** Record bytes per chunk, before compression. */
+  std::size_t chunk_size = 1 << 20;
+
+  /** How chunks are compressed. Chunks that don't get smaller are stored as is. */
+  RecordingCompression compression = RecordingCompression::none;
+
+  /** zlib level, from 1 (fastest) to 9 (smallest). */
+  int compression_level = 1;
+};
+
+/**
+ * @brief Get the time a record is filed under: its capture time if it has one, otherwise when it was received.
+ * @param header Record header.
+ * @return Nanoseconds since the epoch.
+ */
+inline std::int64_t getRecordTime(const RecordingRecordHeader& header)
+{
+  return header.timestamp_ns != 0 ? header.timestamp_ns : header.received_ns;
+}
+
+/**
+ * @brief Round a payload size up to the record alignment.
+ * @param n Size.
+ * @return Padded size.
+ */
+inline std::size_t recordingAlign(const std::size_t n)
+{
+  return (n + recording_alignment_ - 1) & ~(recording_alignment_ - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Records topics to a file. Thread safe.
+ */
+class MessageRecorder final
+{
+public:
+  /**
+   * @brief Constructor. Creates the file and starts the writer thread.
+   * @param msgman Messaging manager to record from. Must outlive the recorder.
+   * @param path File path. An existing file is overwritten.
+   * @param options Configuration.
+   * @throws std::runtime_error if the file can't be created.
+   */
+  MessageRecorder(MessageManager& msgman, const std::string& path, const RecorderOptions& options = RecorderOptions());
+
+  /** Destructor. Closes the recording. */
+  ~MessageRecorder();
+
+  MessageRecorder(const MessageRecorder&) = delete;
+  MessageRecorder& operator=(const MessageRecorder&) = delete;
+
+  /**
+   * @brief Start recording a topic.
+   * @param msg_id Topic.
+   * @param codec Codec for the messages on the topic.
+   * @throws std::runtime_error if the topic is already recorded, the codec is incomplete or the recording is closed.
+   */
+  void record(const std::string& msg_id, MessageCodec codec);
+
+  /**
+   * @brief Stop recording, write what is queued and the index, and close the file. Further calls do nothing. Must not
+   * be called from a subscriber callback.
+   */
+  void close(void);
+
+  /**
+   * @brief Get the number of messages written.
+   * @return Messages.
+   */
+  std::uint64_t getRecorded(void) const;
+
+  /**
+   * @brief Get the number of messages dropped because the writer thread fell behind.
+   * @return Messages.
+   */
+  std::uint64_t getDropped(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** A recorded topic. */
+  struct Topic
+  {
+    std::string msg_id;    ///< Topic.
+    std::uint32_t number;  ///< Topic number in the file.
+    MessageCodec codec;    ///< Codec.
+    bool written;          ///< Whether its topic record is in the file. Writer thread only.
+  };
+
+  /** A message waiting for the writer thread. */
+  struct Pending
+  {
+    Topic* topic = nullptr;                 ///< Topic it came on.
+    std::shared_ptr<MessageInterface> msg;  ///< Message.
+    std::int64_t received_ns = 0;           ///< When it was received.
+  };
+
+  /**
+   * @brief Hand a message to the writer thread. Called on the event loop.
+   * @param topic Topic it came on.
+   * @param msg Message.
+   */
+  void enqueue(Topic* topic, std::shared_ptr<MessageInterface> msg);
+
+  /**
+   * @brief Write messages until stopped and drained.
+   */
+  void run(void);
+
+  /**
+   * @brief Add a message to the current chunk, and the topic's record before it if the file doesn't have it yet.
+   * @param pending Message.
+   */
+  void append(const Pending& pending);
+
+  /**
+   * @brief Add a record to the current chunk.
+   * @param header Record header. Its size is the payload size.
+   * @return Where the payload goes. Valid until the chunk grows again.
+   */
+  std::uint8_t* appendRecord(const RecordingRecordHeader& header);
+
+  /**
+   * @brief Compress and write the current chunk, if it has anything in it.
+   */
+  void flushChunk(void);
+
+  /**
+   * @brief Write the index and trailer.
+   */
+  void writeIndex(void);
+
+  /**
+   * @brief Write bytes to the file. Reports the first failure.
+   * @param data Bytes.
+   * @param size Number of bytes.
+   */
+  void writeFile(const void* data, const std::size_t size);
+
+  /** Messaging manager. */
+  MessageManager& msgman_;
+
+  /** File path. */
+  const std::string path_;
+
+  /** Configuration. */
+  const RecorderOptions options_;
+
+  /** Lock for topics_ and closed_. */
+  std::mutex lock_;
+
+  /** Recorded topics, in topic number order. */
+  std::vector<std::unique_ptr<Topic>> topics_;
+
+  /** Whether close() has been called. */
+  bool closed_;
+
+  /** Messages on their way to the writer thread. */
+  RingBuffer<Pending> queue_;
+
+  /** Messages pushed onto queue_. Its increments are what the writer's notifier waits on. */
+  std::atomic<std::uint64_t> pushed_;
+
+  /** Wakes the writer thread. */
+  Notifier notifier_;
+
+  /** Tells the writer thread to finish. */
+  std::atomic<bool> stop_;
+
+  /** Messages written. */
+  MetricCounter& recorded_;
+
+  /** Messages dropped. */
+  MetricCounter& dropped_;
+
+  /** Output file. Writer thread only, until it has finished. */
+  std::ofstream out_;
+
+  /** Whether writing to the file has failed. */
+  bool failed_;
+
+  /** Offset of the next byte written to the file. */
+  std::uint64_t offset_;
+
+  /** Records of the chunk being filled. */
+  std::vector<std::uint8_t> chunk_;
+
+  /** Header of the chunk being filled. */
+  RecordingChunkHeader chunk_header_;
+
+  /** Chunks written so far. */
+  std::vector<RecordingIndexEntry> index_;
+
+  /** Writer thread. */
+  std::thread thread_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_RECORDER_H_
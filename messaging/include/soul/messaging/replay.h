@@ -0,0 +1,333 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_REPLAY_H_
+#define SOUL_MESSAGING_REPLAY_H_
+
+/*
+ * Message replay.
+ *
+ * RecordingReader memory-maps a file written by MessageRecorder and reads it
+ * chunk by chunk, through the index if the file has one. MessageReplay feeds
+ * the messages back into a MessageManager on its own thread, as the publisher
+ * that recorded them would have: at the pace of their capture times, faster or
+ * slower, or as fast as possible, from any point in the recording.
+ *
+ * Records in uncompressed chunks are decoded straight from the mapping, so
+ * codecs that don't copy (e.g. the Image codec) hand out messages whose pixels
+ * are the file's pages. Those are read-only and keep the mapping alive.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/codec.h>
+#include <soul/messaging/manager.h>
+#include <soul/messaging/recorder.h>
+#include <soul/messaging/topic_handle.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief One message record read from a recording.
+ */
+struct RecordedMessage
+{
+  RecordingRecordHeader header;       ///< Record header.
+  const std::uint8_t* payload;        ///< Encoded message. Valid while the lease is alive.
+  std::shared_ptr<const void> lease;  ///< Keeps the payload's memory around.
+};
+
+/**
+ * @brief Replay configuration.
+ */
+struct ReplayOptions
+{
+  /** Publisher name the replay sends as. */
+  std::string name = "replay";
+
+  /** Playback speed: 1 for real time, 2 for twice as fast and so on. 0 plays as fast as possible. */
+  double speed = 1.0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Reads a recording. Thread safe once constructed.
+ */
+class RecordingReader final
+{
+public:
+  /**
+   * @brief Constructor. Maps the file and reads its index. A file without one, e.g. because the recorder crashed, is
+   * scanned instead, up to the last complete chunk.
+   * @param path File path.
+   * @throws std::runtime_error if the file can't be mapped or isn't a recording.
+   */
+  explicit RecordingReader(const std::string& path);
+
+  RecordingReader(const RecordingReader&) = delete;
+  RecordingReader& operator=(const RecordingReader&) = delete;
+
+  /**
+   * @brief Get the recorded topics.
+   * @return Topic names by topic number.
+   */
+  const std::vector<std::string>& getTopics(void) const;
+
+  /**
+   * @brief Get the chunks.
+   * @return Chunk entries in file order.
+   */
+  const std::vector<RecordingIndexEntry>& getChunks(void) const;
+
+  /**
+   * @brief Whether the file has its index, i.e., the recorder closed it.
+   * @return True if it has.
+   */
+  bool hasIndex(void) const;
+
+  /**
+   * @brief Find where to start playing from to get the messages at or after a time.
+   * @param time_ns Nanoseconds since the epoch.
+   * @return First chunk that ends at or after the time, or the number of chunks if there is none.
+   */
+  std::size_t findChunk(const std::int64_t time_ns) const;
+
+  /**
+   * @brief Read the message records of a chunk. Uncompressed chunks are read in place.
+   * @param chunk Chunk number.
+   * @return Records in file order.
+   * @throws std::runtime_error if the chunk is damaged.
+   */
+  std::vector<RecordedMessage> readChunk(const std::size_t chunk) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Read the index at the end of the file.
+   * @return False if there is no valid index.
+   */
+  bool readIndex(void);
+
+  /**
+   * @brief Find the chunks and topics by walking the file from the start.
+   */
+  void scan(void);
+
+  /**
+   * @brief Get the records of a chunk, decompressed if need be.
+   * @param chunk Chunk number.
+   * @param data Receives the start of the records.
+   * @param size Receives the size of the records.
+   * @return Lease for the records, or null if the chunk is damaged.
+   */
+  std::shared_ptr<const void> loadChunk(const std::size_t chunk, const std::uint8_t*& data, std::size_t& size) const;
+
+  /**
+   * @brief Complain about a damaged file.
+   * @param what What is wrong.
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] void fail(const std::string& what) const;
+
+  /** File path. */
+  const std::string path_;
+
+  /** Mapping of the whole file. Also the lease of records read in place. */
+  std::shared_ptr<const void> mapping_;
+
+  /** Start of the mapping. */
+  const std::uint8_t* data_;
+
+  /** File size. */
+  std::size_t size_;
+
+  /** Topic names by number. */
+  std::vector<std::string> topics_;
+
+  /** Chunks in file order. */
+  std::vector<RecordingIndexEntry> chunks_;
+
+  /** Whether the file has its index. */
+  bool indexed_;
+};
+
+/**
+ * @brief Plays a recording into a messaging manager. Thread safe.
+ */
+class MessageReplay final
+{
+public:
+  /**
+   * @brief Constructor. Playback starts at the beginning of the recording when start() is called.
+   * @param msgman Messaging manager to send to. Must outlive the replay.
+   * @param reader Recording.
+   * @param options Configuration.
+   */
+  MessageReplay(MessageManager& msgman, std::shared_ptr<const RecordingReader> reader,
+                const ReplayOptions& options = ReplayOptions());
+
+  /** Destructor. Stops playing. */
+  ~MessageReplay();
+
+  MessageReplay(const MessageReplay&) = delete;
+  MessageReplay& operator=(const MessageReplay&) = delete;
+
+  /**
+   * @brief Publish a recorded topic. Only the topics played get sent.
+   * @param msg_id Topic.
+   * @param codec Codec for the messages on the topic.
+   * @throws std::runtime_error if the topic isn't in the recording or is already played, or the codec can't decode.
+   */
+  void play(const std::string& msg_id, MessageCodec codec);
+
+  /**
+   * @brief Start playing from the current position, on the replay's thread. Does nothing if already playing.
+   */
+  void start(void);
+
+  /**
+   * @brief Stop playing. start() carries on from where it stopped.
+   */
+  void stop(void);
+
+  /**
+   * @brief Jump to a time. Playback, if running, continues from there.
+   * @param time_ns Nanoseconds since the epoch. The next message sent is the first one filed at or after it.
+   */
+  void seek(const std::int64_t time_ns);
+
+  /**
+   * @brief Change the playback speed. Takes effect from the current position.
+   * @param speed 1 for real time, 2 for twice as fast and so on. 0 plays as fast as possible.
+   * @throws std::runtime_error if the speed is negative.
+   */
+  void setSpeed(const double speed);
+
+  /**
+   * @brief Block until the end of the recording has been played, or playback stops.
+   * @return True if the end was reached.
+   */
+  bool wait(void);
+
+  /**
+   * @brief Get the number of messages sent.
+   * @return Messages.
+   */
+  std::uint64_t getPlayed(void) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** A played topic. */
+  struct Playing
+  {
+    TopicHandle topic;   ///< Where to send.
+    MessageCodec codec;  ///< Codec.
+  };
+
+  /**
+   * @brief Play until stopped.
+   */
+  void run(void);
+
+  /**
+   * @brief Move to the first message at or after seek_ns_. Caller holds lock_.
+   */
+  void locate(void);
+
+  /**
+   * @brief Load the next chunk that can be read. Damaged chunks are reported and skipped. Caller holds lock_.
+   * @return False at the end of the recording.
+   */
+  bool loadChunk(void);
+
+  /** Messaging manager. */
+  MessageManager& msgman_;
+
+  /** Recording. */
+  const std::shared_ptr<const RecordingReader> reader_;
+
+  /** Publisher name. */
+  const std::string name_;
+
+  /** Lock for everything below but played_. */
+  std::mutex lock_;
+
+  /** Signalled on stop, seek and speed changes, and when playback ends. */
+  std::condition_variable cond_;
+
+  /** Played topics by topic number. Empty codecs for topics that aren't played. */
+  std::vector<Playing> playing_;
+
+  /** Playback speed. */
+  double speed_;
+
+  /** Whether the thread should be playing. */
+  bool running_;
+
+  /** Whether the end of the recording has been reached. */
+  bool done_;
+
+  /** Whether a seek is waiting to be carried out. */
+  bool seeking_;
+
+  /** Time to seek to. */
+  std::int64_t seek_ns_;
+
+  /** Bumped by every control call, so the thread wakes up and looks again. */
+  std::uint64_t version_;
+
+  /** Whether the clock has to be set again before the next message, after a seek or a restart. */
+  bool rebase_;
+
+  /** Wall time the next message's pacing is measured from. */
+  std::chrono::steady_clock::time_point wall_origin_;
+
+  /** Recording time corresponding to wall_origin_. */
+  std::int64_t record_origin_;
+
+  /** Next chunk to load. */
+  std::size_t next_chunk_;
+
+  /** Records of the current chunk. */
+  std::vector<RecordedMessage> records_;
+
+  /** Next record in records_. */
+  std::size_t record_;
+
+  /** Messages sent. */
+  std::atomic<std::uint64_t> played_;
+
+  /** Playback thread. */
+  std::thread thread_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_REPLAY_H_
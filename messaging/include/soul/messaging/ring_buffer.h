@@ -0,0 +1,218 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_RING_BUFFER_H_
+#define SOUL_MESSAGING_RING_BUFFER_H_
+
+/**
+ * Bounded lock-free ring buffer.
+ *
+ * Every slot carries a sequence number that tells producers and consumers
+ * whether it is free or holds an element for the current lap, so neither
+ * side needs a lock. Any number of threads may push. Popping is also safe
+ * from several threads, but the message queues use it with one consumer.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Cache line size assumed for padding shared counters. */
+constexpr std::size_t cache_line_size_ = 64;
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Bounded multi-producer ring buffer.
+ * @tparam T Element type. Must be default constructible and move assignable.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param capacity Minimum number of elements the buffer can hold. Rounded up to a power of two.
+   */
+  explicit RingBuffer(const std::size_t capacity) : capacity_(roundUp(capacity)), mask_(capacity_ - 1)
+  {
+    slots_ = std::make_unique<Slot[]>(capacity_);
+
+    for (std::size_t i = 0; i < capacity_; ++i)
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  /**
+   * @brief Try to add an element. The element is only moved from if this succeeds.
+   * @param item Element to add.
+   * @return True if the element was added, false if the buffer is full.
+   */
+  template <typename U>
+  bool tryPush(U&& item)
+  {
+    std::size_t pos = head_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+      const std::size_t seq = slot->seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+      if (diff == 0)
+      {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+
+    slot->value = std::forward<U>(item);
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /**
+   * @brief Try to remove the oldest element.
+   * @param item Receives the element on success.
+   * @return True if an element was removed, false if the buffer is empty.
+   */
+  bool tryPop(T& item)
+  {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+
+    for (;;)
+    {
+      slot = &slots_[pos & mask_];
+      const std::size_t seq = slot->seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+
+      if (diff == 0)
+      {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    item = std::move(slot->value);
+    slot->value = T();  // Drop our reference straight away.
+    slot->seq.store(pos + capacity_, std::memory_order_release);
+
+    return true;
+  }
+
+  /**
+   * @brief Get the number of elements the buffer can hold.
+   * @return Capacity.
+   */
+  std::size_t capacity(void) const
+  {
+    return capacity_;
+  }
+
+  /**
+   * @brief Get the number of elements in the buffer. Only approximate while other threads are pushing or popping.
+   * @return Number of elements.
+   */
+  std::size_t size(void) const
+  {
+    const std::size_t tail = tail_.load(std::memory_order_acquire);
+    const std::size_t head = head_.load(std::memory_order_acquire);
+
+    return head > tail ? head - tail : 0;
+  }
+
+  /**
+   * @brief Indicate whether the buffer is empty. Only approximate while other threads are pushing or popping.
+   * @return True if empty.
+   */
+  bool empty(void) const
+  {
+    return size() == 0;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Element storage. Each slot gets its own cache line so neighbouring producers don't false share. */
+  struct alignas(cache_line_size_) Slot
+  {
+    std::atomic<std::size_t> seq;  ///< Lap sequence number for the slot.
+    T value;                       ///< Stored element.
+  };
+
+  /**
+   * @brief Round up to the next power of two.
+   * @param n Value to round.
+   * @return Smallest power of two >= n (at least 2).
+   */
+  static std::size_t roundUp(const std::size_t n)
+  {
+    std::size_t capacity = 2;
+    while (capacity < n)
+      capacity <<= 1;
+
+    return capacity;
+  }
+
+  /** Number of slots. */
+  const std::size_t capacity_;
+
+  /** Mask to map positions to slots. */
+  const std::size_t mask_;
+
+  /** Slot storage. */
+  std::unique_ptr<Slot[]> slots_;
+
+  /** Next position to push to. */
+  alignas(cache_line_size_) std::atomic<std::size_t> head_;
+
+  /** Next position to pop from. */
+  alignas(cache_line_size_) std::atomic<std::size_t> tail_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_RING_BUFFER_H_
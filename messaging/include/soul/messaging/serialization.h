@@ -0,0 +1,643 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_SERIALIZATION_H_
+#define SOUL_MESSAGING_SERIALIZATION_H_
+
+/*
+ * Binary message serialization.
+ *
+ * Building blocks for turning messages into a compact byte format and back,
+ * for recording, shared memory and streaming off the box. An encoded message
+ * starts with a SerialSchemaHeader naming its type and layout version, so a
+ * decoder refuses types it doesn't know and can still read older layouts after
+ * a type changes. Scalars are stored at a fixed width in little-endian order.
+ * Strings and arrays are length-prefixed. Arrays start on an 8 byte offset, so
+ * decoders can hand out views into the buffer instead of copying.
+ *
+ * A message type T is made serializable by specialising SerialSchema for it
+ * and declaring, in T's namespace so argument-dependent lookup finds them:
+ *
+ *   void serializeFields(SerialWriter& writer, const T& value);
+ *   T deserializeFields(SerialReader& reader, std::uint32_t version, SerialTag<T>);
+ *
+ * ListMessage<T> is then serializable too, and makeSerialCodec<T>() makes a
+ * MessageCodec for it.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/codec.h>
+#include <soul/messaging/interface.h>
+#include <soul/messaging/list.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+// Scalars are copied as they are in memory.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "serialized messages are little-endian");
+
+/** Arrays start on offsets that are a multiple of this. */
+constexpr std::size_t serial_alignment_ = 8;
+
+/** Set in the schema type of a ListMessage of the type. */
+constexpr std::uint32_t serial_list_flag_ = 0x80000000;
+
+/** Start of an encoded message. */
+struct SerialSchemaHeader
+{
+  std::uint32_t type;     ///< SerialSchema<T>::type.
+  std::uint32_t version;  ///< Layout version it was written with.
+};
+
+/**
+ * @brief Schema of a serializable type. Specialisations have a unique type number and the current layout version,
+ * which goes up whenever the layout changes.
+ * @tparam T Message type.
+ */
+template <typename T>
+struct SerialSchema;
+
+/**
+ * @brief Schema of a list of serializable messages. It shares the item type's version.
+ * @tparam T Item type.
+ */
+template <typename T>
+struct SerialSchema<ListMessage<T>>
+{
+  static constexpr std::uint32_t type = SerialSchema<T>::type | serial_list_flag_;  ///< Type number.
+  static constexpr std::uint32_t version = SerialSchema<T>::version;                ///< Layout version.
+};
+
+/**
+ * @brief Selects the deserializeFields overload for a type, which can't be told apart by arguments alone.
+ * @tparam T Type to deserialize.
+ */
+template <typename T>
+struct SerialTag
+{
+};
+
+/**
+ * @brief Read-only view of an array inside an encoded message. Valid while the buffer is.
+ * @tparam T Element type.
+ */
+template <typename T>
+class SerialArrayView final
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param data First element.
+   * @param size Number of elements.
+   */
+  SerialArrayView(const std::uint8_t* data = nullptr, const std::size_t size = 0) : data_(data), size_(size)
+  {
+  }
+
+  /**
+   * @brief Get the elements in place. The buffers the messaging system hands out are aligned, so they are aligned
+   * too; use at() or toVector() on buffers that may not be.
+   * @return First element.
+   */
+  const T* data(void) const
+  {
+    return reinterpret_cast<const T*>(data_);
+  }
+
+  /**
+   * @brief Get the number of elements.
+   * @return Elements.
+   */
+  std::size_t size(void) const
+  {
+    return size_;
+  }
+
+  /**
+   * @brief Read an element, whatever the buffer's alignment.
+   * @param i Index, less than size().
+   * @return Element.
+   */
+  T at(const std::size_t i) const
+  {
+    T value;
+    std::memcpy(&value, data_ + i * sizeof(T), sizeof(T));
+    return value;
+  }
+
+  /**
+   * @brief Copy the elements out.
+   * @return Elements.
+   */
+  std::vector<T> toVector(void) const
+  {
+    std::vector<T> values(size_);
+    if (size_ > 0)
+      std::memcpy(values.data(), data_, size_ * sizeof(T));
+
+    return values;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  const std::uint8_t* data_;  ///< First element.
+  std::size_t size_;          ///< Number of elements.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Writes an encoded message. Without a buffer it only measures, so one serializeFields() serves both.
+ */
+class SerialWriter final
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param dst Buffer with room for the whole message, or nullptr to only count bytes.
+   */
+  explicit SerialWriter(std::uint8_t* dst = nullptr) : dst_(dst), pos_(0)
+  {
+  }
+
+  /**
+   * @brief Write a scalar.
+   * @param value Value.
+   */
+  template <typename T>
+  void write(const T value)
+  {
+    static_assert(std::is_arithmetic<T>::value, "only scalars have a fixed layout");
+    writeBytes(&value, sizeof(value));
+  }
+
+  /**
+   * @brief Write a schema header.
+   * @param type Type number.
+   * @param version Layout version.
+   */
+  void writeSchema(const std::uint32_t type, const std::uint32_t version)
+  {
+    write(type);
+    write(version);
+  }
+
+  /**
+   * @brief Write a string: its length, then its bytes.
+   * @param str String.
+   */
+  void writeString(const std::string& str)
+  {
+    write(static_cast<std::uint32_t>(str.size()));
+    writeBytes(str.data(), str.size());
+  }
+
+  /**
+   * @brief Write an array of scalars: its size, then the elements from an aligned offset.
+   * @param data First element.
+   * @param size Number of elements.
+   */
+  template <typename T>
+  void writeArray(const T* data, const std::size_t size)
+  {
+    static_assert(std::is_arithmetic<T>::value, "only scalars have a fixed layout");
+    write(static_cast<std::uint64_t>(size));
+    align(serial_alignment_);
+    writeBytes(data, size * sizeof(T));
+  }
+
+  /**
+   * @brief Write raw bytes.
+   * @param data Bytes.
+   * @param size Number of bytes.
+   */
+  void writeBytes(const void* data, const std::size_t size)
+  {
+    if (dst_ != nullptr && size > 0)
+      std::memcpy(dst_ + pos_, data, size);
+
+    pos_ += size;
+  }
+
+  /**
+   * @brief Make room for bytes the caller fills in.
+   * @param size Number of bytes.
+   * @return Where they go, or nullptr when only measuring.
+   */
+  std::uint8_t* reserve(const std::size_t size)
+  {
+    auto* dst = dst_ != nullptr ? dst_ + pos_ : nullptr;
+    pos_ += size;
+    return dst;
+  }
+
+  /**
+   * @brief Pad with zeros up to an offset that is a multiple of the alignment.
+   * @param alignment Alignment, a power of 2.
+   */
+  void align(const std::size_t alignment)
+  {
+    const auto padded = (pos_ + alignment - 1) & ~(alignment - 1);
+
+    if (dst_ != nullptr)
+      std::memset(dst_ + pos_, 0, padded - pos_);
+
+    pos_ = padded;
+  }
+
+  /**
+   * @brief Get the number of bytes written.
+   * @return Bytes.
+   */
+  std::size_t size(void) const
+  {
+    return pos_;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  std::uint8_t* dst_;  ///< Buffer, nullptr when measuring.
+  std::size_t pos_;    ///< Offset of the next byte.
+};
+
+/**
+ * @brief Reads an encoded message, checking every read against the end of the buffer.
+ */
+class SerialReader final
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param src Encoded message.
+   * @param size Its size.
+   */
+  SerialReader(const std::uint8_t* src, const std::size_t size) : src_(src), size_(size), pos_(0)
+  {
+  }
+
+  /**
+   * @brief Read a scalar.
+   * @return Value.
+   * @throws std::runtime_error if the buffer ends first.
+   */
+  template <typename T>
+  T read(void)
+  {
+    static_assert(std::is_arithmetic<T>::value, "only scalars have a fixed layout");
+    T value;
+    std::memcpy(&value, readBytes(sizeof(value)), sizeof(value));
+    return value;
+  }
+
+  /**
+   * @brief Read and check a schema header.
+   * @param type Expected type number.
+   * @param version Newest layout version the caller knows.
+   * @return Layout version the message was written with.
+   * @throws std::runtime_error if the type is different or the version newer.
+   */
+  std::uint32_t readSchema(const std::uint32_t type, const std::uint32_t version)
+  {
+    const auto found_type = read<std::uint32_t>();
+    const auto found_version = read<std::uint32_t>();
+
+    if (found_type != type)
+      fail("expected type " + std::to_string(type) + ", found " + std::to_string(found_type));
+
+    if (found_version == 0 || found_version > version)
+      fail("unsupported version " + std::to_string(found_version) + " of type " + std::to_string(type));
+
+    return found_version;
+  }
+
+  /**
+   * @brief Read a string.
+   * @return String.
+   * @throws std::runtime_error if the buffer ends first.
+   */
+  std::string readString(void)
+  {
+    const auto size = read<std::uint32_t>();
+    return std::string(reinterpret_cast<const char*>(readBytes(size)), size);
+  }
+
+  /**
+   * @brief Read an array of scalars without copying it.
+   * @return View into the buffer.
+   * @throws std::runtime_error if the buffer ends first.
+   */
+  template <typename T>
+  SerialArrayView<T> readArray(void)
+  {
+    static_assert(std::is_arithmetic<T>::value, "only scalars have a fixed layout");
+    const auto size = read<std::uint64_t>();
+    align(serial_alignment_);
+
+    if (size > remaining() / sizeof(T))
+      fail("array of " + std::to_string(size) + " elements runs past the end");
+
+    return SerialArrayView<T>(readBytes(size * sizeof(T)), size);
+  }
+
+  /**
+   * @brief Read raw bytes without copying them.
+   * @param size Number of bytes.
+   * @return Start of the bytes.
+   * @throws std::runtime_error if the buffer ends first.
+   */
+  const std::uint8_t* readBytes(const std::size_t size)
+  {
+    if (size > remaining())
+      fail("message is truncated");
+
+    const auto* src = src_ + pos_;
+    pos_ += size;
+    return src;
+  }
+
+  /**
+   * @brief Skip the padding up to an offset that is a multiple of the alignment.
+   * @param alignment Alignment, a power of 2.
+   * @throws std::runtime_error if the buffer ends first.
+   */
+  void align(const std::size_t alignment)
+  {
+    readBytes(((pos_ + alignment - 1) & ~(alignment - 1)) - pos_);
+  }
+
+  /**
+   * @brief Get the number of bytes left.
+   * @return Bytes.
+   */
+  std::size_t remaining(void) const
+  {
+    return size_ - pos_;
+  }
+
+  /**
+   * @brief Complain about a malformed message.
+   * @param what What is wrong.
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] void fail(const std::string& what) const
+  {
+    const auto error = "ERROR: SerialReader: " + what + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  const std::uint8_t* src_;  ///< Encoded message.
+  std::size_t size_;         ///< Its size.
+  std::size_t pos_;          ///< Offset of the next byte.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write a message with its schema header.
+ * @param writer Writer.
+ * @param msg Message.
+ */
+template <typename T>
+void serializeMessage(SerialWriter& writer, const T& msg)
+{
+  writer.writeSchema(SerialSchema<T>::type, SerialSchema<T>::version);
+  serializeFields(writer, msg);
+}
+
+/**
+ * @brief Read a message with its schema header.
+ * @param reader Reader.
+ * @return Message. Zero-copy fields point into the reader's buffer.
+ * @throws std::runtime_error if the message is malformed or of another type.
+ */
+template <typename T>
+T deserializeMessage(SerialReader& reader)
+{
+  const auto version = reader.readSchema(SerialSchema<T>::type, SerialSchema<T>::version);
+  return deserializeFields(reader, version, SerialTag<T>());
+}
+
+/**
+ * @brief Write the items of a list. They share the list's schema header.
+ * @param writer Writer.
+ * @param list List.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const ListMessage<T>& list)
+{
+  writer.write(static_cast<std::uint64_t>(list.getItems().size()));
+
+  for (const auto& item : list.getItems())
+    serializeFields(writer, item);
+}
+
+/**
+ * @brief Read the items of a list.
+ * @param reader Reader.
+ * @param version Layout version of the items.
+ * @return List.
+ */
+template <typename T>
+ListMessage<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<ListMessage<T>>)
+{
+  const auto size = reader.read<std::uint64_t>();
+
+  // Every item takes at least a byte, which keeps a corrupt size from reserving the world.
+  std::vector<T> items;
+  items.reserve(std::min<std::uint64_t>(size, reader.remaining()));
+
+  for (std::uint64_t i = 0; i < size; ++i)
+    items.push_back(deserializeFields(reader, version, SerialTag<T>()));
+
+  return ListMessage<T>(std::move(items));
+}
+
+/**
+ * @brief Make a codec for a serializable message type. Decoded messages hold the buffer's lease, since zero-copy
+ * fields point into it.
+ * @return Codec.
+ */
+template <typename T>
+MessageCodec makeSerialCodec(void)
+{
+  MessageCodec codec;
+
+  codec.size = [](const MessageInterface& msg) {
+    SerialWriter writer;
+    serializeMessage(writer, static_cast<const T&>(msg));
+    return writer.size();
+  };
+
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    SerialWriter writer(dst);
+    serializeMessage(writer, static_cast<const T&>(msg));
+  };
+
+  codec.decode = [](const std::uint8_t* src, const std::size_t size, std::shared_ptr<const void> lease) {
+    SerialReader reader(src, size);
+    auto* msg = new T(deserializeMessage<T>(reader));
+
+    return std::shared_ptr<MessageInterface>(msg, [lease](MessageInterface* p) { delete p; });
+  };
+
+  return codec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Codecs of serializable types, found by C++ type when encoding and by schema type when decoding. Lets a
+ * recorder or bridge carry topics without being told their types. Not thread safe while types are being added.
+ */
+class SerialCodecRegistry final
+{
+public:
+  /**
+   * @brief Add a serializable type.
+   */
+  template <typename T>
+  void add(void)
+  {
+    by_type_[std::type_index(typeid(T))] = SerialSchema<T>::type;
+    codecs_[SerialSchema<T>::type] = makeSerialCodec<T>();
+  }
+
+  /**
+   * @brief Add a serializable type and lists of it.
+   */
+  template <typename T>
+  void addWithList(void)
+  {
+    add<T>();
+    add<ListMessage<T>>();
+  }
+
+  /**
+   * @brief Find the codec for a message's type.
+   * @param msg Message.
+   * @return Codec, or nullptr if the type wasn't added.
+   */
+  const MessageCodec* find(const MessageInterface& msg) const
+  {
+    const auto type = by_type_.find(std::type_index(typeid(msg)));
+    return type != by_type_.end() ? &codecs_.at(type->second) : nullptr;
+  }
+
+  /**
+   * @brief Find the codec for an encoded message.
+   * @param src Encoded message.
+   * @param size Its size.
+   * @return Codec, or nullptr if the type wasn't added.
+   */
+  const MessageCodec* find(const std::uint8_t* src, const std::size_t size) const
+  {
+    if (size < sizeof(SerialSchemaHeader))
+      return nullptr;
+
+    SerialSchemaHeader header;
+    std::memcpy(&header, src, sizeof(header));
+
+    const auto codec = codecs_.find(header.type);
+    return codec != codecs_.end() ? &codec->second : nullptr;
+  }
+
+  /**
+   * @brief Make a codec for any of the types added so far. The registry must outlive it.
+   * @return Codec. It throws std::runtime_error on messages of other types.
+   */
+  MessageCodec makeCodec(void) const
+  {
+    MessageCodec codec;
+
+    codec.size = [this](const MessageInterface& msg) { return get(msg).size(msg); };
+    codec.encode = [this](const MessageInterface& msg, std::uint8_t* dst) { get(msg).encode(msg, dst); };
+
+    codec.decode = [this](const std::uint8_t* src, const std::size_t size, std::shared_ptr<const void> lease) {
+      const auto* codec = find(src, size);
+      if (codec == nullptr)
+        fail("no codec for the encoded message");
+
+      return codec->decode(src, size, std::move(lease));
+    };
+
+    return codec;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Get the codec for a message's type.
+   * @param msg Message.
+   * @return Codec.
+   * @throws std::runtime_error if there is none.
+   */
+  const MessageCodec& get(const MessageInterface& msg) const
+  {
+    const auto* codec = find(msg);
+    if (codec == nullptr)
+      fail(std::string("no codec for ") + typeid(msg).name());
+
+    return *codec;
+  }
+
+  /**
+   * @brief Complain about a message no codec handles.
+   * @param what What is wrong.
+   * @throws std::runtime_error always.
+   */
+  [[noreturn]] static void fail(const std::string& what)
+  {
+    const auto error = "ERROR: SerialCodecRegistry: " + what + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  /** Schema type by C++ type. */
+  std::unordered_map<std::type_index, std::uint32_t> by_type_;
+
+  /** Codecs by schema type. */
+  std::unordered_map<std::uint32_t, MessageCodec> codecs_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_SERIALIZATION_H_
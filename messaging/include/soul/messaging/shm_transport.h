@@ -0,0 +1,331 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_SHM_TRANSPORT_H_
+#define SOUL_MESSAGING_SHM_TRANSPORT_H_
+
+/*
+ * Shared memory transport.
+ *
+ * Moves messages between processes without serialising them through a pipe.
+ * Every topic gets a channel made of two POSIX shared memory objects:
+ *
+ *   <prefix>.<msg_id>.ctl   Control block. A ring of ready slot indices, a
+ *                           ring of free slot indices and a process-shared
+ *                           semaphore. Mapped read/write by both sides.
+ *   <prefix>.<msg_id>.data  Fixed size payload slots. Mapped read/write by the
+ *                           producer and read-only by the consumer.
+ *
+ * The producer encodes a message straight into a free slot and hands the
+ * slot index to the consumer. The consumer decodes in place, so codecs can
+ * build messages that point into the mapping (e.g. cv::Mat headers over
+ * pixel data). The slot goes back to the producer when the last reference to
+ * the decoded message goes away.
+ *
+ * A channel has one producer process and one consumer process. Fan-out
+ * happens on the consumer side by sending into its MessageManager.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/codec.h>
+#include <soul/messaging/interface.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Shared memory codecs are plain message codecs. Slots are the buffers they encode into and decode from. */
+using ShmCodec = MessageCodec;
+
+/**
+ * @brief Shared memory channel configuration.
+ */
+struct ShmChannelOptions
+{
+  /** Number of payload slots. Bounds the number of messages in flight. */
+  std::size_t slot_count = 8;
+
+  /** Size of each payload slot in bytes. Must fit the largest encoded message. */
+  std::size_t slot_size = 1 << 20;
+
+  /** How long the producer waits for a free slot before dropping the message. 0 drops straight away. */
+  std::chrono::milliseconds block_timeout{ 0 };
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief One direction, one topic shared memory channel.
+ */
+class ShmChannel : public std::enable_shared_from_this<ShmChannel>
+{
+public:
+  /**
+   * @brief Create a channel as its producer. Replaces any stale channel with the same name.
+   * @param name Channel name. Must not contain '/'.
+   * @param options Channel configuration.
+   * @return The channel.
+   * @throws std::runtime_error if the shared memory can't be set up.
+   */
+  static std::shared_ptr<ShmChannel> create(const std::string& name, const ShmChannelOptions& options);
+
+  /**
+   * @brief Open a channel as its consumer. Waits for a producer that is still running to create it.
+   * @param name Channel name.
+   * @param timeout How long to wait for the channel.
+   * @return The channel, or nullptr if it didn't show up in time.
+   */
+  static std::shared_ptr<ShmChannel> open(const std::string& name, const std::chrono::milliseconds timeout);
+
+  /** Destructor. Unmaps the channel. The producer also removes the names. */
+  ~ShmChannel();
+
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+
+  /**
+   * @brief Encode a message into a free slot and pass it to the consumer. Producer only.
+   * @param msg Message to send.
+   * @param codec Codec for the message type.
+   * @return True if sent, false if it was dropped because no slot became free in time.
+   * @throws std::runtime_error if the encoded message doesn't fit in a slot.
+   */
+  bool write(const MessageInterface& msg, const ShmCodec& codec);
+
+  /**
+   * @brief Wait for the next message. Consumer only.
+   * @param codec Codec for the message type.
+   * @param timeout How long to wait.
+   * @return The message, or nullptr on timeout.
+   * @throws std::runtime_error if the slot index or size the producer left is out of range, or the codec rejects the
+   * slot.
+   */
+  std::shared_ptr<MessageInterface> read(const ShmCodec& codec, const std::chrono::milliseconds timeout);
+
+  /**
+   * @brief Indicate whether the process that created the channel is still running.
+   * @return True if the producer is alive.
+   */
+  bool isProducerAlive(void) const;
+
+  /**
+   * @brief Get the number of messages the producer dropped for lack of a free slot.
+   * @return Number of dropped messages.
+   */
+  std::uint64_t getDropped(void) const;
+
+  /**
+   * @brief Get the channel name.
+   * @return Channel name.
+   */
+  const std::string& getName(void) const;
+
+  /** Control block header. Defined in the source file. */
+  struct Header;
+
+  /** Ring of slot indices in the control block. Defined in the source file. */
+  struct Ring;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Constructor. Use create() or open().
+   * @param name Channel name.
+   * @param producer Whether this side created the channel.
+   */
+  ShmChannel(const std::string& name, const bool producer);
+
+  /**
+   * @brief Point the ring and size pointers into the control mapping. Needs the slot geometry to be set.
+   */
+  void layout(void);
+
+  /**
+   * @brief Give a slot back to the producer.
+   * @param slot Slot index.
+   */
+  void release(const std::uint64_t slot);
+
+  /** Channel name. */
+  const std::string name_;
+
+  /** Whether this side created the channel. */
+  const bool producer_;
+
+  /** How long write() waits for a free slot. */
+  std::chrono::milliseconds block_timeout_{ 0 };
+
+  /** Control block mapping. */
+  void* ctl_ = nullptr;
+
+  /** Size of the control block mapping. */
+  std::size_t ctl_size_ = 0;
+
+  /** Payload mapping. Read-only for the consumer. */
+  std::uint8_t* data_ = nullptr;
+
+  /** Size of the payload mapping. */
+  std::size_t data_size_ = 0;
+
+  /** Number of payload slots. A copy, since the consumer can't trust the header after checking it. */
+  std::uint64_t slot_count_ = 0;
+
+  /** Bytes per payload slot. */
+  std::uint64_t slot_size_ = 0;
+
+  /** Ring capacity - 1. */
+  std::uint64_t mask_ = 0;
+
+  /** Control block header. */
+  Header* header_ = nullptr;
+
+  /** Slots with messages for the consumer. */
+  Ring* ready_ = nullptr;
+
+  /** Slots the producer can write to. */
+  Ring* free_ = nullptr;
+
+  /** Encoded size of the message in each slot. */
+  std::uint64_t* sizes_ = nullptr;
+};
+
+/**
+ * @brief Sends messages to another process. Hand getSender() to a plugin in place of the messaging manager's sender.
+ */
+class ShmPublisher
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param prefix Prefix for the channel names. Both processes must agree on it.
+   */
+  explicit ShmPublisher(const std::string prefix);
+
+  /**
+   * @brief Create the channel for a msg_id.
+   * @param msg_id Message ID.
+   * @param codec Codec for messages on msg_id.
+   * @param options Channel configuration.
+   */
+  void addTopic(const std::string msg_id, ShmCodec codec, const ShmChannelOptions& options = ShmChannelOptions());
+
+  /**
+   * @brief Get a message sending function that writes to the channels.
+   * @return Message sending function. Throws std::runtime_error for msg_ids without a channel.
+   */
+  MessageSenderFn getSender(void);
+
+  /**
+   * @brief Get the number of messages dropped on a msg_id's channel.
+   * @param msg_id Message ID.
+   * @return Number of dropped messages, 0 for unknown msg_ids.
+   */
+  std::uint64_t getDropped(const std::string& msg_id);
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Channel and codec for one msg_id. */
+  struct Topic
+  {
+    std::shared_ptr<ShmChannel> channel;  ///< Channel.
+    ShmCodec codec;                       ///< Codec.
+  };
+
+  /**
+   * @brief Send a message over the msg_id's channel.
+   * @param msg_id Message ID.
+   * @param msg Message.
+   */
+  void send(const std::string& msg_id, const std::shared_ptr<MessageInterface>& msg);
+
+  /** Channel name prefix. */
+  const std::string prefix_;
+
+  /** Map from msg_id to its channel. */
+  std::unordered_map<std::string, std::shared_ptr<Topic>> topics_;
+
+  /** Lock for topics_. */
+  std::mutex lock_;
+};
+
+/**
+ * @brief Receives messages from another process and passes them to callbacks, one reader thread per msg_id.
+ */
+class ShmSubscriber
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param prefix Prefix for the channel names. Both processes must agree on it.
+   */
+  explicit ShmSubscriber(const std::string prefix);
+
+  /** Destructor. Stops the reader threads. */
+  ~ShmSubscriber();
+
+  /**
+   * @brief Start receiving a msg_id. If the producer process dies, the reader waits for it to come back.
+   * @param msg_id Message ID.
+   * @param codec Codec for messages on msg_id.
+   * @param cb Callback for received messages. Typically sends into the local messaging manager.
+   */
+  void subscribe(const std::string msg_id, ShmCodec codec, MessageReceivedCb cb);
+
+  /**
+   * @brief Stop and join the reader threads.
+   */
+  void stop(void);
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** How often reader threads check whether they should stop. */
+  static constexpr std::chrono::milliseconds poll_time_{ 100 };
+
+  /**
+   * @brief Reader thread body.
+   * @param name Channel name.
+   * @param codec Codec for the channel.
+   * @param cb Callback for received messages.
+   */
+  void readLoop(const std::string name, const ShmCodec codec, const MessageReceivedCb cb);
+
+  /** Channel name prefix. */
+  const std::string prefix_;
+
+  /** Reader threads. */
+  std::vector<std::thread> threads_;
+
+  /** Whether the reader threads should keep going. */
+  std::atomic<bool> running_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_SHM_TRANSPORT_H_
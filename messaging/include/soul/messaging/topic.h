@@ -0,0 +1,187 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_TOPIC_H_
+#define SOUL_MESSAGING_TOPIC_H_
+
+/*
+ * Typed topic.
+ *
+ * A TopicHandle that knows its message type. The messaging manager checks
+ * the type once, when publishers and subscribers register, so messages can
+ * be handed to typed subscribers with a static cast instead of a
+ * dynamic_pointer_cast per message.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/interface.h>
+#include <soul/messaging/topic_handle.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Callback for subscribers of a typed topic. */
+template <typename T>
+using TypedMessageReceivedCb = std::function<void(std::shared_ptr<const T>)>;
+
+template <typename T>
+class TypedMessageBatch;
+
+/** Callback for batch subscribers of a typed topic. */
+template <typename T>
+using TypedMessageBatchCb = std::function<void(const TypedMessageBatch<T>&)>;
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Messages of a typed topic handed to a batch subscriber, oldest first. Like MessageBatch it is only valid
+ * during the callback. Elements are accessed without casting shared pointers, so nothing is copied.
+ * @tparam T Message type.
+ */
+template <typename T>
+class TypedMessageBatch
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param batch Untyped batch. Every message in it must be a T.
+   */
+  explicit TypedMessageBatch(const MessageBatch& batch) : batch_(batch)
+  {
+  }
+
+  /**
+   * @brief Get the number of messages.
+   * @return Number of messages.
+   */
+  std::size_t size(void) const
+  {
+    return batch_.size();
+  }
+
+  /**
+   * @brief Indicate whether the batch is empty.
+   * @return True if there are no messages.
+   */
+  bool empty(void) const
+  {
+    return batch_.empty();
+  }
+
+  /**
+   * @brief Access a message. Use share() if the topic carries null messages.
+   * @param i Index, oldest first.
+   * @return Message.
+   */
+  const T& operator[](const std::size_t i) const
+  {
+    return static_cast<const T&>(*batch_[i]);
+  }
+
+  /**
+   * @brief Get a message to keep beyond the callback.
+   * @param i Index, oldest first.
+   * @return Shared pointer to the message.
+   */
+  std::shared_ptr<const T> share(const std::size_t i) const
+  {
+    return std::static_pointer_cast<const T>(batch_[i]);
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Untyped batch. */
+  const MessageBatch& batch_;
+};
+
+/**
+ * @brief Handle to a message topic that carries messages of type T. Returned by MessageManager::publish<T>().
+ * @tparam T Message type. Must derive publicly from MessageInterface.
+ */
+template <typename T>
+class Topic
+{
+public:
+  static_assert(std::is_base_of<MessageInterface, T>::value, "Topic message types must derive from MessageInterface");
+
+  /** Message type. */
+  using message_type = T;
+
+  /** Default constructor. Creates an invalid topic. */
+  Topic() = default;
+
+  /**
+   * @brief Indicate whether the topic can be used for sending.
+   * @return True if valid.
+   */
+  bool valid(void) const
+  {
+    return handle_.valid();
+  }
+
+  /**
+   * @brief Get the message ID.
+   * @return Message ID.
+   */
+  const std::string& getMsgId(void) const
+  {
+    return handle_.getMsgId();
+  }
+
+  /**
+   * @brief Get the name of the publisher the topic was issued to.
+   * @return Publisher name.
+   */
+  const std::string& getPublisherName(void) const
+  {
+    return handle_.getPublisherName();
+  }
+
+  /**
+   * @brief Get the untyped handle, for code that still uses the MessageInterface API.
+   * @return Handle.
+   */
+  const TopicHandle& getHandle(void) const
+  {
+    return handle_;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  friend class MessageManager;
+
+  /**
+   * @brief Constructor.
+   * @param handle Resolved handle.
+   */
+  explicit Topic(const TopicHandle& handle) : handle_(handle)
+  {
+  }
+
+  /** Untyped handle. */
+  TopicHandle handle_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_TOPIC_H_
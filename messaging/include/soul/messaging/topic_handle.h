@@ -0,0 +1,125 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_TOPIC_HANDLE_H_
+#define SOUL_MESSAGING_TOPIC_HANDLE_H_
+
+/*
+ * Topic handle.
+ *
+ * A pre-resolved publication right to a message topic. The messaging manager
+ * hands these out on publish() so that senders can skip the msg_id and
+ * publisher name lookups on every message.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/message_publisher.h>
+
+#include <atomic>
+#include <memory>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+class MessageManager;
+struct MessageTopic;
+
+/**
+ * @brief A publisher's registration, shared by the messaging manager and the handles it issued. It outlives
+ * unpublish() so that stale handles can tell they were revoked.
+ */
+struct PublisherEntry
+{
+  /**
+   * @brief Constructor.
+   * @param pub Publisher, with its msg_id set.
+   */
+  explicit PublisherEntry(const MessagePublisher& pub) : publisher(pub), revoked(false)
+  {
+  }
+
+  /** Publisher. */
+  const MessagePublisher publisher;
+
+  /** Set when the publisher is withdrawn or the manager is cleared. */
+  std::atomic<bool> revoked;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Handle to a message topic for a particular publisher. Only the messaging manager can create valid handles.
+ * A handle stays valid until the manager that issued it is cleared, or the publisher is withdrawn. After that the
+ * manager refuses sends on it. A handle must not be used after its manager is destroyed.
+ */
+class TopicHandle
+{
+public:
+  /** Default constructor. Creates an invalid handle. */
+  TopicHandle() = default;
+
+  /**
+   * @brief Indicate whether the handle refers to a message topic.
+   * @return True if the handle can be used for sending.
+   */
+  bool valid(void) const
+  {
+    return topic_ != nullptr && publisher_ != nullptr && !publisher_->revoked.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Get the message ID the handle publishes to.
+   * @return Message ID.
+   */
+  const std::string& getMsgId(void) const
+  {
+    return publisher_->publisher.msg_id;
+  }
+
+  /**
+   * @brief Get the name of the publisher the handle was issued to.
+   * @return Publisher name.
+   */
+  const std::string& getPublisherName(void) const
+  {
+    return publisher_->publisher.name;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  friend class MessageManager;
+
+  /**
+   * @brief Constructor.
+   * @param topic Topic to send to.
+   * @param publisher Registered publisher entry.
+   */
+  TopicHandle(MessageTopic* const topic, std::shared_ptr<const PublisherEntry> publisher)
+    : topic_(topic), publisher_(std::move(publisher))
+  {
+  }
+
+  /** Topic the handle sends to. */
+  MessageTopic* topic_ = nullptr;
+
+  /** Publisher entry in the manager's publisher list. Kept alive by the handle so revocation can be seen. */
+  std::shared_ptr<const PublisherEntry> publisher_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_TOPIC_HANDLE_H_
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_MESSAGING_TRACE_H_
+#define SOUL_MESSAGING_TRACE_H_
+
+/*
+ * Message tracing.
+ *
+ * With a tracer set, the messaging manager records when each message is
+ * enqueued, when notify() takes it off its queue and how long every
+ * subscriber callback takes. Messages derived from one another share a trace
+ * ID, so a frame can be followed from the camera through every plugin hop.
+ * Events also carry the capture time, which is not an ID: unrelated messages
+ * can share one. The trace can be written in the Chrome trace event format and opened in
+ * Perfetto or chrome://tracing.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/interface.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief What a trace event records.
+ */
+enum class TraceEventKind
+{
+  enqueue,   ///< A publisher sent the message.
+  dispatch,  ///< notify() took the message off its queue.
+  callback,  ///< A subscriber callback ran.
+};
+
+/**
+ * @brief One trace event.
+ */
+struct TraceEvent
+{
+  TraceEventKind kind = TraceEventKind::enqueue;  ///< What happened.
+  std::string msg_id;                             ///< Topic.
+  std::string actor;                              ///< Publisher for enqueues, subscriber for callbacks.
+  std::uint64_t trace_id = 0;                     ///< Trace the message belongs to. 0 if it had none.
+  std::size_t messages = 1;                       ///< Messages handled, more than one for batch callbacks.
+  std::chrono::steady_clock::time_point start;    ///< When it happened.
+  std::chrono::nanoseconds duration{ 0 };         ///< How long it took. 0 for enqueues and dispatches.
+  std::chrono::system_clock::time_point capture;  ///< Capture time of the message. The epoch if it had none.
+  std::chrono::nanoseconds since_capture{ -1 };   ///< Time from capture to start. Negative without a capture time.
+  std::thread::id thread;                         ///< Thread it happened on.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Records message trace events. Thread safe.
+ */
+class MessageTracer final
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param capacity Events to keep. Later events are dropped and counted, so a long run can't exhaust memory.
+   */
+  explicit MessageTracer(const std::size_t capacity = 1000000);
+
+  MessageTracer(const MessageTracer&) = delete;
+  MessageTracer& operator=(const MessageTracer&) = delete;
+
+  /**
+   * @brief Record that a message was sent. Gives it a new trace ID if it has none. Derived messages join their
+   * source's trace with inheritTrace().
+   * @param msg_id Topic.
+   * @param publisher Publisher name.
+   * @param msg Message.
+   */
+  void traceEnqueue(const std::string& msg_id, const std::string& publisher, MessageInterface& msg);
+
+  /**
+   * @brief Record that notify() took messages off a topic's queue.
+   * @param msg_id Topic.
+   * @param msgs Messages, oldest first.
+   */
+  void traceDispatch(const std::string& msg_id, const std::vector<std::shared_ptr<MessageInterface>>& msgs);
+
+  /**
+   * @brief Record a subscriber callback that has just returned.
+   * @param msg_id Topic.
+   * @param subscriber Subscriber name.
+   * @param msg Message it handled. The newest one for batch callbacks. May be null.
+   * @param start When the callback was called.
+   * @param messages Messages it handled.
+   */
+  void traceCallback(const std::string& msg_id, const std::string& subscriber, const MessageInterface* msg,
+                     const std::chrono::steady_clock::time_point start, const std::size_t messages = 1);
+
+  /**
+   * @brief Get the events recorded so far.
+   * @return Events in the order they were recorded.
+   */
+  std::vector<TraceEvent> getEvents(void) const;
+
+  /**
+   * @brief Get the number of events dropped because the tracer was full.
+   * @return Dropped events.
+   */
+  std::uint64_t getDropped(void) const;
+
+  /**
+   * @brief Forget the recorded events.
+   */
+  void clear(void);
+
+  /**
+   * @brief Write the events in the Chrome trace event format. Events on the same trace are joined by flow arrows.
+   * @param out Where to write.
+   */
+  void writeChromeTrace(std::ostream& out) const;
+
+  /**
+   * @brief Write the events to a Chrome trace event file.
+   * @param path File path.
+   * @return False if the file couldn't be written.
+   */
+  bool writeChromeTrace(const std::string& path) const;
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Store an event, or count it as dropped if the tracer is full.
+   * @param event Event.
+   */
+  void record(TraceEvent event);
+
+  /**
+   * @brief Set an event's trace ID, capture time and time since capture from the message it is about.
+   * @param event Event.
+   * @param msg Message. May be null.
+   */
+  static void describe(TraceEvent& event, const MessageInterface* msg);
+
+  /** Events to keep. */
+  const std::size_t capacity_;
+
+  /** Source of trace IDs. */
+  std::atomic<std::uint64_t> next_id_;
+
+  /** Lock for events_ and dropped_. */
+  mutable std::mutex lock_;
+
+  /** Recorded events. */
+  std::vector<TraceEvent> events_;
+
+  /** Events dropped because the tracer was full. */
+  std::uint64_t dropped_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_MESSAGING_TRACE_H_
@@ -0,0 +1,824 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message bridge.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/bridge.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+// The stream structs are sent as they are in memory.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "bridge streams are little-endian");
+static_assert(sizeof(BridgeHello) == 16, "unexpected BridgeHello padding");
+static_assert(sizeof(BridgeFrameHeader) == 24, "unexpected BridgeFrameHeader padding");
+
+namespace
+{
+/** Most frames handed to one sendmsg() call. */
+constexpr std::size_t max_iov_ = 64;
+
+/** Bytes read at once from clients, which aren't expected to send anything. */
+constexpr std::size_t drain_size_ = 4096;
+
+/** Connections the listening socket holds until they are accepted. */
+constexpr int listen_backlog_ = 16;
+
+/** Longest a client waits for the stream header after connecting. */
+constexpr std::chrono::milliseconds hello_timeout_{ 5000 };
+
+/** Largest payload a client accepts, so a corrupt size doesn't allocate the world. */
+constexpr std::uint64_t max_payload_ = std::uint64_t(1) << 32;
+
+/**
+ * @brief Parts of a bridge address.
+ */
+struct Address
+{
+  bool tcp = false;  ///< TCP or Unix-domain.
+  std::string path;  ///< Socket path, for Unix-domain sockets.
+  std::string host;  ///< Host as written, for TCP. IPv6 addresses are in brackets.
+  std::string port;  ///< Port, for TCP.
+};
+
+/**
+ * @brief Split an address into its parts.
+ * @param address "unix:<path>" or "tcp:<host>:<port>".
+ * @param parsed Receives the parts.
+ * @return Whether the address is well formed.
+ */
+bool parseAddress(const std::string& address, Address& parsed)
+{
+  if (address.compare(0, 5, "unix:") == 0)
+  {
+    parsed.tcp = false;
+    parsed.path = address.substr(5);
+
+    return !parsed.path.empty() && parsed.path.size() < sizeof(sockaddr_un::sun_path);
+  }
+
+  if (address.compare(0, 4, "tcp:") != 0)
+    return false;
+
+  const auto colon = address.rfind(':');
+  if (colon < 4)
+    return false;
+
+  parsed.tcp = true;
+  parsed.host = address.substr(4, colon - 4);
+  parsed.port = address.substr(colon + 1);
+
+  return !parsed.host.empty() && !parsed.port.empty() && parsed.port.size() <= 5 &&
+         parsed.port.find_first_not_of("0123456789") == std::string::npos && std::stoul(parsed.port) <= 65535;
+}
+
+/**
+ * @brief Make a Unix-domain socket address.
+ * @param path Socket path. Must fit.
+ * @return Address.
+ */
+sockaddr_un makeUnixAddress(const std::string& path)
+{
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.data(), path.size());
+
+  return addr;
+}
+
+/**
+ * @brief Resolve a TCP address.
+ * @param parsed Address.
+ * @param flags getaddrinfo() flags.
+ * @param error Receives what went wrong, if anything did.
+ * @return The first address found, or nullptr.
+ */
+std::unique_ptr<addrinfo, void (*)(addrinfo*)> resolve(const Address& parsed, const int flags, std::string& error)
+{
+  auto host = parsed.host;
+  if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+    host = host.substr(1, host.size() - 2);
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = flags | AI_NUMERICSERV;
+
+  addrinfo* found = nullptr;
+  const int err = getaddrinfo(host.c_str(), parsed.port.c_str(), &hints, &found);
+  if (err != 0)
+    error = gai_strerror(err);
+
+  return std::unique_ptr<addrinfo, void (*)(addrinfo*)>(err == 0 ? found : nullptr, &freeaddrinfo);
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+MessageBridge::MessageBridge(MessageManager& msgman, const std::string& address, const BridgeOptions& options)
+  : msgman_(msgman)
+  , options_(options)
+  , tcp_(false)
+  , listen_fd_(-1)
+  , wake_fd_(-1)
+  , closed_(false)
+  , queue_(options.queue_capacity)
+  , wake_pending_(false)
+  , stop_(false)
+  , clients_gauge_(msgman.getMetrics()->getGauge("soul_bridge_clients", "Clients connected to bridges.",
+                                                 { { "bridge", options.name } }))
+  , sent_(msgman.getMetrics()->getCounter("soul_bridge_messages_total", "Messages bridges sent, once per client.",
+                                          { { "bridge", options.name } }))
+  , dropped_(msgman.getMetrics()->getCounter("soul_bridge_dropped_total",
+                                             "Messages bridges dropped, once per client that fell behind.",
+                                             { { "bridge", options.name } }))
+  , client_count_(0)
+{
+  listen(address);
+
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0)
+    fail(std::string("can't create an eventfd: ") + std::strerror(errno));
+
+  thread_ = std::thread(&MessageBridge::run, this);
+}
+
+MessageBridge::~MessageBridge()
+{
+  close();
+}
+
+void MessageBridge::exportTopic(const std::string& msg_id, MessageCodec codec)
+{
+  if (codec.size == nullptr || codec.encode == nullptr)
+  {
+    const auto error = "ERROR: MessageBridge: the codec for " + msg_id + " can't encode\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  Topic* topic = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (closed_)
+    {
+      const auto error = "ERROR: MessageBridge: can't export " + msg_id + " after closing " + address_ + "\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+
+    const auto exported = std::find_if(topics_.begin(), topics_.end(),
+                                       [&msg_id](const std::unique_ptr<Topic>& t) { return t->msg_id == msg_id; });
+    if (exported != topics_.end())
+    {
+      const auto error = "ERROR: MessageBridge: " + msg_id + " is already exported\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+
+    topics_.push_back(std::make_unique<Topic>());
+    topic = topics_.back().get();
+    topic->msg_id = msg_id;
+    topic->number = static_cast<std::uint32_t>(topics_.size() - 1);
+    topic->codec = std::move(codec);
+  }
+
+  // Outside the lock: in lazy mode subscribing can load plugins.
+  msgman_.subscribe(msg_id, options_.name,
+                    [this, topic](std::shared_ptr<MessageInterface> msg) { enqueue(topic, std::move(msg)); });
+}
+
+void MessageBridge::close(void)
+{
+  std::vector<std::string> msg_ids;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (closed_)
+      return;
+
+    closed_ = true;
+
+    for (const auto& topic : topics_)
+      msg_ids.push_back(topic->msg_id);
+  }
+
+  for (const auto& msg_id : msg_ids)
+    msgman_.unsubscribe(msg_id, options_.name);
+
+  stop_ = true;
+  wake();
+  thread_.join();
+
+  ::close(listen_fd_);
+  ::close(wake_fd_);
+
+  if (!unix_path_.empty())
+    unlink(unix_path_.c_str());
+}
+
+const std::string& MessageBridge::getAddress(void) const
+{
+  return address_;
+}
+
+std::size_t MessageBridge::getClients(void) const
+{
+  return client_count_.load();
+}
+
+std::uint64_t MessageBridge::getSent(void) const
+{
+  return sent_.get();
+}
+
+std::uint64_t MessageBridge::getDropped(void) const
+{
+  return dropped_.get();
+}
+
+MessageBridgeClient::MessageBridgeClient(const std::string& address) : address_(address), fd_(-1)
+{
+  Address parsed;
+  if (!parseAddress(address, parsed))
+    fail("malformed address, expected unix:<path> or tcp:<host>:<port>");
+
+  if (!parsed.tcp)
+  {
+    const auto addr = makeUnixAddress(parsed.path);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0 || connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+      fail(std::string("can't connect: ") + std::strerror(errno));
+  }
+  else
+  {
+    std::string error;
+    const auto found = resolve(parsed, 0, error);
+    if (found == nullptr)
+      fail("can't resolve: " + error);
+
+    fd_ = socket(found->ai_family, found->ai_socktype | SOCK_CLOEXEC, found->ai_protocol);
+    if (fd_ < 0 || connect(fd_, found->ai_addr, found->ai_addrlen) != 0)
+      fail(std::string("can't connect: ") + std::strerror(errno));
+  }
+
+  BridgeHello hello;
+  if (!readBytes(&hello, sizeof(hello), hello_timeout_, true))
+    fail("no stream header");
+
+  if (std::memcmp(hello.magic, bridge_magic_, sizeof(hello.magic)) != 0)
+    fail("not a bridge");
+
+  if (hello.version != bridge_version_)
+    fail("unsupported protocol version " + std::to_string(hello.version));
+}
+
+MessageBridgeClient::~MessageBridgeClient()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+}
+
+bool MessageBridgeClient::read(BridgeMessage& msg, const std::chrono::milliseconds timeout)
+{
+  for (;;)
+  {
+    if (fd_ < 0)
+      fail("not connected");
+
+    BridgeFrameHeader header;
+    if (!readBytes(&header, sizeof(header), timeout, true))
+      return false;
+
+    if (header.size > max_payload_)
+      fail("frame of " + std::to_string(header.size) + " bytes");
+
+    // Whole words, so the payload is aligned like the messaging system's buffers.
+    const std::shared_ptr<std::uint64_t> payload(new std::uint64_t[(header.size + 7) / 8],
+                                                 std::default_delete<std::uint64_t[]>());
+    readBytes(payload.get(), header.size, timeout, false);
+
+    const auto* data = reinterpret_cast<const std::uint8_t*>(payload.get());
+
+    if (header.kind == static_cast<std::uint32_t>(BridgeFrameKind::topic))
+    {
+      topics_[header.topic] = std::string(reinterpret_cast<const char*>(data), header.size);
+      continue;
+    }
+
+    if (header.kind != static_cast<std::uint32_t>(BridgeFrameKind::message))
+      fail("unknown frame kind " + std::to_string(header.kind));
+
+    const auto topic = topics_.find(header.topic);
+    if (topic == topics_.end())
+      fail("message on unannounced topic " + std::to_string(header.topic));
+
+    msg.msg_id = topic->second;
+    msg.timestamp_ns = header.timestamp_ns;
+    msg.size = header.size;
+    msg.data = std::shared_ptr<const std::uint8_t>(payload, data);
+
+    return true;
+  }
+}
+
+int MessageBridgeClient::getFd(void) const
+{
+  return fd_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void MessageBridge::enqueue(Topic* topic, std::shared_ptr<MessageInterface> msg)
+{
+  // Nobody to send it to, so don't bother the I/O thread. Clients get the messages from when they connect.
+  const auto clients = client_count_.load();
+  if (clients == 0)
+    return;
+
+  Pending pending;
+  pending.topic = topic;
+  pending.msg = std::move(msg);
+
+  if (!queue_.tryPush(std::move(pending)))
+  {
+    dropped_.add(clients);
+    return;
+  }
+
+  wake();
+}
+
+void MessageBridge::wake(void)
+{
+  // Only the first message since the I/O thread last looked pays for the syscall.
+  if (wake_pending_.exchange(true))
+    return;
+
+  const std::uint64_t one = 1;
+  const auto written = write(wake_fd_, &one, sizeof(one));
+  (void)written;
+}
+
+void MessageBridge::run(void)
+{
+  std::vector<pollfd> fds;
+  Pending pending;
+
+  for (;;)
+  {
+    fds.clear();
+    fds.push_back({ wake_fd_, POLLIN, 0 });
+    fds.push_back({ listen_fd_, POLLIN, 0 });
+
+    for (const auto& client : clients_)
+      fds.push_back({ client->fd, static_cast<short>(client->frames.empty() ? POLLIN : POLLIN | POLLOUT), 0 });
+
+    if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+    {
+      std::cerr << "ERROR: MessageBridge: can't poll " << address_ << ": " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      std::uint64_t wakeups;
+      const auto got = ::read(wake_fd_, &wakeups, sizeof(wakeups));
+      (void)got;
+    }
+
+    // Take the flag back before draining, so messages pushed from now on wake the thread again. The exchange also
+    // makes the pushes that saw it set visible here.
+    wake_pending_.exchange(false);
+    const bool stop = stop_.load();
+
+    while (queue_.tryPop(pending))
+    {
+      // A topic is exported before it carries messages, so its frame can be made now.
+      if (pending.topic->number >= topic_frames_.size())
+        announceTopics();
+
+      const auto frame = makeFrame(pending);
+      pending = Pending();
+
+      if (frame == nullptr)
+        continue;
+
+      for (auto& client : clients_)
+        queueFrame(*client, frame, true);
+    }
+
+    if (stop)
+      break;
+
+    // Clients polled this time round come first in clients_; new ones are appended after them.
+    for (std::size_t i = 2; i < fds.size(); ++i)
+    {
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        drain(*clients_[i - 2]);
+    }
+
+    if (fds[1].revents & POLLIN)
+      accept();
+
+    // Everything queued since the last wake-up goes out together.
+    for (auto& client : clients_)
+    {
+      if (!client->closed && !client->frames.empty())
+        flush(*client);
+    }
+
+    for (auto client = clients_.begin(); client != clients_.end();)
+    {
+      if (!(*client)->closed)
+      {
+        ++client;
+        continue;
+      }
+
+      ::close((*client)->fd);
+      client = clients_.erase(client);
+    }
+
+    client_count_ = clients_.size();
+    clients_gauge_.set(static_cast<std::int64_t>(clients_.size()));
+  }
+
+  for (const auto& client : clients_)
+    ::close(client->fd);
+
+  clients_.clear();
+  client_count_ = 0;
+  clients_gauge_.set(0);
+}
+
+void MessageBridge::accept(void)
+{
+  for (;;)
+  {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        std::cerr << "ERROR: MessageBridge: can't accept a client on " << address_ << ": " << std::strerror(errno)
+                  << "\n";
+
+      return;
+    }
+
+    // Flushes go out at once instead of waiting for the previous packet to be acknowledged.
+    const int on = 1;
+    if (tcp_)
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (options_.socket_buffer_size > 0)
+      setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &options_.socket_buffer_size, sizeof(options_.socket_buffer_size));
+
+    BridgeHello hello;
+    std::memcpy(hello.magic, bridge_magic_, sizeof(hello.magic));
+    hello.version = bridge_version_;
+    hello.reserved = 0;
+
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(&hello);
+
+    clients_.push_back(std::make_unique<Client>());
+    auto& client = *clients_.back();
+    client.fd = fd;
+
+    queueFrame(client, std::make_shared<const std::vector<std::uint8_t>>(bytes, bytes + sizeof(hello)), false);
+
+    for (const auto& frame : topic_frames_)
+      queueFrame(client, frame, false);
+  }
+}
+
+void MessageBridge::announceTopics(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  for (std::size_t i = topic_frames_.size(); i < topics_.size(); ++i)
+  {
+    const auto& msg_id = topics_[i]->msg_id;
+
+    BridgeFrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.size = msg_id.size();
+    header.kind = static_cast<std::uint32_t>(BridgeFrameKind::topic);
+    header.topic = topics_[i]->number;
+
+    auto frame = std::make_shared<std::vector<std::uint8_t>>(sizeof(header) + msg_id.size());
+    std::memcpy(frame->data(), &header, sizeof(header));
+    std::memcpy(frame->data() + sizeof(header), msg_id.data(), msg_id.size());
+
+    topic_frames_.push_back(frame);
+
+    for (auto& client : clients_)
+      queueFrame(*client, frame, false);
+  }
+}
+
+MessageBridge::Frame MessageBridge::makeFrame(const Pending& pending)
+{
+  const auto& topic = *pending.topic;
+  const auto& msg = *pending.msg;
+
+  try
+  {
+    const auto size = topic.codec.size(msg);
+
+    BridgeFrameHeader header;
+    header.size = size;
+    header.kind = static_cast<std::uint32_t>(BridgeFrameKind::message);
+    header.topic = topic.number;
+    header.timestamp_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(msg.timestamp.time_since_epoch()).count();
+
+    auto frame = std::make_shared<std::vector<std::uint8_t>>(sizeof(header) + size);
+    std::memcpy(frame->data(), &header, sizeof(header));
+    topic.codec.encode(msg, frame->data() + sizeof(header));
+
+    return frame;
+  }
+  catch (const std::exception& e)
+  {
+    // E.g. a message type the codec doesn't know.
+    std::cerr << "ERROR: MessageBridge: can't encode a message on " << topic.msg_id << ": " << e.what() << "\n";
+    dropped_.add(clients_.size());
+
+    return nullptr;
+  }
+}
+
+void MessageBridge::queueFrame(Client& client, const Frame& frame, const bool message)
+{
+  if (client.closed)
+    return;
+
+  // A client with nothing waiting gets the frame however big it is, so large messages can't starve it.
+  if (message && client.backlog > 0 && client.backlog + frame->size() > options_.client_backlog)
+  {
+    dropped_.add();
+    return;
+  }
+
+  client.frames.push_back({ frame, message });
+  client.backlog += frame->size();
+}
+
+void MessageBridge::flush(Client& client)
+{
+  iovec iov[max_iov_];
+
+  while (!client.frames.empty())
+  {
+    std::size_t count = 0;
+
+    for (auto queued = client.frames.begin(); queued != client.frames.end() && count < max_iov_; ++queued, ++count)
+    {
+      const std::size_t skip = count == 0 ? client.offset : 0;
+      iov[count].iov_base = const_cast<std::uint8_t*>(queued->frame->data() + skip);
+      iov[count].iov_len = queued->frame->size() - skip;
+    }
+
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    // A client that hung up is an error here rather than a SIGPIPE.
+    const ssize_t written = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        client.closed = true;
+
+      return;
+    }
+
+    std::size_t left = static_cast<std::size_t>(written);
+    client.backlog -= left;
+
+    while (left > 0)
+    {
+      auto& queued = client.frames.front();
+      const std::size_t rest = queued.frame->size() - client.offset;
+
+      if (left < rest)
+      {
+        client.offset += left;
+        break;
+      }
+
+      if (queued.message)
+        sent_.add();
+
+      left -= rest;
+      client.offset = 0;
+      client.frames.pop_front();
+    }
+  }
+}
+
+void MessageBridge::drain(Client& client)
+{
+  std::uint8_t buffer[drain_size_];
+
+  for (;;)
+  {
+    const ssize_t got = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (got > 0 || (got < 0 && errno == EINTR))
+      continue;
+
+    if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+      client.closed = true;
+
+    return;
+  }
+}
+
+void MessageBridge::listen(const std::string& address)
+{
+  Address parsed;
+  if (!parseAddress(address, parsed))
+    fail("malformed address " + address + ", expected unix:<path> or tcp:<host>:<port>");
+
+  tcp_ = parsed.tcp;
+
+  if (!tcp_)
+  {
+    // Replace a socket left behind by an earlier run, but nothing else.
+    struct stat st;
+    if (lstat(parsed.path.c_str(), &st) == 0)
+    {
+      if (!S_ISSOCK(st.st_mode))
+        fail(parsed.path + " exists and isn't a socket");
+
+      unlink(parsed.path.c_str());
+    }
+
+    const auto addr = makeUnixAddress(parsed.path);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+      fail("can't bind " + address + ": " + std::strerror(errno));
+
+    unix_path_ = parsed.path;
+    address_ = address;
+  }
+  else
+  {
+    std::string error;
+    const auto found = resolve(parsed, AI_PASSIVE, error);
+    if (found == nullptr)
+      fail("can't resolve " + address + ": " + error);
+
+    const int on = 1;
+
+    listen_fd_ = socket(found->ai_family, found->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, found->ai_protocol);
+    if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(listen_fd_, found->ai_addr, found->ai_addrlen) != 0)
+      fail("can't bind " + address + ": " + std::strerror(errno));
+
+    // With port 0 the kernel picked one.
+    sockaddr_storage bound;
+    socklen_t bound_size = sizeof(bound);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&bound), &bound_size);
+
+    const auto port = bound.ss_family == AF_INET6 ? reinterpret_cast<const sockaddr_in6*>(&bound)->sin6_port :
+                                                    reinterpret_cast<const sockaddr_in*>(&bound)->sin_port;
+    address_ = "tcp:" + parsed.host + ":" + std::to_string(ntohs(port));
+  }
+
+  if (::listen(listen_fd_, listen_backlog_) != 0)
+    fail("can't listen on " + address + ": " + std::strerror(errno));
+}
+
+void MessageBridge::fail(const std::string& what)
+{
+  if (listen_fd_ >= 0)
+    ::close(listen_fd_);
+
+  if (wake_fd_ >= 0)
+    ::close(wake_fd_);
+
+  if (!unix_path_.empty())
+    unlink(unix_path_.c_str());
+
+  const auto error = "ERROR: MessageBridge: " + what + "\n";
+  std::cerr << error;
+  throw std::runtime_error(error);
+}
+
+bool MessageBridgeClient::readBytes(void* dst, const std::size_t size, const std::chrono::milliseconds timeout,
+                                    const bool start)
+{
+  auto* bytes = static_cast<std::uint8_t*>(dst);
+  std::size_t got = 0;
+
+  while (got < size)
+  {
+    pollfd fd = { fd_, POLLIN, 0 };
+    const int ready = poll(&fd, 1, static_cast<int>(timeout.count()));
+
+    if (ready < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      fail(std::string("can't poll: ") + std::strerror(errno));
+    }
+
+    if (ready == 0)
+    {
+      if (start && got == 0)
+        return false;
+
+      fail("the bridge stalled mid-frame");
+    }
+
+    const ssize_t n = recv(fd_, bytes + got, size - got, 0);
+
+    if (n == 0)
+      fail("the bridge hung up");
+
+    if (n < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+        continue;
+
+      fail(std::string("can't read: ") + std::strerror(errno));
+    }
+
+    got += static_cast<std::size_t>(n);
+  }
+
+  return true;
+}
+
+void MessageBridgeClient::fail(const std::string& what)
+{
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+    fd_ = -1;
+  }
+
+  const auto error = "ERROR: MessageBridgeClient: " + address_ + ": " + what + "\n";
+  std::cerr << error;
+  throw std::runtime_error(error);
+}
+
+}  // namespace soul
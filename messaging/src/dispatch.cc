@@ -0,0 +1,293 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Subscriber dispatch.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/dispatch.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/** Pool the current thread works for, if any. */
+thread_local const WorkStealingPool* current_pool_ = nullptr;
+
+/** Worker index of the current thread in current_pool_. */
+thread_local std::size_t current_worker_ = 0;
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+DispatchStrand::DispatchStrand(MessageReceivedCb cb) : cb_(std::move(cb)), scheduled_(false), closed_(false)
+{
+}
+
+DispatchStrand::DispatchStrand(MessageBatchCb batch_cb)
+  : batch_cb_(std::move(batch_cb)), scheduled_(false), closed_(false)
+{
+}
+
+void DispatchStrand::post(DispatchExecutor& executor, const std::vector<std::shared_ptr<MessageInterface>>& msgs)
+{
+  if (msgs.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (closed_)
+      return;
+
+    pending_.insert(pending_.end(), msgs.begin(), msgs.end());
+
+    if (scheduled_)
+      return;
+
+    scheduled_ = true;
+  }
+
+  auto self = shared_from_this();
+  executor.post([self]() { self->run(); });
+}
+
+void DispatchStrand::drain(void)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+  idle_cond_.wait(lock, [this]() { return !scheduled_; });
+}
+
+void DispatchStrand::close(void)
+{
+  MessageReceivedCb cb;
+  MessageBatchCb batch_cb;
+
+  {
+    std::unique_lock<std::mutex> lock(lock_);
+    idle_cond_.wait(lock, [this]() { return !scheduled_; });
+
+    // Nothing is scheduled, so run() is past its last use of the callbacks.
+    closed_ = true;
+    cb.swap(cb_);
+    batch_cb.swap(batch_cb_);
+  }
+}
+
+WorkStealingPool::WorkStealingPool(const std::size_t workers)
+  : next_(0), queued_(0), unfinished_(0), stop_(false)
+{
+  auto count = workers;
+  if (count == 0)
+    count = std::max(1u, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < count; ++i)
+    workers_.push_back(std::make_unique<Worker>());
+
+  for (std::size_t i = 0; i < count; ++i)
+    threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  drain();
+
+  {
+    std::lock_guard<std::mutex> lg(state_lock_);
+    stop_ = true;
+  }
+
+  work_cond_.notify_all();
+
+  for (auto& t : threads_)
+    t.join();
+}
+
+void WorkStealingPool::post(std::function<void()> task)
+{
+  std::size_t index = 0;
+
+  if (current_pool_ == this)
+    index = current_worker_;
+  else
+    index = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  // Count the task before it becomes visible so a worker can't finish it before it is counted.
+  {
+    std::lock_guard<std::mutex> lg(state_lock_);
+    ++queued_;
+    ++unfinished_;
+  }
+
+  {
+    std::lock_guard<std::mutex> lg(workers_[index]->lock);
+    workers_[index]->tasks.push_back(std::move(task));
+  }
+
+  work_cond_.notify_one();
+}
+
+void WorkStealingPool::drain(void)
+{
+  std::unique_lock<std::mutex> lock(state_lock_);
+  drained_cond_.wait(lock, [this]() { return unfinished_ == 0; });
+}
+
+std::size_t WorkStealingPool::getWorkerCount(void) const
+{
+  return workers_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void DispatchStrand::run(void)
+{
+  std::vector<std::shared_ptr<MessageInterface>> batch;
+
+  for (;;)
+  {
+    {
+      std::lock_guard<std::mutex> lg(lock_);
+
+      if (pending_.empty())
+      {
+        scheduled_ = false;
+        idle_cond_.notify_all();
+        return;
+      }
+
+      batch.swap(pending_);
+    }
+
+    // There is nobody to hand the exception to on a worker thread.
+    if (batch_cb_ != nullptr)
+    {
+      try
+      {
+        batch_cb_(MessageBatch(batch.data(), batch.size()));
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << "ERROR: DispatchStrand: batch subscriber callback threw: " << e.what() << std::endl;
+      }
+      catch (...)
+      {
+        std::cerr << "ERROR: DispatchStrand: batch subscriber callback threw an unknown exception" << std::endl;
+      }
+    }
+    else
+    {
+      for (auto& msg : batch)
+      {
+        try
+        {
+          cb_(msg);
+        }
+        catch (const std::exception& e)
+        {
+          std::cerr << "ERROR: DispatchStrand: subscriber callback threw: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+          std::cerr << "ERROR: DispatchStrand: subscriber callback threw an unknown exception" << std::endl;
+        }
+      }
+    }
+
+    batch.clear();
+  }
+}
+
+void WorkStealingPool::workerLoop(const std::size_t index)
+{
+  current_pool_ = this;
+  current_worker_ = index;
+
+  std::function<void()> task;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(state_lock_);
+      work_cond_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+
+      if (stop_ && queued_ == 0)
+        return;
+    }
+
+    // Another worker may have taken the task we were woken for.
+    if (!popTask(index, task))
+      continue;
+
+    {
+      std::lock_guard<std::mutex> lg(state_lock_);
+      --queued_;
+    }
+
+    task();
+    task = nullptr;
+
+    bool drained = false;
+    {
+      std::lock_guard<std::mutex> lg(state_lock_);
+      drained = --unfinished_ == 0;
+    }
+
+    if (drained)
+      drained_cond_.notify_all();
+  }
+}
+
+bool WorkStealingPool::popTask(const std::size_t index, std::function<void()>& task)
+{
+  {
+    auto& own = *workers_[index];
+    std::lock_guard<std::mutex> lg(own.lock);
+
+    if (!own.tasks.empty())
+    {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  for (std::size_t i = 1; i < workers_.size(); ++i)
+  {
+    auto& victim = *workers_[(index + i) % workers_.size()];
+    std::lock_guard<std::mutex> lg(victim.lock);
+
+    if (!victim.tasks.empty())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace soul
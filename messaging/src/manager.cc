@@ -13,9 +13,14 @@
 
 #include <soul/messaging/manager.h>
 
-#include <future>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeinfo>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -27,134 +32,437 @@ namespace soul
 // PUBLIC METHODS                                                            //
 ///////////////////////////////////////////////////////////////////////////////
 
-MessageManager::MessageManager() : num_msgs_(0), work_(true)
+MessageManager::MessageManager()
+  : num_msgs_(0)
+  , work_(true)
+  , metrics_(std::make_shared<MetricsRegistry>())
+  , pending_metric_(metrics_->getGauge("soul_messages_pending", "Messages waiting in any queue."))
+  , tracing_(nullptr)
+  , notify_thread_(std::thread::id())
+  , delivery_waiters_(0)
 {
-  using namespace std::chrono_literals;
+  metrics_collector_ = metrics_->addCollector([this]() { collectMetrics(); });
+}
+
+MessageManager::~MessageManager()
+{
+  // The registry may outlive us, e.g., in a metrics dumper.
+  metrics_->removeCollector(metrics_collector_);
 
-  // Default maximum wait time before re-polling for data.
-  wait_time_ = 10ms;
+  const auto executor = std::atomic_load(&executor_);
+  if (executor)
+    executor->drain();
 }
 
 void MessageManager::clear(void)
 {
-  queue_.clear();
+  // Pooled callbacks may still hold on to subscriber state.
+  const auto executor = std::atomic_load(&executor_);
+  if (executor)
+    executor->drain();
+
+  {
+    std::lock_guard<std::mutex> lg(ready_lock_);
+    ready_.clear();
+  }
+
+  // Handles outlive the topics they point to, so make sure they are refused from now on.
+  for (auto& pubs : publishers_)
+  {
+    for (auto& pub : pubs.second)
+      pub.second->revoked = true;
+  }
+
+  topics_.clear();
   publishers_.clear();
   subscribers_.clear();
 }
 
+std::unordered_map<std::string, std::uint64_t> MessageManager::getDropped(void)
+{
+  std::lock_guard<std::mutex> lg(mlock_);
+  std::unordered_map<std::string, std::uint64_t> dropped;
+
+  for (const auto& entry : topics_)
+  {
+    if (entry.second.queue)
+      dropped[entry.first] = entry.second.queue->getDropped();
+  }
+
+  return dropped;
+}
+
 std::vector<MessagePublisher> MessageManager::getPublishers(void)
 {
+  std::lock_guard<std::mutex> lg(mlock_);
   std::vector<MessagePublisher> publishers;
 
   for (const auto& pub : publishers_)
   {
     const auto& pubset = pub.second;
     for (const auto& entry : pubset)
-      publishers.push_back(entry);
+      publishers.push_back(entry.second->publisher);
   }
 
   return publishers;
 }
 
+MessageSenderFn MessageManager::getSender(void)
+{
+  return [this](const std::string msg_id, const std::string plugin_name, std::shared_ptr<MessageInterface> msg) {
+    send(msg_id, plugin_name, std::move(msg));
+  };
+}
+
+MessageSenderFn MessageManager::getSender(const std::vector<TopicHandle>& handles)
+{
+  auto topics = std::make_shared<std::unordered_map<std::string, TopicHandle>>();
+  for (const auto& handle : handles)
+  {
+    if (handle.valid())
+      topics->emplace(handle.getMsgId(), handle);
+  }
+
+  return [this, topics](const std::string msg_id, const std::string plugin_name,
+                        std::shared_ptr<MessageInterface> msg) {
+    const auto topic = topics->find(msg_id);
+
+    // Revoked handles and other publishers go the long way, which refuses them if they aren't registered.
+    if (topic != topics->end() && topic->second.valid() && topic->second.getPublisherName() == plugin_name)
+      send(topic->second, std::move(msg));
+    else
+      send(msg_id, plugin_name, std::move(msg));
+  };
+}
+
 void MessageManager::notify(void)
 {
-  // In the future if we are extending it so some messages can be threaded off,
-  // then we can add them as async tasks rather than directly calling the callback.
-  // std::vector<std::future<void>> tasks;
+  notify_thread_ = std::this_thread::get_id();
+
+  {
+    std::lock_guard<std::mutex> lg(ready_lock_);
+    processing_.swap(ready_);
+  }
 
-  for (auto& entry : queue_)
+  // setExecutor() and the first pooled subscriber swap the executor under mlock_, which we don't take.
+  const auto executor = std::atomic_load(&executor_);
+
+  for (auto* topic : processing_)
   {
-    const auto& msg_id = entry.first;
-    auto& q = entry.second;
+    // Clear the flag before draining so a message pushed after popAll puts the topic back on the ready list.
+    topic->ready.exchange(false);
 
-    auto&& messages = q.popAll();
+    auto&& messages = topic->queue->popAll();
     num_msgs_ -= messages.size();
 
-    if (subscribers_.find(msg_id) == subscribers_.end())
+    if (messages.empty())
       continue;
 
-    auto& subscribers = subscribers_[msg_id];
+    topic->metrics.delivered->add(messages.size());
+    topic->metrics.depth_max->raise(static_cast<std::int64_t>(messages.size()));
+
+    auto* tracer = tracing_.load();
+    if (tracer != nullptr)
+      tracer->traceDispatch(topic->msg_id, messages);
+
+    // The read is what tells unsubscribe() a delivery is still in progress.
+    const auto subscribers = topic->subscribers.read();
+
+    // Typed subscribers cast without checking, so drop what untyped publishers sent before the topic was typed.
+    if (topic->late_typed.load())
+    {
+      dropMistyped(*topic, messages);
+      if (messages.empty())
+        continue;
+    }
+
+    // Hand off the pooled subscribers first so they run while we call the direct ones.
+    for (auto& sub : *subscribers)
+    {
+      if (sub.strand != nullptr)
+        sub.strand->post(*executor, messages);
+    }
+
+    // Batch subscribers get the whole drain in one call.
+    for (auto& sub : *subscribers)
+    {
+      if (sub.batch_cb != nullptr && sub.strand == nullptr)
+        deliverBatch(sub, MessageBatch(messages.data(), messages.size()));
+    }
 
     for (auto& msg : messages)
     {
-      for (auto& sub : subscribers)
+      for (auto& sub : *subscribers)
       {
-        if (sub.cb != nullptr)
-        {
-          sub.cb(msg);
-          // tasks.push_back(std::async(std::launch::async, sub.cb, msg));
-        }
+        if (sub.cb != nullptr && sub.strand == nullptr)
+          deliver(sub, msg);
       }
     }
+  }
+
+  processing_.clear();
+  notify_thread_ = std::thread::id();
+
+  // Taking the lock means a waiter is either still to check its condition or already waiting for this.
+  if (delivery_waiters_.load() != 0)
+  {
+    {
+      std::lock_guard<std::mutex> lg(delivery_lock_);
+    }
 
-    // for (auto& task : tasks)
-    //   task.get();
+    delivered_cond_.notify_all();
   }
 }
 
-void MessageManager::publish(const std::string msg_id, const MessagePublisher pub)
+TopicHandle MessageManager::publish(const std::string msg_id, const MessagePublisher pub)
+{
+  return registerPublisher(msg_id, pub, nullptr);
+}
+
+void MessageManager::subscribe(const std::string msg_id, const std::string plugin_name, MessageReceivedCb cb,
+                               const DispatchMode mode)
+{
+  registerSubscriber(MessageSubscriber(msg_id, plugin_name, std::move(cb), mode), nullptr);
+}
+
+void MessageManager::subscribeBatch(const std::string msg_id, const std::string plugin_name, MessageBatchCb cb,
+                                    const DispatchMode mode)
+{
+  MessageSubscriber sub(msg_id, plugin_name, nullptr, mode);
+  sub.batch_cb = std::move(cb);
+
+  registerSubscriber(std::move(sub), nullptr);
+}
+
+bool MessageManager::unsubscribe(const std::string msg_id, const std::string plugin_name)
+{
+  if (notify_thread_.load() == std::this_thread::get_id())
+  {
+    const std::string error = "MessageManager: " + plugin_name + " can't unsubscribe from " + msg_id +
+                              " while the same thread is delivering messages";
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  MessageTopic* topic = nullptr;
+  MessageSubscriber revoked;
+
+  {
+    std::lock_guard<std::mutex> lg(mlock_);
+
+    auto subs = subscribers_.find(msg_id);
+    if (subs == subscribers_.end())
+      return false;
+
+    const auto sub = subs->second.find(MessageSubscriber(msg_id, plugin_name));
+    if (sub == subs->second.end())
+      return false;
+
+    revoked = *sub;
+    subs->second.erase(sub);
+
+    topic = &topics_.at(msg_id);
+    topic->subscribers.update([&revoked](SubscriberList& subscribers) {
+      const auto entry = std::find(subscribers.begin(), subscribers.end(), revoked);
+      if (entry != subscribers.end())
+        subscribers.erase(entry);
+    });
+  }
+
+  // Deliveries that started with the old list finish with it; new ones won't see the subscriber.
+  topic->subscribers.synchronize();
+
+  // The pool's last task may hold the strand after it goes idle, so take the callback off it here.
+  if (revoked.strand != nullptr)
+    revoked.strand->close();
+
+  return true;
+}
+
+bool MessageManager::unpublish(const std::string msg_id, const std::string plugin_name)
 {
   std::lock_guard<std::mutex> lg(mlock_);
 
-  publishers_[msg_id].insert(pub);
+  auto pubs = publishers_.find(msg_id);
+  if (pubs == publishers_.end())
+    return false;
+
+  const auto pub = pubs->second.find(plugin_name);
+  if (pub == pubs->second.end())
+    return false;
+
+  // Handles still share the entry, and see the flag on their next send.
+  pub->second->revoked = true;
+  pubs->second.erase(pub);
+
+  return true;
+}
+
+void MessageManager::setSubscriptionCallback(SubscriptionCb cb)
+{
+  std::lock_guard<std::mutex> lg(mlock_);
+  subscription_cb_ = std::move(cb);
+}
+
+void MessageManager::setExecutor(std::shared_ptr<DispatchExecutor> executor)
+{
+  if (executor == nullptr)
+    throw std::runtime_error("MessageManager: dispatch executor can't be null");
+
+  std::lock_guard<std::mutex> lg(mlock_);
+
+  if (executor_)
+    executor_->drain();
+
+  // notify() reads the executor without mlock_.
+  std::atomic_store(&executor_, std::move(executor));
 }
 
-void MessageManager::subscribe(const std::string msg_id, const std::string plugin_name, MessageReceivedCb cb)
+void MessageManager::setTracer(std::shared_ptr<MessageTracer> tracer)
 {
   std::lock_guard<std::mutex> lg(mlock_);
 
-  MessageSubscriber sub;
-  sub.name = plugin_name;
-  sub.cb = cb;
+  // Finish the pooled callbacks first, so they are traced by the tracer that saw their messages sent.
+  if (executor_)
+    executor_->drain();
 
-  subscribers_[msg_id].insert(sub);
+  tracing_.store(tracer.get());
+  tracer_ = std::move(tracer);
+}
+
+std::shared_ptr<MetricsRegistry> MessageManager::getMetrics(void) const
+{
+  return metrics_;
+}
+
+MessageTracer* MessageManager::getTracer(void) const
+{
+  return tracing_.load();
 }
 
 void MessageManager::send(const std::string msg_id, const std::string plugin_name,
                           std::shared_ptr<MessageInterface> msg)
 {
-  const std::string error = "Unauthorised publication request to " + msg_id + " from plugin " + plugin_name;
+  TopicHandle topic;
+
+  {
+    std::lock_guard<std::mutex> lg(mlock_);
+    topic = getTopicHandle(msg_id, plugin_name);
+  }
+
+  if (!topic.valid())
+  {
+    const std::string error = "Unauthorised publication request to " + msg_id + " from plugin " + plugin_name;
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  send(topic, std::move(msg));
+}
+
+void MessageManager::send(const TopicHandle& topic, std::shared_ptr<MessageInterface> msg)
+{
+  if (!topic.valid())
+    throw std::runtime_error("Publication request with an invalid topic handle");
+
+  // Untyped senders are the only way a wrong type can reach typed subscribers, so check them here.
+  const auto* type = topic.topic_->type.load();
+  if (type != nullptr && msg != nullptr && typeid(*msg.get()) != *type)
+  {
+    const std::string error = "Message of type " + std::string(typeid(*msg.get()).name()) + " sent to " +
+                              topic.getMsgId() + ", which carries " + type->name();
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  enqueue(topic, std::move(msg));
+}
+
+std::shared_ptr<MessageInterface> MessageManager::getLatest(const std::string& msg_id)
+{
+  MessageQueue* queue = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lg(mlock_);
+
+    const auto topic = topics_.find(msg_id);
+    if (topic != topics_.end())
+      queue = topic->second.queue.get();
+  }
+
+  // Queues live as long as their topic, which outlives everything but clear().
+  return queue == nullptr ? nullptr : queue->peek();
+}
+
+void MessageManager::forgetLatest(const std::string& msg_id)
+{
+  std::lock_guard<std::mutex> lg(mlock_);
+
+  // Topics that only have subscribers have no queue.
+  const auto topic = topics_.find(msg_id);
+  if (topic != topics_.end() && topic->second.queue)
+    topic->second.queue->forgetLatest();
+}
 
+bool MessageManager::waitForDelivery(const std::vector<std::string>& msg_ids, const std::chrono::milliseconds timeout)
+{
+  if (notify_thread_.load() == std::this_thread::get_id())
   {
-    std::lock_guard<std::mutex> lg(qlock_);
+    const std::string error = "MessageManager: can't wait for delivery while the same thread is delivering messages";
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  std::vector<MessageQueue*> queues;
+  std::shared_ptr<DispatchExecutor> executor;
 
-    if (publishers_.find(msg_id) == publishers_.end())
+  {
+    std::lock_guard<std::mutex> lg(mlock_);
+
+    for (const auto& msg_id : msg_ids)
     {
-      std::cerr << error << std::endl;
-      throw std::runtime_error(error);
+      const auto topic = topics_.find(msg_id);
+      if (topic != topics_.end() && topic->second.queue)
+        queues.push_back(topic->second.queue.get());
     }
 
-    auto& publishers = publishers_[msg_id];
-    if (publishers.count(plugin_name) == 0)
+    executor = executor_;
+  }
+
+  // notify() marks itself busy before it empties a queue, so an empty queue and an idle notify() mean the messages
+  // have reached the direct subscribers.
+  const auto delivered = [this, &queues]() {
+    for (auto* queue : queues)
     {
-      std::cerr << error << std::endl;
-      throw std::runtime_error(error);
+      if (!queue->empty())
+        return false;
     }
 
-    queue_[msg_id].push(msg);
+    return notify_thread_.load() == std::thread::id();
+  };
 
-    ++num_msgs_;
+  bool done = false;
+
+  {
+    std::unique_lock<std::mutex> lock(delivery_lock_);
+    ++delivery_waiters_;
+    done = delivered_cond_.wait_for(lock, timeout, delivered);
+    --delivery_waiters_;
   }
 
-  q_cond_var_.notify_one();
+  // Pooled subscribers may still be working through their share.
+  if (done && executor)
+    executor->drain();
+
+  return done;
 }
 
 bool MessageManager::waitForWork(void)
 {
-  if (!work_)
-    return work_;
-
-  auto ready = [&]() { return num_msgs_ != 0; };
-  std::unique_lock<std::mutex> lock(qlock_);
-
-  // Sleep and wait until there are things to process. If we want to restrict
-  // the processing rate, add timing controls later. You can interrupt this
+  // Sleep until there are things to process. If we want to restrict the
+  // processing rate, add timing controls later. You can interrupt this
   // process by setting work_ to false.
-  while (work_ && num_msgs_ == 0)
-  {
-    if (q_cond_var_.wait_for(lock, wait_time_, ready))
-      break;
-  }
+  notifier_.wait([this]() { return !work_ || num_msgs_ != 0; });
 
   return work_;
 }
@@ -162,10 +470,267 @@ bool MessageManager::waitForWork(void)
 void MessageManager::setWork(const bool flag)
 {
   work_ = flag;
+  notifier_.notify();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PRIVATE METHODS                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
+TopicHandle MessageManager::registerPublisher(const std::string& msg_id, const MessagePublisher& pub,
+                                              const std::type_info* type)
+{
+  std::lock_guard<std::mutex> lg(mlock_);
+
+  // Check before registering anything, so a mismatch leaves no trace.
+  auto& topic = getTopic(msg_id);
+  checkType(topic, type);
+
+  // Publishing again under the same name keeps the original entry, so earlier handles stay valid.
+  auto& pubs = publishers_[msg_id];
+  if (pubs.find(pub.name) == pubs.end())
+  {
+    auto entry = pub;
+    entry.msg_id = msg_id;
+    pubs.emplace(pub.name, std::make_shared<PublisherEntry>(entry));
+  }
+
+  // Create the queue up front so senders never have to insert into topics_.
+  if (!topic.queue)
+    topic.queue = std::make_unique<MessageQueue>(pub.queue);
+
+  return getTopicHandle(msg_id, pub.name);
+}
+
+void MessageManager::deliver(const MessageSubscriber& sub, const std::shared_ptr<MessageInterface>& msg)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    sub.cb(msg);
+  }
+  catch (...)
+  {
+    sub.metrics.callback_errors->add();
+    throw;
+  }
+
+  sub.metrics.callback_time->observe(std::chrono::steady_clock::now() - start);
+
+  auto* tracer = tracing_.load();
+  if (tracer != nullptr)
+    tracer->traceCallback(sub.msg_id, sub.name, msg.get(), start);
+}
+
+void MessageManager::deliverBatch(const MessageSubscriber& sub, const MessageBatch& batch)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    sub.batch_cb(batch);
+  }
+  catch (...)
+  {
+    sub.metrics.callback_errors->add();
+    throw;
+  }
+
+  sub.metrics.callback_time->observe(std::chrono::steady_clock::now() - start);
+
+  auto* tracer = tracing_.load();
+  if (tracer != nullptr)
+  {
+    const auto* newest = batch.empty() ? nullptr : batch[batch.size() - 1].get();
+    tracer->traceCallback(sub.msg_id, sub.name, newest, start, batch.size());
+  }
+}
+
+void MessageManager::collectMetrics(void)
+{
+  std::lock_guard<std::mutex> lg(mlock_);
+
+  pending_metric_.set(num_msgs_.load());
+
+  for (auto& entry : topics_)
+  {
+    auto& topic = entry.second;
+    if (!topic.queue)
+      continue;
+
+    topic.metrics.depth->set(static_cast<std::int64_t>(topic.queue->size()));
+
+    // The queue keeps its own drop count. Catch the counter up with it.
+    const auto dropped = topic.queue->getDropped();
+    const auto counted = topic.metrics.dropped->get();
+    if (dropped > counted)
+      topic.metrics.dropped->add(dropped - counted);
+  }
+}
+
+void MessageManager::registerSubscriber(MessageSubscriber sub, const std::type_info* type)
+{
+  SubscriptionCb subscribed;
+
+  {
+    std::lock_guard<std::mutex> lg(mlock_);
+
+    if (!addSubscriber(sub, type))
+      return;
+
+    subscribed = subscription_cb_;
+  }
+
+  // Outside the lock, since the callback is likely to publish and subscribe.
+  if (subscribed != nullptr)
+    subscribed(sub.msg_id, sub.name);
+}
+
+bool MessageManager::addSubscriber(MessageSubscriber& sub, const std::type_info* type)
+{
+  auto& topic = getTopic(sub.msg_id);
+  checkType(topic, type);
+
+  const MetricLabels labels = { { "topic", sub.msg_id }, { "subscriber", sub.name } };
+  sub.metrics.callback_time = &metrics_->getHistogram("soul_callback_seconds", "Time spent in subscriber callbacks.",
+                                                      labels);
+  sub.metrics.callback_errors =
+      &metrics_->getCounter("soul_callback_errors_total", "Exceptions thrown by subscriber callbacks.", labels);
+
+  if (sub.dispatch == DispatchMode::pooled && (sub.cb != nullptr || sub.batch_cb != nullptr))
+  {
+    if (!executor_)
+      std::atomic_store(&executor_, std::shared_ptr<DispatchExecutor>(std::make_shared<WorkStealingPool>()));
+
+    // The strand goes through deliver() as well, so pooled callbacks are measured on the thread they run on.
+    const auto target = sub;
+
+    if (sub.batch_cb != nullptr)
+    {
+      sub.strand =
+          std::make_shared<DispatchStrand>([this, target](const MessageBatch& batch) { deliverBatch(target, batch); });
+    }
+    else
+    {
+      sub.strand = std::make_shared<DispatchStrand>(
+          [this, target](std::shared_ptr<MessageInterface> msg) { deliver(target, msg); });
+    }
+  }
+
+  // The set keeps one entry per subscriber name. Only new subscribers go on the topic's delivery list.
+  if (!subscribers_[sub.msg_id].insert(sub).second)
+    return false;
+
+  topic.subscribers.update([&sub](SubscriberList& subscribers) { subscribers.push_back(sub); });
+
+  return true;
+}
+
+void MessageManager::checkType(MessageTopic& topic, const std::type_info* type)
+{
+  if (type == nullptr)
+    return;
+
+  const auto* registered = topic.type.load();
+
+  if (registered == nullptr)
+  {
+    // Untyped publishers may have queued, or be sending, messages of another type. Flag it first, so notify() sees
+    // it by the time it sees the typed subscriber.
+    if (topic.queue)
+      topic.late_typed = true;
+
+    topic.type = type;
+    return;
+  }
+
+  if (*registered != *type)
+  {
+    const std::string error = "Message type mismatch on " + topic.msg_id + ": registered as " + registered->name() +
+                              ", requested as " + type->name();
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+}
+
+void MessageManager::dropMistyped(const MessageTopic& topic, std::vector<std::shared_ptr<MessageInterface>>& messages)
+{
+  const auto* type = topic.type.load();
+  const auto mistyped = [type](const std::shared_ptr<MessageInterface>& msg) {
+    return msg != nullptr && typeid(*msg.get()) != *type;
+  };
+
+  const auto kept = std::remove_if(messages.begin(), messages.end(), mistyped);
+  if (kept == messages.end())
+    return;
+
+  std::cerr << "ERROR: MessageManager: dropped " << std::distance(kept, messages.end()) << " messages sent to "
+            << topic.msg_id << " before it was typed as " << type->name() << std::endl;
+  messages.erase(kept, messages.end());
+}
+
+void MessageManager::enqueue(const TopicHandle& handle, std::shared_ptr<MessageInterface> msg)
+{
+  auto* tracer = tracing_.load();
+  if (tracer != nullptr && msg != nullptr)
+    tracer->traceEnqueue(handle.getMsgId(), handle.getPublisherName(), *msg);
+
+  auto* topic = handle.topic_;
+  topic->metrics.sent->add();
+
+  // The queues synchronise themselves, so producers don't serialise on a manager lock. Only notify() makes room, so
+  // sends from inside it, e.g., a direct subscriber republishing, must not wait for a full queue.
+  const bool wait = notify_thread_.load(std::memory_order_relaxed) != std::this_thread::get_id();
+  const int change = topic->queue->push(std::move(msg), wait);
+
+  // Only the sender that flips the flag adds the topic, so it is on the ready list at most once.
+  if (!topic->ready.exchange(true))
+  {
+    std::lock_guard<std::mutex> lg(ready_lock_);
+    ready_.push_back(topic);
+  }
+
+  // The count update is the sequentially consistent store the notifier relies on. Dropped or replaced messages
+  // leave nothing new for the subscribers to wake up for.
+  num_msgs_ += change;
+
+  if (change > 0)
+    notifier_.notify();
+}
+
+TopicHandle MessageManager::getTopicHandle(const std::string& msg_id, const std::string& plugin_name)
+{
+  const auto pubs = publishers_.find(msg_id);
+  if (pubs == publishers_.end())
+    return TopicHandle();
+
+  const auto pub = pubs->second.find(plugin_name);
+  if (pub == pubs->second.end())
+    return TopicHandle();
+
+  return TopicHandle(&topics_.at(msg_id), pub->second);
+}
+
+MessageTopic& MessageManager::getTopic(const std::string& msg_id)
+{
+  auto& topic = topics_[msg_id];
+  if (!topic.msg_id.empty())
+    return topic;
+
+  topic.msg_id = msg_id;
+
+  const MetricLabels labels = { { "topic", msg_id } };
+  topic.metrics.sent = &metrics_->getCounter("soul_messages_sent_total", "Messages sent.", labels);
+  topic.metrics.delivered =
+      &metrics_->getCounter("soul_messages_delivered_total", "Messages taken off the queue for delivery.", labels);
+  topic.metrics.dropped =
+      &metrics_->getCounter("soul_messages_dropped_total", "Messages the queue dropped or replaced.", labels);
+  topic.metrics.depth = &metrics_->getGauge("soul_queue_depth", "Messages queued.", labels);
+  topic.metrics.depth_max =
+      &metrics_->getGauge("soul_queue_depth_max", "Most messages found queued at once by the event loop.", labels);
+
+  return topic;
+}
+
 }  // namespace soul
\ No newline at end of file
@@ -0,0 +1,393 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Metrics.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/metrics.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/** Histogram buckets written to Prometheus files: every other power of two from about 1 us to about 69 s. */
+constexpr std::size_t prometheus_first_bucket_ = 10;
+constexpr std::size_t prometheus_last_bucket_ = 36;
+constexpr std::size_t prometheus_bucket_step_ = 2;
+
+/**
+ * @brief Get the Prometheus type name of a metric kind.
+ * @param kind Metric kind.
+ * @return Type name.
+ */
+const char* getTypeName(const MetricKind kind)
+{
+  switch (kind)
+  {
+    case MetricKind::counter:
+      return "counter";
+    case MetricKind::gauge:
+      return "gauge";
+    case MetricKind::histogram:
+      return "histogram";
+  }
+
+  return "untyped";
+}
+
+/**
+ * @brief Write a Prometheus label set.
+ * @param out Where to write.
+ * @param labels Labels.
+ * @param le Histogram bucket bound, or null for none.
+ */
+void writeLabels(std::ostream& out, const MetricLabels& labels, const char* le = nullptr)
+{
+  if (labels.empty() && le == nullptr)
+    return;
+
+  out << '{';
+
+  const char* separator = "";
+  for (const auto& label : labels)
+  {
+    out << separator << label.first << "=\"";
+
+    for (const char c : label.second)
+    {
+      if (c == '\\' || c == '"')
+        out << '\\' << c;
+      else if (c == '\n')
+        out << "\\n";
+      else
+        out << c;
+    }
+
+    out << '"';
+    separator = ",";
+  }
+
+  if (le != nullptr)
+    out << separator << "le=\"" << le << '"';
+
+  out << '}';
+}
+
+/**
+ * @brief Get the upper bound of a histogram bucket.
+ * @param bucket Bucket index.
+ * @return Upper bound in nanoseconds.
+ */
+std::uint64_t getBucketBound(const std::size_t bucket)
+{
+  return bucket >= 64 ? std::numeric_limits<std::uint64_t>::max() : std::uint64_t(1) << bucket;
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+std::chrono::nanoseconds MetricHistogram::Snapshot::getQuantile(const double q) const
+{
+  if (count == 0)
+    return std::chrono::nanoseconds(0);
+
+  const auto rank = static_cast<std::uint64_t>(std::max(1.0, q * count + 0.5));
+  std::uint64_t seen = 0;
+
+  for (std::size_t i = 0; i < metric_buckets_; ++i)
+  {
+    seen += buckets[i];
+
+    if (seen >= rank)
+      return std::chrono::nanoseconds(std::min(getBucketBound(i), static_cast<std::uint64_t>(max.count())));
+  }
+
+  return max;
+}
+
+MetricHistogram::Snapshot MetricHistogram::getSnapshot(void) const
+{
+  Snapshot snapshot;
+
+  for (std::size_t i = 0; i < metric_buckets_; ++i)
+    snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+
+  snapshot.count = count_.load(std::memory_order_relaxed);
+  snapshot.sum = std::chrono::nanoseconds(sum_.load(std::memory_order_relaxed));
+  snapshot.max = std::chrono::nanoseconds(max_.load(std::memory_order_relaxed));
+
+  return snapshot;
+}
+
+MetricsRegistry::MetricsRegistry() : next_collector_(0)
+{
+}
+
+MetricCounter& MetricsRegistry::getCounter(const std::string& name, const std::string& help,
+                                           const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  auto& counter = getFamily(name, help, MetricKind::counter).counters[labels];
+  if (!counter)
+    counter = std::make_unique<MetricCounter>();
+
+  return *counter;
+}
+
+MetricGauge& MetricsRegistry::getGauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  auto& gauge = getFamily(name, help, MetricKind::gauge).gauges[labels];
+  if (!gauge)
+    gauge = std::make_unique<MetricGauge>();
+
+  return *gauge;
+}
+
+MetricHistogram& MetricsRegistry::getHistogram(const std::string& name, const std::string& help,
+                                               const MetricLabels& labels)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  auto& histogram = getFamily(name, help, MetricKind::histogram).histograms[labels];
+  if (!histogram)
+    histogram = std::make_unique<MetricHistogram>();
+
+  return *histogram;
+}
+
+std::size_t MetricsRegistry::addCollector(std::function<void()> collector)
+{
+  std::lock_guard<std::mutex> lg(collect_lock_);
+
+  const auto id = next_collector_++;
+  collectors_[id] = std::move(collector);
+
+  return id;
+}
+
+void MetricsRegistry::removeCollector(const std::size_t id)
+{
+  std::lock_guard<std::mutex> lg(collect_lock_);
+  collectors_.erase(id);
+}
+
+std::vector<MetricSample> MetricsRegistry::collect(void)
+{
+  {
+    std::lock_guard<std::mutex> lg(collect_lock_);
+
+    // Collectors register their metrics through the getters, so they run outside lock_.
+    for (auto& collector : collectors_)
+      collector.second();
+  }
+
+  std::lock_guard<std::mutex> lg(lock_);
+  std::vector<MetricSample> samples;
+
+  for (const auto& family : families_)
+  {
+    MetricSample sample;
+    sample.name = family.first;
+    sample.help = family.second.help;
+    sample.kind = family.second.kind;
+
+    for (const auto& counter : family.second.counters)
+    {
+      sample.labels = counter.first;
+      sample.value = static_cast<double>(counter.second->get());
+      samples.push_back(sample);
+    }
+
+    for (const auto& gauge : family.second.gauges)
+    {
+      sample.labels = gauge.first;
+      sample.value = static_cast<double>(gauge.second->get());
+      samples.push_back(sample);
+    }
+
+    for (const auto& histogram : family.second.histograms)
+    {
+      sample.labels = histogram.first;
+      sample.histogram = histogram.second->getSnapshot();
+      samples.push_back(sample);
+    }
+  }
+
+  return samples;
+}
+
+void MetricsRegistry::writePrometheus(std::ostream& out)
+{
+  const auto samples = collect();
+
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+  out << std::setprecision(9);
+
+  const std::string* family = nullptr;
+
+  for (const auto& sample : samples)
+  {
+    if (family == nullptr || *family != sample.name)
+    {
+      out << "# HELP " << sample.name << ' ' << sample.help << '\n'
+          << "# TYPE " << sample.name << ' ' << getTypeName(sample.kind) << '\n';
+      family = &sample.name;
+    }
+
+    if (sample.kind != MetricKind::histogram)
+    {
+      out << sample.name;
+      writeLabels(out, sample.labels);
+      out << ' ' << sample.value << '\n';
+      continue;
+    }
+
+    // Prometheus buckets are cumulative.
+    const auto& histogram = sample.histogram;
+    std::uint64_t cumulative = 0;
+    std::size_t next = 0;
+
+    for (auto bucket = prometheus_first_bucket_; bucket <= prometheus_last_bucket_; bucket += prometheus_bucket_step_)
+    {
+      while (next <= bucket)
+        cumulative += histogram.buckets[next++];
+
+      std::ostringstream le;
+      le << std::setprecision(9) << getBucketBound(bucket) / 1e9;
+
+      out << sample.name << "_bucket";
+      writeLabels(out, sample.labels, le.str().c_str());
+      out << ' ' << cumulative << '\n';
+    }
+
+    out << sample.name << "_bucket";
+    writeLabels(out, sample.labels, "+Inf");
+    out << ' ' << histogram.count << '\n';
+
+    out << sample.name << "_sum";
+    writeLabels(out, sample.labels);
+    out << ' ' << histogram.sum.count() / 1e9 << '\n';
+
+    out << sample.name << "_count";
+    writeLabels(out, sample.labels);
+    out << ' ' << histogram.count << '\n';
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool MetricsRegistry::writePrometheus(const std::string& path)
+{
+  // Write a temporary file and rename it over the old one, so a scraper never reads a half written file.
+  const auto tmp_path = path + ".tmp";
+  std::ofstream out(tmp_path, std::ios::trunc);
+
+  writePrometheus(out);
+  out.close();
+
+  if (!out || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    std::cerr << "WARNING: MetricsRegistry: can't write " << path << "\n";
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+MetricsDumper::MetricsDumper(std::shared_ptr<MetricsRegistry> registry, const std::string& path,
+                             const std::chrono::milliseconds period)
+  : registry_(std::move(registry)), path_(path), period_(period), stop_(false)
+{
+  if (registry_ == nullptr)
+    throw std::runtime_error("MetricsDumper: registry can't be null");
+
+  thread_ = std::thread(&MetricsDumper::run, this);
+}
+
+MetricsDumper::~MetricsDumper()
+{
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    stop_ = true;
+  }
+
+  stop_cond_.notify_one();
+  thread_.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+MetricsRegistry::Family& MetricsRegistry::getFamily(const std::string& name, const std::string& help,
+                                                    const MetricKind kind)
+{
+  auto family = families_.find(name);
+
+  if (family == families_.end())
+  {
+    family = families_.emplace(name, Family()).first;
+    family->second.help = help;
+    family->second.kind = kind;
+  }
+  else if (family->second.kind != kind)
+  {
+    const auto error = "ERROR: MetricsRegistry: " + name + " is already a " + getTypeName(family->second.kind) + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  return family->second;
+}
+
+void MetricsDumper::run(void)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+
+  for (;;)
+  {
+    const bool stop = stop_cond_.wait_for(lock, period_, [this]() { return stop_; });
+
+    // Write without the lock, so the destructor isn't held up by a slow disk for longer than one write.
+    lock.unlock();
+    registry_->writePrometheus(path_);
+    lock.lock();
+
+    if (stop)
+      return;
+  }
+}
+
+}  // namespace soul
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Event notifier.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/notifier.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+Notifier::Notifier() : fd_(eventfd(0, EFD_CLOEXEC)), waiters_(0)
+{
+  if (fd_ < 0)
+  {
+    const std::string error = std::string("Notifier: eventfd failed: ") + std::strerror(errno);
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+}
+
+Notifier::~Notifier()
+{
+  close(fd_);
+}
+
+void Notifier::notify(void)
+{
+  if (waiters_.load() == 0)
+    return;
+
+  // Only fails if the counter would overflow, in which case the waiters are already awake.
+  const std::uint64_t one = 1;
+  while (write(fd_, &one, sizeof(one)) < 0 && errno == EINTR)
+    ;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void Notifier::block(void)
+{
+  // Reading resets the counter, so a burst of notifies costs one wakeup.
+  std::uint64_t count = 0;
+  while (read(fd_, &count, sizeof(count)) < 0 && errno == EINTR)
+    ;
+}
+
+}  // namespace soul
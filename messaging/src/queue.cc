@@ -12,7 +12,12 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <soul/messaging/queue.h>
 
+#include <chrono>
 #include <condition_variable>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -24,58 +29,275 @@ namespace soul
 // PUBLIC METHODS                                                            //
 ///////////////////////////////////////////////////////////////////////////////
 
+MessageQueue::MessageQueue(const QueueOptions& options) : options_(options), dropped_(0)
+{
+  if (options_.backend == QueueBackend::ring)
+  {
+    if (options_.capacity == 0)
+    {
+      const std::string error = "MessageQueue: ring queues need a capacity";
+      std::cerr << error << std::endl;
+      throw std::runtime_error(error);
+    }
+
+    ring_ = std::make_unique<RingBuffer<std::shared_ptr<MessageInterface>>>(options_.capacity);
+  }
+}
+
 bool MessageQueue::empty(void)
 {
+  if (ring_)
+    return ring_->empty();
+
+  if (options_.backend == QueueBackend::latest)
+    return std::atomic_load(&pending_) == nullptr;
+
   std::lock_guard<std::mutex> lock_guard(lock_);
 
   return queue_.empty();
 }
 
-void MessageQueue::push(std::shared_ptr<MessageInterface> msg)
+int MessageQueue::push(std::shared_ptr<MessageInterface> msg, const bool wait)
 {
-  std::lock_guard<std::mutex> lock_guard(lock_);
-  queue_.push(msg);
+  if (ring_)
+    return pushRing(std::move(msg), wait);
+
+  if (options_.backend == QueueBackend::latest)
+    return pushLatest(std::move(msg));
+
+  // Declared before the lock so dropped messages are destroyed after it is released.
+  std::queue<std::shared_ptr<MessageInterface>> shed;
+  std::unique_lock<std::mutex> unique_lock(lock_);
+  int change = 1;
+
+  if (options_.overflow == OverflowPolicy::keep_latest)
+  {
+    change -= static_cast<int>(queue_.size());
+    dropped_ += queue_.size();
+    queue_.swap(shed);
+  }
+  else if (options_.capacity != 0 && queue_.size() >= options_.capacity)
+  {
+    switch (options_.overflow)
+    {
+      case OverflowPolicy::drop_oldest:
+        shed.push(std::move(queue_.front()));
+        queue_.pop();
+        ++dropped_;
+        change = 0;
+        break;
+
+      case OverflowPolicy::drop_newest:
+        ++dropped_;
+        return 0;
+
+      default:
+        if (!wait || !waitForSpace(unique_lock))
+        {
+          ++dropped_;
+          return 0;
+        }
+    }
+  }
+
+  queue_.push(std::move(msg));
   cond_.notify_one();
+
+  return change;
+}
+
+std::shared_ptr<MessageInterface> MessageQueue::peek(void) const
+{
+  return std::atomic_load(&latest_);
+}
+
+void MessageQueue::forgetLatest(void)
+{
+  std::atomic_store(&latest_, std::shared_ptr<MessageInterface>());
 }
 
 std::shared_ptr<MessageInterface> MessageQueue::pop(void)
 {
+  if (ring_)
+  {
+    std::shared_ptr<MessageInterface> msg;
+    ring_->tryPop(msg);
+
+    return msg;
+  }
+
+  if (options_.backend == QueueBackend::latest)
+    return popLatest();
+
   std::unique_lock<std::mutex> unique_lock(lock_);
   while (queue_.empty())
     cond_.wait(unique_lock);
 
   auto msg = queue_.front();
   queue_.pop();
+  space_cond_.notify_one();
 
   return msg;
 }
 
 std::vector<std::shared_ptr<MessageInterface>> MessageQueue::popAll(void)
 {
-  std::unique_lock<std::mutex> unique_lock(lock_);
   std::vector<std::shared_ptr<MessageInterface>> result;
 
+  if (ring_)
+  {
+    result.reserve(ring_->size());
+
+    std::shared_ptr<MessageInterface> msg;
+    while (ring_->tryPop(msg))
+      result.push_back(std::move(msg));
+
+    return result;
+  }
+
+  if (options_.backend == QueueBackend::latest)
+  {
+    auto msg = popLatest();
+    if (msg != nullptr)
+      result.push_back(std::move(msg));
+
+    return result;
+  }
+
+  std::unique_lock<std::mutex> unique_lock(lock_);
+
   if (queue_.empty())
     return result;
 
+  result.reserve(queue_.size());
+
   while (!queue_.empty())
   {
-    result.push_back(queue_.front());
+    result.push_back(std::move(queue_.front()));
     queue_.pop();
   }
 
+  space_cond_.notify_all();
+
   return result;
 }
 
 std::size_t MessageQueue::size(void)
 {
+  if (ring_)
+    return ring_->size();
+
+  if (options_.backend == QueueBackend::latest)
+    return std::atomic_load(&pending_) == nullptr ? 0 : 1;
+
   std::lock_guard<std::mutex> lock_guard(lock_);
 
   return queue_.size();
 }
 
+const QueueOptions& MessageQueue::getOptions(void) const
+{
+  return options_;
+}
+
+std::uint64_t MessageQueue::getDropped(void) const
+{
+  return dropped_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // PRIVATE METHODS                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
+int MessageQueue::pushRing(std::shared_ptr<MessageInterface> msg, const bool wait)
+{
+  int change = 1;
+  std::shared_ptr<MessageInterface> old;
+
+  if (options_.overflow == OverflowPolicy::keep_latest)
+  {
+    while (ring_->tryPop(old))
+    {
+      --change;
+      ++dropped_;
+    }
+  }
+
+  const bool forever = options_.block_timeout == wait_forever_;
+  const auto deadline = forever ? std::chrono::steady_clock::time_point::max() :
+                                  std::chrono::steady_clock::now() + options_.block_timeout;
+
+  // msg is only moved from once a slot is claimed.
+  while (!ring_->tryPush(std::move(msg)))
+  {
+    switch (options_.overflow)
+    {
+      case OverflowPolicy::drop_newest:
+        ++dropped_;
+        return change - 1;
+
+      case OverflowPolicy::drop_oldest:
+      case OverflowPolicy::keep_latest:
+        // Producers race the consumer for the oldest slot here. Only count what we actually took.
+        if (ring_->tryPop(old))
+        {
+          --change;
+          ++dropped_;
+        }
+        break;
+
+      default:
+        if (!wait || (!forever && std::chrono::steady_clock::now() >= deadline))
+        {
+          ++dropped_;
+          return change - 1;
+        }
+
+        // There is no lock to wait on, so poll for the consumer instead of spinning.
+        std::this_thread::sleep_for(ring_poll_time_);
+    }
+  }
+
+  return change;
+}
+
+int MessageQueue::pushLatest(std::shared_ptr<MessageInterface> msg)
+{
+  // An empty slot and a null message look the same, so there is nothing to deliver.
+  if (msg == nullptr)
+  {
+    ++dropped_;
+    return 0;
+  }
+
+  std::atomic_store(&latest_, msg);
+
+  // Whoever swaps a message out owns it. Replacing one that was never popped coalesces the two into one delivery.
+  const auto replaced = std::atomic_exchange(&pending_, std::move(msg));
+
+  if (replaced == nullptr)
+    return 1;
+
+  ++dropped_;
+  return 0;
+}
+
+std::shared_ptr<MessageInterface> MessageQueue::popLatest(void)
+{
+  return std::atomic_exchange(&pending_, std::shared_ptr<MessageInterface>());
+}
+
+bool MessageQueue::waitForSpace(std::unique_lock<std::mutex>& lock)
+{
+  auto has_space = [this]() { return queue_.size() < options_.capacity; };
+
+  if (options_.block_timeout == wait_forever_)
+  {
+    space_cond_.wait(lock, has_space);
+    return true;
+  }
+
+  return space_cond_.wait_for(lock, options_.block_timeout, has_space);
+}
+
 }  // namespace soul
\ No newline at end of file
@@ -0,0 +1,409 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message recorder.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/recorder.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+// The format structs are written as they are in memory.
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "recordings are little-endian");
+static_assert(sizeof(RecordingFileHeader) == 16, "unexpected RecordingFileHeader padding");
+static_assert(sizeof(RecordingChunkHeader) == 48, "unexpected RecordingChunkHeader padding");
+static_assert(sizeof(RecordingRecordHeader) == 32, "unexpected RecordingRecordHeader padding");
+static_assert(sizeof(RecordingIndexHeader) == 16, "unexpected RecordingIndexHeader padding");
+static_assert(sizeof(RecordingIndexEntry) == 32, "unexpected RecordingIndexEntry padding");
+static_assert(sizeof(RecordingTrailer) == 16, "unexpected RecordingTrailer padding");
+
+namespace
+{
+/**
+ * @brief Get the current time in the recording's time base.
+ * @return Nanoseconds since the epoch.
+ */
+std::int64_t getNowNs(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Start an empty chunk header.
+ * @return Header.
+ */
+RecordingChunkHeader makeChunkHeader(void)
+{
+  RecordingChunkHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = recording_chunk_magic_;
+  header.start_ns = std::numeric_limits<std::int64_t>::max();
+  header.end_ns = std::numeric_limits<std::int64_t>::min();
+
+  return header;
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+MessageRecorder::MessageRecorder(MessageManager& msgman, const std::string& path, const RecorderOptions& options)
+  : msgman_(msgman)
+  , path_(path)
+  , options_(options)
+  , closed_(false)
+  , queue_(options.queue_capacity)
+  , pushed_(0)
+  , stop_(false)
+  , recorded_(msgman.getMetrics()->getCounter("soul_recorder_messages_total", "Messages written by recorders.",
+                                              { { "recorder", options.name } }))
+  , dropped_(msgman.getMetrics()->getCounter("soul_recorder_dropped_total",
+                                             "Messages recorders dropped because their writer fell behind.",
+                                             { { "recorder", options.name } }))
+  , out_(path, std::ios::binary | std::ios::trunc)
+  , failed_(false)
+  , offset_(0)
+  , chunk_header_(makeChunkHeader())
+{
+  if (!out_)
+  {
+    const auto error = "ERROR: MessageRecorder: can't create " + path + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  RecordingFileHeader header;
+  std::memcpy(header.magic, recording_magic_, sizeof(header.magic));
+  header.version = recording_version_;
+  header.reserved = 0;
+  writeFile(&header, sizeof(header));
+
+  chunk_.reserve(options_.chunk_size);
+
+  thread_ = std::thread(&MessageRecorder::run, this);
+}
+
+MessageRecorder::~MessageRecorder()
+{
+  close();
+}
+
+void MessageRecorder::record(const std::string& msg_id, MessageCodec codec)
+{
+  if (codec.size == nullptr || codec.encode == nullptr)
+  {
+    const auto error = "ERROR: MessageRecorder: the codec for " + msg_id + " can't encode\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  Topic* topic = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (closed_)
+    {
+      const auto error = "ERROR: MessageRecorder: can't record " + msg_id + " after closing " + path_ + "\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+
+    const auto recorded = std::find_if(topics_.begin(), topics_.end(),
+                                       [&msg_id](const std::unique_ptr<Topic>& t) { return t->msg_id == msg_id; });
+    if (recorded != topics_.end())
+    {
+      const auto error = "ERROR: MessageRecorder: " + msg_id + " is already recorded\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+
+    topics_.push_back(std::make_unique<Topic>());
+    topic = topics_.back().get();
+    topic->msg_id = msg_id;
+    topic->number = static_cast<std::uint32_t>(topics_.size() - 1);
+    topic->codec = std::move(codec);
+    topic->written = false;
+  }
+
+  // Outside the lock: in lazy mode subscribing can load plugins.
+  msgman_.subscribe(msg_id, options_.name,
+                    [this, topic](std::shared_ptr<MessageInterface> msg) { enqueue(topic, std::move(msg)); });
+}
+
+void MessageRecorder::close(void)
+{
+  std::vector<std::string> msg_ids;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (closed_)
+      return;
+
+    closed_ = true;
+
+    for (const auto& topic : topics_)
+      msg_ids.push_back(topic->msg_id);
+  }
+
+  // Once unsubscribed no callback is pushing anymore, so the writer can drain the queue and finish.
+  for (const auto& msg_id : msg_ids)
+    msgman_.unsubscribe(msg_id, options_.name);
+
+  stop_ = true;
+  notifier_.notify();
+  thread_.join();
+
+  writeIndex();
+  out_.close();
+
+  if (!out_ && !failed_)
+    std::cerr << "ERROR: MessageRecorder: can't write " << path_ << "\n";
+}
+
+std::uint64_t MessageRecorder::getRecorded(void) const
+{
+  return recorded_.get();
+}
+
+std::uint64_t MessageRecorder::getDropped(void) const
+{
+  return dropped_.get();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void MessageRecorder::enqueue(Topic* topic, std::shared_ptr<MessageInterface> msg)
+{
+  Pending pending;
+  pending.topic = topic;
+  pending.msg = std::move(msg);
+  pending.received_ns = getNowNs();
+
+  if (!queue_.tryPush(std::move(pending)))
+  {
+    dropped_.add();
+    return;
+  }
+
+  // The increment is the sequentially consistent store the notifier relies on.
+  ++pushed_;
+  notifier_.notify();
+}
+
+void MessageRecorder::run(void)
+{
+  std::uint64_t popped = 0;
+  Pending pending;
+
+  for (;;)
+  {
+    notifier_.wait([this, &popped]() { return pushed_.load() > popped || stop_.load(); });
+
+    // Read the flag before draining: pushes that happened before it was set are in the queue by now.
+    const bool stop = stop_.load();
+
+    while (queue_.tryPop(pending))
+    {
+      ++popped;
+      append(pending);
+      pending = Pending();
+    }
+
+    if (stop)
+      break;
+  }
+
+  flushChunk();
+}
+
+void MessageRecorder::append(const Pending& pending)
+{
+  auto& topic = *pending.topic;
+  const auto& msg = *pending.msg;
+
+  std::size_t size = 0;
+  try
+  {
+    size = topic.codec.size(msg);
+  }
+  catch (const std::exception& e)
+  {
+    // E.g. a message type the codec doesn't know. Nothing has been added to the chunk yet.
+    std::cerr << "ERROR: MessageRecorder: can't encode a message on " << topic.msg_id << ": " << e.what() << "\n";
+    dropped_.add();
+    return;
+  }
+
+  if (!topic.written)
+  {
+    RecordingRecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.kind = static_cast<std::uint32_t>(RecordingRecordKind::topic);
+    header.topic = topic.number;
+    header.received_ns = pending.received_ns;
+    header.size = topic.msg_id.size();
+
+    std::memcpy(appendRecord(header), topic.msg_id.data(), topic.msg_id.size());
+    topic.written = true;
+  }
+
+  RecordingRecordHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.kind = static_cast<std::uint32_t>(RecordingRecordKind::message);
+  header.topic = topic.number;
+  header.timestamp_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(msg.timestamp.time_since_epoch()).count();
+  header.received_ns = pending.received_ns;
+  header.size = size;
+
+  topic.codec.encode(msg, appendRecord(header));
+  recorded_.add();
+
+  const auto time = getRecordTime(header);
+  chunk_header_.start_ns = std::min(chunk_header_.start_ns, time);
+  chunk_header_.end_ns = std::max(chunk_header_.end_ns, time);
+
+  if (chunk_.size() >= options_.chunk_size)
+    flushChunk();
+}
+
+std::uint8_t* MessageRecorder::appendRecord(const RecordingRecordHeader& header)
+{
+  const auto start = chunk_.size();
+
+  // Zeroed, so the padding doesn't leak old memory into the file.
+  chunk_.resize(start + sizeof(header) + recordingAlign(header.size), 0);
+  std::memcpy(chunk_.data() + start, &header, sizeof(header));
+  ++chunk_header_.records;
+
+  return chunk_.data() + start + sizeof(header);
+}
+
+void MessageRecorder::flushChunk(void)
+{
+  if (chunk_.empty())
+    return;
+
+  chunk_header_.raw_size = chunk_.size();
+  chunk_header_.stored_size = chunk_.size();
+  chunk_header_.compression = static_cast<std::uint32_t>(RecordingCompression::none);
+
+  const std::uint8_t* data = chunk_.data();
+  std::vector<std::uint8_t> compressed;
+
+  if (options_.compression == RecordingCompression::zlib)
+  {
+    uLongf size = compressBound(chunk_.size());
+    compressed.resize(size);
+
+    const int err = compress2(compressed.data(), &size, chunk_.data(), chunk_.size(), options_.compression_level);
+    if (err == Z_OK && size < chunk_.size())
+    {
+      chunk_header_.compression = static_cast<std::uint32_t>(RecordingCompression::zlib);
+      chunk_header_.stored_size = size;
+      data = compressed.data();
+    }
+  }
+
+  RecordingIndexEntry entry;
+  entry.offset = offset_;
+  entry.start_ns = chunk_header_.start_ns;
+  entry.end_ns = chunk_header_.end_ns;
+  entry.records = chunk_header_.records;
+  entry.reserved = 0;
+  index_.push_back(entry);
+
+  // Padded, so the next chunk's records are aligned in the file too.
+  const std::uint8_t padding[recording_alignment_] = {};
+
+  writeFile(&chunk_header_, sizeof(chunk_header_));
+  writeFile(data, chunk_header_.stored_size);
+  writeFile(padding, recordingAlign(chunk_header_.stored_size) - chunk_header_.stored_size);
+
+  chunk_.clear();
+  chunk_header_ = makeChunkHeader();
+}
+
+void MessageRecorder::writeIndex(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  RecordingIndexHeader header;
+  header.magic = recording_index_header_magic_;
+  header.topics = static_cast<std::uint32_t>(topics_.size());
+  header.chunks = index_.size();
+
+  const auto index_offset = offset_;
+  writeFile(&header, sizeof(header));
+
+  // Every recorded topic is listed, including ones that never got a message.
+  const std::uint8_t padding[recording_alignment_] = {};
+
+  for (const auto& topic : topics_)
+  {
+    RecordingRecordHeader record;
+    std::memset(&record, 0, sizeof(record));
+    record.kind = static_cast<std::uint32_t>(RecordingRecordKind::topic);
+    record.topic = topic->number;
+    record.size = topic->msg_id.size();
+
+    writeFile(&record, sizeof(record));
+    writeFile(topic->msg_id.data(), topic->msg_id.size());
+    writeFile(padding, recordingAlign(topic->msg_id.size()) - topic->msg_id.size());
+  }
+
+  writeFile(index_.data(), index_.size() * sizeof(RecordingIndexEntry));
+
+  RecordingTrailer trailer;
+  trailer.index_offset = index_offset;
+  std::memcpy(trailer.magic, recording_index_magic_, sizeof(trailer.magic));
+  writeFile(&trailer, sizeof(trailer));
+}
+
+void MessageRecorder::writeFile(const void* data, const std::size_t size)
+{
+  if (failed_ || size == 0)
+    return;
+
+  out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  offset_ += size;
+
+  if (!out_)
+  {
+    std::cerr << "ERROR: MessageRecorder: can't write " << path_ << ", stopped recording\n";
+    failed_ = true;
+  }
+}
+
+}  // namespace soul
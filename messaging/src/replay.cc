@@ -0,0 +1,607 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message replay.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/replay.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/**
+ * @brief Read a struct from a buffer that may not be aligned for it.
+ * @param src Start of the struct.
+ * @return Copy of the struct.
+ */
+template <typename T>
+T readStruct(const std::uint8_t* src)
+{
+  T value;
+  std::memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief Walk the records of a chunk.
+ * @param data Start of the records.
+ * @param size Size of the records.
+ * @param fn Called with each record's header and payload.
+ * @return False if a record runs past the end.
+ */
+template <typename F>
+bool forEachRecord(const std::uint8_t* data, const std::size_t size, F fn)
+{
+  std::size_t pos = 0;
+  while (pos < size)
+  {
+    if (size - pos < sizeof(RecordingRecordHeader))
+      return false;
+
+    const auto header = readStruct<RecordingRecordHeader>(data + pos);
+    pos += sizeof(header);
+
+    if (header.size > size - pos || recordingAlign(header.size) > size - pos)
+      return false;
+
+    fn(header, data + pos);
+    pos += recordingAlign(header.size);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Check a playback speed.
+ * @param speed Speed.
+ * @throws std::runtime_error if it is negative.
+ */
+void checkSpeed(const double speed)
+{
+  if (!(speed >= 0))
+  {
+    const auto error = "ERROR: MessageReplay: invalid speed " + std::to_string(speed) + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+RecordingReader::RecordingReader(const std::string& path) : path_(path), data_(nullptr), size_(0), indexed_(false)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    const auto error = "ERROR: RecordingReader: can't open " + path + ": " + std::strerror(errno) + "\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  struct stat st;
+  void* addr = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(RecordingFileHeader))
+  {
+    size_ = st.st_size;
+    addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  // The mapping keeps the file around.
+  ::close(fd);
+
+  if (addr == MAP_FAILED)
+    fail("can't map the file");
+
+  const auto size = size_;
+  mapping_ = std::shared_ptr<const void>(addr, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+  data_ = static_cast<const std::uint8_t*>(addr);
+
+  const auto header = readStruct<RecordingFileHeader>(data_);
+  if (std::memcmp(header.magic, recording_magic_, sizeof(header.magic)) != 0)
+    fail("not a recording");
+
+  if (header.version != recording_version_)
+    fail("unsupported version " + std::to_string(header.version));
+
+  indexed_ = readIndex();
+  if (!indexed_)
+    scan();
+}
+
+const std::vector<std::string>& RecordingReader::getTopics(void) const
+{
+  return topics_;
+}
+
+const std::vector<RecordingIndexEntry>& RecordingReader::getChunks(void) const
+{
+  return chunks_;
+}
+
+bool RecordingReader::hasIndex(void) const
+{
+  return indexed_;
+}
+
+std::size_t RecordingReader::findChunk(const std::int64_t time_ns) const
+{
+  // Capture times of different topics can interleave, so chunks can overlap and a binary search could skip one.
+  const auto it = std::find_if(chunks_.begin(), chunks_.end(),
+                               [time_ns](const RecordingIndexEntry& entry) { return entry.end_ns >= time_ns; });
+  return it - chunks_.begin();
+}
+
+std::vector<RecordedMessage> RecordingReader::readChunk(const std::size_t chunk) const
+{
+  const std::uint8_t* data = nullptr;
+  std::size_t size = 0;
+
+  auto lease = loadChunk(chunk, data, size);
+  if (lease == nullptr)
+    fail("chunk " + std::to_string(chunk) + " is damaged");
+
+  std::vector<RecordedMessage> records;
+  records.reserve(chunks_[chunk].records);
+
+  const bool ok = forEachRecord(data, size, [&records, &lease](const RecordingRecordHeader& header,
+                                                               const std::uint8_t* payload) {
+    if (header.kind == static_cast<std::uint32_t>(RecordingRecordKind::message))
+      records.push_back({ header, payload, lease });
+  });
+
+  if (!ok)
+    fail("chunk " + std::to_string(chunk) + " is damaged");
+
+  return records;
+}
+
+MessageReplay::MessageReplay(MessageManager& msgman, std::shared_ptr<const RecordingReader> reader,
+                             const ReplayOptions& options)
+  : msgman_(msgman)
+  , reader_(std::move(reader))
+  , name_(options.name)
+  , playing_(reader_->getTopics().size())
+  , speed_(options.speed)
+  , running_(false)
+  , done_(false)
+  , seeking_(true)
+  , seek_ns_(std::numeric_limits<std::int64_t>::min())
+  , version_(0)
+  , rebase_(true)
+  , record_origin_(0)
+  , next_chunk_(0)
+  , record_(0)
+  , played_(0)
+{
+  checkSpeed(speed_);
+}
+
+MessageReplay::~MessageReplay()
+{
+  stop();
+}
+
+void MessageReplay::play(const std::string& msg_id, MessageCodec codec)
+{
+  if (codec.decode == nullptr)
+  {
+    const auto error = "ERROR: MessageReplay: the codec for " + msg_id + " can't decode\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  const auto& topics = reader_->getTopics();
+  const auto number = std::find(topics.begin(), topics.end(), msg_id) - topics.begin();
+
+  if (msg_id.empty() || number == static_cast<std::ptrdiff_t>(topics.size()))
+  {
+    const auto error = "ERROR: MessageReplay: " + msg_id + " isn't in the recording\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  std::lock_guard<std::mutex> lg(lock_);
+
+  auto& playing = playing_[number];
+  if (playing.codec.decode != nullptr)
+  {
+    const auto error = "ERROR: MessageReplay: " + msg_id + " is already played\n";
+    std::cerr << error;
+    throw std::runtime_error(error);
+  }
+
+  // The thread only looks at entries once they have a decoder, and they don't change after that.
+  playing.topic = msgman_.publish(msg_id, name_);
+  playing.codec = std::move(codec);
+}
+
+void MessageReplay::start(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  if (running_)
+    return;
+
+  running_ = true;
+  rebase_ = true;
+  thread_ = std::thread(&MessageReplay::run, this);
+}
+
+void MessageReplay::stop(void)
+{
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (!running_)
+      return;
+
+    running_ = false;
+    ++version_;
+  }
+
+  cond_.notify_all();
+  thread_.join();
+}
+
+void MessageReplay::seek(const std::int64_t time_ns)
+{
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    seeking_ = true;
+    seek_ns_ = time_ns;
+    done_ = false;
+    ++version_;
+  }
+
+  cond_.notify_all();
+}
+
+void MessageReplay::setSpeed(const double speed)
+{
+  checkSpeed(speed);
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (speed_ > 0 && speed > 0 && !rebase_)
+    {
+      // Carry on from where playback is now, rather than from where the last message was.
+      const auto now = std::chrono::steady_clock::now();
+      const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - wall_origin_).count();
+      record_origin_ += static_cast<std::int64_t>(elapsed * speed_);
+      wall_origin_ = now;
+    }
+    else
+    {
+      rebase_ = true;
+    }
+
+    speed_ = speed;
+    ++version_;
+  }
+
+  cond_.notify_all();
+}
+
+bool MessageReplay::wait(void)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+  cond_.wait(lock, [this]() { return done_ || !running_; });
+
+  return done_;
+}
+
+std::uint64_t MessageReplay::getPlayed(void) const
+{
+  return played_.load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+bool RecordingReader::readIndex(void)
+{
+  if (size_ < sizeof(RecordingFileHeader) + sizeof(RecordingIndexHeader) + sizeof(RecordingTrailer))
+    return false;
+
+  const auto trailer = readStruct<RecordingTrailer>(data_ + size_ - sizeof(RecordingTrailer));
+  if (std::memcmp(trailer.magic, recording_index_magic_, sizeof(trailer.magic)) != 0)
+    return false;
+
+  const auto end = size_ - sizeof(RecordingTrailer);
+  if (trailer.index_offset < sizeof(RecordingFileHeader) || trailer.index_offset > end - sizeof(RecordingIndexHeader))
+    return false;
+
+  const auto header = readStruct<RecordingIndexHeader>(data_ + trailer.index_offset);
+  if (header.magic != recording_index_header_magic_)
+    return false;
+
+  std::vector<std::string> topics;
+  std::size_t pos = trailer.index_offset + sizeof(header);
+
+  for (std::uint32_t i = 0; i < header.topics; ++i)
+  {
+    if (end - pos < sizeof(RecordingRecordHeader))
+      return false;
+
+    const auto record = readStruct<RecordingRecordHeader>(data_ + pos);
+    pos += sizeof(record);
+
+    if (record.size > end - pos || record.topic >= header.topics)
+      return false;
+
+    if (record.topic >= topics.size())
+      topics.resize(record.topic + 1);
+
+    topics[record.topic].assign(reinterpret_cast<const char*>(data_ + pos), record.size);
+    pos += std::min<std::size_t>(recordingAlign(record.size), end - pos);
+  }
+
+  if (header.chunks > (end - pos) / sizeof(RecordingIndexEntry))
+    return false;
+
+  std::vector<RecordingIndexEntry> chunks(header.chunks);
+  std::memcpy(chunks.data(), data_ + pos, chunks.size() * sizeof(RecordingIndexEntry));
+
+  for (const auto& entry : chunks)
+  {
+    if (entry.offset < sizeof(RecordingFileHeader) || entry.offset > trailer.index_offset ||
+        trailer.index_offset - entry.offset < sizeof(RecordingChunkHeader))
+      return false;
+  }
+
+  topics_ = std::move(topics);
+  chunks_ = std::move(chunks);
+  return true;
+}
+
+void RecordingReader::scan(void)
+{
+  std::cerr << "WARNING: RecordingReader: " << path_ << " has no index, scanning it\n";
+
+  std::size_t pos = sizeof(RecordingFileHeader);
+
+  while (size_ - pos >= sizeof(RecordingChunkHeader))
+  {
+    const auto header = readStruct<RecordingChunkHeader>(data_ + pos);
+    const auto space = size_ - pos - sizeof(header);
+    if (header.magic != recording_chunk_magic_ || header.stored_size > space ||
+        recordingAlign(header.stored_size) > space)
+      break;
+
+    RecordingIndexEntry entry;
+    entry.offset = pos;
+    entry.start_ns = header.start_ns;
+    entry.end_ns = header.end_ns;
+    entry.records = header.records;
+    entry.reserved = 0;
+    chunks_.push_back(entry);
+
+    // Topic records only live in the chunks now.
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+
+    const bool ok = loadChunk(chunks_.size() - 1, data, size) != nullptr &&
+                    forEachRecord(data, size, [this](const RecordingRecordHeader& record, const std::uint8_t* payload) {
+                      if (record.kind != static_cast<std::uint32_t>(RecordingRecordKind::topic))
+                        return;
+
+                      if (record.topic >= topics_.size())
+                        topics_.resize(record.topic + 1);
+
+                      topics_[record.topic].assign(reinterpret_cast<const char*>(payload), record.size);
+                    });
+
+    if (!ok)
+    {
+      chunks_.pop_back();
+      break;
+    }
+
+    pos += sizeof(header) + recordingAlign(header.stored_size);
+  }
+}
+
+std::shared_ptr<const void> RecordingReader::loadChunk(const std::size_t chunk, const std::uint8_t*& data,
+                                                       std::size_t& size) const
+{
+  const auto offset = chunks_[chunk].offset;
+  const auto header = readStruct<RecordingChunkHeader>(data_ + offset);
+
+  if (header.magic != recording_chunk_magic_ || header.stored_size > size_ - offset - sizeof(header))
+    return nullptr;
+
+  const auto stored = data_ + offset + sizeof(header);
+
+  if (header.compression == static_cast<std::uint32_t>(RecordingCompression::none))
+  {
+    if (header.raw_size != header.stored_size)
+      return nullptr;
+
+    // Read in place: the records' lease is the mapping itself.
+    data = stored;
+    size = header.stored_size;
+    return mapping_;
+  }
+
+  if (header.compression != static_cast<std::uint32_t>(RecordingCompression::zlib))
+    return nullptr;
+
+  auto inflated = std::make_shared<std::vector<std::uint8_t>>(header.raw_size);
+
+  uLongf inflated_size = inflated->size();
+  if (uncompress(inflated->data(), &inflated_size, stored, header.stored_size) != Z_OK ||
+      inflated_size != header.raw_size)
+    return nullptr;
+
+  data = inflated->data();
+  size = inflated->size();
+  return inflated;
+}
+
+void RecordingReader::fail(const std::string& what) const
+{
+  const auto error = "ERROR: RecordingReader: " + path_ + ": " + what + "\n";
+  std::cerr << error;
+  throw std::runtime_error(error);
+}
+
+void MessageReplay::run(void)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+
+  while (running_)
+  {
+    if (seeking_)
+      locate();
+
+    if (record_ >= records_.size())
+    {
+      if (!loadChunk())
+      {
+        done_ = true;
+        cond_.notify_all();
+
+        // Stay at the end until told to go somewhere else.
+        const auto version = version_;
+        cond_.wait(lock, [this, version]() { return version_ != version; });
+      }
+
+      continue;
+    }
+
+    const auto& record = records_[record_];
+    const auto topic = record.header.topic;
+
+    if (topic >= playing_.size() || playing_[topic].codec.decode == nullptr)
+    {
+      ++record_;
+      continue;
+    }
+
+    if (speed_ > 0)
+    {
+      const auto time = getRecordTime(record.header);
+
+      if (rebase_)
+      {
+        wall_origin_ = std::chrono::steady_clock::now();
+        record_origin_ = time;
+        rebase_ = false;
+      }
+
+      const auto delay = std::chrono::nanoseconds(static_cast<std::int64_t>((time - record_origin_) / speed_));
+      const auto version = version_;
+
+      // Anything that changes the plan wakes the wait, and the record is looked at again.
+      if (cond_.wait_until(lock, wall_origin_ + delay, [this, version]() { return version_ != version; }))
+        continue;
+    }
+
+    const RecordedMessage message = records_[record_++];
+    const Playing& playing = playing_[topic];
+
+    lock.unlock();
+
+    std::shared_ptr<MessageInterface> msg;
+    try
+    {
+      msg = playing.codec.decode(message.payload, message.header.size, message.lease);
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "ERROR: MessageReplay: can't decode a message on " << playing.topic.getMsgId() << ": " << e.what()
+                << "\n";
+    }
+
+    if (msg != nullptr)
+    {
+      if (message.header.timestamp_ns != 0)
+      {
+        const auto since_epoch = std::chrono::nanoseconds(message.header.timestamp_ns);
+        msg->timestamp = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(since_epoch));
+      }
+
+      msgman_.send(playing.topic, std::move(msg));
+      played_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    lock.lock();
+  }
+}
+
+void MessageReplay::locate(void)
+{
+  seeking_ = false;
+  done_ = false;
+  rebase_ = true;
+
+  records_.clear();
+  record_ = 0;
+  next_chunk_ = reader_->findChunk(seek_ns_);
+
+  if (!loadChunk())
+    return;
+
+  // The chunk ends at or after the time, but may start before it.
+  while (record_ < records_.size() && getRecordTime(records_[record_].header) < seek_ns_)
+    ++record_;
+}
+
+bool MessageReplay::loadChunk(void)
+{
+  records_.clear();
+  record_ = 0;
+
+  while (next_chunk_ < reader_->getChunks().size())
+  {
+    try
+    {
+      records_ = reader_->readChunk(next_chunk_++);
+      return true;
+    }
+    catch (const std::runtime_error&)
+    {
+      // Already reported. Carry on with the next chunk.
+    }
+  }
+
+  return false;
+}
+
+}  // namespace soul
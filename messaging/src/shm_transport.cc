@@ -0,0 +1,724 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Shared memory transport.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/shm_transport.h>
+
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/** Marks a fully initialised control block. */
+constexpr std::uint32_t shm_magic_ = 0x534f554c;  // "SOUL"
+
+/** Control block layout version. */
+constexpr std::uint32_t shm_version_ = 1;
+
+/** Alignment of the control block sections. */
+constexpr std::size_t shm_align_ = 64;
+
+/** How long open() sleeps between attempts. */
+constexpr std::chrono::milliseconds open_poll_time_{ 10 };
+
+/** Most slots a consumer accepts in a channel. */
+constexpr std::uint64_t max_slots_ = 1 << 16;
+
+/** How long a blocked producer sleeps between checks for a free slot. */
+constexpr std::chrono::microseconds slot_poll_time_{ 50 };
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared memory rings need address-free atomics");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "shared memory header needs address-free atomics");
+
+/** Ring cell. The sequence number says whose turn it is, as in RingBuffer. */
+struct RingCell
+{
+  std::atomic<std::uint64_t> seq;  ///< Lap sequence number.
+  std::uint64_t value;             ///< Slot index.
+};
+
+/**
+ * @brief Round up to a multiple of shm_align_.
+ * @param n Value to round.
+ * @return Rounded value.
+ */
+std::size_t alignUp(const std::size_t n)
+{
+  return (n + shm_align_ - 1) & ~(shm_align_ - 1);
+}
+
+/**
+ * @brief Build the shared memory object name for a channel.
+ * @param name Channel name.
+ * @param suffix Object suffix.
+ * @return Name to pass to shm_open.
+ */
+std::string objectName(const std::string& name, const char suffix[])
+{
+  return "/" + name + suffix;
+}
+
+/**
+ * @brief Report a failed system call.
+ * @param what What failed.
+ * @throws std::runtime_error always.
+ */
+[[noreturn]] void fail(const std::string& what)
+{
+  const std::string error = "ShmChannel: " + what + ": " + std::strerror(errno);
+  std::cerr << error << std::endl;
+  throw std::runtime_error(error);
+}
+
+}  // namespace
+
+/** Start of the control block. */
+struct ShmChannel::Header
+{
+  std::atomic<std::uint32_t> magic;    ///< shm_magic_ once the producer has finished setting up.
+  std::uint32_t version;               ///< Layout version.
+  pid_t producer_pid;                  ///< Process that created the channel.
+  std::uint64_t slot_count;            ///< Number of payload slots.
+  std::uint64_t slot_size;             ///< Bytes per payload slot.
+  std::uint64_t ring_capacity;         ///< Cells per ring. Power of 2 >= slot_count.
+  std::atomic<std::uint64_t> dropped;  ///< Messages dropped for lack of a free slot.
+  sem_t ready_sem;                     ///< Counts the slots in the ready ring.
+};
+
+/** Ring of slot indices. The cells follow the struct. */
+struct ShmChannel::Ring
+{
+  alignas(shm_align_) std::atomic<std::uint64_t> head;  ///< Next position to push to.
+  alignas(shm_align_) std::atomic<std::uint64_t> tail;  ///< Next position to pop from.
+  std::uint64_t mask;                                   ///< Capacity - 1.
+};
+
+namespace
+{
+/**
+ * @brief Get the number of bytes a ring takes up.
+ * @param capacity Number of cells.
+ * @return Bytes, aligned.
+ */
+std::size_t ringBytes(const std::size_t capacity)
+{
+  return alignUp(sizeof(ShmChannel::Ring) + capacity * sizeof(RingCell));
+}
+
+/**
+ * @brief Get the cells of a ring.
+ * @param ring Ring.
+ * @return First cell.
+ */
+RingCell* cells(ShmChannel::Ring* ring)
+{
+  return reinterpret_cast<RingCell*>(reinterpret_cast<std::uint8_t*>(ring) + alignUp(sizeof(ShmChannel::Ring)));
+}
+
+/**
+ * @brief Set up an empty ring in place.
+ * @param ring Ring memory.
+ * @param capacity Number of cells. Power of 2.
+ */
+void ringInit(ShmChannel::Ring* ring, const std::uint64_t capacity)
+{
+  new (ring) ShmChannel::Ring();
+  ring->head.store(0, std::memory_order_relaxed);
+  ring->tail.store(0, std::memory_order_relaxed);
+  ring->mask = capacity - 1;
+
+  auto* cell = cells(ring);
+  for (std::uint64_t i = 0; i < capacity; ++i)
+  {
+    new (&cell[i]) RingCell();
+    cell[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Try to push a slot index.
+ * @param ring Ring.
+ * @param mask Capacity - 1. Taken from the channel, not the ring, which the other process can write to.
+ * @param value Slot index.
+ * @return False if the ring is full.
+ */
+bool ringPush(ShmChannel::Ring* ring, const std::uint64_t mask, const std::uint64_t value)
+{
+  auto* cell = cells(ring);
+  std::uint64_t pos = ring->head.load(std::memory_order_relaxed);
+
+  for (;;)
+  {
+    auto& c = cell[pos & mask];
+    const std::uint64_t seq = c.seq.load(std::memory_order_acquire);
+    const auto diff = static_cast<std::int64_t>(seq - pos);
+
+    if (diff == 0)
+    {
+      if (ring->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        c.value = value;
+        c.seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      pos = ring->head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief Try to pop a slot index.
+ * @param ring Ring.
+ * @param mask Capacity - 1. Taken from the channel, not the ring, which the other process can write to.
+ * @param value Receives the slot index.
+ * @return False if the ring is empty.
+ */
+bool ringPop(ShmChannel::Ring* ring, const std::uint64_t mask, std::uint64_t& value)
+{
+  auto* cell = cells(ring);
+  std::uint64_t pos = ring->tail.load(std::memory_order_relaxed);
+
+  for (;;)
+  {
+    auto& c = cell[pos & mask];
+    const std::uint64_t seq = c.seq.load(std::memory_order_acquire);
+    const auto diff = static_cast<std::int64_t>(seq - (pos + 1));
+
+    if (diff == 0)
+    {
+      if (ring->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        value = c.value;
+        c.seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      pos = ring->tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * @brief Get the size of the control block.
+ * @param slot_count Number of payload slots.
+ * @param ring_capacity Cells per ring.
+ * @return Bytes.
+ */
+std::size_t controlBytes(const std::size_t slot_count, const std::size_t ring_capacity)
+{
+  return alignUp(sizeof(ShmChannel::Header)) + 2 * ringBytes(ring_capacity) + slot_count * sizeof(std::uint64_t);
+}
+
+/**
+ * @brief Check a channel name is usable as a shared memory object name.
+ * @param name Channel name.
+ * @throws std::runtime_error if it isn't.
+ */
+void checkName(const std::string& name)
+{
+  if (name.empty() || name.find('/') != std::string::npos || name.size() > 200)
+  {
+    const std::string error = "ShmChannel: invalid channel name '" + name + "'";
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<ShmChannel> ShmChannel::create(const std::string& name, const ShmChannelOptions& options)
+{
+  checkName(name);
+
+  if (options.slot_count == 0 || options.slot_size == 0)
+    throw std::runtime_error("ShmChannel: slot count and size must be positive");
+
+  std::shared_ptr<ShmChannel> channel(new ShmChannel(name, true));
+  channel->block_timeout_ = options.block_timeout;
+
+  const auto ctl_name = objectName(name, ".ctl");
+  const auto data_name = objectName(name, ".data");
+
+  // Names left behind by a producer that crashed.
+  shm_unlink(ctl_name.c_str());
+  shm_unlink(data_name.c_str());
+
+  std::uint64_t ring_capacity = 2;
+  while (ring_capacity < options.slot_count)
+    ring_capacity <<= 1;
+
+  // Control block.
+  channel->ctl_size_ = controlBytes(options.slot_count, ring_capacity);
+
+  int fd = shm_open(ctl_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    fail("shm_open " + ctl_name);
+
+  if (ftruncate(fd, channel->ctl_size_) != 0)
+  {
+    close(fd);
+    fail("ftruncate " + ctl_name);
+  }
+
+  void* ctl = mmap(nullptr, channel->ctl_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ctl == MAP_FAILED)
+    fail("mmap " + ctl_name);
+  channel->ctl_ = ctl;
+
+  // Payload slots.
+  channel->data_size_ = options.slot_count * options.slot_size;
+
+  fd = shm_open(data_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    fail("shm_open " + data_name);
+
+  if (ftruncate(fd, channel->data_size_) != 0)
+  {
+    close(fd);
+    fail("ftruncate " + data_name);
+  }
+
+  void* data = mmap(nullptr, channel->data_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    fail("mmap " + data_name);
+  channel->data_ = static_cast<std::uint8_t*>(data);
+
+  channel->slot_count_ = options.slot_count;
+  channel->slot_size_ = options.slot_size;
+  channel->mask_ = ring_capacity - 1;
+
+  auto* header = new (ctl) Header();
+  header->version = shm_version_;
+  header->producer_pid = getpid();
+  header->slot_count = options.slot_count;
+  header->slot_size = options.slot_size;
+  header->ring_capacity = ring_capacity;
+  header->dropped.store(0, std::memory_order_relaxed);
+
+  if (sem_init(&header->ready_sem, 1, 0) != 0)
+    fail("sem_init");
+
+  channel->layout();
+  ringInit(channel->ready_, ring_capacity);
+  ringInit(channel->free_, ring_capacity);
+
+  for (std::uint64_t slot = 0; slot < options.slot_count; ++slot)
+    ringPush(channel->free_, channel->mask_, slot);
+
+  // Consumers ignore the channel until this is set.
+  header->magic.store(shm_magic_, std::memory_order_release);
+
+  return channel;
+}
+
+std::shared_ptr<ShmChannel> ShmChannel::open(const std::string& name, const std::chrono::milliseconds timeout)
+{
+  checkName(name);
+
+  const auto ctl_name = objectName(name, ".ctl");
+  const auto data_name = objectName(name, ".data");
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  for (;; std::this_thread::sleep_for(open_poll_time_))
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+      return nullptr;
+
+    std::shared_ptr<ShmChannel> channel(new ShmChannel(name, false));
+
+    int fd = shm_open(ctl_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+      continue;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header))
+    {
+      close(fd);
+      continue;
+    }
+
+    void* ctl = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ctl == MAP_FAILED)
+      continue;
+
+    channel->ctl_ = ctl;
+    channel->ctl_size_ = st.st_size;
+    channel->header_ = static_cast<Header*>(ctl);
+
+    // Half set up, a different layout, or left behind by a dead producer.
+    const auto* header = channel->header_;
+    if (header->magic.load(std::memory_order_acquire) != shm_magic_ || header->version != shm_version_ ||
+        !channel->isProducerAlive())
+      continue;
+
+    // The producer can still write to the header, so check the geometry once and only use our copy of it from here.
+    const std::uint64_t slot_count = header->slot_count;
+    const std::uint64_t slot_size = header->slot_size;
+    const std::uint64_t ring_capacity = header->ring_capacity;
+
+    if (slot_count == 0 || slot_size == 0 || slot_count > max_slots_ || slot_size > SIZE_MAX / slot_count ||
+        ring_capacity < slot_count || ring_capacity > 2 * max_slots_ || (ring_capacity & (ring_capacity - 1)) != 0 ||
+        channel->ctl_size_ < controlBytes(slot_count, ring_capacity))
+    {
+      std::cerr << "ERROR: ShmChannel: " << name << " has an invalid layout" << std::endl;
+      continue;
+    }
+
+    channel->slot_count_ = slot_count;
+    channel->slot_size_ = slot_size;
+    channel->mask_ = ring_capacity - 1;
+
+    fd = shm_open(data_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      continue;
+
+    // Touching pages past the end of the object would raise SIGBUS.
+    channel->data_size_ = slot_count * slot_size;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < channel->data_size_)
+    {
+      close(fd);
+      channel->data_size_ = 0;
+      continue;
+    }
+
+    void* data = mmap(nullptr, channel->data_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+      channel->data_size_ = 0;
+      continue;
+    }
+
+    channel->data_ = static_cast<std::uint8_t*>(data);
+    channel->layout();
+
+    return channel;
+  }
+}
+
+ShmChannel::~ShmChannel()
+{
+  if (data_ != nullptr)
+    munmap(data_, data_size_);
+
+  if (ctl_ != nullptr)
+    munmap(ctl_, ctl_size_);
+
+  // The consumer keeps its mappings after the names go.
+  if (producer_)
+  {
+    shm_unlink(objectName(name_, ".ctl").c_str());
+    shm_unlink(objectName(name_, ".data").c_str());
+  }
+}
+
+bool ShmChannel::write(const MessageInterface& msg, const ShmCodec& codec)
+{
+  std::uint64_t slot = 0;
+
+  if (!ringPop(free_, mask_, slot))
+  {
+    const auto deadline = std::chrono::steady_clock::now() + block_timeout_;
+    bool found = false;
+
+    while (!found && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(slot_poll_time_);
+      found = ringPop(free_, mask_, slot);
+    }
+
+    if (!found)
+    {
+      header_->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+
+  try
+  {
+    const auto size = codec.size(msg);
+    if (size > slot_size_)
+    {
+      const std::string error = "ShmChannel: " + std::to_string(size) + " byte message doesn't fit in a " +
+                                std::to_string(slot_size_) + " byte slot on " + name_;
+      std::cerr << error << std::endl;
+      throw std::runtime_error(error);
+    }
+
+    codec.encode(msg, data_ + slot * slot_size_);
+    sizes_[slot] = size;
+  }
+  catch (...)
+  {
+    ringPush(free_, mask_, slot);
+    throw;
+  }
+
+  ringPush(ready_, mask_, slot);
+  sem_post(&header_->ready_sem);
+
+  return true;
+}
+
+std::shared_ptr<MessageInterface> ShmChannel::read(const ShmCodec& codec, const std::chrono::milliseconds timeout)
+{
+  // sem_timedwait only takes wall clock deadlines.
+  timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count() + deadline.tv_nsec;
+  deadline.tv_sec += ns / 1000000000;
+  deadline.tv_nsec = ns % 1000000000;
+
+  while (sem_timedwait(&header_->ready_sem, &deadline) != 0)
+  {
+    if (errno != EINTR)
+      return nullptr;
+  }
+
+  std::uint64_t slot = 0;
+  if (!ringPop(ready_, mask_, slot))
+    return nullptr;
+
+  // Everything in the control block comes from another process. Don't let a broken one take this one down with it.
+  if (slot >= slot_count_)
+  {
+    const std::string error = "ShmChannel: slot " + std::to_string(slot) + " out of range on " + name_;
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  const auto* src = data_ + slot * slot_size_;
+  auto self = shared_from_this();
+  std::shared_ptr<const void> lease(src, [self, slot](const void*) { self->release(slot); });
+
+  // Read the size once, so the producer can't change it between the check and the decode.
+  const std::uint64_t size = sizes_[slot];
+  if (size > slot_size_)
+  {
+    const std::string error = "ShmChannel: " + std::to_string(size) + " byte message in a " +
+                              std::to_string(slot_size_) + " byte slot on " + name_;
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  return codec.decode(src, size, std::move(lease));
+}
+
+bool ShmChannel::isProducerAlive(void) const
+{
+  return kill(header_->producer_pid, 0) == 0 || errno == EPERM;
+}
+
+std::uint64_t ShmChannel::getDropped(void) const
+{
+  return header_->dropped.load(std::memory_order_relaxed);
+}
+
+const std::string& ShmChannel::getName(void) const
+{
+  return name_;
+}
+
+ShmPublisher::ShmPublisher(const std::string prefix) : prefix_(prefix)
+{
+}
+
+void ShmPublisher::addTopic(const std::string msg_id, ShmCodec codec, const ShmChannelOptions& options)
+{
+  auto topic = std::make_shared<Topic>();
+  topic->channel = ShmChannel::create(prefix_ + "." + msg_id, options);
+  topic->codec = std::move(codec);
+
+  std::lock_guard<std::mutex> lg(lock_);
+  topics_[msg_id] = topic;
+}
+
+MessageSenderFn ShmPublisher::getSender(void)
+{
+  return [this](const std::string msg_id, const std::string plugin_name, std::shared_ptr<MessageInterface> msg) {
+    (void)plugin_name;
+    send(msg_id, msg);
+  };
+}
+
+std::uint64_t ShmPublisher::getDropped(const std::string& msg_id)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  const auto topic = topics_.find(msg_id);
+  if (topic == topics_.end())
+    return 0;
+
+  return topic->second->channel->getDropped();
+}
+
+ShmSubscriber::ShmSubscriber(const std::string prefix) : prefix_(prefix), running_(true)
+{
+}
+
+ShmSubscriber::~ShmSubscriber()
+{
+  stop();
+}
+
+void ShmSubscriber::subscribe(const std::string msg_id, ShmCodec codec, MessageReceivedCb cb)
+{
+  threads_.emplace_back(&ShmSubscriber::readLoop, this, prefix_ + "." + msg_id, std::move(codec), std::move(cb));
+}
+
+void ShmSubscriber::stop(void)
+{
+  running_ = false;
+
+  for (auto& t : threads_)
+    t.join();
+
+  threads_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+ShmChannel::ShmChannel(const std::string& name, const bool producer) : name_(name), producer_(producer)
+{
+}
+
+void ShmChannel::layout(void)
+{
+  auto* base = static_cast<std::uint8_t*>(ctl_);
+  header_ = static_cast<Header*>(ctl_);
+
+  const auto ring_bytes = ringBytes(mask_ + 1);
+  const auto ready_offset = alignUp(sizeof(Header));
+  const auto free_offset = ready_offset + ring_bytes;
+  const auto sizes_offset = free_offset + ring_bytes;
+
+  ready_ = reinterpret_cast<Ring*>(base + ready_offset);
+  free_ = reinterpret_cast<Ring*>(base + free_offset);
+  sizes_ = reinterpret_cast<std::uint64_t*>(base + sizes_offset);
+}
+
+void ShmChannel::release(const std::uint64_t slot)
+{
+  ringPush(free_, mask_, slot);
+}
+
+void ShmPublisher::send(const std::string& msg_id, const std::shared_ptr<MessageInterface>& msg)
+{
+  std::shared_ptr<Topic> topic;
+
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    const auto entry = topics_.find(msg_id);
+    if (entry != topics_.end())
+      topic = entry->second;
+  }
+
+  if (!topic)
+  {
+    const std::string error = "ShmPublisher: no shared memory channel for " + msg_id;
+    std::cerr << error << std::endl;
+    throw std::runtime_error(error);
+  }
+
+  topic->channel->write(*msg, topic->codec);
+}
+
+void ShmSubscriber::readLoop(const std::string name, const ShmCodec codec, const MessageReceivedCb cb)
+{
+  std::shared_ptr<ShmChannel> channel;
+
+  while (running_)
+  {
+    if (!channel)
+    {
+      channel = ShmChannel::open(name, poll_time_);
+      continue;
+    }
+
+    std::shared_ptr<MessageInterface> msg;
+    try
+    {
+      msg = channel->read(codec, poll_time_);
+    }
+    catch (const std::exception& e)
+    {
+      // The slot was rejected. Unless its index was out of range, it has gone back to the producer.
+      std::cerr << "ERROR: ShmSubscriber: can't decode a message on " << name << ": " << e.what() << std::endl;
+      continue;
+    }
+
+    if (!msg)
+    {
+      // Wait for a restarted producer to create a fresh channel.
+      if (!channel->isProducerAlive())
+        channel.reset();
+
+      continue;
+    }
+
+    try
+    {
+      cb(msg);
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "ERROR: ShmSubscriber: callback for " << name << " threw: " << e.what() << std::endl;
+    }
+  }
+}
+
+}  // namespace soul
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message tracing.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/**
+ * @brief Write a string as a JSON string literal.
+ * @param out Where to write.
+ * @param str String.
+ */
+void writeJsonString(std::ostream& out, const std::string& str)
+{
+  out << '"';
+
+  for (const char c : str)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out << '\\' << c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    }
+    else
+    {
+      out << c;
+    }
+  }
+
+  out << '"';
+}
+
+/**
+ * @brief Convert a duration to trace event microseconds.
+ * @param d Duration.
+ * @return Microseconds.
+ */
+double toMicroseconds(const std::chrono::nanoseconds d)
+{
+  return d.count() / 1000.0;
+}
+
+/**
+ * @brief Get the category name of an event kind.
+ * @param kind Event kind.
+ * @return Category name.
+ */
+const char* getCategory(const TraceEventKind kind)
+{
+  switch (kind)
+  {
+    case TraceEventKind::enqueue:
+      return "enqueue";
+    case TraceEventKind::dispatch:
+      return "dispatch";
+    case TraceEventKind::callback:
+      return "callback";
+  }
+
+  return "unknown";
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+MessageTracer::MessageTracer(const std::size_t capacity) : capacity_(capacity), next_id_(1), dropped_(0)
+{
+}
+
+void MessageTracer::traceEnqueue(const std::string& msg_id, const std::string& publisher, MessageInterface& msg)
+{
+  // The same message can be sent on several topics at once, so only the first send gives it an ID. Capture times
+  // aren't used: unrelated messages can share one.
+  if (__atomic_load_n(&msg.trace_id, __ATOMIC_ACQUIRE) == 0)
+  {
+    std::uint64_t unset = 0;
+    __atomic_compare_exchange_n(&msg.trace_id, &unset, next_id_++, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  }
+
+  TraceEvent event;
+  event.kind = TraceEventKind::enqueue;
+  event.msg_id = msg_id;
+  event.actor = publisher;
+  event.start = std::chrono::steady_clock::now();
+  describe(event, &msg);
+
+  record(std::move(event));
+}
+
+void MessageTracer::traceDispatch(const std::string& msg_id, const std::vector<std::shared_ptr<MessageInterface>>& msgs)
+{
+  const auto now = std::chrono::steady_clock::now();
+
+  std::vector<TraceEvent> events(msgs.size());
+  for (std::size_t i = 0; i < msgs.size(); ++i)
+  {
+    events[i].kind = TraceEventKind::dispatch;
+    events[i].msg_id = msg_id;
+    events[i].start = now;
+    describe(events[i], msgs[i].get());
+  }
+
+  std::lock_guard<std::mutex> lg(lock_);
+
+  for (auto& event : events)
+  {
+    if (events_.size() < capacity_)
+      events_.push_back(std::move(event));
+    else
+      ++dropped_;
+  }
+}
+
+void MessageTracer::traceCallback(const std::string& msg_id, const std::string& subscriber,
+                                  const MessageInterface* msg, const std::chrono::steady_clock::time_point start,
+                                  const std::size_t messages)
+{
+  TraceEvent event;
+  event.kind = TraceEventKind::callback;
+  event.msg_id = msg_id;
+  event.actor = subscriber;
+  event.messages = messages;
+  event.start = start;
+  event.duration = std::chrono::steady_clock::now() - start;
+  describe(event, msg);
+
+  record(std::move(event));
+}
+
+std::vector<TraceEvent> MessageTracer::getEvents(void) const
+{
+  std::lock_guard<std::mutex> lg(lock_);
+  return events_;
+}
+
+std::uint64_t MessageTracer::getDropped(void) const
+{
+  std::lock_guard<std::mutex> lg(lock_);
+  return dropped_;
+}
+
+void MessageTracer::clear(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+  events_.clear();
+  dropped_ = 0;
+}
+
+void MessageTracer::writeChromeTrace(std::ostream& out) const
+{
+  const auto events = getEvents();
+
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  // Trace viewers want small thread numbers, and times relative to the start of the trace.
+  std::unordered_map<std::thread::id, std::size_t> tids;
+  auto origin = events.empty() ? std::chrono::steady_clock::time_point() : events.front().start;
+
+  for (const auto& event : events)
+  {
+    tids.emplace(event.thread, tids.size() + 1);
+    origin = std::min(origin, event.start);
+  }
+
+  // Events of each trace in time order, to join them with flow arrows.
+  std::map<std::uint64_t, std::vector<const TraceEvent*>> traces;
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  const char* separator = "\n";
+
+  for (const auto& event : events)
+  {
+    const bool callback = event.kind == TraceEventKind::callback;
+
+    out << separator << "{\"name\":";
+    writeJsonString(out, callback ? event.actor : event.msg_id);
+    out << ",\"cat\":\"" << getCategory(event.kind) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tids[event.thread]
+        << ",\"ts\":" << toMicroseconds(event.start - origin) << ",\"dur\":" << toMicroseconds(event.duration)
+        << ",\"args\":{\"topic\":";
+    writeJsonString(out, event.msg_id);
+
+    if (!event.actor.empty())
+    {
+      out << (callback ? ",\"subscriber\":" : ",\"publisher\":");
+      writeJsonString(out, event.actor);
+    }
+
+    if (event.messages != 1)
+      out << ",\"messages\":" << event.messages;
+
+    // 64-bit IDs and nanosecond times don't fit exactly in JSON numbers.
+    if (event.trace_id != 0)
+      out << ",\"trace_id\":\"" << event.trace_id << "\"";
+
+    if (event.capture.time_since_epoch().count() != 0)
+    {
+      out << ",\"capture_ns\":\""
+          << std::chrono::duration_cast<std::chrono::nanoseconds>(event.capture.time_since_epoch()).count() << "\"";
+    }
+
+    if (event.since_capture.count() >= 0)
+      out << ",\"since_capture_us\":" << toMicroseconds(event.since_capture);
+
+    out << "}}";
+    separator = ",\n";
+
+    if (event.trace_id != 0)
+      traces[event.trace_id].push_back(&event);
+  }
+
+  for (auto& trace : traces)
+  {
+    auto& hops = trace.second;
+    if (hops.size() < 2)
+      continue;
+
+    std::stable_sort(hops.begin(), hops.end(),
+                     [](const TraceEvent* lhs, const TraceEvent* rhs) { return lhs->start < rhs->start; });
+
+    for (std::size_t i = 0; i < hops.size(); ++i)
+    {
+      const char* phase = i == 0 ? "s" : (i + 1 == hops.size() ? "f" : "t");
+
+      out << separator << "{\"name\":\"trace\",\"cat\":\"trace\",\"ph\":\"" << phase << "\",\"id\":\"" << trace.first
+          << "\",\"pid\":1,\"tid\":" << tids[hops[i]->thread] << ",\"ts\":" << toMicroseconds(hops[i]->start - origin)
+          << (i + 1 == hops.size() ? ",\"bp\":\"e\"}" : "}");
+    }
+  }
+
+  out << "\n]}\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool MessageTracer::writeChromeTrace(const std::string& path) const
+{
+  std::ofstream out(path, std::ios::trunc);
+  writeChromeTrace(out);
+  out.close();
+
+  if (!out)
+  {
+    std::cerr << "ERROR: MessageTracer: can't write " << path << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void MessageTracer::record(TraceEvent event)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+
+  if (events_.size() < capacity_)
+    events_.push_back(std::move(event));
+  else
+    ++dropped_;
+}
+
+void MessageTracer::describe(TraceEvent& event, const MessageInterface* msg)
+{
+  event.thread = std::this_thread::get_id();
+
+  if (msg == nullptr)
+    return;
+
+  // Another thread may be giving the message its ID.
+  event.trace_id = __atomic_load_n(&msg->trace_id, __ATOMIC_ACQUIRE);
+
+  if (msg->timestamp.time_since_epoch().count() != 0)
+  {
+    event.capture = msg->timestamp;
+    event.since_capture = std::chrono::system_clock::now() - msg->timestamp;
+  }
+}
+
+}  // namespace soul
@@ -0,0 +1,370 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message bridge test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/bridge.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// HELPERS                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/** How long tests wait for anything to happen. */
+static const std::chrono::milliseconds timeout_(5000);
+
+/**
+ * @brief Make a codec for dummy messages.
+ * @return Codec that writes the string.
+ */
+static MessageCodec makeDummyCodec(void)
+{
+  MessageCodec codec;
+  codec.size = [](const MessageInterface& msg) { return static_cast<const DummyMessage&>(msg).str.size(); };
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    const auto& str = static_cast<const DummyMessage&>(msg).str;
+    std::memcpy(dst, str.data(), str.size());
+  };
+
+  return codec;
+}
+
+/**
+ * @brief Wait for a condition.
+ * @param condition Condition.
+ * @return Whether it came true within timeout_.
+ */
+static bool waitFor(const std::function<bool(void)>& condition)
+{
+  const auto deadline = std::chrono::steady_clock::now() + timeout_;
+
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return true;
+}
+
+/**
+ * @brief Receive a dummy message.
+ * @param client Client.
+ * @param msg_id Receives the topic.
+ * @param timeout Longest time to wait.
+ * @return Message string, or "<timeout>".
+ */
+static std::string receive(MessageBridgeClient& client, std::string& msg_id,
+                           const std::chrono::milliseconds timeout = timeout_)
+{
+  BridgeMessage msg;
+  if (!client.read(msg, timeout))
+    return "<timeout>";
+
+  msg_id = msg.msg_id;
+  return std::string(reinterpret_cast<const char*>(msg.data.get()), msg.size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FIXTURE                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+class BridgeFixture : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    std::remove(path.c_str());
+  }
+
+  /**
+   * @brief Publish a message.
+   * @param topic Topic.
+   * @param str Message string.
+   */
+  void send(const TopicHandle& topic, const std::string& str)
+  {
+    mgr.send(topic, std::make_shared<DummyMessage>(str));
+    mgr.notify();
+  }
+
+  const std::string path = "bridge_test.sock";
+  const std::string address = "unix:" + path;
+
+  MessageManager mgr;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST_F(BridgeFixture, streams_topics_over_unix_socket)
+{
+  auto a = mgr.publish("a", "plug1");
+  auto b = mgr.publish("b", "plug1");
+
+  MessageBridge bridge(mgr, address);
+  bridge.exportTopic("a", makeDummyCodec());
+  bridge.exportTopic("b", makeDummyCodec());
+
+  EXPECT_THROW(bridge.exportTopic("a", makeDummyCodec()), std::runtime_error);
+  EXPECT_THROW(bridge.exportTopic("c", MessageCodec()), std::runtime_error);
+  EXPECT_EQ(bridge.getAddress(), address);
+
+  MessageBridgeClient client(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+
+  auto captured = std::make_shared<DummyMessage>("b0");
+  captured->timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(1000));
+
+  send(a, "a0");
+  mgr.send(b, captured);
+  mgr.notify();
+  send(a, "a1 is longer");
+  send(a, "");
+
+  BridgeMessage msg;
+  ASSERT_TRUE(client.read(msg, timeout_));
+  EXPECT_EQ(msg.msg_id, "a");
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(msg.data.get()), msg.size), "a0");
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(msg.data.get()) % 8, unsigned(0));
+
+  ASSERT_TRUE(client.read(msg, timeout_));
+  EXPECT_EQ(msg.msg_id, "b");
+  EXPECT_EQ(msg.timestamp_ns, 1000000000000);
+
+  std::string msg_id;
+  EXPECT_EQ(receive(client, msg_id), "a1 is longer");
+  EXPECT_EQ(receive(client, msg_id), "");
+  EXPECT_EQ(msg_id, "a");
+
+  EXPECT_FALSE(client.read(msg, std::chrono::milliseconds(20)));
+  EXPECT_TRUE(waitFor([&bridge]() { return bridge.getSent() == 4; }));
+  EXPECT_EQ(bridge.getDropped(), unsigned(0));
+
+  // Closing disconnects the client and removes the socket file.
+  bridge.close();
+  EXPECT_THROW(client.read(msg, timeout_), std::runtime_error);
+  EXPECT_THROW(bridge.exportTopic("d", makeDummyCodec()), std::runtime_error);
+
+  struct stat st;
+  EXPECT_NE(stat(path.c_str(), &st), 0);
+}
+
+TEST_F(BridgeFixture, streams_over_tcp)
+{
+  auto a = mgr.publish("a", "plug1");
+
+  MessageBridge bridge(mgr, "tcp:127.0.0.1:0");
+  bridge.exportTopic("a", makeDummyCodec());
+
+  EXPECT_EQ(bridge.getAddress().compare(0, 14, "tcp:127.0.0.1:"), 0);
+  EXPECT_NE(bridge.getAddress(), "tcp:127.0.0.1:0");
+
+  MessageBridgeClient client(bridge.getAddress());
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+
+  for (int i = 0; i < 100; ++i)
+    send(a, std::to_string(i));
+
+  std::string msg_id;
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(receive(client, msg_id), std::to_string(i));
+
+  EXPECT_EQ(msg_id, "a");
+}
+
+TEST_F(BridgeFixture, late_clients_and_new_topics)
+{
+  auto a = mgr.publish("a", "plug1");
+  auto b = mgr.publish("b", "plug1");
+
+  MessageBridge bridge(mgr, address);
+  bridge.exportTopic("a", makeDummyCodec());
+
+  MessageBridgeClient early(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+
+  send(a, "a0");
+
+  std::string msg_id;
+  EXPECT_EQ(receive(early, msg_id), "a0");
+
+  // A client that connects later hears about the topics announced before it came, and gets only the messages sent
+  // after that.
+  MessageBridgeClient late(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 2; }));
+
+  bridge.exportTopic("b", makeDummyCodec());
+  send(b, "b0");
+  send(a, "a1");
+
+  for (auto* client : { &early, &late })
+  {
+    EXPECT_EQ(receive(*client, msg_id), "b0");
+    EXPECT_EQ(msg_id, "b");
+    EXPECT_EQ(receive(*client, msg_id), "a1");
+    EXPECT_EQ(msg_id, "a");
+  }
+}
+
+TEST_F(BridgeFixture, slow_clients_drop_without_stalling)
+{
+  auto a = mgr.publish("a", "plug1");
+
+  BridgeOptions options;
+  options.client_backlog = 64 << 10;
+  options.socket_buffer_size = 16 << 10;
+
+  MessageBridge bridge(mgr, address, options);
+  bridge.exportTopic("a", makeDummyCodec());
+
+  MessageBridgeClient fast(address);
+  MessageBridgeClient slow(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 2; }));
+
+  // The slow client reads nothing while the fast one keeps up with every message.
+  const int messages = 50;
+  std::string msg_id;
+
+  for (int i = 0; i < messages; ++i)
+  {
+    const auto str = std::to_string(i) + std::string(8 << 10, 'x');
+    send(a, str);
+    EXPECT_EQ(receive(fast, msg_id), str);
+  }
+
+  const auto dropped = bridge.getDropped();
+  EXPECT_GT(dropped, unsigned(0));
+  EXPECT_LT(dropped, unsigned(messages));
+
+  // The slow client gets whole messages, in order, up to where it fell behind.
+  int last = -1;
+  int received = 0;
+
+  for (;;)
+  {
+    const auto str = receive(slow, msg_id, std::chrono::milliseconds(200));
+    if (str == "<timeout>")
+      break;
+
+    const int i = std::stoi(str);
+    EXPECT_GT(i, last);
+    EXPECT_EQ(str, std::to_string(i) + std::string(8 << 10, 'x'));
+
+    last = i;
+    ++received;
+  }
+
+  EXPECT_EQ(unsigned(received), messages - dropped);
+  EXPECT_EQ(bridge.getSent(), unsigned(messages + received));
+}
+
+TEST_F(BridgeFixture, clients_come_and_go)
+{
+  auto a = mgr.publish("a", "plug1");
+
+  MessageBridge bridge(mgr, address);
+  bridge.exportTopic("a", makeDummyCodec());
+
+  {
+    MessageBridgeClient client(address);
+    ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+  }
+
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 0; }));
+
+  // Nobody is listening, so nothing is sent or dropped.
+  send(a, "unheard");
+
+  MessageBridgeClient client(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+
+  send(a, "heard");
+
+  std::string msg_id;
+  EXPECT_EQ(receive(client, msg_id), "heard");
+  EXPECT_EQ(bridge.getDropped(), unsigned(0));
+}
+
+TEST_F(BridgeFixture, codec_errors_are_dropped)
+{
+  auto a = mgr.publish("a", "plug1");
+
+  auto codec = makeDummyCodec();
+  const auto size = codec.size;
+  codec.size = [size](const MessageInterface& msg) {
+    if (static_cast<const DummyMessage&>(msg).str == "bad")
+      throw std::runtime_error("bad message");
+
+    return size(msg);
+  };
+
+  MessageBridge bridge(mgr, address);
+  bridge.exportTopic("a", codec);
+
+  MessageBridgeClient client(address);
+  ASSERT_TRUE(waitFor([&bridge]() { return bridge.getClients() == 1; }));
+
+  send(a, "bad");
+  send(a, "good");
+
+  std::string msg_id;
+  EXPECT_EQ(receive(client, msg_id), "good");
+  EXPECT_EQ(bridge.getDropped(), unsigned(1));
+}
+
+TEST_F(BridgeFixture, bad_addresses_throw)
+{
+  EXPECT_THROW(MessageBridge(mgr, "udp:127.0.0.1:1234"), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "unix:"), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "unix:/nonexistent/dir/bridge.sock"), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "unix:" + std::string(200, 'a')), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "tcp:127.0.0.1"), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "tcp:127.0.0.1:99999"), std::runtime_error);
+  EXPECT_THROW(MessageBridge(mgr, "tcp:127.0.0.1:port"), std::runtime_error);
+
+  // A file that isn't a socket is left alone.
+  std::ofstream(path) << "precious";
+  EXPECT_THROW(MessageBridge(mgr, address), std::runtime_error);
+
+  std::string contents;
+  std::ifstream(path) >> contents;
+  EXPECT_EQ(contents, "precious");
+  std::remove(path.c_str());
+
+  EXPECT_THROW(MessageBridgeClient client(address), std::runtime_error);
+  EXPECT_THROW(MessageBridgeClient client("tcp:127.0.0.1"), std::runtime_error);
+}
+
+}  // namespace soul
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Subscriber dispatch test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/dispatch.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(WorkStealingPoolTest, runs_all_tasks)
+{
+  WorkStealingPool pool(4);
+  EXPECT_EQ(pool.getWorkerCount(), unsigned(4));
+
+  std::atomic<int> count(0);
+  for (int i = 0; i < 10000; ++i)
+    pool.post([&count]() { ++count; });
+
+  pool.drain();
+  EXPECT_EQ(count, 10000);
+}
+
+TEST(WorkStealingPoolTest, default_workers)
+{
+  WorkStealingPool pool;
+  EXPECT_GE(pool.getWorkerCount(), unsigned(1));
+}
+
+TEST(WorkStealingPoolTest, concurrent)
+{
+  WorkStealingPool pool(2);
+
+  // Each task waits for the other, so this only finishes if they run at the same time.
+  std::atomic<int> arrived(0);
+  auto task = [&arrived]() {
+    ++arrived;
+    while (arrived < 2)
+      std::this_thread::yield();
+  };
+
+  pool.post(task);
+  pool.post(task);
+  pool.drain();
+
+  EXPECT_EQ(arrived, 2);
+}
+
+TEST(WorkStealingPoolTest, steal)
+{
+  WorkStealingPool pool(2);
+
+  // Tie up one worker. Tasks dealt to its deque can then only run if the other worker steals them.
+  std::atomic<bool> release(false);
+  std::atomic<bool> blocked(false);
+  pool.post([&]() {
+    blocked = true;
+    while (!release)
+      std::this_thread::yield();
+  });
+
+  while (!blocked)
+    std::this_thread::yield();
+
+  std::atomic<int> count(0);
+  for (int i = 0; i < 100; ++i)
+    pool.post([&count]() { ++count; });
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (count < 100 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::yield();
+
+  EXPECT_EQ(count, 100);
+
+  release = true;
+  pool.drain();
+}
+
+TEST(WorkStealingPoolTest, post_from_task)
+{
+  WorkStealingPool pool(2);
+  std::atomic<int> count(0);
+
+  pool.post([&pool, &count]() {
+    for (int i = 0; i < 100; ++i)
+      pool.post([&count]() { ++count; });
+  });
+
+  pool.drain();
+  EXPECT_EQ(count, 100);
+}
+
+TEST(WorkStealingPoolTest, destructor_finishes_tasks)
+{
+  std::atomic<int> count(0);
+
+  {
+    WorkStealingPool pool(2);
+    for (int i = 0; i < 100; ++i)
+      pool.post([&count]() { ++count; });
+  }
+
+  EXPECT_EQ(count, 100);
+}
+
+TEST(DispatchStrandTest, ordered)
+{
+  WorkStealingPool pool(4);
+
+  std::vector<int> received;
+  std::atomic<int> running(0);
+  bool overlapped = false;
+
+  auto strand = std::make_shared<DispatchStrand>([&](std::shared_ptr<MessageInterface> msg) {
+    if (++running > 1)
+      overlapped = true;
+
+    received.push_back(std::stoi(std::dynamic_pointer_cast<DummyMessage>(msg)->str));
+    --running;
+  });
+
+  int next = 0;
+  for (int batch = 0; batch < 100; ++batch)
+  {
+    std::vector<std::shared_ptr<MessageInterface>> msgs;
+    for (int i = 0; i < 10; ++i)
+      msgs.push_back(std::make_shared<DummyMessage>(std::to_string(next++)));
+
+    strand->post(pool, msgs);
+  }
+
+  pool.drain();
+
+  EXPECT_FALSE(overlapped);
+  ASSERT_EQ(received.size(), unsigned(1000));
+  for (int i = 0; i < 1000; ++i)
+    EXPECT_EQ(received[i], i);
+}
+
+TEST(DispatchStrandTest, callback_throws)
+{
+  WorkStealingPool pool(1);
+  int calls = 0;
+
+  auto strand = std::make_shared<DispatchStrand>([&calls](std::shared_ptr<MessageInterface>) {
+    ++calls;
+    throw std::runtime_error("callback failed");
+  });
+
+  std::vector<std::shared_ptr<MessageInterface>> msgs = { std::make_shared<DummyMessage>("0"),
+                                                          std::make_shared<DummyMessage>("1") };
+  strand->post(pool, msgs);
+  pool.drain();
+
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(DispatchStrandTest, callback_throws_non_std)
+{
+  WorkStealingPool pool(1);
+  int calls = 0;
+
+  auto strand = std::make_shared<DispatchStrand>([&calls](std::shared_ptr<MessageInterface>) {
+    ++calls;
+    throw 42;
+  });
+
+  std::vector<std::shared_ptr<MessageInterface>> msgs = { std::make_shared<DummyMessage>("0"),
+                                                          std::make_shared<DummyMessage>("1") };
+  strand->post(pool, msgs);
+  pool.drain();
+
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(DispatchStrandTest, batch)
+{
+  WorkStealingPool pool(4);
+
+  std::vector<int> received;
+  int calls = 0;
+
+  auto strand = std::make_shared<DispatchStrand>([&](const MessageBatch& batch) {
+    ++calls;
+    for (const auto& msg : batch)
+      received.push_back(std::stoi(std::dynamic_pointer_cast<DummyMessage>(msg)->str));
+  });
+
+  int next = 0;
+  for (int post = 0; post < 100; ++post)
+  {
+    std::vector<std::shared_ptr<MessageInterface>> msgs;
+    for (int i = 0; i < 10; ++i)
+      msgs.push_back(std::make_shared<DummyMessage>(std::to_string(next++)));
+
+    strand->post(pool, msgs);
+  }
+
+  pool.drain();
+
+  // Posts that arrive while a batch runs are merged into the next one, so there is at most one call per post.
+  EXPECT_GE(calls, 1);
+  EXPECT_LE(calls, 100);
+  ASSERT_EQ(received.size(), unsigned(1000));
+  for (int i = 0; i < 1000; ++i)
+    EXPECT_EQ(received[i], i);
+}
+
+TEST(DispatchStrandTest, close_drops_callback)
+{
+  WorkStealingPool pool(1);
+  auto owned = std::make_shared<int>(0);
+  std::weak_ptr<int> state = owned;
+  int calls = 0;
+
+  auto strand = std::make_shared<DispatchStrand>([owned, &calls](std::shared_ptr<MessageInterface>) { ++calls; });
+  owned.reset();
+
+  strand->post(pool, { std::make_shared<DummyMessage>("0") });
+
+  // Whoever still holds the strand, the callback and what it captured are gone once close() returns.
+  auto holder = strand;
+  strand->close();
+  EXPECT_EQ(calls, 1);
+  EXPECT_TRUE(state.expired());
+
+  strand->post(pool, { std::make_shared<DummyMessage>("1") });
+  pool.drain();
+  EXPECT_EQ(calls, 1);
+}
+
+}  // namespace soul
@@ -17,12 +17,16 @@
 
 #include <gmock/gmock.h>
 
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <future>
 #include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -91,7 +95,7 @@ TEST_F(TestFixture, send_normal)
   auto msg = std::make_shared<DummyMessage>("Hi");
   mgr.send("test", "plug1", msg);
 
-  auto& q = mgr.queue_["test"];
+  auto& q = *mgr.topics_["test"].queue;
   EXPECT_EQ(q.size(), unsigned(1));
 }
 
@@ -100,7 +104,7 @@ TEST_F(TestFixture, send_no_subs)
   mgr.publish("test", "plug1");
   auto msg = std::make_shared<DummyMessage>("Hi");
   mgr.send("test", "plug1", msg);
-  auto& q = mgr.queue_["test"];
+  auto& q = *mgr.topics_["test"].queue;
   EXPECT_EQ(q.size(), unsigned(1));
 }
 
@@ -126,7 +130,7 @@ TEST_F(TestFixture, send_and_notify)
 
   EXPECT_EQ(recv_msg, "Hi");
 
-  auto& q = mgr.queue_["test"];
+  auto& q = *mgr.topics_["test"].queue;
   EXPECT_EQ(q.size(), unsigned(0));
 }
 
@@ -141,23 +145,150 @@ TEST_F(TestFixture, send_and_notify_no_cb)
 
   mgr.send("test", "plug1", msg);
 
-  auto& q = mgr.queue_["test"];
+  auto& q = *mgr.topics_["test"].queue;
   EXPECT_EQ(q.size(), unsigned(1));
 
   mgr.notify();
 
   EXPECT_EQ(recv_msg, "");
 
-  auto& q2 = mgr.queue_["test"];
+  auto& q2 = *mgr.topics_["test"].queue;
   EXPECT_EQ(q2.size(), unsigned(0));
 }
 
+TEST_F(TestFixture, send_handle_shares_queue)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.send("test", "plug1", std::make_shared<DummyMessage>("Hi"));
+
+  auto& q = *mgr.topics_["test"].queue;
+  EXPECT_EQ(q.size(), unsigned(2));
+  EXPECT_EQ(mgr.num_msgs_, 2);
+}
+
+TEST_F(TestFixture, send_overflow_count)
+{
+  MessagePublisher pub("plug1");
+  pub.queue.capacity = 2;
+  pub.queue.overflow = OverflowPolicy::drop_oldest;
+  auto topic = mgr.publish("test", pub);
+
+  for (int i = 0; i < 5; ++i)
+    mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+
+  // The message count must track what is actually queued or waitForWork spins.
+  EXPECT_EQ(mgr.topics_["test"].queue->size(), unsigned(2));
+  EXPECT_EQ(mgr.num_msgs_, 2);
+
+  mgr.notify();
+  EXPECT_EQ(mgr.num_msgs_, 0);
+}
+
+TEST_F(TestFixture, send_to_full_queue_from_callback)
+{
+  MessagePublisher pub("plug1");
+  pub.queue.capacity = 1;
+  pub.queue.overflow = OverflowPolicy::block;
+  auto topic = mgr.publish("test", pub);
+
+  // Waiting for space here would wait for this very notify() to drain the queue.
+  int calls = 0;
+  mgr.subscribe("test", "plug2", [&](std::shared_ptr<MessageInterface>) {
+    if (++calls > 1)
+      return;
+
+    mgr.send(topic, std::make_shared<DummyMessage>("0"));
+    mgr.send(topic, std::make_shared<DummyMessage>("1"));
+  });
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+
+  EXPECT_EQ(mgr.getDropped()["test"], unsigned(1));
+  EXPECT_EQ(mgr.num_msgs_, 1);
+
+  mgr.notify();
+  EXPECT_EQ(calls, 2);
+  EXPECT_EQ(mgr.num_msgs_, 0);
+}
+
+TEST_F(TestFixture, ready_list)
+{
+  auto topic = mgr.publish("test", "plug1");
+  mgr.publish("idle1", "plug1");
+  mgr.publish("idle2", "plug1");
+  EXPECT_TRUE(mgr.ready_.empty());
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  ASSERT_EQ(mgr.ready_.size(), unsigned(1));
+  EXPECT_EQ(mgr.ready_[0]->msg_id, "test");
+  EXPECT_TRUE(mgr.topics_["test"].ready);
+
+  mgr.notify();
+  EXPECT_TRUE(mgr.ready_.empty());
+  EXPECT_FALSE(mgr.topics_["test"].ready);
+}
+
+TEST_F(TestFixture, subscribers_resolved)
+{
+  mgr.subscribe("test", "plug1", cb);
+  mgr.subscribe("test", "plug2", cb);
+  mgr.subscribe("test", "plug1", nullptr);
+
+  auto& topic = mgr.topics_["test"];
+  EXPECT_TRUE(topic.queue == nullptr);
+  const auto subscribers = topic.subscribers.read();
+  ASSERT_EQ(subscribers->size(), unsigned(2));
+  EXPECT_EQ(subscribers->at(0).name, "plug1");
+  EXPECT_EQ(subscribers->at(1).name, "plug2");
+}
+
 TEST_F(TestFixture, setWork)
 {
   EXPECT_TRUE(mgr.work_);
   mgr.setWork(false);
   EXPECT_FALSE(mgr.work_);
 }
+
+TEST_F(TestFixture, typed_mismatch_throws)
+{
+  struct OtherMessage : public MessageInterface
+  {
+  };
+
+  mgr.publish<DummyMessage>("test", "plug1");
+
+  EXPECT_THROW(mgr.publish<OtherMessage>("test", "plug2"), std::runtime_error);
+  EXPECT_THROW(mgr.subscribe<OtherMessage>("test", "plug3", nullptr), std::runtime_error);
+
+  // The failed registrations left nothing behind.
+  EXPECT_EQ(mgr.publishers_["test"].size(), unsigned(1));
+  EXPECT_EQ(mgr.subscribers_["test"].size(), unsigned(0));
+
+  // The type can also be fixed by the first subscriber.
+  mgr.subscribe<OtherMessage>("other", "plug3", nullptr);
+  EXPECT_THROW(mgr.publish<DummyMessage>("other", "plug1"), std::runtime_error);
+}
+
+TEST_F(TestFixture, untyped_send_to_typed_topic)
+{
+  struct OtherMessage : public MessageInterface
+  {
+  };
+
+  mgr.publish<DummyMessage>("test", "plug1");
+  auto untyped = mgr.publish("test", "plug2");
+
+  mgr.send(untyped, std::make_shared<DummyMessage>("Hi"));
+  EXPECT_THROW(mgr.send(untyped, std::make_shared<OtherMessage>()), std::runtime_error);
+  EXPECT_THROW(mgr.send("test", "plug2", std::make_shared<OtherMessage>()), std::runtime_error);
+
+  EXPECT_EQ(mgr.num_msgs_, 1);
+}
+
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -175,6 +306,198 @@ TEST_F(TestFixture, getPublishers)
   EXPECT_EQ(pubs.at(0).name, "plug2");
 }
 
+TEST_F(TestFixture, publish_handle)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  ASSERT_TRUE(topic.valid());
+  EXPECT_EQ(topic.getMsgId(), "test");
+  EXPECT_EQ(topic.getPublisherName(), "plug1");
+
+  // Publishing again hands back an equivalent handle.
+  auto again = mgr.publish("test", "plug1");
+  ASSERT_TRUE(again.valid());
+  EXPECT_EQ(again.getMsgId(), "test");
+}
+
+TEST_F(TestFixture, send_handle_and_notify)
+{
+  auto topic = mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  EXPECT_EQ(recv_msg, "");
+
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "Hi");
+}
+
+TEST_F(TestFixture, send_invalid_handle)
+{
+  TopicHandle topic;
+
+  EXPECT_FALSE(topic.valid());
+  EXPECT_THROW(mgr.send(topic, std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+}
+
+TEST_F(TestFixture, getSender)
+{
+  mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  auto sender = mgr.getSender();
+  sender("test", "plug1", std::make_shared<DummyMessage>("Hi"));
+  EXPECT_THROW(sender("test", "plug2", std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "Hi");
+}
+
+TEST_F(TestFixture, getSender_with_handles)
+{
+  auto handle = mgr.publish("test", "plug1");
+  mgr.publish("other", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  auto sender = mgr.getSender({ handle });
+  sender("test", "plug1", std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "Hi");
+
+  // Topics without a handle and unregistered publishers still go through the checked path.
+  sender("other", "plug1", std::make_shared<DummyMessage>("Hi"));
+  EXPECT_THROW(sender("test", "plug2", std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+  EXPECT_THROW(sender("nothing", "plug1", std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+
+  // Withdrawn publishers are refused.
+  mgr.unpublish("test", "plug1");
+  EXPECT_THROW(sender("test", "plug1", std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+}
+
+TEST_F(TestFixture, keep_latest)
+{
+  MessagePublisher pub("plug1");
+  pub.queue.overflow = OverflowPolicy::keep_latest;
+  auto topic = mgr.publish("test", pub);
+  mgr.subscribe("test", "plug2", cb);
+
+  int calls = 0;
+  mgr.subscribe("test", "plug3", [&calls](std::shared_ptr<MessageInterface>) { ++calls; });
+
+  mgr.send(topic, std::make_shared<DummyMessage>("old"));
+  mgr.send(topic, std::make_shared<DummyMessage>("new"));
+  mgr.notify();
+
+  EXPECT_EQ(recv_msg, "new");
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(TestFixture, getDropped)
+{
+  MessagePublisher pub("plug1");
+  pub.queue.capacity = 1;
+  pub.queue.overflow = OverflowPolicy::drop_newest;
+  auto topic = mgr.publish("test", pub);
+  mgr.publish("other", "plug1");
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+
+  auto dropped = mgr.getDropped();
+  EXPECT_EQ(dropped.size(), unsigned(2));
+  EXPECT_EQ(dropped["test"], unsigned(2));
+  EXPECT_EQ(dropped["other"], unsigned(0));
+}
+
+TEST_F(TestFixture, pooled_subscriber_ordered)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  std::vector<std::string> received;
+  mgr.subscribe("test", "plug2", [&received](std::shared_ptr<MessageInterface> msg) {
+    received.push_back(std::dynamic_pointer_cast<DummyMessage>(msg)->str);
+  }, DispatchMode::pooled);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+    if (i % 10 == 0)
+      mgr.notify();
+  }
+
+  mgr.notify();
+  mgr.clear();
+
+  ASSERT_EQ(received.size(), unsigned(100));
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(received[i], std::to_string(i));
+}
+
+TEST_F(TestFixture, pooled_subscriber_doesnt_stall_others)
+{
+  mgr.setExecutor(std::make_shared<WorkStealingPool>(2));
+  auto topic = mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  std::atomic<bool> release(false);
+  std::atomic<int> slow_calls(0);
+  mgr.subscribe("test", "slow", [&](std::shared_ptr<MessageInterface>) {
+    ++slow_calls;
+    while (!release)
+      std::this_thread::yield();
+  }, DispatchMode::pooled);
+
+  // notify returns while the slow subscriber is still busy.
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "Hi");
+
+  mgr.send(topic, std::make_shared<DummyMessage>("again"));
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "again");
+
+  release = true;
+  mgr.clear();
+  EXPECT_EQ(slow_calls, 2);
+}
+
+TEST_F(TestFixture, setExecutor_null)
+{
+  EXPECT_THROW(mgr.setExecutor(nullptr), std::runtime_error);
+}
+
+TEST_F(TestFixture, subscribe_before_publish)
+{
+  mgr.subscribe("test", "plug2", cb);
+  auto topic = mgr.publish("test", "plug1");
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+  EXPECT_EQ(recv_msg, "Hi");
+}
+
+TEST_F(TestFixture, notify_many_topics)
+{
+  std::vector<TopicHandle> topics;
+  for (int i = 0; i < 50; ++i)
+    topics.push_back(mgr.publish("test" + std::to_string(i), "plug1"));
+
+  int calls = 0;
+  mgr.subscribe("test7", "plug2", [&calls](std::shared_ptr<MessageInterface>) { ++calls; });
+  mgr.subscribe("test8", "plug2", cb);
+
+  for (int round = 0; round < 3; ++round)
+  {
+    mgr.send(topics[7], std::make_shared<DummyMessage>("Hi"));
+    mgr.send(topics[8], std::make_shared<DummyMessage>(std::to_string(round)));
+    mgr.notify();
+  }
+
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(recv_msg, "2");
+}
+
 TEST_F(TestFixture, waitForWork_non_empty)
 {
   mgr.publish("test", "plug1");
@@ -228,6 +551,575 @@ TEST_F(TestFixture, waitForWork_interrupted)
   t.join();
 }
 
+TEST_F(TestFixture, typed_publish_subscribe)
+{
+  auto topic = mgr.publish<DummyMessage>("test", "plug1");
+  ASSERT_TRUE(topic.valid());
+  EXPECT_EQ(topic.getMsgId(), "test");
+
+  std::string typed;
+  mgr.subscribe<DummyMessage>("test", "plug2",
+                              [&typed](std::shared_ptr<const DummyMessage> msg) { typed = msg->str; });
+
+  // Untyped subscribers still see typed topics.
+  mgr.subscribe("test", "plug3", cb);
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+
+  EXPECT_EQ(typed, "Hi");
+  EXPECT_EQ(recv_msg, "Hi");
+}
+
+TEST_F(TestFixture, typed_pooled_subscriber)
+{
+  auto topic = mgr.publish<DummyMessage>("test", "plug1");
+
+  std::atomic<int> calls(0);
+  mgr.subscribe<DummyMessage>(
+      "test", "plug2", [&calls](std::shared_ptr<const DummyMessage> msg) { calls += msg->str == "Hi"; },
+      DispatchMode::pooled);
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+  mgr.clear();
+
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(TestFixture, typed_list_message)
+{
+  using DummyList = ListMessage<DummyMessage>;
+  auto topic = mgr.publish<DummyList>("test", "plug1");
+
+  std::size_t items = 0;
+  mgr.subscribe<DummyList>("test", "plug2",
+                           [&items](std::shared_ptr<const DummyList> msg) { items = msg->getItems().size(); });
+
+  mgr.send(topic, std::make_shared<DummyList>(std::vector<DummyMessage>{ DummyMessage("a"), DummyMessage("b") }));
+  mgr.notify();
+
+  EXPECT_EQ(items, size_t(2));
+}
+
+TEST_F(TestFixture, typed_subscriber_after_untyped_sends)
+{
+  struct OtherMessage : public MessageInterface
+  {
+  };
+
+  auto untyped = mgr.publish("test", "plug1");
+  mgr.send(untyped, std::make_shared<OtherMessage>());
+  mgr.send(untyped, std::make_shared<DummyMessage>("Hi"));
+
+  std::vector<std::string> typed;
+  mgr.subscribe<DummyMessage>("test", "plug2",
+                              [&typed](std::shared_ptr<const DummyMessage> msg) { typed.push_back(msg->str); });
+
+  // Sends after the topic is typed are refused up front.
+  EXPECT_THROW(mgr.send(untyped, std::make_shared<OtherMessage>()), std::runtime_error);
+
+  // The message queued before it never reaches the typed subscriber.
+  mgr.notify();
+
+  ASSERT_EQ(typed.size(), size_t(1));
+  EXPECT_EQ(typed[0], "Hi");
+}
+
+TEST_F(TestFixture, send_invalid_typed_topic)
+{
+  Topic<DummyMessage> topic;
+
+  EXPECT_FALSE(topic.valid());
+  EXPECT_THROW(mgr.send(topic, std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+}
+
+TEST_F(TestFixture, subscription_callback)
+{
+  std::vector<std::string> seen;
+
+  mgr.setSubscriptionCallback([&](const std::string& msg_id, const std::string& subscriber_name) {
+    seen.push_back(msg_id + "/" + subscriber_name);
+
+    // Callbacks may subscribe in turn, e.g., when starting a publisher pulls in its own inputs.
+    if (msg_id == "output")
+      mgr.subscribe("input", "producer", cb);
+  });
+
+  mgr.subscribe("output", "consumer", cb);
+  mgr.subscribe("output", "consumer", cb);
+
+  mgr.setSubscriptionCallback(nullptr);
+  mgr.subscribe("other", "consumer", cb);
+
+  EXPECT_EQ(seen, std::vector<std::string>({ "output/consumer", "input/producer" }));
+}
+
+TEST_F(TestFixture, unsubscribe_stops_delivery)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  int calls = 0;
+  mgr.subscribe("test", "plug2", [&calls](std::shared_ptr<MessageInterface>) { ++calls; });
+  mgr.subscribe("test", "plug3", cb);
+
+  EXPECT_TRUE(mgr.unsubscribe("test", "plug2"));
+  EXPECT_FALSE(mgr.unsubscribe("test", "plug2"));
+  EXPECT_FALSE(mgr.unsubscribe("nothing", "plug2"));
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+
+  EXPECT_EQ(calls, 0);
+  EXPECT_EQ(recv_msg, "Hi");
+
+  // The subscriber can come back, e.g., after its plugin is reloaded.
+  mgr.subscribe("test", "plug2", [&calls](std::shared_ptr<MessageInterface>) { ++calls; });
+  mgr.send(topic, std::make_shared<DummyMessage>("again"));
+  mgr.notify();
+
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(TestFixture, unsubscribe_waits_for_delivery)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  std::atomic<bool> entered(false), release(false), finished(false);
+  mgr.subscribe("test", "plug2", [&](std::shared_ptr<MessageInterface>) {
+    entered = true;
+    while (!release)
+      std::this_thread::yield();
+    finished = true;
+  });
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  std::thread loop([this]() { mgr.notify(); });
+
+  while (!entered)
+    std::this_thread::yield();
+
+  auto revoked = std::async(std::launch::async, [this]() { return mgr.unsubscribe("test", "plug2"); });
+  EXPECT_EQ(revoked.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+
+  release = true;
+  EXPECT_TRUE(revoked.get());
+  EXPECT_TRUE(finished);
+
+  loop.join();
+}
+
+TEST_F(TestFixture, unsubscribe_drains_pooled_subscriber)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  std::atomic<int> calls(0);
+  mgr.subscribe("test", "plug2", [&calls](std::shared_ptr<MessageInterface>) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ++calls;
+  }, DispatchMode::pooled);
+
+  for (int i = 0; i < 10; ++i)
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+
+  mgr.notify();
+
+  EXPECT_TRUE(mgr.unsubscribe("test", "plug2"));
+  EXPECT_EQ(calls, 10);
+}
+
+TEST_F(TestFixture, unsubscribe_from_delivery_throws)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  bool threw = false;
+  mgr.subscribe("test", "plug2", [&](std::shared_ptr<MessageInterface>) {
+    try
+    {
+      mgr.unsubscribe("test", "plug2");
+    }
+    catch (const std::runtime_error&)
+    {
+      threw = true;
+    }
+  });
+
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  mgr.notify();
+
+  EXPECT_TRUE(threw);
+  EXPECT_TRUE(mgr.unsubscribe("test", "plug2"));
+}
+
+TEST_F(TestFixture, unpublish_refuses_sends)
+{
+  mgr.publish("test", "plug1");
+  mgr.publish("test", "plug2");
+
+  EXPECT_TRUE(mgr.unpublish("test", "plug1"));
+  EXPECT_FALSE(mgr.unpublish("test", "plug1"));
+  EXPECT_FALSE(mgr.unpublish("nothing", "plug1"));
+
+  EXPECT_THROW(mgr.send("test", "plug1", std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+  mgr.send("test", "plug2", std::make_shared<DummyMessage>("Hi"));
+
+  ASSERT_EQ(mgr.getPublishers().size(), unsigned(1));
+  EXPECT_EQ(mgr.getPublishers()[0].name, "plug2");
+}
+
+TEST_F(TestFixture, unpublish_revokes_handles)
+{
+  auto handle = mgr.publish("test", "plug1");
+  auto typed = mgr.publish<DummyMessage>("typed", "plug1");
+  ASSERT_TRUE(handle.valid());
+  ASSERT_TRUE(typed.valid());
+
+  EXPECT_TRUE(mgr.unpublish("test", "plug1"));
+  EXPECT_TRUE(mgr.unpublish("typed", "plug1"));
+
+  EXPECT_FALSE(handle.valid());
+  EXPECT_FALSE(typed.valid());
+  EXPECT_EQ(handle.getMsgId(), "test");
+  EXPECT_THROW(mgr.send(handle, std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+  EXPECT_THROW(mgr.send(typed, std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+
+  // Publishing again doesn't bring the old handle back.
+  auto fresh = mgr.publish("test", "plug1");
+  EXPECT_TRUE(fresh.valid());
+  EXPECT_FALSE(handle.valid());
+
+  // Clearing the manager revokes everything it handed out.
+  mgr.clear();
+  EXPECT_FALSE(fresh.valid());
+  EXPECT_THROW(mgr.send(fresh, std::make_shared<DummyMessage>("Hi")), std::runtime_error);
+}
+
+TEST_F(TestFixture, waitForDelivery)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  std::atomic<int> calls(0);
+  mgr.subscribe("test", "plug2", [&calls](std::shared_ptr<MessageInterface>) { ++calls; });
+  mgr.subscribe("test", "plug3", [&calls](std::shared_ptr<MessageInterface>) { ++calls; }, DispatchMode::pooled);
+
+  // Nothing queued, or nothing known, is delivered already.
+  EXPECT_TRUE(mgr.waitForDelivery({ "test", "nothing" }, std::chrono::milliseconds(0)));
+
+  // Nobody is calling notify().
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  EXPECT_FALSE(mgr.waitForDelivery({ "test" }, std::chrono::milliseconds(10)));
+
+  std::thread loop([this]() {
+    while (mgr.waitForWork())
+      mgr.notify();
+  });
+
+  EXPECT_TRUE(mgr.waitForDelivery({ "test" }, std::chrono::milliseconds(5000)));
+  EXPECT_EQ(calls, 2);
+
+  mgr.setWork(false);
+  loop.join();
+}
+
+TEST_F(TestFixture, latest_value_topic)
+{
+  MessagePublisher pub("camera");
+  pub.queue.backend = QueueBackend::latest;
+  auto topic = mgr.publish<DummyMessage>("frames", pub);
+
+  int calls = 0;
+  mgr.subscribe<DummyMessage>("frames", "overlay", [&](std::shared_ptr<const DummyMessage> msg) {
+    recv_msg = msg->str;
+    ++calls;
+  });
+
+  EXPECT_TRUE(mgr.getLatest("frames") == nullptr);
+  EXPECT_TRUE(mgr.getLatest("nothing") == nullptr);
+
+  for (int i = 0; i < 3; ++i)
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+
+  // The frames coalesce into one delivery of the newest.
+  mgr.notify();
+  mgr.notify();
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(recv_msg, "2");
+
+  // Consumers that don't subscribe sample it whenever they like.
+  EXPECT_EQ(mgr.getLatest<DummyMessage>("frames")->str, "2");
+  EXPECT_EQ(mgr.getDropped()["frames"], unsigned(2));
+
+  // Forgetting it releases the message, and the next send is kept again.
+  std::weak_ptr<MessageInterface> kept = mgr.getLatest("frames");
+  mgr.forgetLatest("frames");
+  mgr.forgetLatest("nothing");
+  EXPECT_TRUE(mgr.getLatest("frames") == nullptr);
+  EXPECT_TRUE(kept.expired());
+
+  mgr.send(topic, std::make_shared<DummyMessage>("3"));
+  EXPECT_EQ(mgr.getLatest<DummyMessage>("frames")->str, "3");
+}
+
+TEST_F(TestFixture, forgetLatest_subscriber_only_topic)
+{
+  // Nobody has published, so the topic has no queue yet.
+  mgr.subscribe("frames", "overlay", cb);
+
+  mgr.forgetLatest("frames");
+  EXPECT_TRUE(mgr.getLatest("frames") == nullptr);
+}
+
+TEST_F(TestFixture, batch_subscriber)
+{
+  auto topic = mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  std::vector<std::size_t> batches;
+  std::string last;
+  mgr.subscribeBatch("test", "plug3", [&](const MessageBatch& batch) {
+    batches.push_back(batch.size());
+    last = std::dynamic_pointer_cast<DummyMessage>(batch[batch.size() - 1])->str;
+  });
+
+  for (int i = 0; i < 5; ++i)
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+
+  mgr.notify();
+
+  ASSERT_EQ(batches.size(), unsigned(1));
+  EXPECT_EQ(batches[0], unsigned(5));
+  EXPECT_EQ(last, "4");
+  EXPECT_EQ(recv_msg, "4");
+
+  // Nothing new, no call.
+  mgr.notify();
+  EXPECT_EQ(batches.size(), unsigned(1));
+}
+
+TEST_F(TestFixture, pooled_batch_subscriber)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  std::vector<std::string> received;
+  mgr.subscribeBatch("test", "plug2", [&received](const MessageBatch& batch) {
+    for (const auto& msg : batch)
+      received.push_back(std::dynamic_pointer_cast<DummyMessage>(msg)->str);
+  }, DispatchMode::pooled);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+    if (i % 10 == 0)
+      mgr.notify();
+  }
+
+  mgr.notify();
+  mgr.clear();
+
+  ASSERT_EQ(received.size(), unsigned(100));
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(received[i], std::to_string(i));
+}
+
+TEST_F(TestFixture, typed_batch_subscriber)
+{
+  auto topic = mgr.publish<DummyMessage>("test", "plug1");
+
+  std::string joined;
+  std::shared_ptr<const DummyMessage> kept;
+  mgr.subscribeBatch<DummyMessage>("test", "plug2", [&](const TypedMessageBatch<DummyMessage>& batch) {
+    for (std::size_t i = 0; i < batch.size(); ++i)
+      joined += batch[i].str;
+
+    kept = batch.share(0);
+  });
+
+  mgr.send(topic, std::make_shared<DummyMessage>("a"));
+  mgr.send(topic, std::make_shared<DummyMessage>("b"));
+  mgr.notify();
+
+  EXPECT_EQ(joined, "ab");
+  ASSERT_TRUE(kept != nullptr);
+  EXPECT_EQ(kept->str, "a");
+
+  // Typed batches take the same type checks as typed subscribers.
+  mgr.publish<ListMessage<DummyMessage>>("other", "plug1");
+  EXPECT_THROW(mgr.subscribeBatch<DummyMessage>("other", "plug2", [](const TypedMessageBatch<DummyMessage>&) {}),
+               std::runtime_error);
+}
+
+TEST_F(TestFixture, tracing)
+{
+  EXPECT_TRUE(mgr.getTracer() == nullptr);
+
+  auto tracer = std::make_shared<MessageTracer>();
+  mgr.setTracer(tracer);
+  EXPECT_EQ(mgr.getTracer(), tracer.get());
+
+  auto topic = mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+  mgr.subscribeBatch("test", "plug3", [](const MessageBatch&) {});
+
+  std::atomic<int> pooled(0);
+  mgr.subscribe("test", "plug4", [&pooled](std::shared_ptr<MessageInterface>) { ++pooled; }, DispatchMode::pooled);
+
+  auto msg = std::make_shared<DummyMessage>("Hi");
+  mgr.send(topic, msg);
+  mgr.notify();
+  mgr.setTracer(nullptr);
+
+  // Sends after tracing stops aren't recorded.
+  mgr.send(topic, std::make_shared<DummyMessage>("again"));
+  mgr.notify();
+  mgr.clear();
+
+  EXPECT_EQ(pooled, 2);
+
+  const auto events = tracer->getEvents();
+  ASSERT_EQ(events.size(), unsigned(5));
+
+  std::vector<std::string> callbacks;
+  for (const auto& event : events)
+  {
+    EXPECT_EQ(event.msg_id, "test");
+    EXPECT_EQ(event.trace_id, msg->trace_id);
+
+    if (event.kind == TraceEventKind::callback)
+      callbacks.push_back(event.actor);
+  }
+
+  EXPECT_EQ(events[0].kind, TraceEventKind::enqueue);
+  EXPECT_EQ(events[1].kind, TraceEventKind::dispatch);
+  EXPECT_THAT(callbacks, ::testing::UnorderedElementsAre("plug2", "plug3", "plug4"));
+}
+
+TEST_F(TestFixture, tracing_typed_send)
+{
+  auto tracer = std::make_shared<MessageTracer>();
+  mgr.setTracer(tracer);
+
+  auto topic = mgr.publish<DummyMessage>("test", "plug1");
+  mgr.subscribe<DummyMessage>("test", "plug2", [](std::shared_ptr<const DummyMessage>) {});
+
+  auto msg = std::make_shared<DummyMessage>("Hi");
+  mgr.send(topic, msg);
+  mgr.notify();
+  mgr.setTracer(nullptr);
+
+  // Typed sends get a trace ID and an enqueue event like untyped ones.
+  EXPECT_NE(msg->trace_id, unsigned(0));
+
+  const auto events = tracer->getEvents();
+  ASSERT_EQ(events.size(), unsigned(3));
+
+  EXPECT_EQ(events[0].kind, TraceEventKind::enqueue);
+  EXPECT_EQ(events[0].actor, "plug1");
+  EXPECT_EQ(events[1].kind, TraceEventKind::dispatch);
+  EXPECT_EQ(events[2].kind, TraceEventKind::callback);
+  EXPECT_EQ(events[2].actor, "plug2");
+
+  for (const auto& event : events)
+    EXPECT_EQ(event.trace_id, msg->trace_id);
+}
+
+TEST_F(TestFixture, tracing_list_hops)
+{
+  using DummyList = ListMessage<DummyMessage>;
+
+  auto tracer = std::make_shared<MessageTracer>();
+  mgr.setTracer(tracer);
+
+  auto images = mgr.publish<DummyMessage>("image", "camera");
+  auto faces = mgr.publish<DummyList>("faces", "detector");
+  auto encodings = mgr.publish<DummyList>("encodings", "encoder");
+
+  // Each hop derives its items from the message it got, the way the perception plugins do.
+  mgr.subscribe<DummyMessage>("image", "detector", [this, &faces](std::shared_ptr<const DummyMessage> image) {
+    DummyMessage face("face");
+    inheritTrace(face, *image);
+    mgr.send(faces, std::make_shared<DummyList>(std::vector<DummyMessage>{ face }));
+  });
+
+  mgr.subscribe<DummyList>("faces", "encoder", [this, &encodings](std::shared_ptr<const DummyList> list) {
+    DummyMessage encoding("encoding");
+    inheritTrace(encoding, list->getItems().front());
+    mgr.send(encodings, std::make_shared<DummyList>(std::vector<DummyMessage>{ encoding }));
+  });
+
+  std::uint64_t received = 0;
+  mgr.subscribe<DummyList>("encodings", "person",
+                           [&received](std::shared_ptr<const DummyList> list) { received = list->trace_id; });
+
+  auto image = std::make_shared<DummyMessage>("image");
+  mgr.send(images, image);
+
+  for (int hop = 0; hop < 3; ++hop)
+    mgr.notify();
+
+  mgr.setTracer(nullptr);
+
+  ASSERT_NE(image->trace_id, unsigned(0));
+  EXPECT_EQ(received, image->trace_id);
+
+  // Every event from the camera to the last subscriber is on the image's trace.
+  const auto events = tracer->getEvents();
+  ASSERT_EQ(events.size(), unsigned(9));
+
+  for (const auto& event : events)
+    EXPECT_EQ(event.trace_id, image->trace_id) << event.msg_id << " " << event.actor;
+}
+
+TEST_F(TestFixture, metrics)
+{
+  MessagePublisher pub("camera");
+  pub.queue.backend = QueueBackend::latest;
+  auto frames = mgr.publish("frames", pub);
+  auto topic = mgr.publish("test", "plug1");
+  mgr.subscribe("test", "plug2", cb);
+
+  for (int i = 0; i < 3; ++i)
+  {
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+    mgr.send(frames, std::make_shared<DummyMessage>(std::to_string(i)));
+  }
+
+  auto metrics = mgr.getMetrics();
+  const MetricLabels test = { { "topic", "test" } };
+  const MetricLabels sub = { { "topic", "test" }, { "subscriber", "plug2" } };
+
+  // Depths are read on collection.
+  metrics->collect();
+  EXPECT_EQ(metrics->getCounter("soul_messages_sent_total", "", test).get(), unsigned(3));
+  EXPECT_EQ(metrics->getGauge("soul_queue_depth", "", test).get(), 3);
+  EXPECT_EQ(metrics->getGauge("soul_messages_pending", "").get(), 4);
+  EXPECT_EQ(metrics->getCounter("soul_messages_dropped_total", "", { { "topic", "frames" } }).get(), unsigned(2));
+
+  mgr.notify();
+  metrics->collect();
+
+  EXPECT_EQ(metrics->getCounter("soul_messages_delivered_total", "", test).get(), unsigned(3));
+  EXPECT_EQ(metrics->getGauge("soul_queue_depth", "", test).get(), 0);
+  EXPECT_EQ(metrics->getGauge("soul_queue_depth_max", "", test).get(), 3);
+  EXPECT_EQ(metrics->getGauge("soul_messages_pending", "").get(), 0);
+  EXPECT_EQ(metrics->getHistogram("soul_callback_seconds", "", sub).getSnapshot().count, unsigned(3));
+
+  // Collecting again doesn't count the drops twice.
+  metrics->collect();
+  EXPECT_EQ(metrics->getCounter("soul_messages_dropped_total", "", { { "topic", "frames" } }).get(), unsigned(2));
+
+  std::ostringstream out;
+  metrics->writePrometheus(out);
+  EXPECT_NE(out.str().find("soul_messages_sent_total{topic=\"test\"} 3\n"), std::string::npos);
+
+  // Callbacks that throw are counted, and the exception still reaches the caller.
+  mgr.subscribe("test", "plug3", [](std::shared_ptr<MessageInterface>) { throw std::runtime_error("oops"); });
+  mgr.send(topic, std::make_shared<DummyMessage>("Hi"));
+  EXPECT_THROW(mgr.notify(), std::runtime_error);
+  EXPECT_EQ(metrics->getCounter("soul_callback_errors_total", "", { { "topic", "test" }, { "subscriber", "plug3" } })
+                .get(),
+            unsigned(1));
+}
+
 TEST(TestListMessageCompiles, IfThisWorksListMessageCompiled)
 {
   std::vector<int> items = { 4, 8, 15, 16, 23, 42 };
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Metrics test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/metrics.h>
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(MetricHistogramTest, buckets)
+{
+  MetricHistogram histogram;
+
+  histogram.observe(std::chrono::nanoseconds(0));
+  histogram.observe(std::chrono::nanoseconds(-5));
+  histogram.observe(std::chrono::nanoseconds(1));
+  histogram.observe(std::chrono::nanoseconds(1023));
+  histogram.observe(std::chrono::nanoseconds(1024));
+
+  EXPECT_EQ(histogram.buckets_[0].load(), unsigned(2));
+  EXPECT_EQ(histogram.buckets_[1].load(), unsigned(1));
+  EXPECT_EQ(histogram.buckets_[10].load(), unsigned(1));
+  EXPECT_EQ(histogram.buckets_[11].load(), unsigned(1));
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(MetricCounterTest, counts_across_threads)
+{
+  MetricCounter counter;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 16; ++i)
+  {
+    threads.emplace_back([&counter]() {
+      for (int j = 0; j < 1000; ++j)
+        counter.add();
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  counter.add(5);
+  EXPECT_EQ(counter.get(), unsigned(16005));
+}
+
+TEST(MetricGaugeTest, set_add_raise)
+{
+  MetricGauge gauge;
+
+  gauge.set(10);
+  gauge.add(-3);
+  EXPECT_EQ(gauge.get(), 7);
+
+  gauge.raise(5);
+  EXPECT_EQ(gauge.get(), 7);
+
+  gauge.raise(12);
+  EXPECT_EQ(gauge.get(), 12);
+}
+
+TEST(MetricHistogramTest, snapshot)
+{
+  MetricHistogram histogram;
+
+  EXPECT_EQ(histogram.getSnapshot().getQuantile(0.5).count(), 0);
+
+  for (int i = 0; i < 99; ++i)
+    histogram.observe(std::chrono::microseconds(1));
+
+  histogram.observe(std::chrono::milliseconds(1));
+
+  const auto snapshot = histogram.getSnapshot();
+  EXPECT_EQ(snapshot.count, unsigned(100));
+  EXPECT_EQ(snapshot.sum, std::chrono::microseconds(99 + 1000));
+  EXPECT_EQ(snapshot.max, std::chrono::milliseconds(1));
+
+  // Quantiles are bucket bounds, so within a factor of 2, and never more than the maximum.
+  EXPECT_GE(snapshot.getQuantile(0.5), std::chrono::microseconds(1));
+  EXPECT_LE(snapshot.getQuantile(0.5), std::chrono::microseconds(2));
+  EXPECT_EQ(snapshot.getQuantile(1.0), std::chrono::milliseconds(1));
+}
+
+TEST(MetricsRegistryTest, same_metric)
+{
+  MetricsRegistry registry;
+
+  auto& counter = registry.getCounter("test_total", "Test.", { { "topic", "a" } });
+  EXPECT_EQ(&registry.getCounter("test_total", "Test.", { { "topic", "a" } }), &counter);
+  EXPECT_NE(&registry.getCounter("test_total", "Test.", { { "topic", "b" } }), &counter);
+
+  EXPECT_THROW(registry.getGauge("test_total", "Test."), std::runtime_error);
+}
+
+TEST(MetricsRegistryTest, collect)
+{
+  MetricsRegistry registry;
+
+  registry.getCounter("test_total", "Test.").add(3);
+  auto& gauge = registry.getGauge("test_depth", "Depth.");
+
+  int collected = 0;
+  const auto id = registry.addCollector([&]() {
+    gauge.set(++collected);
+  });
+
+  auto samples = registry.collect();
+  ASSERT_EQ(samples.size(), unsigned(2));
+  EXPECT_EQ(samples[0].name, "test_depth");
+  EXPECT_EQ(samples[0].kind, MetricKind::gauge);
+  EXPECT_EQ(samples[0].value, 1.0);
+  EXPECT_EQ(samples[1].name, "test_total");
+  EXPECT_EQ(samples[1].value, 3.0);
+
+  registry.removeCollector(id);
+  samples = registry.collect();
+  EXPECT_EQ(samples[0].value, 1.0);
+  EXPECT_EQ(collected, 1);
+}
+
+TEST(MetricsRegistryTest, prometheus)
+{
+  MetricsRegistry registry;
+
+  registry.getCounter("test_total", "Test.", { { "topic", "a \"b\"" } }).add(2);
+  registry.getHistogram("test_seconds", "Time.").observe(std::chrono::microseconds(3));
+
+  std::ostringstream out;
+  registry.writePrometheus(out);
+  const auto text = out.str();
+
+  EXPECT_NE(text.find("# HELP test_total Test.\n# TYPE test_total counter\n"), std::string::npos);
+  EXPECT_NE(text.find("test_total{topic=\"a \\\"b\\\"\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find("# TYPE test_seconds histogram\n"), std::string::npos);
+
+  // 3 us is over the first bucket, which ends at 1024 ns, and under the second.
+  EXPECT_NE(text.find("test_seconds_bucket{le=\"1.024e-06\"} 0\n"), std::string::npos);
+  EXPECT_NE(text.find("test_seconds_bucket{le=\"4.096e-06\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find("test_seconds_bucket{le=\"+Inf\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find("test_seconds_sum 3e-06\n"), std::string::npos);
+  EXPECT_NE(text.find("test_seconds_count 1\n"), std::string::npos);
+}
+
+TEST(MetricsDumperTest, writes_file)
+{
+  const std::string path = "metrics_dumper_test.prom";
+  std::remove(path.c_str());
+
+  auto registry = std::make_shared<MetricsRegistry>();
+  registry->getCounter("test_total", "Test.").add(7);
+
+  {
+    MetricsDumper dumper(registry, path, std::chrono::hours(1));
+  }
+
+  std::ifstream in(path);
+  std::stringstream text;
+  text << in.rdbuf();
+
+  EXPECT_NE(text.str().find("test_total 7\n"), std::string::npos);
+  std::remove(path.c_str());
+}
+
+}  // namespace soul
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Event notifier test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/notifier.h>
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(NotifierTest, no_waiters_after_wait)
+{
+  Notifier notifier;
+  std::atomic<bool> flag(false);
+
+  std::thread t([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    flag = true;
+    notifier.notify();
+  });
+
+  notifier.wait([&]() { return flag.load(); });
+  t.join();
+
+  EXPECT_EQ(notifier.waiters_, 0);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(NotifierTest, ready_returns_immediately)
+{
+  Notifier notifier;
+  notifier.wait([]() { return true; });
+}
+
+TEST(NotifierTest, notify_without_waiter)
+{
+  Notifier notifier;
+  notifier.notify();
+
+  std::atomic<bool> flag(true);
+  notifier.wait([&]() { return flag.load(); });
+}
+
+TEST(NotifierTest, wakes_waiter)
+{
+  Notifier notifier;
+  std::atomic<bool> flag(false);
+
+  std::thread t([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    flag = true;
+    notifier.notify();
+  });
+
+  notifier.wait([&]() { return flag.load(); });
+  EXPECT_TRUE(flag);
+
+  t.join();
+}
+
+TEST(NotifierTest, no_lost_wakeups)
+{
+  // Ping pong between two threads. A single lost wakeup hangs the test.
+  Notifier to_consumer;
+  Notifier to_producer;
+  std::atomic<int> produced(0);
+  std::atomic<int> consumed(0);
+  const int rounds = 20000;
+
+  std::thread producer([&]() {
+    for (int i = 1; i <= rounds; ++i)
+    {
+      produced = i;
+      to_consumer.notify();
+      to_producer.wait([&]() { return consumed.load() == i; });
+    }
+  });
+
+  for (int i = 1; i <= rounds; ++i)
+  {
+    to_consumer.wait([&]() { return produced.load() == i; });
+    consumed = i;
+    to_producer.notify();
+  }
+
+  producer.join();
+  EXPECT_EQ(consumed, rounds);
+}
+
+}  // namespace soul
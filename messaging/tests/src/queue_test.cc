@@ -16,7 +16,12 @@
 
 #include <gmock/gmock.h>
 
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -43,12 +48,44 @@ protected:
   MessageQueue msg_q;
 };
 
+class RingFixture : public ::testing::Test
+{
+public:
+  RingFixture() : msg_q(ringOptions())
+  {
+  }
+
+protected:
+  static QueueOptions ringOptions(void)
+  {
+    QueueOptions options;
+    options.backend = QueueBackend::ring;
+    options.capacity = 2048;
+
+    return options;
+  }
+
+  MessageQueue msg_q;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // PRIVATE TESTS                                                             //
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifdef HR_DEBUG
 
+TEST_F(TestFixture, locked_by_default)
+{
+  EXPECT_EQ(msg_q.getOptions().backend, QueueBackend::locked);
+  EXPECT_TRUE(msg_q.ring_ == nullptr);
+}
+
+TEST_F(RingFixture, ring_allocated)
+{
+  ASSERT_TRUE(msg_q.ring_ != nullptr);
+  EXPECT_EQ(msg_q.ring_->capacity(), unsigned(2048));
+}
+
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -124,4 +161,283 @@ TEST_F(TestFixture, popAll)
   EXPECT_EQ(msgs.size(), unsigned(500));
 }
 
-}  // namespace soul
\ No newline at end of file
+TEST_F(RingFixture, push_threaded)
+{
+  EXPECT_TRUE(msg_q.empty());
+  auto t = std::thread(push_hi, std::ref(msg_q));
+
+  for (int i = 0; i < 500; ++i)
+  {
+    auto msg = std::make_shared<DummyMessage>("Hi");
+    msg_q.push(std::move(msg));
+  }
+
+  t.join();
+
+  EXPECT_EQ(msg_q.size(), unsigned(1000));
+  EXPECT_FALSE(msg_q.empty());
+}
+
+TEST_F(RingFixture, pop_empty)
+{
+  // Nothing to wait on, so an empty ring queue hands back nothing.
+  EXPECT_TRUE(msg_q.pop() == nullptr);
+
+  msg_q.push(std::make_shared<DummyMessage>("Hi"));
+  EXPECT_EQ(std::dynamic_pointer_cast<DummyMessage>(msg_q.pop())->str, "Hi");
+  EXPECT_TRUE(msg_q.pop() == nullptr);
+}
+
+TEST(RingQueueTest, needs_capacity)
+{
+  QueueOptions options;
+  options.backend = QueueBackend::ring;
+
+  EXPECT_THROW(MessageQueue msg_q(options), std::runtime_error);
+}
+
+TEST_F(RingFixture, popAll)
+{
+  for (int i = 0; i < 500; ++i)
+    msg_q.push(std::make_shared<DummyMessage>(std::to_string(i)));
+
+  auto msgs = msg_q.popAll();
+  ASSERT_EQ(msgs.size(), unsigned(500));
+
+  for (int i = 0; i < 500; ++i)
+    EXPECT_EQ(std::dynamic_pointer_cast<DummyMessage>(msgs.at(i))->str, std::to_string(i));
+
+  EXPECT_TRUE(msg_q.empty());
+}
+
+TEST(RingQueueTest, push_waits_when_full)
+{
+  QueueOptions options;
+  options.backend = QueueBackend::ring;
+  options.capacity = 4;
+  options.overflow = OverflowPolicy::block;
+
+  MessageQueue msg_q(options);
+
+  // Twice the capacity. The producer has to wait for the consumer to drain.
+  auto t = std::thread([&msg_q]() {
+    for (int i = 0; i < 8; ++i)
+      msg_q.push(std::make_shared<DummyMessage>("Hi"));
+  });
+
+  int received = 0;
+  while (received < 8)
+    received += msg_q.popAll().size();
+
+  t.join();
+
+  EXPECT_TRUE(msg_q.empty());
+}
+
+TEST(OverflowTest, unbounded_by_default)
+{
+  MessageQueue msg_q;
+
+  for (int i = 0; i < 10000; ++i)
+    EXPECT_EQ(msg_q.push(std::make_shared<DummyMessage>("Hi")), 1);
+
+  EXPECT_EQ(msg_q.size(), unsigned(10000));
+  EXPECT_EQ(msg_q.getDropped(), unsigned(0));
+}
+
+/** Result of pushing past the capacity of a queue. */
+struct OverflowResult
+{
+  std::vector<std::string> contents;  ///< Messages left in the queue, oldest first.
+  int changes = 0;                    ///< Sum of the push return values.
+  std::uint64_t dropped = 0;          ///< Drop counter of the queue.
+};
+
+/**
+ * @brief Push two messages more than the capacity onto a queue. Messages are numbered from "0".
+ * @param backend Queue backend.
+ * @param policy Overflow policy.
+ * @return Queue contents and counters.
+ */
+static OverflowResult overflow(const QueueBackend backend, const OverflowPolicy policy)
+{
+  // Ring capacities are powers of 2.
+  QueueOptions options;
+  options.backend = backend;
+  options.capacity = 4;
+  options.overflow = policy;
+  options.block_timeout = std::chrono::milliseconds(1);
+
+  MessageQueue msg_q(options);
+  OverflowResult result;
+
+  for (int i = 0; i < 6; ++i)
+    result.changes += msg_q.push(std::make_shared<DummyMessage>(std::to_string(i)));
+
+  result.dropped = msg_q.getDropped();
+
+  for (auto& msg : msg_q.popAll())
+    result.contents.push_back(std::dynamic_pointer_cast<DummyMessage>(msg)->str);
+
+  return result;
+}
+
+static const std::vector<QueueBackend> backends = { QueueBackend::locked, QueueBackend::ring };
+
+TEST(OverflowTest, drop_oldest)
+{
+  for (auto backend : backends)
+  {
+    auto result = overflow(backend, OverflowPolicy::drop_oldest);
+
+    EXPECT_EQ(result.contents, std::vector<std::string>({ "2", "3", "4", "5" }));
+    EXPECT_EQ(result.changes, 4);
+    EXPECT_EQ(result.dropped, unsigned(2));
+  }
+}
+
+TEST(OverflowTest, drop_newest)
+{
+  for (auto backend : backends)
+  {
+    auto result = overflow(backend, OverflowPolicy::drop_newest);
+
+    EXPECT_EQ(result.contents, std::vector<std::string>({ "0", "1", "2", "3" }));
+    EXPECT_EQ(result.changes, 4);
+    EXPECT_EQ(result.dropped, unsigned(2));
+  }
+}
+
+TEST(OverflowTest, block_timeout)
+{
+  for (auto backend : backends)
+  {
+    auto result = overflow(backend, OverflowPolicy::block);
+
+    EXPECT_EQ(result.contents, std::vector<std::string>({ "0", "1", "2", "3" }));
+    EXPECT_EQ(result.changes, 4);
+    EXPECT_EQ(result.dropped, unsigned(2));
+  }
+}
+
+TEST(OverflowTest, keep_latest)
+{
+  for (auto backend : backends)
+  {
+    auto result = overflow(backend, OverflowPolicy::keep_latest);
+
+    EXPECT_EQ(result.contents, std::vector<std::string>({ "5" }));
+    EXPECT_EQ(result.changes, 1);
+    EXPECT_EQ(result.dropped, unsigned(5));
+  }
+}
+
+TEST(OverflowTest, block_until_space)
+{
+  for (auto backend : backends)
+  {
+    QueueOptions options;
+    options.backend = backend;
+    options.capacity = 2;
+    options.overflow = OverflowPolicy::block;
+
+    MessageQueue msg_q(options);
+    msg_q.push(std::make_shared<DummyMessage>("0"));
+    msg_q.push(std::make_shared<DummyMessage>("1"));
+
+    auto t = std::thread([&msg_q]() { msg_q.push(std::make_shared<DummyMessage>("2")); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(msg_q.size(), unsigned(2));
+
+    EXPECT_EQ(std::dynamic_pointer_cast<DummyMessage>(msg_q.pop())->str, "0");
+    t.join();
+
+    EXPECT_EQ(msg_q.size(), unsigned(2));
+    EXPECT_EQ(msg_q.getDropped(), unsigned(0));
+  }
+}
+
+TEST(OverflowTest, block_without_wait_drops)
+{
+  for (auto backend : backends)
+  {
+    QueueOptions options;
+    options.backend = backend;
+    options.capacity = 2;
+    options.overflow = OverflowPolicy::block;
+
+    MessageQueue msg_q(options);
+    EXPECT_EQ(msg_q.push(std::make_shared<DummyMessage>("0"), false), 1);
+    EXPECT_EQ(msg_q.push(std::make_shared<DummyMessage>("1"), false), 1);
+    EXPECT_EQ(msg_q.push(std::make_shared<DummyMessage>("2"), false), 0);
+    EXPECT_EQ(msg_q.getDropped(), unsigned(1));
+  }
+}
+
+TEST(LatestQueueTest, newest_message_wins)
+{
+  for (auto policy : { OverflowPolicy::block, OverflowPolicy::drop_newest, OverflowPolicy::keep_latest })
+  {
+    auto result = overflow(QueueBackend::latest, policy);
+
+    EXPECT_EQ(result.contents, std::vector<std::string>({ "5" }));
+    EXPECT_EQ(result.changes, 1);
+    EXPECT_EQ(result.dropped, unsigned(5));
+  }
+}
+
+TEST(LatestQueueTest, peek_keeps_popped_message)
+{
+  QueueOptions options;
+  options.backend = QueueBackend::latest;
+  MessageQueue msg_q(options);
+
+  EXPECT_TRUE(msg_q.peek() == nullptr);
+  EXPECT_TRUE(msg_q.empty());
+
+  EXPECT_EQ(msg_q.push(std::make_shared<DummyMessage>("frame")), 1);
+  EXPECT_EQ(msg_q.size(), unsigned(1));
+  EXPECT_EQ(std::dynamic_pointer_cast<DummyMessage>(msg_q.pop())->str, "frame");
+
+  EXPECT_TRUE(msg_q.empty());
+  EXPECT_TRUE(msg_q.pop() == nullptr);
+  EXPECT_TRUE(msg_q.popAll().empty());
+  EXPECT_EQ(std::dynamic_pointer_cast<DummyMessage>(msg_q.peek())->str, "frame");
+
+  // Nothing to hold on a null message.
+  EXPECT_EQ(msg_q.push(nullptr), 0);
+  EXPECT_TRUE(msg_q.empty());
+}
+
+TEST(LatestQueueTest, concurrent_producers_counted)
+{
+  QueueOptions options;
+  options.backend = QueueBackend::latest;
+  MessageQueue msg_q(options);
+
+  std::atomic<int> queued(0);
+  std::vector<std::thread> producers;
+
+  for (int p = 0; p < 4; ++p)
+  {
+    producers.emplace_back([&msg_q, &queued]() {
+      for (int i = 0; i < 1000; ++i)
+        queued += msg_q.push(std::make_shared<DummyMessage>(std::to_string(i)));
+    });
+  }
+
+  int popped = 0;
+  for (int i = 0; i < 1000; ++i)
+    popped += static_cast<int>(msg_q.popAll().size());
+
+  for (auto& t : producers)
+    t.join();
+
+  popped += static_cast<int>(msg_q.popAll().size());
+
+  EXPECT_EQ(queued, popped);
+  EXPECT_EQ(msg_q.getDropped() + static_cast<unsigned>(popped), unsigned(4000));
+}
+
+}  // namespace soul
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Read-copy-update cell test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/rcu.h>
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(RcuCellTest, unread_versions_freed_on_update)
+{
+  RcuCell<std::vector<int>> cell;
+
+  cell.update([](std::vector<int>& v) { v.push_back(1); });
+  EXPECT_TRUE(cell.retired_.empty());
+}
+
+TEST(RcuCellTest, read_versions_kept_until_synchronize)
+{
+  RcuCell<std::vector<int>> cell;
+
+  {
+    const auto old = cell.read();
+    cell.update([](std::vector<int>& v) { v.push_back(1); });
+
+    EXPECT_TRUE(old->empty());
+    EXPECT_EQ(cell.retired_.size(), unsigned(1));
+  }
+
+  cell.synchronize();
+  EXPECT_TRUE(cell.retired_.empty());
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(RcuCellTest, read_sees_updates)
+{
+  RcuCell<std::vector<int>> cell(std::vector<int>({ 1 }));
+
+  cell.update([](std::vector<int>& v) { v.push_back(2); });
+
+  EXPECT_EQ(*cell.read(), std::vector<int>({ 1, 2 }));
+}
+
+TEST(RcuCellTest, throwing_update_publishes_nothing)
+{
+  RcuCell<std::vector<int>> cell(std::vector<int>({ 1 }));
+
+  EXPECT_THROW(cell.update([](std::vector<int>& v) {
+    v.push_back(2);
+    throw std::runtime_error("no");
+  }), std::runtime_error);
+
+  EXPECT_EQ(*cell.read(), std::vector<int>({ 1 }));
+}
+
+TEST(RcuCellTest, update_inside_read)
+{
+  RcuCell<std::vector<int>> cell;
+  const auto old = cell.read();
+
+  cell.update([](std::vector<int>& v) { v.push_back(1); });
+
+  EXPECT_TRUE(old->empty());
+  EXPECT_EQ(cell.read()->size(), unsigned(1));
+}
+
+TEST(RcuCellTest, synchronize_waits_for_reads)
+{
+  RcuCell<std::vector<int>> cell;
+
+  std::atomic<bool> reading(false), release(false);
+  std::thread reader([&]() {
+    const auto value = cell.read();
+    reading = true;
+
+    while (!release)
+      std::this_thread::yield();
+  });
+
+  while (!reading)
+    std::this_thread::yield();
+
+  cell.update([](std::vector<int>& v) { v.push_back(1); });
+
+  auto synced = std::async(std::launch::async, [&cell]() { cell.synchronize(); });
+  EXPECT_EQ(synced.wait_for(std::chrono::milliseconds(50)), std::future_status::timeout);
+
+  release = true;
+  synced.get();
+  reader.join();
+}
+
+TEST(RcuCellTest, concurrent_reads_and_updates)
+{
+  RcuCell<std::vector<int>> cell;
+  std::atomic<bool> stop(false);
+  std::atomic<int> bad(0);
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; ++r)
+  {
+    readers.emplace_back([&]() {
+      while (!stop)
+      {
+        const auto value = cell.read();
+        for (std::size_t i = 0; i < value->size(); ++i)
+        {
+          if ((*value)[i] != static_cast<int>(i))
+            ++bad;
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    cell.update([i](std::vector<int>& v) { v.push_back(i); });
+
+    if (i % 100 == 0)
+      cell.synchronize();
+  }
+
+  stop = true;
+  for (auto& t : readers)
+    t.join();
+
+  EXPECT_EQ(bad, 0);
+  EXPECT_EQ(cell.read()->size(), unsigned(1000));
+}
+
+}  // namespace soul
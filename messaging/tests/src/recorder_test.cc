@@ -0,0 +1,323 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message recorder test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/recorder.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+#include <zlib.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// HELPERS                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Make a codec for dummy messages.
+ * @return Codec that writes the string.
+ */
+static MessageCodec makeDummyCodec(void)
+{
+  MessageCodec codec;
+  codec.size = [](const MessageInterface& msg) { return static_cast<const DummyMessage&>(msg).str.size(); };
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    const auto& str = static_cast<const DummyMessage&>(msg).str;
+    std::memcpy(dst, str.data(), str.size());
+  };
+
+  return codec;
+}
+
+/** What a recording holds. */
+struct Recording
+{
+  std::map<std::uint32_t, std::string> topics;                ///< Topic names from the topic records.
+  std::vector<std::pair<std::string, std::string>> messages;  ///< Topic and message string, in file order.
+  std::vector<RecordingChunkHeader> chunks;                   ///< Chunk headers.
+  std::map<std::uint32_t, std::string> index_topics;          ///< Topic names from the index.
+  std::vector<RecordingIndexEntry> index;                     ///< Index entries.
+};
+
+/**
+ * @brief Read a recording of dummy messages.
+ * @param path File path.
+ * @return What the file holds.
+ */
+static Recording readRecording(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  const std::vector<std::uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  Recording recording;
+
+  RecordingFileHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  EXPECT_EQ(std::memcmp(header.magic, recording_magic_, sizeof(header.magic)), 0);
+  EXPECT_EQ(header.version, recording_version_);
+
+  RecordingTrailer trailer;
+  std::memcpy(&trailer, file.data() + file.size() - sizeof(trailer), sizeof(trailer));
+  EXPECT_EQ(std::memcmp(trailer.magic, recording_index_magic_, sizeof(trailer.magic)), 0);
+
+  auto records = [](const std::uint8_t* data, const std::size_t size, std::map<std::uint32_t, std::string>& topics,
+                    std::vector<std::pair<std::string, std::string>>& messages) {
+    std::size_t pos = 0;
+    while (pos < size)
+    {
+      RecordingRecordHeader record;
+      std::memcpy(&record, data + pos, sizeof(record));
+      const std::string payload(reinterpret_cast<const char*>(data + pos + sizeof(record)), record.size);
+
+      if (record.kind == static_cast<std::uint32_t>(RecordingRecordKind::topic))
+        topics[record.topic] = payload;
+      else
+        messages.emplace_back(topics.at(record.topic), payload);
+
+      pos += sizeof(record) + recordingAlign(record.size);
+    }
+  };
+
+  std::size_t pos = sizeof(header);
+  while (pos < trailer.index_offset)
+  {
+    RecordingChunkHeader chunk;
+    std::memcpy(&chunk, file.data() + pos, sizeof(chunk));
+    EXPECT_EQ(chunk.magic, recording_chunk_magic_);
+    recording.chunks.push_back(chunk);
+
+    std::vector<std::uint8_t> raw(file.data() + pos + sizeof(chunk),
+                                  file.data() + pos + sizeof(chunk) + chunk.stored_size);
+
+    if (chunk.compression == static_cast<std::uint32_t>(RecordingCompression::zlib))
+    {
+      std::vector<std::uint8_t> inflated(chunk.raw_size);
+      uLongf size = inflated.size();
+      EXPECT_EQ(uncompress(inflated.data(), &size, raw.data(), raw.size()), Z_OK);
+      raw = inflated;
+    }
+
+    EXPECT_EQ(raw.size(), chunk.raw_size);
+    records(raw.data(), raw.size(), recording.topics, recording.messages);
+
+    pos += sizeof(chunk) + recordingAlign(chunk.stored_size);
+  }
+
+  EXPECT_EQ(pos, trailer.index_offset);
+
+  RecordingIndexHeader index;
+  std::memcpy(&index, file.data() + pos, sizeof(index));
+  EXPECT_EQ(index.magic, recording_index_header_magic_);
+  pos += sizeof(index);
+
+  // The index only holds topic records.
+  std::vector<std::pair<std::string, std::string>> index_messages;
+
+  for (std::uint32_t i = 0; i < index.topics; ++i)
+  {
+    RecordingRecordHeader record;
+    std::memcpy(&record, file.data() + pos, sizeof(record));
+    const auto size = sizeof(record) + recordingAlign(record.size);
+
+    records(file.data() + pos, size, recording.index_topics, index_messages);
+    pos += size;
+  }
+
+  EXPECT_TRUE(index_messages.empty());
+
+  recording.index.resize(index.chunks);
+  std::memcpy(recording.index.data(), file.data() + pos, index.chunks * sizeof(RecordingIndexEntry));
+
+  return recording;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FIXTURE                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+class RecorderFixture : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    std::remove(path.c_str());
+  }
+
+  const std::string path = "recorder_test.rec";
+
+  MessageManager mgr;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST_F(RecorderFixture, full_queue_drops)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  // Hold the writer up in the codec so the queue fills.
+  std::promise<void> release;
+  auto released = release.get_future().share();
+
+  auto codec = makeDummyCodec();
+  const auto size = codec.size;
+  codec.size = [size, released](const MessageInterface& msg) {
+    released.wait();
+    return size(msg);
+  };
+
+  RecorderOptions options;
+  options.queue_capacity = 4;
+  MessageRecorder recorder(mgr, path, options);
+  recorder.record("test", codec);
+
+  for (int i = 0; i < 20; ++i)
+    mgr.send(topic, std::make_shared<DummyMessage>(std::to_string(i)));
+
+  mgr.notify();
+
+  // The writer has taken at most one message off the queue, which holds 4.
+  EXPECT_GE(recorder.getDropped(), unsigned(20 - 4 - 1));
+  EXPECT_EQ(recorder.queue_.capacity(), unsigned(4));
+
+  release.set_value();
+  recorder.close();
+
+  EXPECT_EQ(recorder.getRecorded() + recorder.getDropped(), unsigned(20));
+  EXPECT_EQ(readRecording(path).messages.size(), recorder.getRecorded());
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST_F(RecorderFixture, records_topics)
+{
+  auto a = mgr.publish("a", "plug1");
+  auto b = mgr.publish("b", "plug1");
+  mgr.publish("quiet", "plug1");
+
+  {
+    MessageRecorder recorder(mgr, path);
+    recorder.record("a", makeDummyCodec());
+    recorder.record("b", makeDummyCodec());
+    recorder.record("quiet", makeDummyCodec());
+
+    EXPECT_THROW(recorder.record("a", makeDummyCodec()), std::runtime_error);
+    EXPECT_THROW(recorder.record("c", MessageCodec()), std::runtime_error);
+
+    auto captured = std::make_shared<DummyMessage>("b0");
+    captured->timestamp = std::chrono::system_clock::time_point(std::chrono::seconds(1000));
+
+    mgr.send(a, std::make_shared<DummyMessage>("a0"));
+    mgr.send(b, captured);
+    mgr.send(a, std::make_shared<DummyMessage>("a1 is longer"));
+    mgr.notify();
+
+    recorder.close();
+    EXPECT_EQ(recorder.getRecorded(), unsigned(3));
+    EXPECT_EQ(recorder.getDropped(), unsigned(0));
+    EXPECT_THROW(recorder.record("d", makeDummyCodec()), std::runtime_error);
+  }
+
+  // The recorder is off the messaging system.
+  mgr.send(a, std::make_shared<DummyMessage>("late"));
+  mgr.notify();
+
+  const auto recording = readRecording(path);
+
+  // Topics only get a record in the chunks once they carry a message, but the index lists them all.
+  EXPECT_EQ(recording.topics.size(), unsigned(2));
+  EXPECT_EQ(recording.index_topics.size(), unsigned(3));
+  EXPECT_EQ(recording.index_topics.at(2), "quiet");
+
+  using Message = std::pair<std::string, std::string>;
+  EXPECT_THAT(recording.messages,
+              ::testing::UnorderedElementsAre(Message("a", "a0"), Message("a", "a1 is longer"), Message("b", "b0")));
+
+  ASSERT_EQ(recording.chunks.size(), unsigned(1));
+  ASSERT_EQ(recording.index.size(), unsigned(1));
+  EXPECT_EQ(recording.index[0].offset, sizeof(RecordingFileHeader));
+  EXPECT_EQ(recording.index[0].records, unsigned(5));
+
+  // The captured message is filed under its capture time.
+  EXPECT_EQ(recording.index[0].start_ns, 1000000000000);
+  EXPECT_GT(recording.index[0].end_ns, recording.index[0].start_ns);
+}
+
+TEST_F(RecorderFixture, compressed_chunks)
+{
+  auto topic = mgr.publish("test", "plug1");
+
+  RecorderOptions options;
+  options.chunk_size = 4096;
+  options.compression = RecordingCompression::zlib;
+
+  MessageRecorder recorder(mgr, path, options);
+  recorder.record("test", makeDummyCodec());
+
+  for (int i = 0; i < 100; ++i)
+  {
+    mgr.send(topic, std::make_shared<DummyMessage>(std::string(500, 'a' + i % 26)));
+    mgr.notify();
+  }
+
+  recorder.close();
+
+  const auto recording = readRecording(path);
+  ASSERT_EQ(recording.messages.size(), unsigned(100));
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(recording.messages[i].second, std::string(500, 'a' + i % 26));
+
+  EXPECT_GT(recording.chunks.size(), unsigned(1));
+  EXPECT_EQ(recording.index.size(), recording.chunks.size());
+
+  for (std::size_t i = 0; i < recording.chunks.size(); ++i)
+  {
+    EXPECT_EQ(recording.chunks[i].compression, static_cast<std::uint32_t>(RecordingCompression::zlib));
+    EXPECT_LT(recording.chunks[i].stored_size, recording.chunks[i].raw_size);
+    EXPECT_EQ(recording.index[i].start_ns, recording.chunks[i].start_ns);
+
+    if (i > 0)
+    {
+      EXPECT_GE(recording.index[i].start_ns, recording.index[i - 1].end_ns);
+    }
+  }
+}
+
+TEST_F(RecorderFixture, unwritable_file_throws)
+{
+  EXPECT_THROW(MessageRecorder(mgr, "/nonexistent/dir/recording.rec"), std::runtime_error);
+}
+
+}  // namespace soul
@@ -0,0 +1,451 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message replay test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/replay.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// HELPERS                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Message decoded in place from a recording. */
+struct LeasedMessage : public MessageInterface
+{
+  const std::uint8_t* data = nullptr;             ///< Payload.
+  std::size_t size = 0;                           ///< Payload size.
+  std::shared_ptr<const void> lease;              ///< Keeps the payload around.
+  std::chrono::steady_clock::time_point decoded;  ///< When the replay decoded it.
+};
+
+/**
+ * @brief Make a codec that writes dummy messages and reads them back without copying.
+ * @return Codec.
+ */
+static MessageCodec makeCodec(void)
+{
+  MessageCodec codec;
+  codec.size = [](const MessageInterface& msg) { return static_cast<const DummyMessage&>(msg).str.size(); };
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    const auto& str = static_cast<const DummyMessage&>(msg).str;
+    std::memcpy(dst, str.data(), str.size());
+  };
+  codec.decode = [](const std::uint8_t* src, const std::size_t size, std::shared_ptr<const void> lease) {
+    auto msg = std::make_shared<LeasedMessage>();
+    msg->data = src;
+    msg->size = size;
+    msg->lease = std::move(lease);
+    msg->decoded = std::chrono::steady_clock::now();
+    return msg;
+  };
+
+  return codec;
+}
+
+/**
+ * @brief Get a capture time.
+ * @param ms Milliseconds since the epoch.
+ * @return Time point.
+ */
+static std::chrono::system_clock::time_point at(const std::int64_t ms)
+{
+  return std::chrono::system_clock::time_point(std::chrono::milliseconds(ms));
+}
+
+/** A message the replay delivered. */
+struct Played
+{
+  std::string msg_id;                               ///< Topic.
+  std::string str;                                  ///< Payload.
+  std::chrono::system_clock::time_point timestamp;  ///< Capture time.
+  std::chrono::steady_clock::time_point decoded;    ///< When it was decoded.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FIXTURE                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+class ReplayFixture : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    std::remove(path.c_str());
+  }
+
+  /**
+   * @brief Record messages, each sent on its own.
+   * @param messages Topic, payload and capture time of each message.
+   * @param options Recorder configuration.
+   */
+  void record(const std::vector<std::tuple<std::string, std::string, std::int64_t>>& messages,
+              const RecorderOptions& options = RecorderOptions())
+  {
+    MessageManager source;
+    MessageRecorder recorder(source, path, options);
+    std::map<std::string, TopicHandle> topics;
+
+    for (const auto& message : messages)
+    {
+      const auto& msg_id = std::get<0>(message);
+      if (topics.count(msg_id) == 0)
+      {
+        topics[msg_id] = source.publish(msg_id, "plug1");
+        recorder.record(msg_id, makeCodec());
+      }
+
+      auto msg = std::make_shared<DummyMessage>(std::get<1>(message));
+      msg->timestamp = at(std::get<2>(message));
+      source.send(topics[msg_id], msg);
+      source.notify();
+    }
+
+    recorder.close();
+  }
+
+  /**
+   * @brief Collect what gets delivered on a topic.
+   * @param msg_id Topic.
+   */
+  void collect(const std::string& msg_id)
+  {
+    mgr.subscribe(msg_id, "sub1", [this, msg_id](std::shared_ptr<MessageInterface> msg) {
+      const auto& leased = static_cast<const LeasedMessage&>(*msg);
+      played.push_back({ msg_id, std::string(reinterpret_cast<const char*>(leased.data), leased.size),
+                         leased.timestamp, leased.decoded });
+    });
+  }
+
+  /**
+   * @brief Get the payloads delivered so far.
+   * @return Payloads in delivery order.
+   */
+  std::vector<std::string> getPlayed(void) const
+  {
+    std::vector<std::string> strs;
+    for (const auto& p : played)
+      strs.push_back(p.str);
+
+    return strs;
+  }
+
+  const std::string path = "replay_test.rec";
+
+  MessageManager mgr;
+
+  std::vector<Played> played;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST_F(ReplayFixture, payloads_are_read_in_place)
+{
+  record({ { "a", "plain", 1000 } });
+
+  {
+    RecordingReader reader(path);
+    const auto records = reader.readChunk(0);
+    ASSERT_EQ(records.size(), unsigned(1));
+
+    // Uncompressed payloads point into the mapping and hold it.
+    EXPECT_EQ(records[0].lease, reader.mapping_);
+    EXPECT_GE(records[0].payload, reader.data_);
+    EXPECT_LT(records[0].payload, reader.data_ + reader.size_);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(records[0].payload) % recording_alignment_, 0u);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(records[0].payload), records[0].header.size), "plain");
+  }
+
+  RecorderOptions options;
+  options.compression = RecordingCompression::zlib;
+  record({ { "a", std::string(1000, 'z'), 1000 } }, options);
+
+  RecordingReader compressed(path);
+  const auto inflated = compressed.readChunk(0);
+  ASSERT_EQ(inflated.size(), unsigned(1));
+  EXPECT_NE(inflated[0].lease, compressed.mapping_);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(inflated[0].payload), inflated[0].header.size),
+            std::string(1000, 'z'));
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST_F(ReplayFixture, plays_recorded_topics)
+{
+  record({ { "a", "a0", 1000 }, { "b", "b0", 1001 }, { "c", "c0", 1002 }, { "a", "a1", 1003 }, { "b", "b1", 1004 } });
+
+  auto reader = std::make_shared<RecordingReader>(path);
+  EXPECT_TRUE(reader->hasIndex());
+  EXPECT_THAT(reader->getTopics(), ::testing::ElementsAre("a", "b", "c"));
+
+  ReplayOptions options;
+  options.speed = 0;
+  MessageReplay replay(mgr, reader, options);
+
+  replay.play("a", makeCodec());
+  replay.play("b", makeCodec());
+  EXPECT_THROW(replay.play("a", makeCodec()), std::runtime_error);
+  EXPECT_THROW(replay.play("d", makeCodec()), std::runtime_error);
+  EXPECT_THROW(replay.play("c", MessageCodec()), std::runtime_error);
+
+  collect("a");
+  collect("b");
+  collect("c");
+
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+
+  // Only the played topics are sent, with their original capture times.
+  EXPECT_EQ(replay.getPlayed(), unsigned(4));
+  ASSERT_EQ(played.size(), unsigned(4));
+  EXPECT_THAT(getPlayed(), ::testing::UnorderedElementsAre("a0", "b0", "a1", "b1"));
+
+  for (const auto& p : played)
+  {
+    const std::int64_t ms = p.str == "a0" ? 1000 : p.str == "b0" ? 1001 : p.str == "a1" ? 1003 : 1004;
+    EXPECT_EQ(p.timestamp, at(ms)) << p.str;
+    EXPECT_EQ(p.msg_id, p.str.substr(0, 1));
+  }
+}
+
+TEST_F(ReplayFixture, plays_compressed_recording)
+{
+  std::vector<std::tuple<std::string, std::string, std::int64_t>> messages;
+  std::vector<std::string> strs;
+
+  for (int i = 0; i < 100; ++i)
+  {
+    strs.push_back(std::string(500, 'a' + i % 26));
+    messages.emplace_back("test", strs.back(), 1000 + i);
+  }
+
+  RecorderOptions recorder_options;
+  recorder_options.chunk_size = 4096;
+  recorder_options.compression = RecordingCompression::zlib;
+  record(messages, recorder_options);
+
+  auto reader = std::make_shared<RecordingReader>(path);
+  EXPECT_GT(reader->getChunks().size(), unsigned(1));
+
+  ReplayOptions options;
+  options.speed = 0;
+  MessageReplay replay(mgr, reader, options);
+  replay.play("test", makeCodec());
+  collect("test");
+
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+
+  EXPECT_EQ(getPlayed(), strs);
+}
+
+TEST_F(ReplayFixture, paces_by_capture_time)
+{
+  record({ { "test", "0", 1000 }, { "test", "1", 1020 }, { "test", "2", 1040 }, { "test", "3", 1060 } });
+
+  MessageReplay replay(mgr, std::make_shared<RecordingReader>(path));
+  replay.play("test", makeCodec());
+  collect("test");
+
+  EXPECT_THROW(replay.setSpeed(-1), std::runtime_error);
+
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+
+  ASSERT_EQ(played.size(), unsigned(4));
+  EXPECT_GE(played[3].decoded - played[0].decoded, std::chrono::milliseconds(55));
+
+  // Twice as fast takes half as long.
+  played.clear();
+  replay.setSpeed(2);
+  replay.seek(0);
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+
+  ASSERT_EQ(played.size(), unsigned(4));
+  EXPECT_GE(played[3].decoded - played[0].decoded, std::chrono::milliseconds(25));
+}
+
+TEST_F(ReplayFixture, seeks_by_time)
+{
+  std::vector<std::tuple<std::string, std::string, std::int64_t>> messages;
+  for (int i = 0; i < 10; ++i)
+    messages.emplace_back("test", std::to_string(i), 1000 * (i + 1));
+
+  // A chunk per message.
+  RecorderOptions recorder_options;
+  recorder_options.chunk_size = 32;
+  record(messages, recorder_options);
+
+  auto reader = std::make_shared<RecordingReader>(path);
+  ASSERT_EQ(reader->getChunks().size(), unsigned(10));
+  EXPECT_EQ(reader->findChunk(0), unsigned(0));
+  EXPECT_EQ(reader->findChunk(5500000000), unsigned(5));
+  EXPECT_EQ(reader->findChunk(6000000000), unsigned(5));
+  EXPECT_EQ(reader->findChunk(20000000000), unsigned(10));
+
+  ReplayOptions options;
+  options.speed = 0;
+  MessageReplay replay(mgr, reader, options);
+  replay.play("test", makeCodec());
+  collect("test");
+
+  replay.seek(5500000000);
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_THAT(getPlayed(), ::testing::ElementsAre("5", "6", "7", "8", "9"));
+
+  // Past the end there is nothing to play.
+  played.clear();
+  replay.seek(20000000000);
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_TRUE(played.empty());
+
+  replay.seek(9000000000);
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_THAT(getPlayed(), ::testing::ElementsAre("8", "9"));
+}
+
+TEST_F(ReplayFixture, seeks_within_a_chunk)
+{
+  std::vector<std::tuple<std::string, std::string, std::int64_t>> messages;
+  for (int i = 0; i < 10; ++i)
+    messages.emplace_back("test", std::to_string(i), 1000 * (i + 1));
+
+  record(messages);
+
+  auto reader = std::make_shared<RecordingReader>(path);
+  ASSERT_EQ(reader->getChunks().size(), unsigned(1));
+
+  ReplayOptions options;
+  options.speed = 0;
+  MessageReplay replay(mgr, reader, options);
+  replay.play("test", makeCodec());
+  collect("test");
+
+  replay.seek(7000000000);
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_THAT(getPlayed(), ::testing::ElementsAre("6", "7", "8", "9"));
+}
+
+TEST_F(ReplayFixture, stops_and_resumes)
+{
+  // A second between messages, so playback at real time stops after the first one.
+  std::vector<std::tuple<std::string, std::string, std::int64_t>> messages;
+  for (int i = 0; i < 5; ++i)
+    messages.emplace_back("test", std::to_string(i), 1000 * (i + 1));
+
+  record(messages);
+
+  MessageReplay replay(mgr, std::make_shared<RecordingReader>(path));
+  replay.play("test", makeCodec());
+  collect("test");
+
+  replay.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  replay.stop();
+  EXPECT_FALSE(replay.wait());
+  EXPECT_EQ(replay.getPlayed(), unsigned(1));
+
+  // Nothing is lost or sent twice.
+  replay.setSpeed(0);
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_THAT(getPlayed(), ::testing::ElementsAre("0", "1", "2", "3", "4"));
+}
+
+TEST_F(ReplayFixture, reads_recording_without_index)
+{
+  std::vector<std::tuple<std::string, std::string, std::int64_t>> messages;
+  for (int i = 0; i < 10; ++i)
+    messages.emplace_back(i % 2 ? "odd" : "even", std::to_string(i), 1000 + i);
+
+  RecorderOptions recorder_options;
+  recorder_options.chunk_size = 32;
+  record(messages, recorder_options);
+
+  // Cut the file in the middle of the last chunk, as a crash would.
+  {
+    RecordingReader reader(path);
+    ASSERT_EQ(reader.getChunks().size(), unsigned(10));
+    ASSERT_EQ(truncate(path.c_str(), reader.getChunks().back().offset + 40), 0);
+  }
+
+  auto reader = std::make_shared<RecordingReader>(path);
+  EXPECT_FALSE(reader->hasIndex());
+  EXPECT_THAT(reader->getTopics(), ::testing::ElementsAre("even", "odd"));
+  EXPECT_EQ(reader->getChunks().size(), unsigned(9));
+
+  ReplayOptions options;
+  options.speed = 0;
+  MessageReplay replay(mgr, reader, options);
+  replay.play("even", makeCodec());
+  replay.play("odd", makeCodec());
+  collect("even");
+  collect("odd");
+
+  replay.start();
+  EXPECT_TRUE(replay.wait());
+  mgr.notify();
+  EXPECT_EQ(played.size(), unsigned(9));
+}
+
+TEST_F(ReplayFixture, bad_files_throw)
+{
+  EXPECT_THROW(RecordingReader("/nonexistent/dir/recording.rec"), std::runtime_error);
+
+  {
+    std::ofstream out(path);
+    out << "definitely not a recording";
+  }
+
+  EXPECT_THROW(RecordingReader reader(path), std::runtime_error);
+}
+
+}  // namespace soul
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Ring buffer test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/ring_buffer.h>
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(RingBufferTest, slots_padded)
+{
+  EXPECT_EQ(alignof(RingBuffer<int>::Slot), cache_line_size_);
+  EXPECT_EQ(sizeof(RingBuffer<int>::Slot), cache_line_size_);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(RingBufferTest, capacity_rounded)
+{
+  RingBuffer<int> ring(1000);
+  EXPECT_EQ(ring.capacity(), unsigned(1024));
+
+  RingBuffer<int> tiny(0);
+  EXPECT_EQ(tiny.capacity(), unsigned(2));
+}
+
+TEST(RingBufferTest, fifo)
+{
+  RingBuffer<int> ring(8);
+
+  for (int i = 0; i < 8; ++i)
+    EXPECT_TRUE(ring.tryPush(i));
+
+  EXPECT_EQ(ring.size(), unsigned(8));
+
+  int value = -1;
+  for (int i = 0; i < 8; ++i)
+  {
+    ASSERT_TRUE(ring.tryPop(value));
+    EXPECT_EQ(value, i);
+  }
+
+  EXPECT_TRUE(ring.empty());
+  EXPECT_FALSE(ring.tryPop(value));
+}
+
+TEST(RingBufferTest, full)
+{
+  RingBuffer<std::shared_ptr<int>> ring(2);
+
+  EXPECT_TRUE(ring.tryPush(std::make_shared<int>(1)));
+  EXPECT_TRUE(ring.tryPush(std::make_shared<int>(2)));
+
+  // A failed push must leave the element alone.
+  auto third = std::make_shared<int>(3);
+  EXPECT_FALSE(ring.tryPush(std::move(third)));
+  ASSERT_TRUE(third != nullptr);
+
+  std::shared_ptr<int> value;
+  EXPECT_TRUE(ring.tryPop(value));
+  EXPECT_EQ(*value, 1);
+  EXPECT_TRUE(ring.tryPush(std::move(third)));
+}
+
+TEST(RingBufferTest, pop_releases_element)
+{
+  RingBuffer<std::shared_ptr<int>> ring(4);
+  auto element = std::make_shared<int>(1);
+  std::weak_ptr<int> watcher = element;
+
+  EXPECT_TRUE(ring.tryPush(std::move(element)));
+
+  {
+    std::shared_ptr<int> value;
+    EXPECT_TRUE(ring.tryPop(value));
+  }
+
+  EXPECT_TRUE(watcher.expired());
+}
+
+TEST(RingBufferTest, multi_producer)
+{
+  const int producers = 4;
+  const int per_producer = 20000;
+
+  RingBuffer<int> ring(64);
+  std::vector<std::thread> threads;
+
+  for (int p = 0; p < producers; ++p)
+  {
+    threads.emplace_back([&ring, p, per_producer]() {
+      for (int i = 0; i < per_producer; ++i)
+      {
+        while (!ring.tryPush(p * per_producer + i))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // Each producer's elements must come out in the order they went in.
+  std::vector<int> last(producers, -1);
+  int received = 0;
+  int value = 0;
+
+  while (received < producers * per_producer)
+  {
+    if (!ring.tryPop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    const int producer = value / per_producer;
+    EXPECT_GT(value, last[producer]);
+    last[producer] = value;
+    ++received;
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  EXPECT_TRUE(ring.empty());
+}
+
+}  // namespace soul
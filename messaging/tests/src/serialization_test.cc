@@ -0,0 +1,262 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message serialization test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/serialization.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace test
+{
+///////////////////////////////////////////////////////////////////////////////
+// HELPERS                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Serializable test message. */
+struct Sample : public MessageInterface
+{
+  std::int32_t id = 0;         ///< Scalar.
+  std::string name;            ///< String.
+  std::vector<double> values;  ///< Array.
+};
+
+/**
+ * @brief Write a sample.
+ * @param writer Writer.
+ * @param sample Sample.
+ */
+void serializeFields(SerialWriter& writer, const Sample& sample)
+{
+  writer.write(sample.id);
+  writer.writeString(sample.name);
+  writer.writeArray(sample.values.data(), sample.values.size());
+}
+
+/**
+ * @brief Read a sample.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Sample.
+ */
+Sample deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Sample>)
+{
+  (void)version;
+
+  Sample sample;
+  sample.id = reader.read<std::int32_t>();
+  sample.name = reader.readString();
+  sample.values = reader.readArray<double>().toVector();
+  return sample;
+}
+
+/**
+ * @brief Make a sample.
+ * @param id Scalar, also the number of values.
+ * @return Sample.
+ */
+Sample makeSample(const std::int32_t id)
+{
+  Sample sample;
+  sample.id = id;
+  sample.name = "sample " + std::to_string(id);
+  for (std::int32_t i = 0; i < id; ++i)
+    sample.values.push_back(i * 0.5);
+
+  return sample;
+}
+
+/**
+ * @brief Encode a message with a codec.
+ * @param codec Codec.
+ * @param msg Message.
+ * @param size Receives the encoded size.
+ * @return Encoded message, in a buffer aligned like the messaging system's.
+ */
+std::vector<std::uint64_t> encode(const MessageCodec& codec, const MessageInterface& msg, std::size_t& size)
+{
+  size = codec.size(msg);
+  std::vector<std::uint64_t> buffer((size + 7) / 8);
+  codec.encode(msg, reinterpret_cast<std::uint8_t*>(buffer.data()));
+  return buffer;
+}
+
+}  // namespace test
+
+template <>
+struct SerialSchema<test::Sample>
+{
+  static constexpr std::uint32_t type = 0x7f;  ///< Type number.
+  static constexpr std::uint32_t version = 2;  ///< Layout version.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(SerializationTest, layout_is_fixed)
+{
+  auto sample = test::makeSample(3);
+  sample.name = "abc";
+
+  SerialWriter measure;
+  serializeMessage(measure, sample);
+
+  // Schema, id, name, count, padding to 8, values.
+  const std::size_t expected = 8 + 4 + 4 + 3 + 8 + 5 + 3 * sizeof(double);
+  ASSERT_EQ(measure.size(), expected);
+
+  std::vector<std::uint8_t> buffer(expected, 0xff);
+  SerialWriter writer(buffer.data());
+  serializeMessage(writer, sample);
+  EXPECT_EQ(writer.size(), expected);
+
+  const std::uint8_t start[] = { 0x7f, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0, 3, 0, 0, 0,  // schema, id, name length
+                                 'a',  'b', 'c', 3, 0, 0, 0, 0, 0, 0, 0 };           // name, count
+  EXPECT_EQ(std::memcmp(buffer.data(), start, sizeof(start)), 0);
+
+  // Padding is zeroed and the values start on an aligned offset.
+  for (std::size_t i = sizeof(start); i < 32; ++i)
+    EXPECT_EQ(buffer[i], 0) << i;
+
+  double first;
+  std::memcpy(&first, buffer.data() + 32, sizeof(first));
+  EXPECT_EQ(first, 0.0);
+}
+
+TEST(SerializationTest, round_trips_and_views_in_place)
+{
+  const auto codec = makeSerialCodec<test::Sample>();
+  const auto sample = test::makeSample(5);
+
+  std::size_t size = 0;
+  const auto buffer = test::encode(codec, sample, size);
+  const auto* src = reinterpret_cast<const std::uint8_t*>(buffer.data());
+
+  // The lease lives as long as the decoded message.
+  auto lease = std::make_shared<int>(0);
+  std::weak_ptr<int> lease_ref = lease;
+
+  auto msg = codec.decode(src, size, std::move(lease));
+  const auto& decoded = static_cast<const test::Sample&>(*msg);
+  EXPECT_EQ(decoded.id, 5);
+  EXPECT_EQ(decoded.name, "sample 5");
+  EXPECT_EQ(decoded.values, sample.values);
+
+  EXPECT_FALSE(lease_ref.expired());
+  msg.reset();
+  EXPECT_TRUE(lease_ref.expired());
+
+  // Arrays can be looked at without copying them.
+  SerialReader reader(src, size);
+  reader.readSchema(SerialSchema<test::Sample>::type, SerialSchema<test::Sample>::version);
+  reader.read<std::int32_t>();
+  reader.readString();
+
+  const auto view = reader.readArray<double>();
+  ASSERT_EQ(view.size(), unsigned(5));
+  EXPECT_GE(reinterpret_cast<const std::uint8_t*>(view.data()), src);
+  EXPECT_LT(reinterpret_cast<const std::uint8_t*>(view.data()), src + size);
+  EXPECT_EQ(view.data()[4], 2.0);
+  EXPECT_EQ(view.at(3), 1.5);
+  EXPECT_EQ(reader.remaining(), unsigned(0));
+}
+
+TEST(SerializationTest, lists_round_trip)
+{
+  const auto codec = makeSerialCodec<ListMessage<test::Sample>>();
+  const ListMessage<test::Sample> list({ test::makeSample(0), test::makeSample(1), test::makeSample(7) });
+
+  std::size_t size = 0;
+  const auto buffer = test::encode(codec, list, size);
+
+  auto msg = codec.decode(reinterpret_cast<const std::uint8_t*>(buffer.data()), size, nullptr);
+  const auto& items = static_cast<const ListMessage<test::Sample>&>(*msg).getItems();
+  ASSERT_EQ(items.size(), unsigned(3));
+
+  for (std::size_t i = 0; i < items.size(); ++i)
+  {
+    EXPECT_EQ(items[i].id, list.getItems()[i].id);
+    EXPECT_EQ(items[i].name, list.getItems()[i].name);
+    EXPECT_EQ(items[i].values, list.getItems()[i].values);
+  }
+
+  // A list is a different type from its items.
+  EXPECT_THROW(makeSerialCodec<test::Sample>().decode(reinterpret_cast<const std::uint8_t*>(buffer.data()), size,
+                                                       nullptr),
+               std::runtime_error);
+}
+
+TEST(SerializationTest, malformed_messages_throw)
+{
+  const auto codec = makeSerialCodec<test::Sample>();
+
+  std::size_t size = 0;
+  auto buffer = test::encode(codec, test::makeSample(4), size);
+  auto* src = reinterpret_cast<std::uint8_t*>(buffer.data());
+
+  // Every truncation is caught.
+  for (std::size_t cut = 0; cut < size; ++cut)
+    EXPECT_THROW(codec.decode(src, cut, nullptr), std::runtime_error) << cut;
+
+  // Newer layouts than the decoder knows are refused, older ones are read.
+  src[4] = 3;
+  EXPECT_THROW(codec.decode(src, size, nullptr), std::runtime_error);
+  src[4] = 1;
+  EXPECT_NO_THROW(codec.decode(src, size, nullptr));
+
+  // So are array sizes that can't be right.
+  src[4] = 2;
+  const std::uint64_t huge = std::uint64_t(1) << 60;
+  std::memcpy(src + 8 + 4 + 4 + std::strlen("sample 4"), &huge, sizeof(huge));
+  EXPECT_THROW(codec.decode(src, size, nullptr), std::runtime_error);
+}
+
+TEST(SerializationTest, registry_dispatches_by_type)
+{
+  SerialCodecRegistry registry;
+  registry.addWithList<test::Sample>();
+
+  const auto codec = registry.makeCodec();
+  const auto sample = test::makeSample(2);
+  const ListMessage<test::Sample> list({ test::makeSample(1) });
+
+  std::size_t size = 0;
+  auto buffer = test::encode(codec, sample, size);
+  auto msg = codec.decode(reinterpret_cast<const std::uint8_t*>(buffer.data()), size, nullptr);
+  EXPECT_NE(dynamic_cast<const test::Sample*>(msg.get()), nullptr);
+
+  buffer = test::encode(codec, list, size);
+  msg = codec.decode(reinterpret_cast<const std::uint8_t*>(buffer.data()), size, nullptr);
+  EXPECT_NE(dynamic_cast<const ListMessage<test::Sample>*>(msg.get()), nullptr);
+
+  EXPECT_EQ(registry.find(DummyMessage("unknown")), nullptr);
+  EXPECT_THROW(codec.size(DummyMessage("unknown")), std::runtime_error);
+
+  const std::uint8_t unknown[8] = { 1, 0, 0, 0, 1, 0, 0, 0 };
+  EXPECT_THROW(codec.decode(unknown, sizeof(unknown), nullptr), std::runtime_error);
+}
+
+}  // namespace soul
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Shared memory transport test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/shm_transport.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/**
+ * @brief Codec that stores DummyMessage::str as raw bytes. Decoded messages hold their slot until deleted.
+ * @return The codec.
+ */
+ShmCodec makeStringCodec(void)
+{
+  ShmCodec codec;
+
+  codec.size = [](const MessageInterface& msg) { return static_cast<const DummyMessage&>(msg).str.size(); };
+
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    const auto& str = static_cast<const DummyMessage&>(msg).str;
+    std::memcpy(dst, str.data(), str.size());
+  };
+
+  codec.decode = [](const std::uint8_t* src, const std::size_t size, std::shared_ptr<const void> lease) {
+    auto* msg = new DummyMessage(std::string(reinterpret_cast<const char*>(src), size));
+    return std::shared_ptr<MessageInterface>(msg, [lease](MessageInterface* p) { delete p; });
+  };
+
+  return codec;
+}
+
+/**
+ * @brief Get a channel name no other test run is using.
+ * @param name Test specific part of the name.
+ * @return Channel name.
+ */
+std::string channelName(const std::string& name)
+{
+  return "soul_test." + std::to_string(getpid()) + "." + name;
+}
+
+/**
+ * @brief Get the string out of a received message.
+ * @param msg Message.
+ * @return Message string.
+ */
+std::string str(const std::shared_ptr<MessageInterface>& msg)
+{
+  return std::dynamic_pointer_cast<DummyMessage>(msg)->str;
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(ShmChannelTest, oversized_slot_rejected)
+{
+  ShmChannelOptions options;
+  options.slot_count = 1;
+  options.slot_size = 64;
+
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("bad_size"), options);
+  auto consumer = ShmChannel::open(channelName("bad_size"), std::chrono::milliseconds(100));
+  ASSERT_NE(consumer, nullptr);
+
+  // A broken producer claims more bytes than the slot holds.
+  ASSERT_TRUE(producer->write(DummyMessage("hello"), codec));
+  producer->sizes_[0] = 1 << 30;
+  EXPECT_THROW(consumer->read(codec, std::chrono::milliseconds(100)), std::runtime_error);
+
+  // The slot went back to the producer.
+  ASSERT_TRUE(producer->write(DummyMessage("again"), codec));
+  EXPECT_EQ(str(consumer->read(codec, std::chrono::milliseconds(100))), "again");
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(ShmChannelTest, round_trip)
+{
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("round_trip"), ShmChannelOptions());
+  auto consumer = ShmChannel::open(channelName("round_trip"), std::chrono::milliseconds(100));
+  ASSERT_NE(consumer, nullptr);
+  EXPECT_TRUE(consumer->isProducerAlive());
+
+  EXPECT_TRUE(producer->write(DummyMessage("hello"), codec));
+  EXPECT_TRUE(producer->write(DummyMessage("world"), codec));
+
+  EXPECT_EQ(str(consumer->read(codec, std::chrono::milliseconds(100))), "hello");
+  EXPECT_EQ(str(consumer->read(codec, std::chrono::milliseconds(100))), "world");
+  EXPECT_EQ(consumer->read(codec, std::chrono::milliseconds(10)), nullptr);
+}
+
+TEST(ShmChannelTest, open_times_out_without_producer)
+{
+  EXPECT_EQ(ShmChannel::open(channelName("missing"), std::chrono::milliseconds(20)), nullptr);
+}
+
+TEST(ShmChannelTest, invalid_name_throws)
+{
+  EXPECT_THROW(ShmChannel::create("a/b", ShmChannelOptions()), std::runtime_error);
+  EXPECT_THROW(ShmChannel::create("", ShmChannelOptions()), std::runtime_error);
+}
+
+TEST(ShmChannelTest, drops_when_no_slot_is_free)
+{
+  ShmChannelOptions options;
+  options.slot_count = 2;
+  options.slot_size = 64;
+
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("drop"), options);
+  auto consumer = ShmChannel::open(channelName("drop"), std::chrono::milliseconds(100));
+  ASSERT_NE(consumer, nullptr);
+
+  EXPECT_TRUE(producer->write(DummyMessage("0"), codec));
+  EXPECT_TRUE(producer->write(DummyMessage("1"), codec));
+  EXPECT_FALSE(producer->write(DummyMessage("2"), codec));
+  EXPECT_EQ(producer->getDropped(), uint64_t(1));
+  EXPECT_EQ(consumer->getDropped(), uint64_t(1));
+}
+
+TEST(ShmChannelTest, slots_recycled_when_message_released)
+{
+  ShmChannelOptions options;
+  options.slot_count = 1;
+  options.slot_size = 64;
+
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("recycle"), options);
+  auto consumer = ShmChannel::open(channelName("recycle"), std::chrono::milliseconds(100));
+  ASSERT_NE(consumer, nullptr);
+
+  for (int i = 0; i < 10; ++i)
+  {
+    ASSERT_TRUE(producer->write(DummyMessage(std::to_string(i)), codec));
+
+    auto msg = consumer->read(codec, std::chrono::milliseconds(100));
+    ASSERT_NE(msg, nullptr);
+    EXPECT_EQ(str(msg), std::to_string(i));
+
+    // The only slot is still leased.
+    EXPECT_FALSE(producer->write(DummyMessage("x"), codec));
+  }
+
+  EXPECT_EQ(producer->getDropped(), uint64_t(10));
+}
+
+TEST(ShmChannelTest, blocked_write_waits_for_slot)
+{
+  ShmChannelOptions options;
+  options.slot_count = 1;
+  options.slot_size = 64;
+  options.block_timeout = std::chrono::milliseconds(2000);
+
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("block"), options);
+  auto consumer = ShmChannel::open(channelName("block"), std::chrono::milliseconds(100));
+  ASSERT_NE(consumer, nullptr);
+
+  ASSERT_TRUE(producer->write(DummyMessage("0"), codec));
+  auto msg = consumer->read(codec, std::chrono::milliseconds(100));
+
+  std::thread t([&msg]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    msg.reset();
+  });
+
+  EXPECT_TRUE(producer->write(DummyMessage("1"), codec));
+  t.join();
+  EXPECT_EQ(str(consumer->read(codec, std::chrono::milliseconds(100))), "1");
+}
+
+TEST(ShmChannelTest, oversized_message_throws)
+{
+  ShmChannelOptions options;
+  options.slot_count = 1;
+  options.slot_size = 4;
+
+  const auto codec = makeStringCodec();
+  auto producer = ShmChannel::create(channelName("oversize"), options);
+
+  EXPECT_THROW(producer->write(DummyMessage("too long"), codec), std::runtime_error);
+
+  // The slot was handed back.
+  EXPECT_TRUE(producer->write(DummyMessage("ok"), codec));
+}
+
+TEST(ShmPublisherTest, unknown_msg_id_throws)
+{
+  ShmPublisher publisher(channelName("pub"));
+  auto sender = publisher.getSender();
+
+  EXPECT_THROW(sender("unknown", "plugin", std::make_shared<DummyMessage>("x")), std::runtime_error);
+}
+
+TEST(ShmTransportTest, between_processes)
+{
+  const int num_msgs = 200;
+  const auto prefix = channelName("fork");
+
+  int done[2];
+  ASSERT_EQ(pipe(done), 0);
+
+  const pid_t child = fork();
+  ASSERT_GE(child, 0);
+
+  if (child == 0)
+  {
+    // Producer process. Blocks on slots, so the consumer sets the pace.
+    ShmChannelOptions options;
+    options.slot_count = 4;
+    options.slot_size = 64;
+    options.block_timeout = std::chrono::milliseconds(5000);
+
+    ShmPublisher publisher(prefix);
+    publisher.addTopic("str", makeStringCodec(), options);
+    auto sender = publisher.getSender();
+
+    for (int i = 0; i < num_msgs; ++i)
+      sender("str", "producer", std::make_shared<DummyMessage>(std::to_string(i)));
+
+    // Keep the channel around until the consumer has everything.
+    char c;
+    (void)!read(done[0], &c, 1);
+    _exit(publisher.getDropped("str") == 0 ? 0 : 1);
+  }
+
+  std::vector<std::string> received;
+  std::atomic<int> count(0);
+
+  {
+    ShmSubscriber subscriber(prefix);
+    subscriber.subscribe("str", makeStringCodec(), [&](std::shared_ptr<MessageInterface> msg) {
+      received.push_back(str(msg));
+      ++count;
+    });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (count < num_msgs && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  (void)!write(done[1], "x", 1);
+
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+
+  close(done[0]);
+  close(done[1]);
+
+  ASSERT_EQ(received.size(), size_t(num_msgs));
+  for (int i = 0; i < num_msgs; ++i)
+    EXPECT_EQ(received[i], std::to_string(i));
+}
+
+}  // namespace soul
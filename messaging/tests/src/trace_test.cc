@@ -0,0 +1,170 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message trace test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/trace.h>
+#include "dummy_msg.h"
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE TESTS                                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef HR_DEBUG
+
+TEST(MessageTracerTest, full_tracer_counts_drops)
+{
+  MessageTracer tracer(2);
+  DummyMessage msg("Hi");
+
+  for (int i = 0; i < 5; ++i)
+    tracer.traceEnqueue("test", "plug1", msg);
+
+  EXPECT_EQ(tracer.events_.size(), unsigned(2));
+  EXPECT_EQ(tracer.getDropped(), unsigned(3));
+
+  tracer.clear();
+  EXPECT_TRUE(tracer.getEvents().empty());
+  EXPECT_EQ(tracer.getDropped(), unsigned(0));
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(MessageTracerTest, trace_ids)
+{
+  MessageTracer tracer;
+
+  // Every message starts its own trace.
+  DummyMessage first("a"), second("b");
+  tracer.traceEnqueue("test", "plug1", first);
+  tracer.traceEnqueue("test", "plug1", second);
+
+  EXPECT_NE(first.trace_id, unsigned(0));
+  EXPECT_NE(first.trace_id, second.trace_id);
+
+  // Sending again keeps the trace.
+  const auto id = first.trace_id;
+  tracer.traceEnqueue("other", "plug2", first);
+  EXPECT_EQ(first.trace_id, id);
+
+  // Unrelated messages with the same capture time, e.g., from two cameras, stay on separate traces.
+  DummyMessage left("left"), right("right");
+  left.timestamp = right.timestamp = std::chrono::system_clock::now();
+  tracer.traceEnqueue("left", "camera1", left);
+  tracer.traceEnqueue("right", "camera2", right);
+
+  EXPECT_NE(left.trace_id, right.trace_id);
+
+  // Messages derived from another share its trace.
+  DummyMessage detection("detection"), encoding("encoding");
+  inheritTrace(detection, left);
+  tracer.traceEnqueue("faces", "detector", detection);
+  inheritTrace(encoding, detection);
+
+  EXPECT_EQ(detection.trace_id, left.trace_id);
+  EXPECT_EQ(encoding.trace_id, left.trace_id);
+  EXPECT_EQ(encoding.timestamp, left.timestamp);
+
+  // The capture time goes on the events separately.
+  const auto events = tracer.getEvents();
+  ASSERT_EQ(events.size(), unsigned(6));
+  EXPECT_EQ(events[0].capture, std::chrono::system_clock::time_point());
+  EXPECT_EQ(events[3].capture, left.timestamp);
+  EXPECT_EQ(events[4].capture, right.timestamp);
+  EXPECT_NE(events[3].trace_id, events[4].trace_id);
+}
+
+TEST(MessageTracerTest, events)
+{
+  MessageTracer tracer;
+
+  auto msg = std::make_shared<DummyMessage>("Hi");
+  msg->timestamp = std::chrono::system_clock::now();
+
+  tracer.traceEnqueue("test", "plug1", *msg);
+  tracer.traceDispatch("test", { msg });
+
+  const auto start = std::chrono::steady_clock::now();
+  tracer.traceCallback("test", "plug2", msg.get(), start, 3);
+
+  const auto events = tracer.getEvents();
+  ASSERT_EQ(events.size(), unsigned(3));
+
+  EXPECT_EQ(events[0].kind, TraceEventKind::enqueue);
+  EXPECT_EQ(events[0].actor, "plug1");
+  EXPECT_EQ(events[1].kind, TraceEventKind::dispatch);
+  EXPECT_EQ(events[1].actor, "");
+  EXPECT_EQ(events[2].kind, TraceEventKind::callback);
+  EXPECT_EQ(events[2].actor, "plug2");
+  EXPECT_EQ(events[2].messages, unsigned(3));
+  EXPECT_EQ(events[2].start, start);
+
+  for (const auto& event : events)
+  {
+    EXPECT_EQ(event.msg_id, "test");
+    EXPECT_EQ(event.trace_id, msg->trace_id);
+    EXPECT_EQ(event.capture, msg->timestamp);
+    EXPECT_GE(event.since_capture.count(), 0);
+  }
+
+  EXPECT_LE(events[0].start, events[1].start);
+  EXPECT_GE(events[2].duration.count(), 0);
+}
+
+TEST(MessageTracerTest, chrome_trace)
+{
+  MessageTracer tracer;
+
+  auto msg = std::make_shared<DummyMessage>("Hi");
+  tracer.traceEnqueue("test \"quoted\"", "plug1", *msg);
+  tracer.traceDispatch("test \"quoted\"", { msg });
+  tracer.traceCallback("test \"quoted\"", "plug2", msg.get(), std::chrono::steady_clock::now());
+
+  // A message on its own trace gets no flow arrows.
+  DummyMessage lone("lone");
+  tracer.traceEnqueue("test", "plug1", lone);
+
+  std::ostringstream out;
+  tracer.writeChromeTrace(out);
+  const auto json = out.str();
+
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+  EXPECT_NE(json.find("\"name\":\"test \\\"quoted\\\"\",\"cat\":\"enqueue\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"cat\":\"dispatch\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"plug2\",\"cat\":\"callback\""), std::string::npos);
+
+  const auto id = "\"id\":\"" + std::to_string(msg->trace_id) + "\"";
+  EXPECT_NE(json.find("\"ph\":\"s\"," + id), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"t\"," + id), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"f\"," + id), std::string::npos);
+  EXPECT_EQ(json.find("\"id\":\"" + std::to_string(lone.trace_id) + "\""), std::string::npos);
+
+  EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+}
+
+}  // namespace soul
@@ -15,6 +15,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <soul/plugins/interface.h>
+#include <soul/plugins/manifest_cache.h>
+#include <soul/plugins/startup.h>
 
 #include <boost/config.hpp>
 #include <boost/dll/import.hpp>
@@ -22,9 +24,11 @@
 #include <boost/dll/shared_library.hpp>
 
 #include <algorithm>
+#include <chrono>
 #include <experimental/filesystem>  // If gcc > 7 this will become <filesystem>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -84,16 +88,38 @@ public:
 
   /**
    * @brief List all loaded plugins.
-   * @return List of plugin names.
+   * @return List of plugin names, in the order they were loaded.
    */
   std::vector<std::string> listLoadedPlugins()
   {
-    std::vector<std::string> plugins;
+    return load_order_;
+  }
 
-    for (auto& plugin : plugins_)
-      plugins.push_back(plugin.first);
+  /**
+   * @brief Get how long a plugin took to load.
+   * @param plugin_name Name of the plugin.
+   * @return Time spent inspecting, opening and creating the plugin.
+   * @throws std::runtime_error if the plugin is not loaded.
+   */
+  std::chrono::microseconds getLoadTime(const std::string plugin_name) const
+  {
+    const auto time = load_times_.find(plugin_name);
 
-    return plugins;
+    if (time == load_times_.end())
+      throw std::runtime_error("Plugin not found.");
+
+    return time->second;
+  }
+
+  /**
+   * @brief Get the plugin name string.
+   * @param section_name Section name the plugin symbol is exported under.
+   * @param library_name Shared object library name.
+   * @return Plugin name string.
+   */
+  std::string getPluginName(const std::string section_name, const std::string library_name) const
+  {
+    return section_name + "," + library_name;
   }
 
   /**
@@ -115,24 +141,13 @@ public:
       return false;
     }
 
-    if (!containsSymbols(plugin_path, section_name, plugin_factory_method_name_))
-    {
-      std::cerr << "Library " << library_name << " does not contain " << plugin_factory_method_name_ << ". Skipping.\n";
-      return true;
-    }
-
-    if (load_cb_ != nullptr)
-      load_cb_(plugin_path, section_name, plugin_factory_method_name_);
-
-    boost::dll::shared_library shlib(plugin_path);
-    shared_libs_.insert_or_assign(plugin_name, std::move(shlib));
-    auto creator =
-        boost::dll::import_alias<std::unique_ptr<PluginType>()>(shared_libs_[plugin_name], plugin_factory_method_name_);
+    auto staged = stage(library_name, plugin_name, plugin_path, section_name);
+    const bool committed = commit(staged);
 
-    auto plugin = creator();
-    plugins_.insert_or_assign(plugin_name, std::move(plugin));
+    if (manifest_ != nullptr)
+      manifest_->save();
 
-    return true;
+    return committed;
   }
 
   /**
@@ -140,18 +155,44 @@ public:
    * directory with the section name.
    * @param directory Directory path to search for plugin libraries.
    * @param section_name Name of the section your plugin is exported under.
+   * @param workers Number of threads that open and create plugins at the same time. 0 uses the number of hardware
+   * threads. Plugins are registered in library name order however many workers there are.
    * @return True on success, or false if there was a failure.
    */
-  bool loadAll(const std::string directory, const std::string section_name)
+  bool loadAll(const std::string directory, const std::string section_name, const std::size_t workers = 1)
   {
-    const auto&& shared_libs = getSharedLibs(directory);
-    const auto&& plugin_names = getPluginNameFromFileName(shared_libs);
+    return loadLibraries(directory, listLibraries(directory), section_name, workers);
+  }
 
-    for (const auto& library_name : plugin_names)
+  /**
+   * @brief Load the plugins in some of the libraries in a directory.
+   * @param directory Directory path to search for plugin libraries.
+   * @param library_names Names of the libraries, without prefix and suffix.
+   * @param section_name Name of the section your plugin is exported under.
+   * @param workers Number of threads that open and create plugins at the same time. 0 uses the number of hardware
+   * threads. Plugins are registered in the order of library_names however many workers there are.
+   * @return True on success, or false if there was a failure.
+   */
+  bool loadLibraries(const std::string directory, const std::vector<std::string>& library_names,
+                     const std::string section_name, const std::size_t workers = 1)
+  {
+    std::vector<StagedPlugin> staged(library_names.size());
+
+    parallelFor(library_names.size(), workers, [&](const std::size_t i) {
+      const auto& library_name = library_names[i];
+      staged[i] = stage(library_name, getPluginName(section_name, library_name),
+                        getPluginPath(directory, library_name), section_name);
+    });
+
+    // Everything has been inspected by now, so the manifest is as complete as it will get.
+    if (manifest_ != nullptr)
+      manifest_->save();
+
+    for (auto& plugin : staged)
     {
-      if (!load(directory, library_name, section_name))
+      if (!commit(plugin))
       {
-        std::cerr << "Error loading " << library_name << "\n";
+        std::cerr << "Error loading " << plugin.library_name << "\n";
         return false;
       }
     }
@@ -160,7 +201,23 @@ public:
   }
 
   /**
-   * @brief Sets a callback to be called whenever it loads a plugin.
+   * @brief List the libraries in a directory that may contain plugins.
+   * @param directory Directory path to search for plugin libraries.
+   * @return Library names without prefix and suffix, sorted so plugins come up in the same order on every boot.
+   */
+  std::vector<std::string> listLibraries(const std::string directory)
+  {
+    const auto&& shared_libs = getSharedLibs(directory);
+    auto&& library_names = getPluginNameFromFileName(shared_libs);
+
+    std::sort(library_names.begin(), library_names.end());
+
+    return library_names;
+  }
+
+  /**
+   * @brief Sets a callback to be called whenever it loads a plugin. It is called on the loading thread, just before
+   * the plugin is registered.
    * @param cb Callback function.
    */
   void setLoadCallback(PluginLoadCallback cb)
@@ -168,6 +225,16 @@ public:
     load_cb_ = cb;
   }
 
+  /**
+   * @brief Use a manifest cache to find plugin factories without parsing every library. The cache is saved after each
+   * load() and loadAll().
+   * @param manifest Manifest cache. nullptr parses every library, as without a cache.
+   */
+  void setManifestCache(std::shared_ptr<PluginManifestCache> manifest)
+  {
+    manifest_ = std::move(manifest);
+  }
+
   /**
    * @brief Sets a callback to be called whenever it unloads a plugin.
    * @param cb Callback function.
@@ -195,6 +262,8 @@ public:
 
     plugins_.erase(plugin_name);
     shared_libs_.erase(plugin_name);
+    load_times_.erase(plugin_name);
+    load_order_.erase(std::find(load_order_.begin(), load_order_.end(), plugin_name));
 
     return true;
   }
@@ -205,10 +274,8 @@ public:
    */
   bool unloadAll()
   {
-    std::vector<std::string> plugins;
-
-    for (auto& entry : plugins_)
-      plugins.push_back(entry.first);
+    // Unload in reverse so plugins go away in the opposite order they came up.
+    const std::vector<std::string> plugins(load_order_.rbegin(), load_order_.rend());
 
     for (auto& plugin : plugins)
     {
@@ -222,6 +289,19 @@ public:
 #ifndef HR_DEBUG
 private:
 #endif
+  /** A plugin that has been opened and created but not registered yet. */
+  struct StagedPlugin
+  {
+    std::string library_name;                  ///< Library name.
+    std::string plugin_name;                   ///< Plugin name.
+    std::string plugin_path;                   ///< Library path.
+    std::string section_name;                  ///< Section the factory is exported under.
+    bool found = false;                        ///< Whether the library exports a plugin factory.
+    boost::dll::shared_library library;        ///< Opened library.
+    std::unique_ptr<PluginType> plugin;        ///< Created plugin. Declared after library so it is destroyed first.
+    std::chrono::microseconds load_time{ 0 };  ///< Time spent staging.
+  };
+
   /** Callback to invoke when loading a plugin. */
   PluginLoadCallback load_cb_;
 
@@ -231,9 +311,84 @@ private:
   /** Loaded shared libraries. */
   std::unordered_map<std::string, boost::dll::shared_library> shared_libs_;
 
+  /** Remembers which libraries export which symbols. May be nullptr. */
+  std::shared_ptr<PluginManifestCache> manifest_;
+
   /** Contains all the plugins that have been loaded. */
   std::unordered_map<std::string, std::unique_ptr<PluginType>> plugins_;
 
+  /** Names of the loaded plugins in the order they were loaded. */
+  std::vector<std::string> load_order_;
+
+  /** Time each loaded plugin took to load. */
+  std::unordered_map<std::string, std::chrono::microseconds> load_times_;
+
+  /**
+   * @brief Inspect, open and create a plugin without touching the manager's state, so several can be staged at once.
+   * @param library_name Name of the library.
+   * @param plugin_name Name of the plugin.
+   * @param plugin_path Path of the library.
+   * @param section_name Name of the section the plugin is exported under.
+   * @return Staged plugin. found is false if the library has no plugin factory.
+   */
+  StagedPlugin stage(const std::string library_name, const std::string plugin_name, const std::string plugin_path,
+                     const std::string section_name) const
+  {
+    const auto start = std::chrono::steady_clock::now();
+
+    StagedPlugin staged;
+    staged.library_name = library_name;
+    staged.plugin_name = plugin_name;
+    staged.plugin_path = plugin_path;
+    staged.section_name = section_name;
+    staged.found = containsSymbols(plugin_path, section_name, plugin_factory_method_name_);
+
+    if (staged.found)
+    {
+      staged.library = boost::dll::shared_library(plugin_path);
+      auto creator =
+          boost::dll::import_alias<std::unique_ptr<PluginType>()>(staged.library, plugin_factory_method_name_);
+      staged.plugin = creator();
+    }
+
+    staged.load_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    return staged;
+  }
+
+  /**
+   * @brief Register a staged plugin.
+   * @param staged Staged plugin. Moved from on success.
+   * @return False if a plugin with the same name is already loaded. True otherwise, including when the library has no
+   * plugin factory and is skipped.
+   */
+  bool commit(StagedPlugin& staged)
+  {
+    if (!staged.found)
+    {
+      std::cerr << "Library " << staged.library_name << " does not contain " << plugin_factory_method_name_
+                << ". Skipping.\n";
+      return true;
+    }
+
+    if (plugins_.find(staged.plugin_name) != plugins_.end())
+    {
+      std::cerr << "Plugin is already loaded. Skipping.\n";
+      return false;
+    }
+
+    if (load_cb_ != nullptr)
+      load_cb_(staged.plugin_path, staged.section_name, plugin_factory_method_name_);
+
+    plugins_.insert_or_assign(staged.plugin_name, std::move(staged.plugin));
+    shared_libs_.insert_or_assign(staged.plugin_name, std::move(staged.library));
+    load_times_.insert_or_assign(staged.plugin_name, staged.load_time);
+    load_order_.push_back(staged.plugin_name);
+
+    return true;
+  }
+
   /**
    * @brief Checks whether a library contains a symbol under a particular section name.
    * @param plugin_path File path for the plugin shared library.
@@ -241,10 +396,18 @@ private:
    * @param symbol Symbol name.
    * @return True if symbol found, false otherwise.
    */
-  bool containsSymbols(const std::string plugin_path, const std::string section_name, const std::string symbol)
+  bool containsSymbols(const std::string plugin_path, const std::string section_name, const std::string symbol) const
   {
-    boost::dll::library_info info(plugin_path);
-    std::vector<std::string> exports = info.symbols(section_name);
+    std::vector<std::string> exports;
+
+    if (manifest_ == nullptr || !manifest_->lookup(plugin_path, section_name, exports))
+    {
+      boost::dll::library_info info(plugin_path);
+      exports = info.symbols(section_name);
+
+      if (manifest_ != nullptr)
+        manifest_->store(plugin_path, section_name, exports);
+    }
 
     const auto sym = std::find(exports.begin(), exports.end(), symbol);
 
@@ -257,24 +420,13 @@ private:
     return true;
   }
 
-  /**
-   * @brief Get the plugin name string.
-   * @param section_name Section name the plugin symbol is exported under.
-   * @param library_name Shared object library name.
-   * @return Plugin name string.
-   */
-  std::string getPluginName(const std::string section_name, const std::string library_name)
-  {
-    return section_name + "," + library_name;
-  }
-
   /**
    * @brief Get the plugin path
    * @param library_dir Plugin directory.
    * @param library_name Shared object library name.
    * @return Plugin path string.
    */
-  std::string getPluginPath(const std::string library_dir, const std::string library_name)
+  std::string getPluginPath(const std::string library_dir, const std::string library_name) const
   {
     return library_dir + "/lib" + library_name + ".so";
   }
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_PLUGINS_MANIFEST_CACHE_H_
+#define SOUL_PLUGINS_MANIFEST_CACHE_H_
+
+/*
+ * Plugin manifest cache.
+ *
+ * Finding out whether a shared library exports a plugin factory means parsing
+ * its ELF sections. The manifest cache remembers what each library exports,
+ * keyed by its path, modification time, size and inode, and keeps that in a
+ * file between runs. On a warm start the plugin manager only stats each
+ * library and goes straight to dlopen for the ones that are plugins.
+ *
+ * File format, one line per library and section:
+ *
+ *   soul-plugin-manifest 1
+ *   <path>\t<mtime ns>\t<size>\t<inode>\t<section>\t<symbol> <symbol> ...
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <experimental/filesystem>  // If gcc > 7 this will become <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** First line of a manifest cache file. Bump the version when the format changes. */
+constexpr char plugin_manifest_header_[] = "soul-plugin-manifest 1";
+
+/**
+ * @brief Manifest cache statistics.
+ */
+struct PluginManifestStats
+{
+  std::uint64_t hits = 0;    ///< Lookups answered from the cache.
+  std::uint64_t misses = 0;  ///< Lookups that needed the library to be parsed.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASSES                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief On-disk cache of the symbols plugin libraries export. Thread safe, and can be shared by several plugin
+ * managers.
+ */
+class PluginManifestCache final
+{
+public:
+  /**
+   * @brief Constructor. Reads the cache file if there is one. A missing, unreadable or outdated file gives an empty
+   * cache.
+   * @param path Cache file path.
+   */
+  explicit PluginManifestCache(const std::string& path) : path_(path), dirty_(false)
+  {
+    read();
+  }
+
+  PluginManifestCache(const PluginManifestCache&) = delete;
+  PluginManifestCache& operator=(const PluginManifestCache&) = delete;
+
+  /**
+   * @brief Look up the symbols a library exports under a section.
+   * @param library_path Library path.
+   * @param section_name Section name.
+   * @param symbols Set to the exported symbols on a hit.
+   * @return True on a hit. False if the library isn't cached for the section or has changed since.
+   */
+  bool lookup(const std::string& library_path, const std::string& section_name, std::vector<std::string>& symbols)
+  {
+    FileId id;
+    const bool identified = identify(library_path, id);
+
+    std::lock_guard<std::mutex> lg(lock_);
+
+    const auto entry = entries_.find(absolute(library_path));
+
+    if (identified && entry != entries_.end() && entry->second.id == id)
+    {
+      const auto section = entry->second.sections.find(section_name);
+
+      if (section != entry->second.sections.end())
+      {
+        symbols = section->second;
+        ++stats_.hits;
+        return true;
+      }
+    }
+
+    ++stats_.misses;
+    return false;
+  }
+
+  /**
+   * @brief Record the symbols a library exports under a section.
+   * @param library_path Library path.
+   * @param section_name Section name.
+   * @param symbols Exported symbols.
+   */
+  void store(const std::string& library_path, const std::string& section_name, const std::vector<std::string>& symbols)
+  {
+    FileId id;
+    if (!identify(library_path, id) || !storable(library_path) || !storable(section_name))
+      return;
+
+    std::lock_guard<std::mutex> lg(lock_);
+
+    auto& entry = entries_[absolute(library_path)];
+
+    // The library changed, so whatever else we knew about it is stale.
+    if (!(entry.id == id))
+    {
+      entry.id = id;
+      entry.sections.clear();
+    }
+
+    entry.sections[section_name] = symbols;
+    dirty_ = true;
+  }
+
+  /**
+   * @brief Write the cache file if anything was stored since it was read. Libraries that no longer exist are dropped.
+   * @return False if the file couldn't be written. The cache still works, it just won't be warm next time.
+   */
+  bool save(void)
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (!dirty_)
+      return true;
+
+    // Write a temporary file and rename it over the old one, so a crash never leaves a half written cache.
+    const auto tmp_path = path_ + ".tmp";
+    std::ofstream out(tmp_path, std::ios::trunc);
+
+    out << plugin_manifest_header_ << "\n";
+
+    for (const auto& entry : entries_)
+    {
+      FileId id;
+      if (!identify(entry.first, id))
+        continue;
+
+      for (const auto& section : entry.second.sections)
+      {
+        out << entry.first << '\t' << entry.second.id.mtime_ns << '\t' << entry.second.id.size << '\t'
+            << entry.second.id.inode << '\t' << section.first << '\t';
+
+        for (std::size_t i = 0; i < section.second.size(); ++i)
+          out << (i == 0 ? "" : " ") << section.second[i];
+
+        out << '\n';
+      }
+    }
+
+    out.close();
+
+    if (!out || std::rename(tmp_path.c_str(), path_.c_str()) != 0)
+    {
+      std::cerr << "WARNING: PluginManifestCache: can't write " << path_ << "\n";
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+
+    dirty_ = false;
+    return true;
+  }
+
+  /**
+   * @brief Get the cache statistics.
+   * @return Statistics.
+   */
+  PluginManifestStats getStats(void)
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    return stats_;
+  }
+
+  /**
+   * @brief Get the cache file path.
+   * @return Path.
+   */
+  const std::string& getPath(void) const
+  {
+    return path_;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** What identifies one version of a library file. */
+  struct FileId
+  {
+    std::int64_t mtime_ns = 0;  ///< Modification time.
+    std::uint64_t size = 0;     ///< File size.
+    std::uint64_t inode = 0;    ///< Inode.
+
+    /**
+     * @brief Equality comparison.
+     * @param rhs Other file ID.
+     * @return True if both describe the same file version.
+     */
+    bool operator==(const FileId& rhs) const
+    {
+      return mtime_ns == rhs.mtime_ns && size == rhs.size && inode == rhs.inode;
+    }
+  };
+
+  /** What one library exports. */
+  struct Entry
+  {
+    FileId id;                                                           ///< File version the symbols belong to.
+    std::unordered_map<std::string, std::vector<std::string>> sections;  ///< Exported symbols by section.
+  };
+
+  /**
+   * @brief Identify a library file.
+   * @param library_path Library path.
+   * @param id Set to the file's identity.
+   * @return False if the file can't be stat'd.
+   */
+  static bool identify(const std::string& library_path, FileId& id)
+  {
+    struct stat st;
+    if (::stat(library_path.c_str(), &st) != 0)
+      return false;
+
+    id.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    id.size = static_cast<std::uint64_t>(st.st_size);
+    id.inode = static_cast<std::uint64_t>(st.st_ino);
+
+    return true;
+  }
+
+  /**
+   * @brief Get the key for a library, so the same file is found whatever directory it was loaded from.
+   * @param library_path Library path.
+   * @return Absolute path.
+   */
+  static std::string absolute(const std::string& library_path)
+  {
+    return std::experimental::filesystem::absolute(library_path).string();
+  }
+
+  /**
+   * @brief Check whether a string can go in a cache file field.
+   * @param field Field.
+   * @return True if it has no field or line separators.
+   */
+  static bool storable(const std::string& field)
+  {
+    return field.find_first_of("\t\n") == std::string::npos;
+  }
+
+  /**
+   * @brief Read the cache file.
+   */
+  void read(void)
+  {
+    std::ifstream in(path_);
+    std::string line;
+
+    if (!std::getline(in, line) || line != plugin_manifest_header_)
+      return;
+
+    while (std::getline(in, line))
+    {
+      std::istringstream fields(line);
+      std::string library_path, mtime, size, inode, section, symbols;
+
+      if (!std::getline(fields, library_path, '\t') || !std::getline(fields, mtime, '\t') ||
+          !std::getline(fields, size, '\t') || !std::getline(fields, inode, '\t') ||
+          !std::getline(fields, section, '\t'))
+      {
+        continue;
+      }
+
+      std::getline(fields, symbols);
+
+      FileId id;
+      try
+      {
+        id.mtime_ns = std::stoll(mtime);
+        id.size = std::stoull(size);
+        id.inode = std::stoull(inode);
+      }
+      catch (const std::exception&)
+      {
+        continue;
+      }
+
+      auto& entry = entries_[library_path];
+      entry.id = id;
+
+      auto& exports = entry.sections[section];
+      std::istringstream names(symbols);
+      for (std::string name; names >> name;)
+        exports.push_back(name);
+    }
+  }
+
+  /** Cache file path. */
+  const std::string path_;
+
+  /** Lock for entries_, dirty_ and stats_. */
+  std::mutex lock_;
+
+  /** Cached libraries by absolute path. */
+  std::unordered_map<std::string, Entry> entries_;
+
+  /** Whether entries_ changed since the file was read or saved. */
+  bool dirty_;
+
+  /** Statistics. */
+  PluginManifestStats stats_;
+};
+
+}  // namespace soul
+
+#endif  // SOUL_PLUGINS_MANIFEST_CACHE_H_
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_PLUGINS_STARTUP_H_
+#define SOUL_PLUGINS_STARTUP_H_
+
+/*
+ * Plugin startup helpers.
+ *
+ * Loading and configuring plugins is dominated by work each plugin does on its
+ * own: parsing its ELF file, running its static initialisers, loading models
+ * in configure(). These helpers run that work for several plugins at once and
+ * record how long each one took, so slow plugins are easy to spot at boot.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Time one plugin took to start.
+ */
+struct PluginTiming
+{
+  std::string name;                          ///< Plugin name.
+  std::chrono::microseconds load{ 0 };       ///< Inspecting, opening and creating the plugin.
+  std::chrono::microseconds configure{ 0 };  ///< Running configure().
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Call fn(i) for every i in [0, count), spread over worker threads. Returns once every call has finished.
+ * @param count Number of calls.
+ * @param workers Maximum number of threads, including the caller's. 0 uses the number of hardware threads, 1 runs
+ * everything on the calling thread in order.
+ * @param fn Function to call. Must be safe to call concurrently for different i.
+ * @throws The first exception thrown by fn, after every other call has finished.
+ */
+inline void parallelFor(const std::size_t count, const std::size_t workers, const std::function<void(std::size_t)>& fn)
+{
+  auto threads = workers == 0 ? std::max(1u, std::thread::hardware_concurrency()) : workers;
+  threads = std::min(threads, count);
+
+  if (threads <= 1)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+      fn(i);
+
+    return;
+  }
+
+  std::atomic<std::size_t> next(0);
+  std::exception_ptr error;
+  std::mutex error_lock;
+
+  const auto work = [&]() {
+    for (auto i = next++; i < count; i = next++)
+    {
+      try
+      {
+        fn(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lg(error_lock);
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < threads; ++t)
+    pool.emplace_back(work);
+
+  work();
+
+  for (auto& t : pool)
+    t.join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+/**
+ * @brief Print how long each plugin took to start.
+ * @param out Where to print.
+ * @param system Name of the system that started the plugins.
+ * @param timings Plugin timings.
+ */
+inline void printStartupTimes(std::ostream& out, const std::string& system, const std::vector<PluginTiming>& timings)
+{
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+
+  for (const auto& t : timings)
+  {
+    out << system << " started " << t.name << ": load " << std::fixed << std::setprecision(1)
+        << t.load.count() / 1000.0 << " ms, configure " << t.configure.count() / 1000.0 << " ms\n";
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+}  // namespace soul
+
+#endif  // SOUL_PLUGINS_STARTUP_H_
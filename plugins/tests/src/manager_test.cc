@@ -177,4 +177,39 @@ TEST_F(LoaderFixture, getPlugin_invalid)
   EXPECT_THROW(pluginman.getPlugin("this name should not exist"), std::runtime_error);
 }
 
+// Parallel loading registers the same plugins as serial loading.
+TEST_F(LoaderFixture, loadAll_parallel)
+{
+  EXPECT_TRUE(pluginman.loadAll(".", "Dummy"));
+  const auto serial = pluginman.listLoadedPlugins();
+  EXPECT_TRUE(pluginman.unloadAll());
+
+  PluginManager<DummyPluginType> parallel;
+  EXPECT_TRUE(parallel.loadAll(".", "Dummy", 4));
+  EXPECT_EQ(parallel.listLoadedPlugins(), serial);
+
+  auto plugin = parallel.getPlugin("Dummy,dummy_plugin");
+  ASSERT_TRUE(plugin != nullptr);
+  EXPECT_EQ(plugin->name(), "Dummy,dummy_plugin");
+}
+
+// Loading twice fails in the parallel path too.
+TEST_F(LoaderFixture, loadAll_parallel_duplicate)
+{
+  EXPECT_TRUE(pluginman.loadAll(".", "Dummy", 4));
+  EXPECT_FALSE(pluginman.loadAll(".", "Dummy", 4));
+  EXPECT_EQ(pluginman.listLoadedPlugins().size(), unsigned(1));
+}
+
+// Load times are recorded for loaded plugins only.
+TEST_F(LoaderFixture, getLoadTime)
+{
+  EXPECT_THROW(pluginman.getLoadTime("Dummy,dummy_plugin"), std::runtime_error);
+  EXPECT_TRUE(pluginman.load(".", "dummy_plugin", "Dummy"));
+  EXPECT_GE(pluginman.getLoadTime("Dummy,dummy_plugin").count(), 0);
+
+  EXPECT_TRUE(pluginman.unload("Dummy,dummy_plugin"));
+  EXPECT_THROW(pluginman.getLoadTime("Dummy,dummy_plugin"), std::runtime_error);
+}
+
 }  // namespace soul
\ No newline at end of file
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Plugin manifest cache test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/plugins/manager.h>
+#include <soul/plugins/manifest_cache.h>
+#include "dummy_plugin_type.h"
+
+#include <gmock/gmock.h>
+
+#include <unistd.h>
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace fs = std::experimental::filesystem;
+
+///////////////////////////////////////////////////////////////////////////////
+// FIXTURE                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+class ManifestFixture : public ::testing::Test
+{
+protected:
+  std::string dir;
+  std::string manifest;
+  std::string library;
+
+  void SetUp() override
+  {
+    dir = (fs::temp_directory_path() / ("soul_manifest_test_" + std::to_string(::getpid()))).string();
+    fs::create_directories(dir);
+
+    manifest = dir + "/manifest";
+    library = dir + "/libfake.so";
+    write(library, "not really a library");
+  }
+
+  void TearDown() override
+  {
+    fs::remove_all(dir);
+  }
+
+  void write(const std::string& path, const std::string& content)
+  {
+    std::ofstream out(path, std::ios::trunc);
+    out << content;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST_F(ManifestFixture, store_and_lookup)
+{
+  PluginManifestCache cache(manifest);
+  std::vector<std::string> symbols;
+
+  EXPECT_FALSE(cache.lookup(library, "Sense", symbols));
+
+  cache.store(library, "Sense", { "create", "other" });
+  EXPECT_TRUE(cache.lookup(library, "Sense", symbols));
+  EXPECT_EQ(symbols, std::vector<std::string>({ "create", "other" }));
+
+  EXPECT_FALSE(cache.lookup(library, "SenseHw", symbols));
+
+  EXPECT_EQ(cache.getStats().hits, uint64_t(1));
+  EXPECT_EQ(cache.getStats().misses, uint64_t(2));
+}
+
+TEST_F(ManifestFixture, survives_restart)
+{
+  {
+    PluginManifestCache cache(manifest);
+    cache.store(library, "Sense", { "create" });
+    cache.store(library, "Empty", {});
+    EXPECT_TRUE(cache.save());
+  }
+
+  PluginManifestCache cache(manifest);
+  std::vector<std::string> symbols;
+
+  EXPECT_TRUE(cache.lookup(library, "Sense", symbols));
+  EXPECT_EQ(symbols, std::vector<std::string>({ "create" }));
+
+  EXPECT_TRUE(cache.lookup(library, "Empty", symbols));
+  EXPECT_TRUE(symbols.empty());
+}
+
+TEST_F(ManifestFixture, changed_library_misses)
+{
+  PluginManifestCache cache(manifest);
+  cache.store(library, "Sense", { "create" });
+
+  write(library, "a different, longer library");
+
+  std::vector<std::string> symbols;
+  EXPECT_FALSE(cache.lookup(library, "Sense", symbols));
+}
+
+TEST_F(ManifestFixture, deleted_library_dropped_on_save)
+{
+  {
+    PluginManifestCache cache(manifest);
+    cache.store(library, "Sense", { "create" });
+    fs::remove(library);
+    EXPECT_TRUE(cache.save());
+  }
+
+  std::ifstream in(manifest);
+  std::string header, line;
+  EXPECT_TRUE(static_cast<bool>(std::getline(in, header)));
+  EXPECT_FALSE(static_cast<bool>(std::getline(in, line)));
+}
+
+TEST_F(ManifestFixture, bad_file_gives_empty_cache)
+{
+  write(manifest, "soul-plugin-manifest 0\n" + library + "\t1\t2\t3\tSense\tcreate\n");
+
+  PluginManifestCache old_version(manifest);
+  std::vector<std::string> symbols;
+  EXPECT_FALSE(old_version.lookup(library, "Sense", symbols));
+
+  write(manifest, std::string(plugin_manifest_header_) + "\ngarbage\n" + library + "\tx\ty\tz\tSense\tcreate\n");
+
+  PluginManifestCache garbage(manifest);
+  EXPECT_FALSE(garbage.lookup(library, "Sense", symbols));
+}
+
+TEST_F(ManifestFixture, unwritable_file)
+{
+  PluginManifestCache cache(dir + "/missing/manifest");
+  cache.store(library, "Sense", { "create" });
+
+  EXPECT_FALSE(cache.save());
+}
+
+// A warm plugin manager loads the same plugins without inspecting any library.
+TEST_F(ManifestFixture, warm_start)
+{
+  auto cold_cache = std::make_shared<PluginManifestCache>(manifest);
+  std::vector<std::string> cold_plugins;
+
+  {
+    PluginManager<DummyPluginType> pluginman;
+    pluginman.setManifestCache(cold_cache);
+    EXPECT_TRUE(pluginman.loadAll(".", "Dummy"));
+    cold_plugins = pluginman.listLoadedPlugins();
+  }
+
+  EXPECT_EQ(cold_cache->getStats().hits, uint64_t(0));
+  EXPECT_GT(cold_cache->getStats().misses, uint64_t(0));
+
+  auto warm_cache = std::make_shared<PluginManifestCache>(manifest);
+
+  PluginManager<DummyPluginType> pluginman;
+  pluginman.setManifestCache(warm_cache);
+  EXPECT_TRUE(pluginman.loadAll(".", "Dummy"));
+
+  EXPECT_EQ(pluginman.listLoadedPlugins(), cold_plugins);
+  EXPECT_EQ(warm_cache->getStats().hits, cold_cache->getStats().misses);
+  EXPECT_EQ(warm_cache->getStats().misses, uint64_t(0));
+}
+
+}  // namespace soul
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Plugin startup helpers test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/plugins/startup.h>
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+// Every index runs exactly once whatever the worker count.
+TEST(StartupTest, parallelFor_covers_every_index)
+{
+  for (const std::size_t workers : { 0, 1, 3, 64 })
+  {
+    std::vector<std::atomic<int>> calls(100);
+
+    parallelFor(calls.size(), workers, [&calls](const std::size_t i) { ++calls[i]; });
+
+    for (auto& c : calls)
+      EXPECT_EQ(c.load(), 1);
+  }
+}
+
+// A single worker runs everything on the caller's thread, in order.
+TEST(StartupTest, parallelFor_serial)
+{
+  std::vector<std::size_t> order;
+  const auto caller = std::this_thread::get_id();
+
+  parallelFor(10, 1, [&](const std::size_t i) {
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+    order.push_back(i);
+  });
+
+  ASSERT_EQ(order.size(), static_cast<size_t>(10));
+  for (std::size_t i = 0; i < order.size(); ++i)
+    EXPECT_EQ(order[i], i);
+}
+
+// An exception surfaces after the other calls finish.
+TEST(StartupTest, parallelFor_rethrows)
+{
+  std::atomic<int> calls(0);
+
+  EXPECT_THROW(parallelFor(20, 4,
+                           [&calls](const std::size_t i) {
+                             ++calls;
+                             if (i == 3)
+                               throw std::runtime_error("configure failed");
+                           }),
+               std::runtime_error);
+
+  EXPECT_EQ(calls.load(), 20);
+}
+
+TEST(StartupTest, printStartupTimes)
+{
+  std::ostringstream out;
+  PluginTiming timing;
+  timing.name = "Sense,camera";
+  timing.load = std::chrono::microseconds(1500);
+  timing.configure = std::chrono::microseconds(300);
+
+  printStartupTimes(out, "Test", { timing });
+
+  EXPECT_EQ(out.str(), "Test started Sense,camera: load 1.5 ms, configure 0.3 ms\n");
+}
+
+}  // namespace soul
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message copy benchmark.
+ *
+ * Counts heap allocations while building PersonState messages the way a
+ * perception pipeline would (moving freshly detected data into each message)
+ * and while a subscriber reads every field back. Allocations beyond the
+ * inputs themselves are copies made by the message API.
+ *
+ * Usage: sense_msg_copy_benchmark [messages]
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/knowledge/msg/person_state.h>
+#include <soul/sense/msg/body_parts.h>
+#include <soul/sense/msg/face_detection.h>
+#include <soul/sense/msg/face_encoding.h>
+#include <soul/sense/msg/face_landmarks.h>
+#include <soul/sense/msg/header.h>
+#include <soul/sense/msg/image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// ALLOCATION COUNTING                                                       //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+std::atomic<std::uint64_t> allocations(0);
+
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  ++allocations;
+
+  if (void* p = std::malloc(size == 0 ? 1 : size))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t size) noexcept
+{
+  (void)size;
+  std::free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace soul::sense::math;
+using namespace soul::sense::msg;
+
+/** Detector output for one person, before it is wrapped in messages. */
+struct Detections
+{
+  std::string frame_id;
+  cv::Mat face;
+  std::vector<float> encoding;
+  std::vector<std::string> landmark_names;
+  std::vector<Point3i> landmarks;
+  std::vector<std::string> body_part_names;
+  std::vector<Pose3f> poses;
+};
+
+/**
+ * @brief Make detector output the way a detector would.
+ * @return Detections.
+ */
+Detections detect(void)
+{
+  Detections d;
+  d.frame_id = "camera_color_optical_frame";
+  d.face = cv::Mat(64, 64, CV_8UC3);
+  d.encoding.assign(128, 0.5f);
+  d.landmark_names = { "reye_rcorner", "reye_lcorner", "leye_rcorner", "leye_lcorner", "nose_tip_and_bridge" };
+  d.landmarks.assign(d.landmark_names.size(), Point3i(1, 2, 0));
+  d.body_part_names = { "head_orientation_and_position", "left_hand_palm_center" };
+  d.poses.assign(d.body_part_names.size(), Pose3f(Point3f(1, 1, 1), Quaternionf(0, 0, 0, 1)));
+
+  return d;
+}
+
+/**
+ * @brief Wrap detections in a PersonState, moving everything that can be moved.
+ * @param d Detections. Left moved-from.
+ * @return Message.
+ */
+knowledge::msg::PersonState build(Detections& d)
+{
+  const auto now = std::chrono::system_clock::now();
+  const BoundingBox bbox(Point3i(0, 0, 0), Size3i(64, 64, 0));
+
+  FaceEncoding encoding(Header(now, d.frame_id), std::move(d.encoding));
+  FaceDetection detection(Header(now, d.frame_id), Image(Header(now, d.frame_id), std::move(d.face)), bbox);
+  FaceLandmarks landmarks(Header(now, d.frame_id), std::move(d.landmark_names), std::move(d.landmarks));
+  BodyParts body_parts(Header(now, std::move(d.frame_id)), std::move(d.body_part_names), std::move(d.poses));
+
+  return knowledge::msg::PersonState(1, std::move(encoding), std::move(detection), std::move(landmarks),
+                                     std::move(body_parts));
+}
+
+/**
+ * @brief Read every field of a PersonState like a subscriber would.
+ * @param person Message.
+ * @return Something derived from the fields, so the reads aren't optimised away.
+ */
+std::size_t read(const knowledge::msg::PersonState& person)
+{
+  std::size_t sum = person.getId();
+
+  sum += person.getFaceEncoding().getEncoding().size();
+  sum += person.getFaceEncoding().getHeader().getFrameId().size();
+  sum += person.getFaceDetection().getFaceImage().getImage().rows;
+  sum += person.getFaceDetection().getBoundingBox().getSize().getWidth();
+  sum += person.getFaceLandmarks().getNames().size();
+  sum += person.getFaceLandmarks().getLandmarks().size();
+  sum += person.getBodyParts().getNames().size();
+  sum += person.getBodyParts().getPoses().size();
+
+  return sum;
+}
+
+}  // namespace soul
+
+///////////////////////////////////////////////////////////////////////////////
+// MAIN                                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  using namespace soul;
+
+  const int messages = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+
+  std::uint64_t input_allocs = 0;
+  std::uint64_t build_allocs = 0;
+  std::uint64_t read_allocs = 0;
+  std::uint64_t list_allocs = 0;
+  std::size_t sink = 0;
+
+  std::vector<knowledge::msg::PersonState> people;
+  people.reserve(messages);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < messages; ++i)
+  {
+    auto before = allocations.load();
+    auto d = detect();
+    input_allocs += allocations - before;
+
+    before = allocations.load();
+    people.push_back(build(d));
+    build_allocs += allocations - before;
+
+    before = allocations.load();
+    sink += read(people.back());
+    read_allocs += allocations - before;
+  }
+
+  // Batch everything into a list message and read it back.
+  auto before = allocations.load();
+  knowledge::msg::PersonStateList list(std::move(people));
+  for (const auto& person : list.getItems())
+    sink += read(person);
+  list_allocs = allocations - before;
+
+  const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  std::printf("%d PersonState messages (checksum %zu)\n", messages, sink);
+  std::printf("allocations per message: inputs %.1f, build %.1f, read %.1f, list %.1f\n",
+              double(input_allocs) / messages, double(build_allocs) / messages, double(read_allocs) / messages,
+              double(list_allocs) / messages);
+  std::printf("%.2f us per message\n", elapsed / messages);
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Message serialization benchmark.
+ *
+ * Encodes and decodes each sense and knowledge message type through its
+ * binary codec and reports the throughput of both directions. Decoding reads
+ * pixels in place, so large images decode at the cost of their small fields.
+ *
+ * Usage: sense_serialization_benchmark [messages]
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/knowledge/msg/serialization.h>
+#include <soul/sense/msg/serialization.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+using namespace soul::sense::math;
+using namespace soul::sense::msg;
+
+/**
+ * @brief Make a message header.
+ * @return Header.
+ */
+Header makeHeader(void)
+{
+  return Header(std::chrono::system_clock::now(), "camera_color_optical_frame");
+}
+
+/**
+ * @brief Make a person state the size a perception pipeline would publish.
+ * @return Person state.
+ */
+knowledge::msg::PersonState makePerson(void)
+{
+  const std::vector<std::string> landmark_names(68, "landmark");
+  const std::vector<std::string> body_part_names(18, "body_part");
+
+  FaceEncoding encoding(makeHeader(), std::vector<float>(128, 0.5f));
+  FaceDetection detection(makeHeader(), Image(makeHeader(), cv::Mat(64, 64, CV_8UC3)),
+                          BoundingBox(Point3i(0, 0, 0), Size3i(64, 64, 0)));
+  FaceLandmarks landmarks(makeHeader(), landmark_names, std::vector<Point3i>(68, Point3i(1, 2, 0)));
+  BodyParts body_parts(makeHeader(), body_part_names,
+                       std::vector<Pose3f>(18, Pose3f(Point3f(1, 1, 1), Quaternionf(0, 0, 0, 1))));
+
+  return knowledge::msg::PersonState(1, std::move(encoding), std::move(detection), std::move(landmarks),
+                                     std::move(body_parts));
+}
+
+/**
+ * @brief Encode and decode a message repeatedly and print the throughput.
+ * @param name Name to print.
+ * @param msg Message.
+ * @param messages Times to encode and decode it.
+ */
+template <typename T>
+void run(const char* name, const T& msg, const int messages)
+{
+  const auto codec = makeSerialCodec<T>();
+  const std::size_t size = codec.size(msg);
+
+  // Aligned like the messaging system's buffers.
+  std::vector<std::uint64_t> buffer((size + 7) / 8);
+  auto* dst = reinterpret_cast<std::uint8_t*>(buffer.data());
+  std::size_t sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Encoding measures the message first, like the messaging system does.
+  for (int i = 0; i < messages; ++i)
+  {
+    sink += codec.size(msg);
+    codec.encode(msg, dst);
+    sink += dst[i % size];
+  }
+
+  const auto encode_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < messages; ++i)
+    sink += codec.decode(dst, size, nullptr) != nullptr;
+
+  const auto decode_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const double mb = double(size) * messages / (1024 * 1024);
+  std::printf("%-24s %9zu B  encode %10.0f msg/s %8.1f MB/s  decode %10.0f msg/s %8.1f MB/s  (%zu)\n", name, size,
+              messages / encode_s, mb / encode_s, messages / decode_s, mb / decode_s, sink);
+}
+
+}  // namespace soul
+
+///////////////////////////////////////////////////////////////////////////////
+// MAIN                                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
+{
+  using namespace soul;
+
+  const int messages = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10000;
+  const auto person = makePerson();
+
+  run("Image 640x480 RGB+depth", Image(makeHeader(), cv::Mat(480, 640, CV_8UC3), cv::Mat(480, 640, CV_16UC1)),
+      messages);
+  run("FaceDetection 64x64", person.getFaceDetection(), messages);
+  run("FaceEncoding 128", person.getFaceEncoding(), messages);
+  run("FaceLandmarks 68", person.getFaceLandmarks(), messages);
+  run("BodyParts 18", person.getBodyParts(), messages);
+  run("PersonState", person, messages);
+  run("PersonStateList 10", knowledge::msg::PersonStateList(std::vector<knowledge::msg::PersonState>(10, person)),
+      messages);
+
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_FRAME_POOL_H_
+#define SOUL_SENSE_FRAME_POOL_H_
+
+/*
+ * Frame buffer pool.
+ *
+ * Hands out Image messages whose cv::Mats come from a pool of buffers sized
+ * for one device. When the last shared_ptr to the Image goes away its buffers
+ * go back to the pool, so a camera running at full frame rate stops hitting
+ * the allocator for every frame.
+ *
+ * A buffer is only recycled if nothing else refers to it, so consumers can
+ * keep shallow Mat copies past the Image message. Those buffers are freed
+ * instead, and the pool allocates a new one for a later frame.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/sense/hw_plugin_profile.h>
+#include <soul/sense/msg/header.h>
+#include <soul/sense/msg/image.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Number of idle frames a pool keeps when the device doesn't say. */
+constexpr std::size_t default_frame_pool_size_ = 4;
+
+/**
+ * @brief Frame pool statistics.
+ */
+struct FramePoolStats
+{
+  std::uint64_t hits = 0;       ///< Frames served from an idle buffer.
+  std::uint64_t misses = 0;     ///< Frames that needed a new allocation.
+  std::uint64_t recycled = 0;   ///< Buffers returned to the pool.
+  std::uint64_t discarded = 0;  ///< Buffers freed because the pool was already full.
+  std::uint64_t shared = 0;     ///< Buffers left to Mat copies that outlived their Image.
+  std::size_t idle = 0;         ///< Buffers currently waiting in the pool.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// CLASSES                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Pool of recyclable frame buffers for one device. Thread safe.
+ */
+class FramePool final : public std::enable_shared_from_this<FramePool>
+{
+public:
+  /**
+   * @brief Create a pool sized for a device.
+   * @param devinfo Device information. Uses its frame formats and pool size.
+   * @return The pool.
+   */
+  static std::shared_ptr<FramePool> create(const DeviceInfo& devinfo)
+  {
+    const auto capacity = devinfo.frame_pool_size > 0 ? devinfo.frame_pool_size : default_frame_pool_size_;
+    return create(devinfo.image_format, devinfo.depth_format, capacity);
+  }
+
+  /**
+   * @brief Create a pool.
+   * @param image RGB frame format.
+   * @param depth Depth frame format. Leave rows at 0 for devices without depth.
+   * @param capacity Maximum number of idle frames kept for reuse.
+   * @return The pool.
+   */
+  static std::shared_ptr<FramePool> create(const FrameFormat& image, const FrameFormat& depth,
+                                           const std::size_t capacity)
+  {
+    return std::shared_ptr<FramePool>(new FramePool(image, depth, capacity));
+  }
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  /**
+   * @brief Get an Image message backed by pooled buffers. Fill the pixels through copies of its Mats, which share the
+   * pooled buffers, then send it.
+   * @param header Message header.
+   * @return Image whose buffers return to the pool when it is deleted. Buffer contents are unspecified.
+   */
+  std::shared_ptr<msg::Image> acquire(const msg::Header& header)
+  {
+    Frame frame;
+    bool hit = false;
+
+    {
+      std::lock_guard<std::mutex> lg(lock_);
+
+      if (!idle_.empty())
+      {
+        frame = std::move(idle_.back());
+        idle_.pop_back();
+        hit = true;
+        ++stats_.hits;
+      }
+      else
+      {
+        ++stats_.misses;
+      }
+    }
+
+    // Allocate outside the lock.
+    if (!hit)
+      frame = allocate();
+
+    std::weak_ptr<FramePool> pool = shared_from_this();
+
+    return std::shared_ptr<msg::Image>(new msg::Image(header, frame.image, frame.depth),
+                                       [pool, frame](msg::Image* image) {
+                                         delete image;
+
+                                         // Outliving the pool is fine, the buffers are just freed.
+                                         if (auto p = pool.lock())
+                                           p->release(frame);
+                                       });
+  }
+
+  /**
+   * @brief Get the pool statistics.
+   * @return Statistics.
+   */
+  FramePoolStats getStats(void) const
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    auto stats = stats_;
+    stats.idle = idle_.size();
+
+    return stats;
+  }
+
+  /**
+   * @brief Get the RGB frame format.
+   * @return RGB frame format.
+   */
+  const FrameFormat& getImageFormat(void) const
+  {
+    return image_format_;
+  }
+
+  /**
+   * @brief Get the depth frame format.
+   * @return Depth frame format.
+   */
+  const FrameFormat& getDepthFormat(void) const
+  {
+    return depth_format_;
+  }
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /** Buffers behind one Image. */
+  struct Frame
+  {
+    cv::Mat image;  ///< RGB buffer.
+    cv::Mat depth;  ///< Depth buffer. Empty for devices without depth.
+  };
+
+  /**
+   * @brief Constructor. Use create().
+   * @param image RGB frame format.
+   * @param depth Depth frame format.
+   * @param capacity Maximum number of idle frames.
+   */
+  FramePool(const FrameFormat& image, const FrameFormat& depth, const std::size_t capacity)
+    : image_format_(image), depth_format_(depth), capacity_(capacity)
+  {
+    idle_.reserve(capacity_);
+  }
+
+  /**
+   * @brief Allocate a new frame.
+   * @return Frame.
+   */
+  Frame allocate(void) const
+  {
+    Frame frame;
+
+    if (image_format_.rows > 0)
+      frame.image = cv::Mat(image_format_.rows, image_format_.cols, image_format_.type);
+
+    if (depth_format_.rows > 0)
+      frame.depth = cv::Mat(depth_format_.rows, depth_format_.cols, depth_format_.type);
+
+    return frame;
+  }
+
+  /**
+   * @brief Indicate whether a buffer is referred to by anything but the frame being released.
+   * @param mat Buffer.
+   * @return True if another Mat still shares it.
+   */
+  static bool isShared(const cv::Mat& mat)
+  {
+    // Nobody else can take a new reference once the count is down to ours.
+    return mat.u != nullptr && CV_XADD(&mat.u->refcount, 0) > 1;
+  }
+
+  /**
+   * @brief Take back a frame whose Image was deleted. Buffers a subscriber still holds a Mat copy of are left to it.
+   * @param frame Frame.
+   */
+  void release(const Frame& frame)
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+
+    if (isShared(frame.image) || isShared(frame.depth))
+    {
+      ++stats_.shared;
+    }
+    else if (idle_.size() < capacity_)
+    {
+      idle_.push_back(frame);
+      ++stats_.recycled;
+    }
+    else
+    {
+      ++stats_.discarded;
+    }
+  }
+
+  /** RGB frame format. */
+  const FrameFormat image_format_;
+
+  /** Depth frame format. */
+  const FrameFormat depth_format_;
+
+  /** Maximum number of idle frames. */
+  const std::size_t capacity_;
+
+  /** Idle frames. */
+  std::vector<Frame> idle_;
+
+  /** Statistics. */
+  FramePoolStats stats_;
+
+  /** Lock for idle_ and stats_. */
+  mutable std::mutex lock_;
+};
+
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_FRAME_POOL_H_
@@ -17,10 +17,15 @@
 
 #include <soul/messaging/manager.h>
 #include <soul/plugins/manager.h>
+#include <soul/plugins/manifest_cache.h>
+#include <soul/plugins/startup.h>
 #include <soul/sense/hw_plugin_interface.h>
 #include <soul/sense/plugin_state.h>
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -42,9 +47,13 @@ struct SoulSenseHwManagerParameters
   std::string plugin_dir;    ///< Plugin directory containing all the hardware plugins.
   std::string section_name;  ///< Section name.
 
-  MessageSenderFn sender;  ///< Message sender function.
+  MessageSenderFn sender;  ///< Message sender function. Empty sends through msgman on the plugins' topic handles.
   MessageManager* msgman;  ///< Pointer to the perception message manager.
 
+  std::size_t startup_workers = 1;  ///< Plugins loaded and configured at once. 0 uses every hardware thread.
+
+  std::shared_ptr<PluginManifestCache> manifest_cache;  ///< Plugin manifest cache. nullptr inspects every library.
+
   /**
    * @brief Constructor to help with initialisation.
    * @param pd Plugin directory.
@@ -77,6 +86,19 @@ public:
    */
   void activatePlugins(void);
 
+  /**
+   * @brief Get the frame pool the manager created for a plugin.
+   * @param plugin_name Plugin name.
+   * @return Frame pool, or nullptr if the plugin's device has no frame format.
+   */
+  std::shared_ptr<FramePool> getFramePool(const std::string& plugin_name) const;
+
+  /**
+   * @brief Get how long each plugin took to load and configure.
+   * @return Timings in plugin load order.
+   */
+  const std::vector<PluginTiming>& getStartupTimes(void) const;
+
 #ifndef HR_DEBUG
 private:
 #endif
@@ -87,6 +109,12 @@ private:
   /** Plugin manager. */
   PluginManager<soul::sense::SenseHwPluginInterface> pluginman_;
 
+  /** Frame pools by plugin name. */
+  std::unordered_map<std::string, std::shared_ptr<FramePool>> frame_pools_;
+
+  /** Plugin startup timings in load order. */
+  std::vector<PluginTiming> startup_times_;
+
   /**
    * @brief Load plugins.
    */
@@ -102,6 +130,12 @@ private:
    * @param plugin Pointer to the plugin.
    */
   void setupMessaging(SenseHwPluginInterface* plugin);
+
+  /**
+   * @brief Create a frame pool for the plugin if its device has a frame format.
+   * @param plugin Pointer to the plugin.
+   */
+  void setupFramePool(SenseHwPluginInterface* plugin);
 };
 
 }  // namespace sense
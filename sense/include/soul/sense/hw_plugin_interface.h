@@ -22,6 +22,7 @@
 #include <soul/sense/plugin_state.h>
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -37,6 +38,8 @@ namespace sense
 // CUSTOM DEFINITIONS                                                        //
 ///////////////////////////////////////////////////////////////////////////////
 
+class FramePool;
+
 /** Perception hardware error messages. */
 struct HwError
 {
@@ -108,6 +111,16 @@ public:
    * @param fn Message sending function.
    */
   virtual void setMessageSender(MessageSenderFn fn) = 0;
+
+  /**
+   * @brief Give the plugin a pool of frame buffers sized from its DeviceInfo. Only called for devices that set a
+   * frame format. Plugins that allocate their own frames can leave this alone.
+   * @param pool Frame pool.
+   */
+  virtual void setFramePool(std::shared_ptr<FramePool> pool)
+  {
+    (void)pool;
+  }
 };
 
 }  // namespace sense
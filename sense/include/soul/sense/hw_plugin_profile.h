@@ -18,6 +18,7 @@
 #include <soul/messaging/message_publisher.h>
 #include <soul/plugins/interface.h>
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -42,6 +43,16 @@ enum class DeviceType
   Camera,   ///< Cameras.
 };
 
+/**
+ * @brief Size and pixel type of one camera stream.
+ */
+struct FrameFormat
+{
+  int rows = 0;  ///< Frame height. 0 if the device doesn't produce this stream.
+  int cols = 0;  ///< Frame width.
+  int type = 0;  ///< OpenCV Mat type, e.g. CV_8UC3.
+};
+
 /**
  * @brief Hardware device information.
  */
@@ -51,6 +62,9 @@ struct DeviceInfo
   std::string id;                       ///< Device ID (in case we have multiple). Implement specifics as need arises.
   std::string name;                     ///< Name of the device.
   std::vector<std::string> attributes;  ///< Device attributes.
+  FrameFormat image_format;             ///< RGB frames. Setting it gets the plugin a frame pool.
+  FrameFormat depth_format;             ///< Depth frames. Setting it gets the plugin a frame pool.
+  std::size_t frame_pool_size = 0;      ///< Idle frames the pool keeps. 0 for the default.
 };
 
 /**
@@ -15,15 +15,27 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/messaging/bridge.h>
 #include <soul/messaging/manager.h>
+#include <soul/messaging/serialization.h>
 #include <soul/plugins/manager.h>
+#include <soul/plugins/manifest_cache.h>
+#include <soul/plugins/startup.h>
 #include <soul/sense/hw_manager.h>
 #include <soul/sense/plugin_interface.h>
+#include <soul/sense/plugin_thread.h>
+#include <soul/sense/plugin_topics.h>
 
+#include <chrono>
+#include <functional>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -42,8 +54,32 @@ namespace sense
  */
 struct SoulSenseManagerParameters
 {
-  std::string plugin_dir;    ///< Plugin directory containing all the perception plugins.
-  std::string section_name;  ///< Section name.
+  std::string plugin_dir;           ///< Plugin directory containing all the perception plugins.
+  std::string section_name;         ///< Section name.
+  std::size_t startup_workers = 1;  ///< Plugins loaded and configured at once. 0 uses every hardware thread.
+
+  std::shared_ptr<PluginManifestCache> manifest_cache;  ///< Plugin manifest cache. nullptr inspects every library.
+
+  /**
+   * Load plugins only when something subscribes to a topic they publish. Needs a topic manifest next to the plugin
+   * library (see plugin_topics.h). Libraries without one are always loaded.
+   */
+  bool lazy = false;
+
+  std::vector<std::string> required_plugins;  ///< Libraries loaded at start in lazy mode, without prefix and suffix.
+
+  std::shared_ptr<MessageTracer> tracer;  ///< Records message latencies from the start. nullptr turns tracing off.
+
+  std::string metrics_file;                          ///< Prometheus text file to keep up to date. Empty for none.
+  std::chrono::milliseconds metrics_period{ 10000 };  ///< Time between writes of the metrics file.
+
+  /** Address to export topics to other processes on, "unix:<path>" or "tcp:<host>:<port>". Empty for none. */
+  std::string bridge_address;
+
+  std::vector<std::string> bridge_topics;  ///< Topics the bridge exports. Their messages need a registered schema.
+
+  /** How long reloadPlugin() waits for the messages the old plugin sent to be delivered before unloading it. */
+  std::chrono::milliseconds reload_drain_timeout{ 1000 };
 
   /**
    * @brief Constructor to help with initialisation.
@@ -86,6 +122,38 @@ public:
    */
   void run(void);
 
+  /**
+   * @brief Get how long each plugin took to load and configure.
+   * @return Timings in plugin load order.
+   */
+  const std::vector<PluginTiming>& getStartupTimes(void) const;
+
+  /**
+   * @brief Get the metrics: the messaging manager's, plugin startup times, plugin thread inbox depths, and callback
+   * times and errors on plugin threads.
+   * @return Registry.
+   */
+  std::shared_ptr<MetricsRegistry> getMetrics(void) const;
+
+  /**
+   * @brief Load a plugin that lazy mode is holding back, and the plugins publishing what it subscribes to.
+   * @param library_name Library name without prefix and suffix.
+   * @return True if the plugin was waiting to be loaded, false if it is already loaded or unknown.
+   */
+  bool requirePlugin(const std::string& library_name);
+
+  /**
+   * @brief Replace a loaded plugin with a fresh copy of its library, e.g., to roll out a model update, while run()
+   * keeps going. The old instance stops receiving messages and finishes the callbacks it already has. Once the messages
+   * it sent are delivered it is unloaded, so subscribers must not keep them past their callbacks. The library is then
+   * loaded again, configured, wired in and, if the manager is running, activated. Other plugins' topics keep flowing
+   * throughout. Must not be called from a subscriber callback.
+   * @param library_name Library name without prefix and suffix.
+   * @return False if the plugin isn't loaded, its messages weren't delivered within reload_drain_timeout (the old
+   * instance is then wired back in), or its library no longer loads.
+   */
+  bool reloadPlugin(const std::string& library_name);
+
 #ifndef HR_DEBUG
 private:
 #endif
@@ -104,6 +172,36 @@ private:
   /** Hardware manager. */
   std::unique_ptr<SoulSenseHwManager> hwman_;
 
+  /** Plugin startup timings in load order. Lazily loaded plugins are appended when they load. */
+  std::vector<PluginTiming> startup_times_;
+
+  /** Lock for lazy_plugins_, activated_, plugin_threads_ and loading plugins after the constructor. */
+  std::recursive_mutex lazy_lock_;
+
+  /** Serialises reloads. Unlike lazy_lock_ it is held while a reload waits for callbacks to finish. */
+  std::mutex reload_lock_;
+
+  /** Libraries lazy mode hasn't loaded yet, with the topics they declare. */
+  std::map<std::string, PluginTopics> lazy_plugins_;
+
+  /** Whether run() has activated the plugins, so lazily loaded ones must be activated as they load. */
+  bool activated_;
+
+  /** Worker threads of the plugins that run in their own thread, by plugin name. */
+  std::unordered_map<std::string, std::unique_ptr<PluginThread>> plugin_threads_;
+
+  /** ID of the collector that reads the plugin thread metrics. */
+  std::size_t metrics_collector_;
+
+  /** Writes the metrics file, if there is one. */
+  std::unique_ptr<MetricsDumper> metrics_dumper_;
+
+  /** Schemas of the sense and knowledge messages, for the bridge. Must outlive it. */
+  SerialCodecRegistry codecs_;
+
+  /** Exports topics to other processes, if there is an address. */
+  std::unique_ptr<MessageBridge> bridge_;
+
   /**
    * @brief Load perception plugins.
    */
@@ -114,16 +212,89 @@ private:
    */
   void configurePlugins(void);
 
+  /**
+   * @brief Configure some of the loaded plugins and set up their messaging.
+   * @param names Plugin names in load order.
+   */
+  void configure(const std::vector<std::string>& names);
+
+  /**
+   * @brief Take the lazy plugins that publish any of the topics, and the ones publishing what those subscribe to.
+   * @param topics Topics wanted.
+   * @return Library names, sorted. They are no longer in lazy_plugins_.
+   */
+  std::vector<std::string> takeLazyPublishers(std::vector<std::string> topics);
+
+  /**
+   * @brief Load, configure and, if the manager is running, activate plugins lazy mode held back.
+   * @param library_names Library names without prefix and suffix.
+   */
+  void loadLazily(const std::vector<std::string>& library_names);
+
+  /**
+   * @brief Called when a topic gets a new subscriber. Loads the lazy plugins that publish it.
+   * @param msg_id Topic ID.
+   */
+  void onSubscription(const std::string& msg_id);
+
   /**
    * @brief Start the plugins. Threaded plugins will be run here.
    */
   void activatePlugins(void);
 
   /**
-   * @brief Setup messaging for the plugin.
+   * @brief Start one plugin, on its own thread if it has one.
+   * @param plugin Pointer to the plugin.
+   */
+  void activatePlugin(SensePluginInterface* plugin);
+
+  /**
+   * @brief Setup messaging for the plugin. Plugins that want their own thread get it here, and their subscriber
+   * callbacks are routed to it.
    * @param plugin Pointer to the plugin.
    */
   void setupMessaging(SensePluginInterface* plugin);
+
+  /**
+   * @brief Get the metrics of a subscriber whose callbacks run on a plugin thread.
+   * @param sub Subscriber.
+   * @return Metrics.
+   */
+  SubscriberMetrics getWorkerMetrics(const MessageSubscriber& sub);
+
+  /**
+   * @brief Run a subscriber callback on a plugin thread, recording its metrics and tracing it if tracing is on.
+   * @param sub Subscriber.
+   * @param metrics Subscriber metrics from getWorkerMetrics().
+   * @param call Calls the callback.
+   * @param msg Message it handles. The newest one for batch callbacks.
+   * @param messages Messages it handles.
+   */
+  void runWorkerCallback(const MessageSubscriber& sub, const SubscriberMetrics& metrics,
+                         const std::function<void()>& call, const MessageInterface* msg, const std::size_t messages);
+
+  /**
+   * @brief Add plugin startup times to the metrics.
+   * @param timings Timings.
+   */
+  void recordStartupTimes(const std::vector<PluginTiming>& timings);
+
+  /**
+   * @brief Bring the plugin thread metrics up to date.
+   */
+  void collectMetrics(void);
+
+  /**
+   * @brief Stop a plugin and take it off the messaging system so it can be unloaded. Waits for callbacks into it that
+   * are already running or queued.
+   * @param plugin Pointer to the plugin.
+   */
+  void retirePlugin(SensePluginInterface* plugin);
+
+  /**
+   * @brief Stop the plugin threads. Callbacks already queued for them still run.
+   */
+  void stopPluginThreads(void);
 };
 
 }  // namespace sense
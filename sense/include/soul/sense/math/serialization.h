@@ -0,0 +1,247 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_MATH_SERIALIZATION_H_
+#define SOUL_SENSE_MATH_SERIALIZATION_H_
+
+/*
+ * Binary serialization of the math types.
+ *
+ * The math types are values inside messages rather than messages, so they have
+ * no schema of their own: their layout is part of the layout of the message
+ * that holds them. Each is its components in order, at the width of T. int is
+ * stored as 32 bits.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/serialization.h>
+#include <soul/sense/math/bounding_box.h>
+#include <soul/sense/math/point.h>
+#include <soul/sense/math/pose.h>
+#include <soul/sense/math/quaternion.h>
+#include <soul/sense/math/size.h>
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+namespace math
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+static_assert(sizeof(int) == sizeof(std::int32_t), "int components are stored as 32 bits");
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write a 2D point.
+ * @param writer Writer.
+ * @param point 2D point.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Point2<T>& point)
+{
+  writer.write(point.getX());
+  writer.write(point.getY());
+}
+
+/**
+ * @brief Read a 2D point.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return 2D point.
+ */
+template <typename T>
+Point2<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Point2<T>>)
+{
+  (void)version;
+  const auto x = reader.read<T>();
+  const auto y = reader.read<T>();
+  return Point2<T>(x, y);
+}
+
+/**
+ * @brief Write a 3D point.
+ * @param writer Writer.
+ * @param point 3D point.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Point3<T>& point)
+{
+  writer.write(point.getX());
+  writer.write(point.getY());
+  writer.write(point.getZ());
+}
+
+/**
+ * @brief Read a 3D point.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return 3D point.
+ */
+template <typename T>
+Point3<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Point3<T>>)
+{
+  (void)version;
+  const auto x = reader.read<T>();
+  const auto y = reader.read<T>();
+  const auto z = reader.read<T>();
+  return Point3<T>(x, y, z);
+}
+
+/**
+ * @brief Write a 2D size.
+ * @param writer Writer.
+ * @param size 2D size.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Size2<T>& size)
+{
+  writer.write(size.getWidth());
+  writer.write(size.getHeight());
+}
+
+/**
+ * @brief Read a 2D size.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return 2D size.
+ */
+template <typename T>
+Size2<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Size2<T>>)
+{
+  (void)version;
+  const auto width = reader.read<T>();
+  const auto height = reader.read<T>();
+  return Size2<T>(width, height);
+}
+
+/**
+ * @brief Write a 3D size.
+ * @param writer Writer.
+ * @param size 3D size.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Size3<T>& size)
+{
+  writer.write(size.getWidth());
+  writer.write(size.getHeight());
+  writer.write(size.getDepth());
+}
+
+/**
+ * @brief Read a 3D size.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return 3D size.
+ */
+template <typename T>
+Size3<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Size3<T>>)
+{
+  (void)version;
+  const auto width = reader.read<T>();
+  const auto height = reader.read<T>();
+  const auto depth = reader.read<T>();
+  return Size3<T>(width, height, depth);
+}
+
+/**
+ * @brief Write a quaternion.
+ * @param writer Writer.
+ * @param q Quaternion.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Quaternion<T>& q)
+{
+  writer.write(q.getX());
+  writer.write(q.getY());
+  writer.write(q.getZ());
+  writer.write(q.getW());
+}
+
+/**
+ * @brief Read a quaternion.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return Quaternion.
+ */
+template <typename T>
+Quaternion<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Quaternion<T>>)
+{
+  (void)version;
+  const auto x = reader.read<T>();
+  const auto y = reader.read<T>();
+  const auto z = reader.read<T>();
+  const auto w = reader.read<T>();
+  return Quaternion<T>(x, y, z, w);
+}
+
+/**
+ * @brief Write a pose.
+ * @param writer Writer.
+ * @param pose Pose.
+ */
+template <typename T>
+void serializeFields(SerialWriter& writer, const Pose<T>& pose)
+{
+  serializeFields(writer, pose.getPosition());
+  serializeFields(writer, pose.getOrientation());
+}
+
+/**
+ * @brief Read a pose.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return Pose.
+ */
+template <typename T>
+Pose<T> deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Pose<T>>)
+{
+  const auto position = deserializeFields(reader, version, SerialTag<Point3<T>>());
+  const auto orientation = deserializeFields(reader, version, SerialTag<Quaternion<T>>());
+  return Pose<T>(position, orientation);
+}
+
+/**
+ * @brief Write a bounding box.
+ * @param writer Writer.
+ * @param bbox Bounding box.
+ */
+inline void serializeFields(SerialWriter& writer, const BoundingBox& bbox)
+{
+  serializeFields(writer, bbox.getPoint());
+  serializeFields(writer, bbox.getSize());
+}
+
+/**
+ * @brief Read a bounding box.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return Bounding box.
+ */
+inline BoundingBox deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<BoundingBox>)
+{
+  const auto point = deserializeFields(reader, version, SerialTag<Point3i>());
+  const auto size = deserializeFields(reader, version, SerialTag<Size3i>());
+  return BoundingBox(point, size);
+}
+
+}  // namespace math
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_MATH_SERIALIZATION_H_
@@ -20,6 +20,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -51,9 +52,8 @@ public:
    * pose detector employed.
    * @param poses The poses of the detected body parts in world coordinates.
    */
-  explicit BodyParts(const Header header, std::vector<std::string> names,
-                     const std::vector<soul::sense::math::Pose3f> poses)
-    : SenseMessageInterface(header), names_(names), poses_(poses)
+  explicit BodyParts(Header header, std::vector<std::string> names, std::vector<soul::sense::math::Pose3f> poses)
+    : SenseMessageInterface(std::move(header)), names_(std::move(names)), poses_(std::move(poses))
   {
   }
 
@@ -61,7 +61,7 @@ public:
    * @brief Get the names of the detected body parts.
    * @return body part names.
    */
-  std::vector<std::string> getNames() const
+  const std::vector<std::string>& getNames() const
   {
     return names_;
   }
@@ -70,7 +70,7 @@ public:
    * @brief Get the poses of the detected body parts.
    * @return 3D poses.
    */
-  std::vector<soul::sense::math::Pose3f> getPoses() const
+  const std::vector<soul::sense::math::Pose3f>& getPoses() const
   {
     return poses_;
   }
@@ -78,8 +78,8 @@ public:
 #ifndef HR_DEBUG
 private:
 #endif
-  const std::vector<std::string> names_;
-  const std::vector<soul::sense::math::Pose3f> poses_;
+  std::vector<std::string> names_;
+  std::vector<soul::sense::math::Pose3f> poses_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -19,6 +19,8 @@
 #include <soul/sense/math/bounding_box.h>
 #include <soul/messaging/list.h>
 
+#include <utility>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -51,8 +53,8 @@ public:
    * @param face_image The cropped images of the person's faces.
    * @param bbox The bounding box indicating the location of the detected face in the source image.
    */
-  explicit FaceDetection(const Header header, const Image face_image, const soul::sense::math::BoundingBox bbox)
-    : SenseMessageInterface(header), face_image_(face_image), bbox_(bbox)
+  explicit FaceDetection(Header header, Image face_image, const soul::sense::math::BoundingBox bbox)
+    : SenseMessageInterface(std::move(header)), face_image_(std::move(face_image)), bbox_(bbox)
   {
   }
 
@@ -60,7 +62,7 @@ public:
    * @brief Get the cropped images of the person's face.
    * @return the cropped face image.
    */
-  Image getFaceImage(void) const
+  const Image& getFaceImage(void) const
   {
     return face_image_;
   }
@@ -69,7 +71,7 @@ public:
    * @brief Get bounding boxes indicating the location of the detected face in the source image.
    * @return the bounding boxes.
    */
-  soul::sense::math::BoundingBox getBoundingBox(void) const
+  const soul::sense::math::BoundingBox& getBoundingBox(void) const
   {
     return bbox_;
   }
@@ -17,6 +17,7 @@
 #include <soul/sense/msg/sense_msg.h>
 #include <soul/messaging/list.h>
 
+#include <utility>
 #include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -50,8 +51,8 @@ public:
    * image timestamp obtained from the camera driver firmware.
    * @param encodings The face encoding for a detected face.
    */
-  explicit FaceEncoding(const Header header, const std::vector<float> encoding)
-    : SenseMessageInterface(header), encoding_(encoding)
+  explicit FaceEncoding(Header header, std::vector<float> encoding)
+    : SenseMessageInterface(std::move(header)), encoding_(std::move(encoding))
   {
   }
 
@@ -59,7 +60,7 @@ public:
    * @brief Get the face encoding for a detected face.
    * @return the encodings.
    */
-  std::vector<float> getEncoding() const
+  const std::vector<float>& getEncoding() const
   {
     return encoding_;
   }
@@ -20,6 +20,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -55,9 +56,9 @@ public:
    * @param landmarks A vector of 3D image coordinates for the face landmarks for a detected face. If 2D image
    * coordinates (i.e. no depth) then for each point set z to zero.
    */
-  explicit FaceLandmarks(const Header header, const std::vector<std::string> names,
-                         const std::vector<soul::sense::math::Point3i> landmarks)
-    : SenseMessageInterface(header), names_(names), landmarks_(landmarks)
+  explicit FaceLandmarks(Header header, std::vector<std::string> names,
+                         std::vector<soul::sense::math::Point3i> landmarks)
+    : SenseMessageInterface(std::move(header)), names_(std::move(names)), landmarks_(std::move(landmarks))
   {
   }
 
@@ -65,7 +66,7 @@ public:
    * @brief Get the names of the face landmarks.
    * @return landmark names.
    */
-  std::vector<std::string> getNames() const
+  const std::vector<std::string>& getNames() const
   {
     return names_;
   }
@@ -74,7 +75,7 @@ public:
    * @brief Get the face landmark image coordinates.
    * @return landmarks.
    */
-  std::vector<soul::sense::math::Point3i> getLandmarks() const
+  const std::vector<soul::sense::math::Point3i>& getLandmarks() const
   {
     return landmarks_;
   }
@@ -82,8 +83,8 @@ public:
 #ifndef HR_DEBUG
 private:
 #endif
-  const std::vector<std::string> names_;
-  const std::vector<soul::sense::math::Point3i> landmarks_;
+  std::vector<std::string> names_;
+  std::vector<soul::sense::math::Point3i> landmarks_;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -15,6 +15,7 @@
 
 #include <chrono>
 #include <string>
+#include <utility>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -52,8 +53,8 @@ public:
    * @param timestamp The \a time that source sensor data was captured.
    * @param frame_id The coordinate frame \a where source sensor data originated.
    */
-  explicit Header(const std::chrono::system_clock::time_point timestamp, const std::string frame_id)
-    : timestamp_(timestamp), frame_id_(frame_id)
+  explicit Header(const std::chrono::system_clock::time_point timestamp, std::string frame_id)
+    : timestamp_(timestamp), frame_id_(std::move(frame_id))
   {
   }
 
@@ -70,7 +71,7 @@ public:
    * @brief Get the coordinate frame \a where source sensor data originated.
    * @return the frame id.
    */
-  std::string getFrameId(void) const
+  const std::string& getFrameId(void) const
   {
     return frame_id_;
   }
@@ -17,6 +17,8 @@
 #include <soul/sense/msg/header.h>
 #include <opencv2/opencv.hpp>
 
+#include <utility>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -49,8 +51,8 @@ public:
    * @param image The RGB image.
    * @param depth The depth image.
    */
-  explicit Image(const Header header, const cv::Mat image, const cv::Mat depth = cv::Mat())
-    : SenseMessageInterface(header), image_(image), depth_(depth)
+  explicit Image(Header header, cv::Mat image, cv::Mat depth = cv::Mat())
+    : SenseMessageInterface(std::move(header)), image_(std::move(image)), depth_(std::move(depth))
   {
   }
 
@@ -58,7 +60,7 @@ public:
    * @brief Get the RGB image.
    * @return the RGB image.
    */
-  cv::Mat getImage(void) const
+  const cv::Mat& getImage(void) const
   {
     return image_;
   }
@@ -67,7 +69,7 @@ public:
    * @brief Get the depth image.
    * @return the depth image.
    */
-  cv::Mat getDepth(void) const
+  const cv::Mat& getDepth(void) const
   {
     return depth_;
   }
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_IMAGE_CODEC_H_
+#define SOUL_SENSE_IMAGE_CODEC_H_
+
+/*
+ * Shared memory codec for Image messages.
+ *
+ * Slot layout: ImageSlotHeader, the frame id, then the RGB and depth pixels,
+ * each starting on a 64 byte boundary. Decoding copies nothing: the decoded
+ * cv::Mats point straight into the slot, so they are read-only and only valid
+ * while the decoded message is alive. Clone them to keep pixels any longer.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/shm_transport.h>
+#include <soul/sense/msg/image.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+namespace msg
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/** Where one cv::Mat lives in a slot. */
+struct ImageSlotMat
+{
+  std::int32_t rows;     ///< Rows, 0 for an empty Mat.
+  std::int32_t cols;     ///< Columns.
+  std::int32_t type;     ///< OpenCV type.
+  std::int32_t pad;      ///< Unused.
+  std::uint64_t offset;  ///< Offset of the first pixel from the start of the slot.
+};
+
+/** Start of an Image slot. */
+struct ImageSlotHeader
+{
+  std::int64_t timestamp_ns;    ///< Header timestamp, nanoseconds since the epoch.
+  std::uint64_t frame_id_size;  ///< Length of the frame id that follows.
+  ImageSlotMat image;           ///< RGB image.
+  ImageSlotMat depth;           ///< Depth image.
+};
+
+/**
+ * @brief Round an offset up to the 64 byte pixel alignment.
+ * @param n Offset.
+ * @return Aligned offset.
+ */
+inline std::size_t imageSlotAlign(const std::size_t n)
+{
+  return (n + 63) & ~static_cast<std::size_t>(63);
+}
+
+/**
+ * @brief Get the number of pixel bytes in a Mat, without row padding.
+ * @param mat Mat.
+ * @return Bytes.
+ */
+inline std::size_t imageSlotBytes(const cv::Mat& mat)
+{
+  return static_cast<std::size_t>(mat.rows) * mat.cols * mat.elemSize();
+}
+
+/**
+ * @brief Work out where everything goes in a slot.
+ * @param image Message to lay out.
+ * @param header Receives the layout.
+ * @return Total bytes.
+ */
+inline std::size_t imageSlotLayout(const Image& image, ImageSlotHeader& header)
+{
+  const auto& rgb = image.getImage();
+  const auto& depth = image.getDepth();
+  const auto& frame_id = image.getHeader().getFrameId();
+
+  header.timestamp_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(image.getHeader().getTimestamp().time_since_epoch()).count();
+  header.frame_id_size = frame_id.size();
+
+  header.image = { rgb.rows, rgb.cols, rgb.type(), 0, imageSlotAlign(sizeof(ImageSlotHeader) + frame_id.size()) };
+  header.depth = { depth.rows, depth.cols, depth.type(), 0, imageSlotAlign(header.image.offset + imageSlotBytes(rgb)) };
+
+  return header.depth.offset + imageSlotBytes(depth);
+}
+
+/**
+ * @brief Copy a Mat's pixels into a slot row by row, so non-continuous Mats (ROIs) work too.
+ * @param mat Mat.
+ * @param dst Where the pixels go.
+ */
+inline void imageSlotCopy(const cv::Mat& mat, std::uint8_t* dst)
+{
+  const std::size_t row_bytes = mat.cols * mat.elemSize();
+
+  for (int r = 0; r < mat.rows; ++r)
+    std::memcpy(dst + r * row_bytes, mat.ptr(r), row_bytes);
+}
+
+/**
+ * @brief Check that a Mat described by a slot lies within it. The slot is written by another process, so none of it
+ * can be trusted.
+ * @param info Where the Mat lives.
+ * @param size Size of the slot contents.
+ * @return True if the Mat is empty or its pixels are inside the slot.
+ */
+inline bool imageSlotCheck(const ImageSlotMat& info, const std::size_t size)
+{
+  if (info.rows == 0)
+    return true;
+
+  if (info.rows < 0 || info.cols <= 0 || info.type < 0 || info.type != CV_MAT_TYPE(info.type))
+    return false;
+
+  // Divide rather than multiply, so huge dimensions can't overflow past the check.
+  const std::uint64_t pixels = static_cast<std::uint64_t>(info.rows) * static_cast<std::uint64_t>(info.cols);
+  const std::uint64_t elem_size = CV_ELEM_SIZE(info.type);
+  if (pixels > size / elem_size)
+    return false;
+
+  return info.offset <= size && pixels * elem_size <= size - info.offset;
+}
+
+/**
+ * @brief Wrap pixels in a slot without copying them. Check the Mat with imageSlotCheck() first.
+ * @param info Where the Mat lives.
+ * @param src Start of the slot.
+ * @return Mat over the slot, or an empty Mat.
+ */
+inline cv::Mat imageSlotMat(const ImageSlotMat& info, const std::uint8_t* src)
+{
+  if (info.rows == 0)
+    return cv::Mat();
+
+  return cv::Mat(info.rows, info.cols, info.type, const_cast<std::uint8_t*>(src + info.offset));
+}
+
+/**
+ * @brief Make a shared memory codec for Image messages.
+ * @return The codec.
+ */
+inline ShmCodec makeImageShmCodec(void)
+{
+  ShmCodec codec;
+
+  codec.size = [](const MessageInterface& msg) {
+    ImageSlotHeader header;
+    return imageSlotLayout(static_cast<const Image&>(msg), header);
+  };
+
+  codec.encode = [](const MessageInterface& msg, std::uint8_t* dst) {
+    const auto& image = static_cast<const Image&>(msg);
+
+    ImageSlotHeader header;
+    imageSlotLayout(image, header);
+    std::memcpy(dst, &header, sizeof(header));
+
+    const auto& frame_id = image.getHeader().getFrameId();
+    std::memcpy(dst + sizeof(header), frame_id.data(), frame_id.size());
+
+    imageSlotCopy(image.getImage(), dst + header.image.offset);
+    imageSlotCopy(image.getDepth(), dst + header.depth.offset);
+  };
+
+  codec.decode = [](const std::uint8_t* src, const std::size_t size, std::shared_ptr<const void> lease) {
+    if (size < sizeof(ImageSlotHeader))
+      throw std::runtime_error("Image slot too small for its header");
+
+    // Work from a copy, so the producer can't change the layout between the checks and their use.
+    ImageSlotHeader header;
+    std::memcpy(&header, src, sizeof(header));
+
+    if (header.frame_id_size > size - sizeof(header) || !imageSlotCheck(header.image, size) ||
+        !imageSlotCheck(header.depth, size))
+      throw std::runtime_error("Image slot layout out of bounds");
+
+    const std::chrono::system_clock::time_point timestamp(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(header.timestamp_ns)));
+    const std::string frame_id(reinterpret_cast<const char*>(src + sizeof(header)), header.frame_id_size);
+
+    auto* image =
+        new Image(Header(timestamp, frame_id), imageSlotMat(header.image, src), imageSlotMat(header.depth, src));
+
+    // The slot goes back to the producer when the message is deleted.
+    return std::shared_ptr<MessageInterface>(image, [lease](MessageInterface* p) { delete p; });
+  };
+
+  return codec;
+}
+
+}  // namespace msg
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_IMAGE_CODEC_H_
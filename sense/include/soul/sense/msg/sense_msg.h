@@ -16,6 +16,8 @@
 #include <soul/messaging/interface.h>
 #include <soul/sense/msg/header.h>
 
+#include <utility>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,7 +37,7 @@ namespace msg
  * indicating the time and coordinate frame of the originating sensor data.
  */
 
-class SenseMessageInterface : MessageInterface
+class SenseMessageInterface : public MessageInterface
 {
 public:
   /**
@@ -43,15 +45,17 @@ public:
    * @param header The header indicates the time and originating location of source data. The image timestamp obtained
    * from the sensor firmware should be used to set the header's timestamp.
    */
-  explicit SenseMessageInterface(const Header header) : header_(header)
+  explicit SenseMessageInterface(Header header) : header_(std::move(header))
   {
+    // Derived messages copy the header, so they keep the capture time. inheritTrace() puts them on its trace.
+    timestamp = header_.getTimestamp();
   }
 
   /**
    * @brief Get the header that indicates the time and originating location of source data.
    * @return the header.
    */
-  Header getHeader(void) const
+  const Header& getHeader(void) const
   {
     return header_;
   }
@@ -0,0 +1,416 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_MSG_SERIALIZATION_H_
+#define SOUL_SENSE_MSG_SERIALIZATION_H_
+
+/*
+ * Binary serialization of the sense messages (see soul/messaging/serialization.h).
+ *
+ * Layouts, version 1:
+ *
+ *   Header         int64 timestamp in ns since the epoch, string frame id.
+ *   cv::Mat        int32 rows, cols and OpenCV type, then, unless empty, the
+ *                  pixels from a 64 byte aligned offset, without row padding.
+ *   Image          Header, RGB Mat, depth Mat.
+ *   FaceDetection  Header, Image with its schema header, BoundingBox.
+ *   FaceEncoding   Header, float array.
+ *   FaceLandmarks  Header, names, int32 array of x, y, z per landmark.
+ *   BodyParts      Header, names, float array of x, y, z, qx, qy, qz, qw per
+ *                  pose.
+ *
+ * Names are a uint32 count followed by the strings. Decoded Mats point into the
+ * buffer: they are read-only and only valid while the decoded message is
+ * alive. Clone them to keep pixels any longer. The other arrays are copied
+ * into the messages, which own their vectors; readers that only need to look
+ * can use SerialReader::readArray() views instead.
+ *
+ * Sense types are numbered from 0x100.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/serialization.h>
+#include <soul/sense/math/serialization.h>
+#include <soul/sense/msg/body_parts.h>
+#include <soul/sense/msg/face_detection.h>
+#include <soul/sense/msg/face_encoding.h>
+#include <soul/sense/msg/face_landmarks.h>
+#include <soul/sense/msg/header.h>
+#include <soul/sense/msg/image.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+template <>
+struct SerialSchema<sense::msg::Image>
+{
+  static constexpr std::uint32_t type = 0x100;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+template <>
+struct SerialSchema<sense::msg::FaceDetection>
+{
+  static constexpr std::uint32_t type = 0x101;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+template <>
+struct SerialSchema<sense::msg::FaceEncoding>
+{
+  static constexpr std::uint32_t type = 0x102;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+template <>
+struct SerialSchema<sense::msg::FaceLandmarks>
+{
+  static constexpr std::uint32_t type = 0x103;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+template <>
+struct SerialSchema<sense::msg::BodyParts>
+{
+  static constexpr std::uint32_t type = 0x104;  ///< Type number.
+  static constexpr std::uint32_t version = 1;   ///< Layout version.
+};
+
+namespace sense
+{
+namespace msg
+{
+/** Pixel data starts on offsets that are a multiple of this. */
+constexpr std::size_t serial_pixel_alignment_ = 64;
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Write a message header.
+ * @param writer Writer.
+ * @param header Header.
+ */
+inline void serializeFields(SerialWriter& writer, const Header& header)
+{
+  writer.write(static_cast<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(header.getTimestamp().time_since_epoch()).count()));
+  writer.writeString(header.getFrameId());
+}
+
+/**
+ * @brief Read a message header.
+ * @param reader Reader.
+ * @param version Layout version of the message holding it.
+ * @return Header.
+ */
+inline Header deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Header>)
+{
+  (void)version;
+
+  const auto timestamp_ns = reader.read<std::int64_t>();
+  const std::chrono::system_clock::time_point timestamp(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(timestamp_ns)));
+
+  return Header(timestamp, reader.readString());
+}
+
+/**
+ * @brief Write a 2D Mat. Non-continuous Mats (ROIs) are written row by row.
+ * @param writer Writer.
+ * @param mat Mat.
+ */
+inline void serializeMat(SerialWriter& writer, const cv::Mat& mat)
+{
+  const bool empty = mat.empty();
+  writer.write(static_cast<std::int32_t>(empty ? 0 : mat.rows));
+  writer.write(static_cast<std::int32_t>(empty ? 0 : mat.cols));
+  writer.write(static_cast<std::int32_t>(empty ? 0 : mat.type()));
+
+  if (empty)
+    return;
+
+  writer.align(serial_pixel_alignment_);
+
+  const std::size_t row_bytes = mat.cols * mat.elemSize();
+  auto* dst = writer.reserve(mat.rows * row_bytes);
+
+  if (dst == nullptr)
+    return;
+
+  if (mat.isContinuous())
+  {
+    std::memcpy(dst, mat.data, mat.rows * row_bytes);
+    return;
+  }
+
+  for (int r = 0; r < mat.rows; ++r)
+    std::memcpy(dst + r * row_bytes, mat.ptr(r), row_bytes);
+}
+
+/**
+ * @brief Read a Mat without copying its pixels.
+ * @param reader Reader.
+ * @return Read-only Mat over the reader's buffer, or an empty Mat.
+ */
+inline cv::Mat deserializeMat(SerialReader& reader)
+{
+  const auto rows = reader.read<std::int32_t>();
+  const auto cols = reader.read<std::int32_t>();
+  const auto type = reader.read<std::int32_t>();
+
+  if (rows == 0)
+    return cv::Mat();
+
+  if (rows < 0 || cols <= 0 || CV_MAT_TYPE(type) != type)
+    reader.fail("invalid Mat " + std::to_string(rows) + "x" + std::to_string(cols) + " of type " +
+                std::to_string(type));
+
+  reader.align(serial_pixel_alignment_);
+
+  const std::size_t row_bytes = static_cast<std::size_t>(cols) * CV_ELEM_SIZE(type);
+  if (static_cast<std::size_t>(rows) > reader.remaining() / row_bytes)
+    reader.fail("Mat pixels run past the end");
+
+  const auto* pixels = reader.readBytes(rows * row_bytes);
+  return cv::Mat(rows, cols, type, const_cast<std::uint8_t*>(pixels));
+}
+
+/**
+ * @brief Write names.
+ * @param writer Writer.
+ * @param names Names.
+ */
+inline void serializeNames(SerialWriter& writer, const std::vector<std::string>& names)
+{
+  writer.write(static_cast<std::uint32_t>(names.size()));
+
+  for (const auto& name : names)
+    writer.writeString(name);
+}
+
+/**
+ * @brief Read names.
+ * @param reader Reader.
+ * @return Names.
+ */
+inline std::vector<std::string> deserializeNames(SerialReader& reader)
+{
+  const auto size = reader.read<std::uint32_t>();
+
+  // Each name takes at least its length, which keeps a corrupt count from reserving the world.
+  if (size > reader.remaining() / sizeof(std::uint32_t))
+    reader.fail(std::to_string(size) + " names run past the end");
+
+  std::vector<std::string> names;
+  names.reserve(size);
+
+  for (std::uint32_t i = 0; i < size; ++i)
+    names.push_back(reader.readString());
+
+  return names;
+}
+
+/**
+ * @brief Write an image.
+ * @param writer Writer.
+ * @param image Image.
+ */
+inline void serializeFields(SerialWriter& writer, const Image& image)
+{
+  serializeFields(writer, image.getHeader());
+  serializeMat(writer, image.getImage());
+  serializeMat(writer, image.getDepth());
+}
+
+/**
+ * @brief Read an image without copying its pixels.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Image.
+ */
+inline Image deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<Image>)
+{
+  auto header = deserializeFields(reader, version, SerialTag<Header>());
+  auto image = deserializeMat(reader);
+  auto depth = deserializeMat(reader);
+
+  return Image(std::move(header), std::move(image), std::move(depth));
+}
+
+/**
+ * @brief Write a face detection.
+ * @param writer Writer.
+ * @param detection Face detection.
+ */
+inline void serializeFields(SerialWriter& writer, const FaceDetection& detection)
+{
+  serializeFields(writer, detection.getHeader());
+  serializeMessage(writer, detection.getFaceImage());
+  serializeFields(writer, detection.getBoundingBox());
+}
+
+/**
+ * @brief Read a face detection without copying the face image's pixels.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Face detection.
+ */
+inline FaceDetection deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<FaceDetection>)
+{
+  auto header = deserializeFields(reader, version, SerialTag<Header>());
+  auto face_image = deserializeMessage<Image>(reader);
+  const auto bbox = deserializeFields(reader, version, SerialTag<math::BoundingBox>());
+
+  return FaceDetection(std::move(header), std::move(face_image), bbox);
+}
+
+/**
+ * @brief Write a face encoding.
+ * @param writer Writer.
+ * @param encoding Face encoding.
+ */
+inline void serializeFields(SerialWriter& writer, const FaceEncoding& encoding)
+{
+  serializeFields(writer, encoding.getHeader());
+  writer.writeArray(encoding.getEncoding().data(), encoding.getEncoding().size());
+}
+
+/**
+ * @brief Read a face encoding.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Face encoding.
+ */
+inline FaceEncoding deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<FaceEncoding>)
+{
+  auto header = deserializeFields(reader, version, SerialTag<Header>());
+  return FaceEncoding(std::move(header), reader.readArray<float>().toVector());
+}
+
+/**
+ * @brief Write face landmarks.
+ * @param writer Writer.
+ * @param landmarks Face landmarks.
+ */
+inline void serializeFields(SerialWriter& writer, const FaceLandmarks& landmarks)
+{
+  serializeFields(writer, landmarks.getHeader());
+  serializeNames(writer, landmarks.getNames());
+
+  const auto& points = landmarks.getLandmarks();
+  writer.write(static_cast<std::uint64_t>(points.size() * 3));
+  writer.align(serial_alignment_);
+
+  for (const auto& point : points)
+    math::serializeFields(writer, point);
+}
+
+/**
+ * @brief Read face landmarks.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Face landmarks.
+ */
+inline FaceLandmarks deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<FaceLandmarks>)
+{
+  auto header = deserializeFields(reader, version, SerialTag<Header>());
+  auto names = deserializeNames(reader);
+
+  const auto coords = reader.readArray<std::int32_t>();
+  if (coords.size() % 3 != 0)
+    reader.fail("landmark coordinates don't come in threes");
+
+  std::vector<math::Point3i> points;
+  points.reserve(coords.size() / 3);
+
+  for (std::size_t i = 0; i < coords.size(); i += 3)
+    points.emplace_back(coords.at(i), coords.at(i + 1), coords.at(i + 2));
+
+  return FaceLandmarks(std::move(header), std::move(names), std::move(points));
+}
+
+/**
+ * @brief Write body parts.
+ * @param writer Writer.
+ * @param body_parts Body parts.
+ */
+inline void serializeFields(SerialWriter& writer, const BodyParts& body_parts)
+{
+  serializeFields(writer, body_parts.getHeader());
+  serializeNames(writer, body_parts.getNames());
+
+  const auto& poses = body_parts.getPoses();
+  writer.write(static_cast<std::uint64_t>(poses.size() * 7));
+  writer.align(serial_alignment_);
+
+  for (const auto& pose : poses)
+    math::serializeFields(writer, pose);
+}
+
+/**
+ * @brief Read body parts.
+ * @param reader Reader.
+ * @param version Layout version.
+ * @return Body parts.
+ */
+inline BodyParts deserializeFields(SerialReader& reader, const std::uint32_t version, SerialTag<BodyParts>)
+{
+  auto header = deserializeFields(reader, version, SerialTag<Header>());
+  auto names = deserializeNames(reader);
+
+  const auto values = reader.readArray<float>();
+  if (values.size() % 7 != 0)
+    reader.fail("pose values don't come in sevens");
+
+  std::vector<math::Pose3f> poses;
+  poses.reserve(values.size() / 7);
+
+  for (std::size_t i = 0; i < values.size(); i += 7)
+  {
+    const math::Point3f position(values.at(i), values.at(i + 1), values.at(i + 2));
+    const math::Quaternionf orientation(values.at(i + 3), values.at(i + 4), values.at(i + 5), values.at(i + 6));
+    poses.emplace_back(position, orientation);
+  }
+
+  return BodyParts(std::move(header), std::move(names), std::move(poses));
+}
+
+/**
+ * @brief Add the sense messages, and lists of them, to a codec registry.
+ * @param registry Registry.
+ */
+inline void addSenseSchemas(SerialCodecRegistry& registry)
+{
+  registry.addWithList<Image>();
+  registry.addWithList<FaceDetection>();
+  registry.addWithList<FaceEncoding>();
+  registry.addWithList<FaceLandmarks>();
+  registry.addWithList<BodyParts>();
+}
+
+}  // namespace msg
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_MSG_SERIALIZATION_H_
@@ -20,6 +20,8 @@
 #include <soul/messaging/message_subscriber.h>
 #include <soul/plugins/interface.h>
 
+#include <vector>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,12 +34,22 @@ namespace sense
 // CUSTOM DEFINITIONS                                                        //
 ///////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief Settings for the worker thread of a plugin that runs in its own thread.
+ */
+struct PluginThreadOptions
+{
+  std::vector<int> cpus;  ///< CPUs the thread may run on. Empty leaves it to the scheduler.
+  int priority = 0;       ///< SCHED_FIFO priority, 1 to 99. 0 keeps the normal scheduler.
+};
+
 /**
  * @brief Soul sense plugin profile and settings.
  */
 struct SensePluginProfile : public soul::PluginProfile
 {
   bool thread;                          ///< Whether we should launch in an independent thread.
+  PluginThreadOptions thread_options;   ///< Worker thread settings. Only used if thread is set.
   std::vector<MessagePublisher> pubs;   ///< List of topics we want to request publication to.
   std::vector<MessageSubscriber> subs;  ///< List of topics (including callbacks) we want to subscribe to.
 
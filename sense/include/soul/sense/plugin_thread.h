@@ -0,0 +1,144 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_PLUGIN_THREAD_H_
+#define SOUL_SENSE_PLUGIN_THREAD_H_
+
+/*
+ * Plugin worker thread.
+ *
+ * Plugins whose profile sets thread get one of these. Their activation and
+ * their subscriber callbacks are posted to its inbox and run on its thread in
+ * order, so a slow detector doesn't hold up the central event loop. The
+ * thread can be pinned to CPUs and given a real time priority.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/messaging/dispatch.h>
+#include <soul/sense/plugin_profile.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// CLASSES                                                                   //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Worker thread with its own inbox. Tasks run one at a time in the order they were posted.
+ */
+class PluginThread final : public DispatchExecutor
+{
+public:
+  /**
+   * @brief Constructor. Starts the thread.
+   * @param name Name of the plugin the thread runs. Used in error messages.
+   * @param options CPU affinity and priority.
+   * @throws std::runtime_error if the thread can't be pinned to the requested CPUs.
+   */
+  PluginThread(const std::string& name, const PluginThreadOptions& options);
+
+  /** Destructor. Finishes the queued tasks and stops the thread. */
+  ~PluginThread() override;
+
+  PluginThread(const PluginThread&) = delete;
+  PluginThread& operator=(const PluginThread&) = delete;
+
+  /**
+   * @brief Queue a task for the thread.
+   * @param task Task to run.
+   */
+  void post(std::function<void()> task) override;
+
+  /**
+   * @brief Block until every posted task has finished. Must not be called from a task.
+   */
+  void drain(void) override;
+
+  /**
+   * @brief Get the thread's ID.
+   * @return Thread ID.
+   */
+  std::thread::id getId(void) const;
+
+  /**
+   * @brief Get the name of the plugin the thread runs.
+   * @return Plugin name.
+   */
+  const std::string& getName(void) const;
+
+  /**
+   * @brief Get the number of tasks waiting to run.
+   * @return Tasks waiting.
+   */
+  std::size_t getPending(void);
+
+  /**
+   * @brief Get the most tasks that have been waiting to run at once.
+   * @return High-water mark of the inbox.
+   */
+  std::size_t getPendingMax(void);
+
+#ifndef HR_DEBUG
+private:
+#endif
+  /**
+   * @brief Apply the CPU affinity and priority settings to the thread.
+   * @param options Settings.
+   */
+  void applyOptions(const PluginThreadOptions& options);
+
+  /**
+   * @brief Run tasks until stopped.
+   */
+  void run(void);
+
+  /** Plugin name. */
+  const std::string name_;
+
+  /** Lock for inbox_, pending_max_, busy_ and stop_. */
+  std::mutex lock_;
+
+  /** Signalled when a task is posted or the thread should stop. */
+  std::condition_variable work_cond_;
+
+  /** Signalled when the inbox runs dry. */
+  std::condition_variable drained_cond_;
+
+  /** Tasks waiting to run. */
+  std::deque<std::function<void()>> inbox_;
+
+  /** Most tasks that have been waiting at once. */
+  std::size_t pending_max_;
+
+  /** Whether a task is running. */
+  bool busy_;
+
+  /** Whether the thread should exit once the inbox is empty. */
+  bool stop_;
+
+  /** Worker thread. */
+  std::thread thread_;
+};
+
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_PLUGIN_THREAD_H_
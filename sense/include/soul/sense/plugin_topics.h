@@ -0,0 +1,113 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+#ifndef SOUL_SENSE_PLUGIN_TOPICS_H_
+#define SOUL_SENSE_PLUGIN_TOPICS_H_
+
+/*
+ * Plugin topic manifest.
+ *
+ * A plugin library can ship a lib<name>.topics file next to it listing the
+ * topics it publishes and subscribes to. In lazy mode the sense manager reads
+ * these instead of loading the plugin, and only loads it once something
+ * subscribes to one of its topics. One declaration per line, # starts a
+ * comment:
+ *
+ *   publish face_detections
+ *   subscribe camera_frames
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Topics a plugin declares in its manifest.
+ */
+struct PluginTopics
+{
+  std::vector<std::string> publishes;   ///< Topics the plugin publishes to.
+  std::vector<std::string> subscribes;  ///< Topics the plugin subscribes to.
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FUNCTIONS                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Get the path of a plugin library's topic manifest.
+ * @param library_dir Plugin directory.
+ * @param library_name Library name without prefix and suffix.
+ * @return Manifest path.
+ */
+inline std::string getPluginTopicsPath(const std::string& library_dir, const std::string& library_name)
+{
+  return library_dir + "/lib" + library_name + ".topics";
+}
+
+/**
+ * @brief Read a topic manifest.
+ * @param path Manifest path.
+ * @param topics Set to the declared topics.
+ * @return False if there is no manifest.
+ * @throws std::runtime_error if the manifest is malformed.
+ */
+inline bool readPluginTopics(const std::string& path, PluginTopics& topics)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+
+  topics = PluginTopics();
+
+  std::string line;
+  for (int line_number = 1; std::getline(in, line); ++line_number)
+  {
+    const auto comment = line.find('#');
+    if (comment != std::string::npos)
+      line.erase(comment);
+
+    std::istringstream fields(line);
+    std::string kind, msg_id, extra;
+
+    if (!(fields >> kind))
+      continue;
+
+    if (!(fields >> msg_id) || (fields >> extra) || (kind != "publish" && kind != "subscribe"))
+    {
+      const auto error = "ERROR: " + path + ":" + std::to_string(line_number) +
+                         ": expected 'publish <msg_id>' or 'subscribe <msg_id>'\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+
+    (kind == "publish" ? topics.publishes : topics.subscribes).push_back(msg_id);
+  }
+
+  return true;
+}
+
+}  // namespace sense
+}  // namespace soul
+
+#endif  // SOUL_SENSE_PLUGIN_TOPICS_H_
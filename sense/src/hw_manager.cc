@@ -12,9 +12,11 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/sense/frame_pool.h>
 #include <soul/sense/hw_manager.h>
 #include <soul/sense/hw_plugin_profile.h>
 
+#include <chrono>
 #include <stdexcept>
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -49,6 +51,21 @@ void SoulSenseHwManager::activatePlugins(void)
   }
 }
 
+const std::vector<PluginTiming>& SoulSenseHwManager::getStartupTimes(void) const
+{
+  return startup_times_;
+}
+
+std::shared_ptr<FramePool> SoulSenseHwManager::getFramePool(const std::string& plugin_name) const
+{
+  const auto pool = frame_pools_.find(plugin_name);
+
+  if (pool == frame_pools_.end())
+    return nullptr;
+
+  return pool->second;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // PRIVATE METHODS                                                           //
 ///////////////////////////////////////////////////////////////////////////////
@@ -69,24 +86,44 @@ void SoulSenseHwManager::loadPlugins(void)
     throw std::runtime_error(error);
   }
 
-  pluginman_.loadAll(params_.plugin_dir, params_.section_name);
+  pluginman_.setManifestCache(params_.manifest_cache);
+  pluginman_.loadAll(params_.plugin_dir, params_.section_name, params_.startup_workers);
 }
 
 void SoulSenseHwManager::configurePlugins(void)
 {
   auto&& loaded_plugins = pluginman_.listLoadedPlugins();
 
+  std::vector<SenseHwPluginInterface*> plugins;
+  startup_times_.clear();
+
   for (auto& p : loaded_plugins)
   {
-    auto* plugin = dynamic_cast<SenseHwPluginInterface*>(pluginman_.getPlugin(p));
+    plugins.push_back(dynamic_cast<SenseHwPluginInterface*>(pluginman_.getPlugin(p)));
+    startup_times_.push_back({ p, pluginman_.getLoadTime(p) });
+  }
+
+  // Devices configure independently, so slow ones (e.g., camera initialisation) overlap.
+  parallelFor(plugins.size(), params_.startup_workers, [&](const std::size_t i) {
+    const auto start = std::chrono::steady_clock::now();
 
     // TODO: parameter loading.
     std::unordered_map<std::string, std::string> params;
-    plugin->configure(params);
+    plugins[i]->configure(params);
 
+    startup_times_[i].configure =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  });
+
+  for (auto* plugin : plugins)
+  {
     // Setup messaging system.
     setupMessaging(plugin);
+
+    setupFramePool(plugin);
   }
+
+  printStartupTimes(std::cerr, "SoulSenseHwManager", startup_times_);
 }
 
 void SoulSenseHwManager::setupMessaging(SenseHwPluginInterface* plugin)
@@ -100,11 +137,26 @@ void SoulSenseHwManager::setupMessaging(SenseHwPluginInterface* plugin)
   }
 
   // Publish
+  std::vector<TopicHandle> handles;
+  handles.reserve(profile->pubs.size());
   for (auto& pub : profile->pubs)
-    params_.msgman->publish(pub.msg_id, pub);
+    handles.push_back(params_.msgman->publish(pub.msg_id, pub));
+
+  // Set messaging function. A caller-supplied sender, e.g., another transport, takes precedence.
+  plugin->setMessageSender(params_.sender ? params_.sender : params_.msgman->getSender(handles));
+}
+
+void SoulSenseHwManager::setupFramePool(SenseHwPluginInterface* plugin)
+{
+  auto* profile = reinterpret_cast<const SenseHwPluginProfile*>(plugin->getProfile());
+  const auto& devinfo = profile->devinfo;
+
+  if (devinfo.image_format.rows <= 0 && devinfo.depth_format.rows <= 0)
+    return;
 
-  // Set messaging function
-  plugin->setMessageSender(params_.sender);
+  auto pool = FramePool::create(devinfo);
+  frame_pools_[plugin->name()] = pool;
+  plugin->setFramePool(pool);
 }
 
 }  // namespace sense
@@ -12,10 +12,18 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/knowledge/msg/serialization.h>
 #include <soul/sense/manager.h>
+#include <soul/sense/msg/serialization.h>
 #include <soul/sense/plugin_profile.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -35,22 +43,58 @@ namespace sense
 
 SoulSenseManager::SoulSenseManager(const SoulSenseManagerParameters& params,
                                    const SoulSenseHwManagerParameters& hwparams)
-  : params_(params), hw_params_(hwparams), hwman_(nullptr)
+  : params_(params), hw_params_(hwparams), hwman_(nullptr), activated_(false), metrics_collector_(0)
 {
+  // Trace from the first message the plugins send.
+  if (params_.tracer)
+    msgman_.setTracer(params_.tracer);
+
   // Initialise hardware manager
   hw_params_.msgman = &msgman_;
-  hw_params_.sender =
-      std::bind(&MessageManager::send, &msgman_, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 
   hwman_ = std::make_unique<SoulSenseHwManager>(hw_params_);
+  recordStartupTimes(hwman_->getStartupTimes());
+
+  // Plugin thread inboxes are read when the metrics are.
+  metrics_collector_ = msgman_.getMetrics()->addCollector([this]() { collectMetrics(); });
+
+  // In lazy mode a new subscriber pulls in the plugins that publish its topic.
+  if (params_.lazy)
+    msgman_.setSubscriptionCallback([this](const std::string& msg_id, const std::string&) { onSubscription(msg_id); });
 
   /* Initialise the plugins. */
   loadPlugins();
   configurePlugins();
+
+  if (!params_.metrics_file.empty())
+    metrics_dumper_ =
+        std::make_unique<MetricsDumper>(msgman_.getMetrics(), params_.metrics_file, params_.metrics_period);
+
+  if (!params_.bridge_address.empty())
+  {
+    msg::addSenseSchemas(codecs_);
+    knowledge::msg::addKnowledgeSchemas(codecs_);
+
+    bridge_ = std::make_unique<MessageBridge>(msgman_, params_.bridge_address);
+
+    for (const auto& msg_id : params_.bridge_topics)
+      bridge_->exportTopic(msg_id, codecs_.makeCodec());
+  }
 }
 
 SoulSenseManager::~SoulSenseManager()
 {
+  // Off the messaging system before the plugins go.
+  bridge_.reset();
+
+  // The dumper writes the final metrics while the plugins are still there to report on.
+  metrics_dumper_.reset();
+  msgman_.getMetrics()->removeCollector(metrics_collector_);
+
+  msgman_.setSubscriptionCallback(nullptr);
+
+  // Plugin threads may still be sending, so stop them before the queues go.
+  stopPluginThreads();
   msgman_.clear();
 }
 
@@ -62,9 +106,106 @@ void SoulSenseManager::interrupt(void)
   msgman_.setWork(false);
 }
 
+std::shared_ptr<MetricsRegistry> SoulSenseManager::getMetrics(void) const
+{
+  return msgman_.getMetrics();
+}
+
+const std::vector<PluginTiming>& SoulSenseManager::getStartupTimes(void) const
+{
+  return startup_times_;
+}
+
+bool SoulSenseManager::requirePlugin(const std::string& library_name)
+{
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+  const auto lazy = lazy_plugins_.find(library_name);
+  if (lazy == lazy_plugins_.end())
+    return false;
+
+  const auto subscribes = lazy->second.subscribes;
+  lazy_plugins_.erase(lazy);
+
+  auto library_names = takeLazyPublishers(subscribes);
+  library_names.push_back(library_name);
+  std::sort(library_names.begin(), library_names.end());
+
+  loadLazily(library_names);
+  return true;
+}
+
+bool SoulSenseManager::reloadPlugin(const std::string& library_name)
+{
+  std::lock_guard<std::mutex> reload(reload_lock_);
+
+  const auto name = pluginman_.getPluginName(params_.section_name, library_name);
+  SensePluginInterface* plugin = nullptr;
+
+  {
+    std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+    const auto loaded = pluginman_.listLoadedPlugins();
+    if (std::find(loaded.begin(), loaded.end(), name) == loaded.end())
+    {
+      std::cerr << "ERROR: SoulSenseManager: can't reload " << library_name << ", it isn't loaded.\n";
+      return false;
+    }
+
+    plugin = dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(name));
+  }
+
+  // Without lazy_lock_, so a callback we wait for can still pull in lazy plugins.
+  retirePlugin(plugin);
+
+  // Revoking the handles stopped new sends. Messages already sent run the library's code when they are destroyed.
+  std::vector<std::string> topics;
+  for (auto& pub : reinterpret_cast<const SensePluginProfile*>(plugin->getProfile())->pubs)
+    topics.push_back(pub.msg_id);
+
+  const bool delivered = msgman_.waitForDelivery(topics, params_.reload_drain_timeout);
+
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+  if (!delivered)
+  {
+    std::cerr << "ERROR: SoulSenseManager: messages from " << library_name
+              << " are still queued, so it can't be unloaded. Keeping the old instance.\n";
+
+    setupMessaging(plugin);
+    if (activated_)
+      activatePlugin(plugin);
+
+    return false;
+  }
+
+  // Close the old library before opening the new one, or dlopen would hand back the old mapping.
+  pluginman_.unload(name);
+  pluginman_.load(params_.plugin_dir, library_name, params_.section_name);
+
+  const auto loaded = pluginman_.listLoadedPlugins();
+  if (std::find(loaded.begin(), loaded.end(), name) == loaded.end())
+  {
+    std::cerr << "ERROR: SoulSenseManager: " << library_name << " was unloaded but didn't load again.\n";
+    return false;
+  }
+
+  configure({ name });
+
+  if (activated_)
+    activatePlugin(dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(name)));
+
+  return true;
+}
+
 void SoulSenseManager::run()
 {
-  activatePlugins();
+  {
+    std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+    activatePlugins();
+    activated_ = true;
+  }
+
   hwman_->activatePlugins();
 
   // Main event loop.
@@ -84,26 +225,144 @@ void SoulSenseManager::run()
 
 void SoulSenseManager::loadPlugins()
 {
-  // For now, just load all plugins.
-  pluginman_.loadAll(params_.plugin_dir, params_.section_name);
+  pluginman_.setManifestCache(params_.manifest_cache);
+
+  if (!params_.lazy)
+  {
+    pluginman_.loadAll(params_.plugin_dir, params_.section_name, params_.startup_workers);
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+  std::vector<std::string> library_names;
+  std::vector<std::string> wanted;
+
+  for (auto& library : pluginman_.listLibraries(params_.plugin_dir))
+  {
+    PluginTopics topics;
+    const bool declared = readPluginTopics(getPluginTopicsPath(params_.plugin_dir, library), topics);
+    const bool required = std::find(params_.required_plugins.begin(), params_.required_plugins.end(), library) !=
+                          params_.required_plugins.end();
+
+    if (declared && !required)
+    {
+      lazy_plugins_.emplace(library, std::move(topics));
+      continue;
+    }
+
+    // Without a manifest we can't tell what the plugin publishes, so it can't wait for a subscriber.
+    library_names.push_back(library);
+    wanted.insert(wanted.end(), topics.subscribes.begin(), topics.subscribes.end());
+  }
+
+  const auto upstream = takeLazyPublishers(wanted);
+  library_names.insert(library_names.end(), upstream.begin(), upstream.end());
+  std::sort(library_names.begin(), library_names.end());
+
+  pluginman_.loadLibraries(params_.plugin_dir, library_names, params_.section_name, params_.startup_workers);
 }
 
 void SoulSenseManager::configurePlugins()
 {
-  // For each loaded plugin, configure them.
-  auto&& loaded_plugins = pluginman_.listLoadedPlugins();
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
 
-  for (auto& p : loaded_plugins)
+  startup_times_.clear();
+  configure(pluginman_.listLoadedPlugins());
+}
+
+void SoulSenseManager::configure(const std::vector<std::string>& names)
+{
+  std::vector<SensePluginInterface*> plugins;
+  const auto first = startup_times_.size();
+
+  for (auto& p : names)
   {
-    auto* plugin = dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(p));
+    plugins.push_back(dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(p)));
+    startup_times_.push_back({ p, pluginman_.getLoadTime(p) });
+  }
+
+  // Plugins configure independently, so slow ones (e.g., loading models) overlap.
+  parallelFor(plugins.size(), params_.startup_workers, [&](const std::size_t i) {
+    const auto start = std::chrono::steady_clock::now();
 
     // TODO: parameter loading.
     std::unordered_map<std::string, std::string> params;
-    plugin->configure(params);
+    plugins[i]->configure(params);
+
+    startup_times_[first + i].configure =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  });
 
-    // Setup messaging system.
+  const std::vector<PluginTiming> timings(startup_times_.begin() + first, startup_times_.end());
+
+  // Setup messaging system. Done in load order so topics are registered the same way on every boot. In lazy mode
+  // this can load and configure more plugins, which are appended to startup_times_.
+  for (auto* plugin : plugins)
     setupMessaging(plugin);
+
+  printStartupTimes(std::cerr, "SoulSenseManager", timings);
+  recordStartupTimes(timings);
+}
+
+std::vector<std::string> SoulSenseManager::takeLazyPublishers(std::vector<std::string> topics)
+{
+  std::vector<std::string> library_names;
+
+  while (!topics.empty())
+  {
+    const auto msg_id = topics.back();
+    topics.pop_back();
+
+    for (auto lazy = lazy_plugins_.begin(); lazy != lazy_plugins_.end();)
+    {
+      const auto& publishes = lazy->second.publishes;
+
+      if (std::find(publishes.begin(), publishes.end(), msg_id) == publishes.end())
+      {
+        ++lazy;
+        continue;
+      }
+
+      // The publisher needs its own inputs too.
+      library_names.push_back(lazy->first);
+      topics.insert(topics.end(), lazy->second.subscribes.begin(), lazy->second.subscribes.end());
+      lazy = lazy_plugins_.erase(lazy);
+    }
   }
+
+  std::sort(library_names.begin(), library_names.end());
+
+  return library_names;
+}
+
+void SoulSenseManager::loadLazily(const std::vector<std::string>& library_names)
+{
+  const auto before = pluginman_.listLoadedPlugins();
+  pluginman_.loadLibraries(params_.plugin_dir, library_names, params_.section_name, params_.startup_workers);
+  const auto after = pluginman_.listLoadedPlugins();
+
+  // Load order only grows at the end.
+  const std::vector<std::string> names(after.begin() + before.size(), after.end());
+
+  configure(names);
+
+  // Before run(), activatePlugins() picks these up with everything else.
+  if (!activated_)
+    return;
+
+  for (auto& p : names)
+    activatePlugin(dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(p)));
+}
+
+void SoulSenseManager::onSubscription(const std::string& msg_id)
+{
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+  const auto library_names = takeLazyPublishers({ msg_id });
+
+  if (!library_names.empty())
+    loadLazily(library_names);
 }
 
 void SoulSenseManager::activatePlugins()
@@ -115,27 +374,206 @@ void SoulSenseManager::activatePlugins()
   {
     auto* plugin = dynamic_cast<SensePluginInterface*>(pluginman_.getPlugin(p));
 
+    activatePlugin(plugin);
+  }
+}
+
+void SoulSenseManager::activatePlugin(SensePluginInterface* plugin)
+{
+  const auto worker = plugin_threads_.find(plugin->name());
+
+  if (worker == plugin_threads_.end())
+  {
     plugin->activate();
+    return;
   }
+
+  worker->second->post([plugin]() {
+    if (!plugin->activate())
+      std::cerr << "ERROR: SoulSenseManager: " << plugin->name() << " failed to activate on its thread.\n";
+  });
 }
 
 void SoulSenseManager::setupMessaging(SensePluginInterface* plugin)
 {
   auto* profile = reinterpret_cast<const SensePluginProfile*>(plugin->getProfile());
 
+  PluginThread* worker = nullptr;
+
+  if (profile->thread)
+  {
+    auto& slot = plugin_threads_[plugin->name()];
+    slot = std::make_unique<PluginThread>(plugin->name(), profile->thread_options);
+    worker = slot.get();
+  }
+
   // Subscribe
   for (auto& sub : profile->subs)
-    msgman_.subscribe(sub.msg_id, sub.name, sub.cb);
+  {
+    if (sub.batch_cb != nullptr)
+    {
+      if (worker == nullptr)
+      {
+        msgman_.subscribeBatch(sub.msg_id, sub.name, sub.batch_cb, sub.dispatch);
+        continue;
+      }
+
+      // The batch only lives for the duration of the call, so the plugin thread gets its own copy of the pointers.
+      // The profile outlives the plugin thread, so the tasks can point at its subscriber entry.
+      const auto* profile_sub = &sub;
+      const auto metrics = getWorkerMetrics(sub);
+      auto cb = sub.batch_cb;
+      msgman_.subscribeBatch(sub.msg_id, sub.name, [this, worker, profile_sub, metrics, cb](const MessageBatch& batch) {
+        std::vector<std::shared_ptr<MessageInterface>> msgs(batch.begin(), batch.end());
+        worker->post([this, profile_sub, metrics, cb, msgs]() {
+          runWorkerCallback(*profile_sub, metrics, [&cb, &msgs]() { cb(MessageBatch(msgs.data(), msgs.size())); },
+                            msgs.back().get(), msgs.size());
+        });
+      });
+      continue;
+    }
+
+    if (worker == nullptr || sub.cb == nullptr)
+    {
+      msgman_.subscribe(sub.msg_id, sub.name, sub.cb, sub.dispatch);
+      continue;
+    }
+
+    // Hand the message to the plugin's inbox straight from the event loop. The plugin thread already keeps the
+    // callbacks off the event loop and in order, so the subscriber's dispatch mode doesn't apply.
+    const auto* profile_sub = &sub;
+    const auto metrics = getWorkerMetrics(sub);
+    auto cb = sub.cb;
+    msgman_.subscribe(sub.msg_id, sub.name,
+                      [this, worker, profile_sub, metrics, cb](std::shared_ptr<MessageInterface> msg) {
+                        worker->post([this, profile_sub, metrics, cb, msg]() {
+                          runWorkerCallback(*profile_sub, metrics, [&cb, &msg]() { cb(msg); }, msg.get(), 1);
+                        });
+                      });
+  }
 
   // Publish
+  std::vector<TopicHandle> handles;
   for (auto& pub : profile->pubs)
-    msgman_.publish(pub.msg_id, pub);
+    handles.push_back(msgman_.publish(pub.msg_id, pub));
+
+  // Set messaging function. Sends on the plugin's own topics skip the topic and publisher lookups.
+  plugin->setMessageSender(msgman_.getSender(handles));
+}
+
+SubscriberMetrics SoulSenseManager::getWorkerMetrics(const MessageSubscriber& sub)
+{
+  auto metrics = msgman_.getMetrics();
+  const MetricLabels labels = { { "topic", sub.msg_id }, { "plugin", sub.name } };
 
-  // Set messaging function
-  auto sender = std::bind(&soul::MessageManager::send, &msgman_, std::placeholders::_1, std::placeholders::_2,
-                          std::placeholders::_3);
+  SubscriberMetrics worker_metrics;
+  worker_metrics.callback_time = &metrics->getHistogram(
+      "soul_plugin_callback_seconds", "Time spent in subscriber callbacks on plugin threads.", labels);
+  worker_metrics.callback_errors = &metrics->getCounter(
+      "soul_plugin_callback_errors_total", "Exceptions thrown by subscriber callbacks on plugin threads.", labels);
 
-  plugin->setMessageSender(sender);
+  return worker_metrics;
+}
+
+void SoulSenseManager::runWorkerCallback(const MessageSubscriber& sub, const SubscriberMetrics& metrics,
+                                         const std::function<void()>& call, const MessageInterface* msg,
+                                         const std::size_t messages)
+{
+  // The messaging manager only sees the hand-off to the plugin thread, so measure the callback itself here.
+  const auto start = std::chrono::steady_clock::now();
+
+  try
+  {
+    call();
+  }
+  catch (...)
+  {
+    metrics.callback_errors->add();
+    throw;
+  }
+
+  metrics.callback_time->observe(std::chrono::steady_clock::now() - start);
+
+  auto* tracer = msgman_.getTracer();
+  if (tracer != nullptr)
+    tracer->traceCallback(sub.msg_id, sub.name, msg, start, messages);
+}
+
+void SoulSenseManager::recordStartupTimes(const std::vector<PluginTiming>& timings)
+{
+  auto metrics = msgman_.getMetrics();
+
+  for (const auto& timing : timings)
+  {
+    metrics->getHistogram("soul_plugin_startup_seconds", "Time plugins took to start.",
+                          { { "plugin", timing.name }, { "phase", "load" } })
+        .observe(timing.load);
+    metrics->getHistogram("soul_plugin_startup_seconds", "Time plugins took to start.",
+                          { { "plugin", timing.name }, { "phase", "configure" } })
+        .observe(timing.configure);
+  }
+}
+
+void SoulSenseManager::collectMetrics(void)
+{
+  auto metrics = msgman_.getMetrics();
+  std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+  for (const auto& thread : plugin_threads_)
+  {
+    const MetricLabels labels = { { "plugin", thread.first } };
+
+    metrics->getGauge("soul_plugin_inbox_depth", "Callbacks waiting for a plugin thread.", labels)
+        .set(static_cast<std::int64_t>(thread.second->getPending()));
+    metrics->getGauge("soul_plugin_inbox_depth_max", "Most callbacks that have waited for a plugin thread at once.",
+                      labels)
+        .set(static_cast<std::int64_t>(thread.second->getPendingMax()));
+  }
+}
+
+void SoulSenseManager::retirePlugin(SensePluginInterface* plugin)
+{
+  auto* profile = reinterpret_cast<const SensePluginProfile*>(plugin->getProfile());
+
+  // Once the subscriptions are revoked neither the event loop nor the dispatch pool can call into the plugin.
+  for (auto& sub : profile->subs)
+    msgman_.unsubscribe(sub.msg_id, sub.name);
+
+  std::unique_ptr<PluginThread> worker;
+
+  {
+    std::lock_guard<std::recursive_mutex> lg(lazy_lock_);
+
+    const auto thread = plugin_threads_.find(plugin->name());
+    if (thread != plugin_threads_.end())
+    {
+      worker = std::move(thread->second);
+      plugin_threads_.erase(thread);
+    }
+  }
+
+  if (worker)
+  {
+    // Deactivate behind the callbacks already queued for the plugin's thread, which finishes them before it stops.
+    worker->post([plugin]() { plugin->deactivate(); });
+    worker.reset();
+  }
+  else
+  {
+    plugin->deactivate();
+  }
+
+  // Latest-value topics keep the newest message for getLatest(), which would hold it until the next send.
+  for (auto& pub : profile->pubs)
+  {
+    msgman_.unpublish(pub.msg_id, pub.name);
+    msgman_.forgetLatest(pub.msg_id);
+  }
+}
+
+void SoulSenseManager::stopPluginThreads(void)
+{
+  plugin_threads_.clear();
 }
 
 }  // namespace sense
@@ -19,8 +19,11 @@
 
 #include <signal.h>
 
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // CUSTOM DEFINITIONS                                                        //
@@ -50,6 +53,27 @@ static soul::sense::SoulSenseManagerParameters getSoulSenseParameters(const boos
 
   params.plugin_dir = vm["dir"].as<std::string>();
   params.section_name = vm["secname"].as<std::string>();
+  params.startup_workers = vm["jobs"].as<std::size_t>();
+
+  const auto manifest = vm["manifest"].as<std::string>();
+  if (!manifest.empty())
+    params.manifest_cache = std::make_shared<soul::PluginManifestCache>(manifest);
+
+  params.lazy = vm["lazy"].as<bool>();
+
+  if (vm.count("require") > 0)
+    params.required_plugins = vm["require"].as<std::vector<std::string>>();
+
+  if (!vm["trace"].as<std::string>().empty())
+    params.tracer = std::make_shared<soul::MessageTracer>();
+
+  params.metrics_file = vm["metrics"].as<std::string>();
+  params.metrics_period = std::chrono::seconds(vm["metrics-period"].as<std::size_t>());
+
+  params.bridge_address = vm["bridge"].as<std::string>();
+
+  if (vm.count("bridge-topics") > 0)
+    params.bridge_topics = vm["bridge-topics"].as<std::vector<std::string>>();
 
   return params;
 }
@@ -73,6 +97,31 @@ static boost::program_options::options_description getOptions()
 
   desc.add_options()("secname,s", value<std::string>()->default_value("Sense"), "plugin section name");
 
+  desc.add_options()("jobs,j", value<std::size_t>()->default_value(0),
+                     "plugins to load and configure at once (0 for one per hardware thread)");
+
+  desc.add_options()("manifest,m", value<std::string>()->default_value(".soul_plugin_manifest"),
+                     "plugin manifest cache file (empty to inspect every library on each start)");
+
+  desc.add_options()("lazy,l", bool_switch(), "only load plugins once something subscribes to their topics");
+
+  desc.add_options()("require,r", value<std::vector<std::string>>()->multitoken(),
+                     "plugin libraries to load at start in lazy mode (names without lib prefix and .so suffix)");
+
+  desc.add_options()("trace,t", value<std::string>()->default_value(""),
+                     "write message latency traces to this file on exit (Chrome trace event format, for Perfetto)");
+
+  desc.add_options()("metrics", value<std::string>()->default_value(""),
+                     "keep this Prometheus text file up to date with queue, callback and plugin metrics");
+
+  desc.add_options()("metrics-period", value<std::size_t>()->default_value(10), "seconds between metrics file writes");
+
+  desc.add_options()("bridge", value<std::string>()->default_value(""),
+                     "export topics to other processes on this address (unix:<path> or tcp:<host>:<port>)");
+
+  desc.add_options()("bridge-topics", value<std::vector<std::string>>()->multitoken(),
+                     "topics to export on the bridge");
+
   return desc;
 }
 
@@ -146,6 +195,8 @@ int main(int argc, char* argv[])
   soul::sense::SoulSenseHwManagerParameters hwparams;
   hwparams.plugin_dir = ".";
   hwparams.section_name = "SenseHw";
+  hwparams.startup_workers = params.startup_workers;
+  hwparams.manifest_cache = params.manifest_cache;
 
   /* Instantiate the manager. */
   // soul::sense::SoulSenseManager mgr(params);
@@ -163,5 +214,8 @@ int main(int argc, char* argv[])
   /* Run the manager. */
   mgr.run();
 
+  if (params.tracer)
+    params.tracer->writeChromeTrace(vm["trace"].as<std::string>());
+
   return SUCCESS;
 }
\ No newline at end of file
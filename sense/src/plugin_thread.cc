@@ -0,0 +1,200 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Plugin worker thread.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/sense/plugin_thread.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC METHODS                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+PluginThread::PluginThread(const std::string& name, const PluginThreadOptions& options)
+  : name_(name), pending_max_(0), busy_(false), stop_(false)
+{
+  thread_ = std::thread(&PluginThread::run, this);
+
+  try
+  {
+    applyOptions(options);
+  }
+  catch (...)
+  {
+    {
+      std::lock_guard<std::mutex> lg(lock_);
+      stop_ = true;
+    }
+
+    work_cond_.notify_one();
+    thread_.join();
+    throw;
+  }
+}
+
+PluginThread::~PluginThread()
+{
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    stop_ = true;
+  }
+
+  work_cond_.notify_one();
+
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void PluginThread::post(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lg(lock_);
+    inbox_.push_back(std::move(task));
+    pending_max_ = std::max(pending_max_, inbox_.size());
+  }
+
+  work_cond_.notify_one();
+}
+
+void PluginThread::drain(void)
+{
+  std::unique_lock<std::mutex> lock(lock_);
+  drained_cond_.wait(lock, [this]() { return inbox_.empty() && !busy_; });
+}
+
+std::thread::id PluginThread::getId(void) const
+{
+  return thread_.get_id();
+}
+
+const std::string& PluginThread::getName(void) const
+{
+  return name_;
+}
+
+std::size_t PluginThread::getPending(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+  return inbox_.size();
+}
+
+std::size_t PluginThread::getPendingMax(void)
+{
+  std::lock_guard<std::mutex> lg(lock_);
+  return pending_max_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PRIVATE METHODS                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void PluginThread::applyOptions(const PluginThreadOptions& options)
+{
+  if (!options.cpus.empty())
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+
+    for (const auto cpu : options.cpus)
+    {
+      if (cpu < 0 || cpu >= CPU_SETSIZE)
+      {
+        const auto error = "ERROR: PluginThread: " + name_ + " asked for invalid CPU " + std::to_string(cpu) + "\n";
+        std::cerr << error;
+        throw std::runtime_error(error);
+      }
+
+      CPU_SET(cpu, &cpus);
+    }
+
+    const int err = pthread_setaffinity_np(thread_.native_handle(), sizeof(cpus), &cpus);
+    if (err != 0)
+    {
+      const auto error = "ERROR: PluginThread: can't pin " + name_ + " to its CPUs: " + std::strerror(err) + "\n";
+      std::cerr << error;
+      throw std::runtime_error(error);
+    }
+  }
+
+  if (options.priority > 0)
+  {
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    param.sched_priority = options.priority;
+
+    // Real time scheduling needs privileges the robot has but development machines often don't. The plugin still
+    // works without it, so carry on.
+    const int err = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param);
+    if (err != 0)
+    {
+      std::cerr << "WARNING: PluginThread: can't set priority " << options.priority << " for " << name_ << ": "
+                << std::strerror(err) << std::endl;
+    }
+  }
+}
+
+void PluginThread::run(void)
+{
+  std::function<void()> task;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      busy_ = false;
+
+      if (inbox_.empty())
+        drained_cond_.notify_all();
+
+      work_cond_.wait(lock, [this]() { return stop_ || !inbox_.empty(); });
+
+      if (inbox_.empty())
+        return;
+
+      task = std::move(inbox_.front());
+      inbox_.pop_front();
+      busy_ = true;
+    }
+
+    // There is nobody to hand the exception to on the plugin's thread.
+    try
+    {
+      task();
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "ERROR: PluginThread: " << name_ << " threw: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+      std::cerr << "ERROR: PluginThread: " << name_ << " threw an unknown exception" << std::endl;
+    }
+
+    task = nullptr;
+  }
+}
+
+}  // namespace sense
+}  // namespace soul
@@ -14,6 +14,8 @@
 #include <soul/sense/hw_plugin_interface.h>
 #include <soul/sense/hw_plugin_profile.h>
 
+#include <memory>
+
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
 ///////////////////////////////////////////////////////////////////////////////
@@ -101,6 +103,12 @@ public:
    */
   void setMessageSender(MessageSenderFn fn) override;
 
+  /**
+   * @brief Set the frame pool to take image buffers from.
+   * @param pool Frame pool.
+   */
+  void setFramePool(std::shared_ptr<FramePool> pool) override;
+
 #ifndef HR_DEBUG
 private:
 #endif
@@ -122,6 +130,9 @@ private:
 
   /** Message sender. */
   MessageSenderFn sender_;
+
+  /** Frame pool. */
+  std::shared_ptr<FramePool> frame_pool_;
 };
 
 }  // namespace sense
@@ -12,11 +12,14 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dummy_sense_hw_plugin.h"
+#include <soul/sense/frame_pool.h>
 #include <soul/sense/hw_plugin_interface.h>
 
 #include <boost/dll/alias.hpp>
 
+#include <chrono>
 #include <iostream>
+#include <memory>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -42,6 +45,8 @@ DummySenseHwPlugin::DummySenseHwPlugin() : name_("dummy_sense_hw_plugin"), state
   profile_.devinfo.name = "dummydevice";
   profile_.devinfo.type = DeviceType::Camera;
   profile_.devinfo.attributes.push_back("RGBD");
+  profile_.devinfo.image_format = { 48, 64, CV_8UC3 };
+  profile_.devinfo.depth_format = { 48, 64, CV_16UC1 };
 }
 
 void DummySenseHwPlugin::setErrorCb(HwErrorCbFunc cb)
@@ -62,7 +67,13 @@ bool DummySenseHwPlugin::activate(void)
 
   if (sender_ != nullptr)
   {
-    auto msg = std::make_shared<MessageInterface>();
+    std::shared_ptr<MessageInterface> msg;
+
+    if (frame_pool_ != nullptr)
+      msg = frame_pool_->acquire(msg::Header(std::chrono::system_clock::now(), profile_.devinfo.id));
+    else
+      msg = std::make_shared<MessageInterface>();
+
     sender_("test3", name_, msg);
   }
 
@@ -91,6 +102,11 @@ void DummySenseHwPlugin::setMessageSender(MessageSenderFn fn)
   sender_ = fn;
 }
 
+void DummySenseHwPlugin::setFramePool(std::shared_ptr<FramePool> pool)
+{
+  frame_pool_ = pool;
+}
+
 std::string DummySenseHwPlugin::name() const
 {
   return name_;
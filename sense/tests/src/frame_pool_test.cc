@@ -0,0 +1,221 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Frame buffer pool test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/sense/frame_pool.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+/**
+ * @brief Make a message header.
+ * @return Header.
+ */
+msg::Header header(void)
+{
+  return msg::Header(std::chrono::system_clock::now(), "camera");
+}
+
+/**
+ * @brief Make an RGBD pool.
+ * @param capacity Idle frames kept.
+ * @return Pool.
+ */
+std::shared_ptr<FramePool> makePool(const std::size_t capacity)
+{
+  return FramePool::create({ 48, 64, CV_8UC3 }, { 48, 64, CV_16UC1 }, capacity);
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(FramePoolTest, frames_have_device_format)
+{
+  auto pool = makePool(2);
+  auto image = pool->acquire(header());
+
+  EXPECT_EQ(image->getImage().rows, 48);
+  EXPECT_EQ(image->getImage().cols, 64);
+  EXPECT_EQ(image->getImage().type(), CV_8UC3);
+  EXPECT_EQ(image->getDepth().rows, 48);
+  EXPECT_EQ(image->getDepth().type(), CV_16UC1);
+  EXPECT_EQ(image->getHeader().getFrameId(), "camera");
+}
+
+TEST(FramePoolTest, no_depth_without_depth_format)
+{
+  auto pool = FramePool::create({ 4, 4, CV_8UC3 }, FrameFormat(), 1);
+  auto image = pool->acquire(header());
+
+  EXPECT_EQ(image->getImage().rows, 4);
+  EXPECT_EQ(image->getDepth().rows, 0);
+}
+
+TEST(FramePoolTest, buffers_recycled_when_image_dropped)
+{
+  auto pool = makePool(2);
+
+  auto image = pool->acquire(header());
+  const auto* data = image->getImage().data;
+  const auto* depth = image->getDepth().data;
+  image.reset();
+
+  auto stats = pool->getStats();
+  EXPECT_EQ(stats.misses, uint64_t(1));
+  EXPECT_EQ(stats.hits, uint64_t(0));
+  EXPECT_EQ(stats.recycled, uint64_t(1));
+  EXPECT_EQ(stats.idle, size_t(1));
+
+  image = pool->acquire(header());
+  EXPECT_EQ(image->getImage().data, data);
+  EXPECT_EQ(image->getDepth().data, depth);
+
+  stats = pool->getStats();
+  EXPECT_EQ(stats.hits, uint64_t(1));
+  EXPECT_EQ(stats.idle, size_t(0));
+}
+
+TEST(FramePoolTest, writes_reach_the_message)
+{
+  auto pool = makePool(1);
+  auto image = pool->acquire(header());
+
+  // Mat copies share the pooled buffer, so plugins fill frames in place.
+  auto mat = image->getImage();
+  mat.ptr(0)[0] = 42;
+
+  EXPECT_EQ(image->getImage().ptr(0)[0], 42);
+}
+
+TEST(FramePoolTest, shared_buffers_not_recycled)
+{
+  auto pool = makePool(2);
+
+  // A subscriber keeps a shallow copy of the depth buffer past the message.
+  auto image = pool->acquire(header());
+  cv::Mat kept = image->getDepth();
+  kept.ptr(0)[0] = 7;
+  image.reset();
+
+  auto stats = pool->getStats();
+  EXPECT_EQ(stats.shared, uint64_t(1));
+  EXPECT_EQ(stats.recycled, uint64_t(0));
+  EXPECT_EQ(stats.idle, size_t(0));
+
+  // The next frame gets fresh buffers, so the kept pixels survive it.
+  auto next = pool->acquire(header());
+  EXPECT_NE(next->getDepth().data, kept.data);
+
+  {
+    auto depth = next->getDepth();
+    depth.ptr(0)[0] = 9;
+  }
+
+  EXPECT_EQ(kept.ptr(0)[0], 7);
+
+  // Once nothing else holds them, buffers are recycled again.
+  next.reset();
+  EXPECT_EQ(pool->getStats().recycled, uint64_t(1));
+}
+
+TEST(FramePoolTest, discards_beyond_capacity)
+{
+  auto pool = makePool(1);
+
+  std::vector<std::shared_ptr<msg::Image>> images;
+  for (int i = 0; i < 3; ++i)
+    images.push_back(pool->acquire(header()));
+
+  images.clear();
+
+  const auto stats = pool->getStats();
+  EXPECT_EQ(stats.misses, uint64_t(3));
+  EXPECT_EQ(stats.recycled, uint64_t(1));
+  EXPECT_EQ(stats.discarded, uint64_t(2));
+  EXPECT_EQ(stats.idle, size_t(1));
+}
+
+TEST(FramePoolTest, image_outlives_pool)
+{
+  auto pool = makePool(1);
+  auto image = pool->acquire(header());
+  pool.reset();
+
+  auto mat = image->getImage();
+  mat.ptr(0)[0] = 1;
+  image.reset();
+}
+
+TEST(FramePoolTest, sized_from_device_info)
+{
+  DeviceInfo devinfo;
+  devinfo.type = DeviceType::Camera;
+  devinfo.image_format = { 2, 3, CV_8UC3 };
+
+  auto pool = FramePool::create(devinfo);
+  EXPECT_EQ(pool->getImageFormat().cols, 3);
+  EXPECT_EQ(pool->getDepthFormat().rows, 0);
+
+  std::vector<std::shared_ptr<msg::Image>> images;
+  for (std::size_t i = 0; i < default_frame_pool_size_ + 1; ++i)
+    images.push_back(pool->acquire(header()));
+
+  images.clear();
+  EXPECT_EQ(pool->getStats().idle, default_frame_pool_size_);
+}
+
+TEST(FramePoolTest, concurrent_acquire_and_release)
+{
+  auto pool = makePool(4);
+  const int per_thread = 200;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&pool]() {
+      for (int i = 0; i < per_thread; ++i)
+        pool->acquire(header());
+    });
+  }
+
+  for (auto& t : threads)
+    t.join();
+
+  const auto stats = pool->getStats();
+  EXPECT_EQ(stats.hits + stats.misses, uint64_t(4 * per_thread));
+  EXPECT_EQ(stats.recycled + stats.discarded, uint64_t(4 * per_thread));
+  EXPECT_LE(stats.misses, uint64_t(4));
+}
+
+}  // namespace sense
+}  // namespace soul
@@ -11,6 +11,7 @@
 // INCLUDES                                                                  //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <soul/sense/frame_pool.h>
 #include <soul/sense/hw_manager.h>
 #include <soul/sense/hw_plugin_profile.h>
 
@@ -47,8 +48,7 @@ protected:
     params.plugin_dir = ".";
     params.section_name = hw_plugin_section_name_;
     params.msgman = &msgman;
-    params.sender =
-        std::bind(&MessageManager::send, &msgman, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+    params.sender = msgman.getSender();
 
     hwman = std::make_unique<SoulSenseHwManager>(params);
   }
@@ -108,5 +108,47 @@ TEST_F(TestFixture, profileCheck)
 // PUBLIC TESTS                                                              //
 ///////////////////////////////////////////////////////////////////////////////
 
+TEST_F(TestFixture, frame_pool_setup)
+{
+  EXPECT_EQ(hwman->getFramePool("unknown"), nullptr);
+
+  auto pool = hwman->getFramePool("dummy_sense_hw_plugin");
+  ASSERT_NE(pool, nullptr);
+  EXPECT_EQ(pool->getImageFormat().rows, 48);
+  EXPECT_EQ(pool->getDepthFormat().type, CV_16UC1);
+
+  // The dummy plugin sends one pooled frame on activation.
+  hwman->activatePlugins();
+  EXPECT_EQ(pool->getStats().misses, uint64_t(1));
+}
+
+TEST_F(TestFixture, startup_times)
+{
+  const auto& times = hwman->getStartupTimes();
+  ASSERT_EQ(times.size(), static_cast<size_t>(1));
+  EXPECT_EQ(times[0].name, std::string(hw_plugin_section_name_) + ",dummy_sense_hw_plugin");
+}
+
+TEST_F(TestFixture, parallel_startup)
+{
+  SoulSenseHwManagerParameters params;
+  params.plugin_dir = ".";
+  params.section_name = hw_plugin_section_name_;
+  params.msgman = &msgman;
+  params.sender = msgman.getSender();
+  params.startup_workers = 4;
+
+  SoulSenseHwManager parallel(params);
+
+  const auto& serial_times = hwman->getStartupTimes();
+  const auto& parallel_times = parallel.getStartupTimes();
+
+  ASSERT_EQ(parallel_times.size(), serial_times.size());
+  for (std::size_t i = 0; i < serial_times.size(); ++i)
+    EXPECT_EQ(parallel_times[i].name, serial_times[i].name);
+
+  EXPECT_NE(parallel.getFramePool("dummy_sense_hw_plugin"), nullptr);
+}
+
 }  // namespace sense
 }  // namespace soul
\ No newline at end of file
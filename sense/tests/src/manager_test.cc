@@ -12,11 +12,21 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <soul/sense/manager.h>
+#include <soul/sense/msg/face_encoding.h>
+#include <soul/sense/plugin_profile.h>
 
 #include <gmock/gmock.h>
 
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <experimental/filesystem>
+#include <fstream>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 // NAMESPACES                                                                //
@@ -73,6 +83,104 @@ protected:
 
 #ifdef HR_DEBUG
 
+/**
+ * @brief Plugin that asks for its own thread and remembers which thread it ran on.
+ */
+class ThreadedPlugin final : public SensePluginInterface
+{
+public:
+  ThreadedPlugin()
+  {
+    profile_.thread = true;
+    profile_.subs.push_back(MessageSubscriber("threaded_in", name(), [this](std::shared_ptr<MessageInterface>) {
+      received_on = std::this_thread::get_id();
+    }));
+
+    MessageSubscriber batch_sub("threaded_batch", name());
+    batch_sub.batch_cb = [this](const MessageBatch& batch) {
+      batch_received_on = std::this_thread::get_id();
+      batch_size = batch.size();
+    };
+    profile_.subs.push_back(batch_sub);
+  }
+
+  void setErrorCb(ErrorCbFunc) override
+  {
+  }
+
+  bool configure(std::unordered_map<std::string, std::string>&) override
+  {
+    return true;
+  }
+
+  bool activate(void) override
+  {
+    activated_on = std::this_thread::get_id();
+    return true;
+  }
+
+  bool deactivate(void) override
+  {
+    deactivated_on = std::this_thread::get_id();
+    return true;
+  }
+
+  bool cleanup(void) override
+  {
+    return true;
+  }
+
+  std::string name() const override
+  {
+    return "threaded_plugin";
+  }
+
+  const PluginProfile* getProfile() const override
+  {
+    return &profile_;
+  }
+
+  PluginState getState(void) const override
+  {
+    return PluginState::inactive;
+  }
+
+  void setMessageSender(MessageSenderFn) override
+  {
+  }
+
+  SensePluginProfile profile_;
+  std::thread::id activated_on;
+  std::thread::id deactivated_on;
+  std::thread::id received_on;
+  std::thread::id batch_received_on;
+  std::size_t batch_size = 0;
+};
+
+/**
+ * @brief Make a plugin directory holding only the dummy sense plugin.
+ * @param name Directory name.
+ * @param manifest Topic manifest for the plugin. Empty for none.
+ * @return Directory path.
+ */
+static std::string makePluginDir(const std::string& name, const std::string& manifest)
+{
+  namespace fs = std::experimental::filesystem;
+
+  const auto dir = fs::temp_directory_path() / name;
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  fs::copy_file("libdummy_sense_plugin.so", dir / "libdummy_sense_plugin.so");
+
+  if (!manifest.empty())
+    std::ofstream(getPluginTopicsPath(dir.string(), "dummy_sense_plugin")) << manifest;
+
+  return dir.string();
+}
+
+/** Manifest matching what the dummy sense plugin registers. */
+static const std::string dummy_topics_ = "# dummy sense plugin\npublish test1\npublish test2\nsubscribe msg_name\n";
+
 TEST_F(TestFixture, init)
 {
   auto&& plugins = mgr->pluginman_.listLoadedPlugins();
@@ -106,6 +214,290 @@ TEST_F(TestFixture, hwman_activate)
   mgr->hwman_->activatePlugins();
   EXPECT_EQ(mgr->msgman_.num_msgs_, 1);
 }
+
+TEST_F(TestFixture, unthreaded_plugin_has_no_thread)
+{
+  EXPECT_TRUE(mgr->plugin_threads_.empty());
+}
+
+TEST_F(TestFixture, threaded_plugin_runs_on_its_thread)
+{
+  ThreadedPlugin plugin;
+  mgr->setupMessaging(&plugin);
+
+  ASSERT_EQ(mgr->plugin_threads_.count(plugin.name()), static_cast<size_t>(1));
+  auto& worker = *mgr->plugin_threads_.at(plugin.name());
+
+  mgr->activatePlugin(&plugin);
+
+  auto topic = mgr->msgman_.publish("threaded_in", MessagePublisher("tester"));
+  mgr->msgman_.send(topic, std::make_shared<MessageInterface>());
+  mgr->msgman_.notify();
+  worker.drain();
+
+  EXPECT_EQ(plugin.activated_on, worker.getId());
+  EXPECT_EQ(plugin.received_on, worker.getId());
+  EXPECT_NE(plugin.received_on, std::this_thread::get_id());
+}
+
+TEST_F(TestFixture, threaded_plugin_takes_batches_on_its_thread)
+{
+  ThreadedPlugin plugin;
+  mgr->setupMessaging(&plugin);
+
+  auto& worker = *mgr->plugin_threads_.at(plugin.name());
+
+  auto topic = mgr->msgman_.publish("threaded_batch", MessagePublisher("tester"));
+  for (int i = 0; i < 3; ++i)
+    mgr->msgman_.send(topic, std::make_shared<MessageInterface>());
+
+  mgr->msgman_.notify();
+  worker.drain();
+
+  EXPECT_EQ(plugin.batch_received_on, worker.getId());
+  EXPECT_EQ(plugin.batch_size, static_cast<size_t>(3));
+}
+
+TEST_F(TestFixture, threaded_plugin_callbacks_are_traced_on_its_thread)
+{
+  auto tracer = std::make_shared<MessageTracer>();
+  mgr->msgman_.setTracer(tracer);
+
+  ThreadedPlugin plugin;
+  mgr->setupMessaging(&plugin);
+
+  auto& worker = *mgr->plugin_threads_.at(plugin.name());
+
+  auto topic = mgr->msgman_.publish("threaded_in", MessagePublisher("tester"));
+  mgr->msgman_.send(topic, std::make_shared<MessageInterface>());
+  mgr->msgman_.notify();
+  worker.drain();
+
+  // One callback event for the hand-off on the event loop, one for the plugin's callback on its thread.
+  std::vector<std::thread::id> threads;
+  for (const auto& event : tracer->getEvents())
+  {
+    if (event.kind == TraceEventKind::callback)
+      threads.push_back(event.thread);
+  }
+
+  EXPECT_THAT(threads, ::testing::UnorderedElementsAre(std::this_thread::get_id(), worker.getId()));
+
+  mgr->msgman_.setTracer(nullptr);
+}
+
+TEST_F(TestFixture, threaded_plugin_callbacks_are_measured_on_its_thread)
+{
+  ThreadedPlugin plugin;
+  mgr->setupMessaging(&plugin);
+
+  auto topic = mgr->msgman_.publish("threaded_in", MessagePublisher("tester"));
+  for (int i = 0; i < 3; ++i)
+    mgr->msgman_.send(topic, std::make_shared<MessageInterface>());
+
+  mgr->msgman_.notify();
+  mgr->plugin_threads_.at(plugin.name())->drain();
+
+  auto metrics = mgr->getMetrics();
+  const MetricLabels labels = { { "topic", "threaded_in" }, { "plugin", plugin.name() } };
+  EXPECT_EQ(metrics->getHistogram("soul_plugin_callback_seconds", "", labels).getSnapshot().count, unsigned(3));
+
+  metrics->collect();
+  const MetricLabels thread = { { "plugin", plugin.name() } };
+  EXPECT_EQ(metrics->getGauge("soul_plugin_inbox_depth", "", thread).get(), 0);
+  EXPECT_GE(metrics->getGauge("soul_plugin_inbox_depth_max", "", thread).get(), 1);
+
+  // The plugins' startup times are there too.
+  ASSERT_FALSE(mgr->getStartupTimes().empty());
+  const MetricLabels startup = { { "plugin", mgr->getStartupTimes()[0].name }, { "phase", "configure" } };
+  EXPECT_EQ(metrics->getHistogram("soul_plugin_startup_seconds", "", startup).getSnapshot().count, unsigned(1));
+}
+
+TEST_F(TestFixture, retired_threaded_plugin_is_off_the_messaging_system)
+{
+  ThreadedPlugin plugin;
+  mgr->setupMessaging(&plugin);
+
+  auto topic = mgr->msgman_.publish("threaded_in", MessagePublisher("tester"));
+  mgr->msgman_.send(topic, std::make_shared<MessageInterface>());
+  mgr->msgman_.notify();
+
+  const auto worker_id = mgr->plugin_threads_.at(plugin.name())->getId();
+  mgr->retirePlugin(&plugin);
+
+  // The queued callback ran before the plugin was deactivated on its thread.
+  EXPECT_EQ(plugin.received_on, worker_id);
+  EXPECT_EQ(plugin.deactivated_on, worker_id);
+  EXPECT_EQ(mgr->plugin_threads_.count(plugin.name()), static_cast<size_t>(0));
+  EXPECT_EQ(mgr->msgman_.subscribers_["threaded_in"].size(), static_cast<size_t>(0));
+}
+
+TEST_F(TestFixture, reload_plugin)
+{
+  const auto name = mgr->pluginman_.getPluginName("Sense", "dummy_sense_plugin");
+  mgr->activated_ = true;
+
+  EXPECT_FALSE(mgr->reloadPlugin("missing_plugin"));
+  ASSERT_TRUE(mgr->reloadPlugin("dummy_sense_plugin"));
+
+  auto&& plugins = mgr->pluginman_.listLoadedPlugins();
+  ASSERT_EQ(plugins, std::vector<std::string>({ name }));
+
+  auto* plugin = dynamic_cast<SensePluginInterface*>(mgr->pluginman_.getPlugin(name));
+  EXPECT_EQ(plugin->getState(), PluginState::active);
+
+  // The new instance is wired in as the old one was.
+  EXPECT_EQ(mgr->msgman_.subscribers_["msg_name"].size(), static_cast<size_t>(1));
+  EXPECT_EQ(mgr->msgman_.publishers_["test1"].size(), static_cast<size_t>(1));
+  EXPECT_EQ(mgr->msgman_.num_msgs_, 1);
+  EXPECT_EQ(mgr->getStartupTimes().size(), static_cast<size_t>(2));
+}
+
+TEST_F(TestFixture, reload_keeps_plugin_with_queued_messages)
+{
+  const auto name = mgr->pluginman_.getPluginName("Sense", "dummy_sense_plugin");
+  mgr->params_.reload_drain_timeout = std::chrono::milliseconds(10);
+  mgr->activatePlugins();
+  mgr->activated_ = true;
+
+  auto* plugin = dynamic_cast<SensePluginInterface*>(mgr->pluginman_.getPlugin(name));
+
+  // Nothing runs the event loop, so the message the plugin sent when it activated is still queued.
+  EXPECT_FALSE(mgr->reloadPlugin("dummy_sense_plugin"));
+  EXPECT_EQ(mgr->pluginman_.getPlugin(name), plugin);
+  EXPECT_EQ(plugin->getState(), PluginState::active);
+  EXPECT_EQ(mgr->msgman_.subscribers_["msg_name"].size(), static_cast<size_t>(1));
+  EXPECT_EQ(mgr->msgman_.publishers_["test1"].size(), static_cast<size_t>(1));
+
+  mgr->msgman_.notify();
+  EXPECT_TRUE(mgr->reloadPlugin("dummy_sense_plugin"));
+}
+
+TEST_F(TestFixture, lazy_plugin_loads_when_its_topic_gets_a_subscriber)
+{
+  SoulSenseManagerParameters params(makePluginDir("soul_sense_lazy", dummy_topics_), "Sense");
+  params.lazy = true;
+
+  SoulSenseHwManagerParameters hwparams;
+  hwparams.plugin_dir = ".";
+  hwparams.section_name = "SenseHw";
+
+  SoulSenseManager lazy(params, hwparams);
+
+  EXPECT_TRUE(lazy.pluginman_.listLoadedPlugins().empty());
+  EXPECT_EQ(lazy.lazy_plugins_.count("dummy_sense_plugin"), static_cast<size_t>(1));
+
+  lazy.msgman_.subscribe("unrelated", "tester", cb);
+  EXPECT_TRUE(lazy.pluginman_.listLoadedPlugins().empty());
+
+  lazy.msgman_.subscribe("test1", "tester", cb);
+
+  auto&& plugins = lazy.pluginman_.listLoadedPlugins();
+  ASSERT_EQ(plugins.size(), static_cast<size_t>(1));
+  EXPECT_TRUE(lazy.lazy_plugins_.empty());
+  ASSERT_EQ(lazy.getStartupTimes().size(), static_cast<size_t>(1));
+  EXPECT_EQ(lazy.getStartupTimes()[0].name, plugins[0]);
+
+  auto* plugin = dynamic_cast<SensePluginInterface*>(lazy.pluginman_.getPlugin(plugins[0]));
+  EXPECT_EQ(plugin->getState(), PluginState::inactive);
+  EXPECT_EQ(lazy.msgman_.publishers_.size(), static_cast<size_t>(3));
+}
+
+TEST_F(TestFixture, lazy_plugin_activates_when_loaded_after_run)
+{
+  SoulSenseManagerParameters params(makePluginDir("soul_sense_lazy_run", dummy_topics_), "Sense");
+  params.lazy = true;
+
+  SoulSenseHwManagerParameters hwparams;
+  hwparams.plugin_dir = ".";
+  hwparams.section_name = "SenseHw";
+
+  SoulSenseManager lazy(params, hwparams);
+  lazy.activated_ = true;
+
+  EXPECT_TRUE(lazy.requirePlugin("dummy_sense_plugin"));
+  EXPECT_FALSE(lazy.requirePlugin("dummy_sense_plugin"));
+
+  auto&& plugins = lazy.pluginman_.listLoadedPlugins();
+  ASSERT_EQ(plugins.size(), static_cast<size_t>(1));
+
+  auto* plugin = dynamic_cast<SensePluginInterface*>(lazy.pluginman_.getPlugin(plugins[0]));
+  EXPECT_EQ(plugin->getState(), PluginState::active);
+}
+
+TEST_F(TestFixture, lazy_mode_loads_required_and_undeclared_plugins)
+{
+  SoulSenseHwManagerParameters hwparams;
+  hwparams.plugin_dir = ".";
+  hwparams.section_name = "SenseHw";
+
+  SoulSenseManagerParameters required(makePluginDir("soul_sense_lazy_required", dummy_topics_), "Sense");
+  required.lazy = true;
+  required.required_plugins = { "dummy_sense_plugin" };
+
+  SoulSenseManagerParameters undeclared(makePluginDir("soul_sense_lazy_undeclared", ""), "Sense");
+  undeclared.lazy = true;
+
+  for (const auto& params : { required, undeclared })
+  {
+    SoulSenseManager lazy(params, hwparams);
+
+    EXPECT_EQ(lazy.pluginman_.listLoadedPlugins().size(), static_cast<size_t>(1));
+    EXPECT_TRUE(lazy.lazy_plugins_.empty());
+  }
+}
+
+TEST_F(TestFixture, lazy_publishers_include_their_inputs)
+{
+  mgr->lazy_plugins_["detector"] = { { "faces" }, { "frames" } };
+  mgr->lazy_plugins_["camera"] = { { "frames" }, {} };
+  mgr->lazy_plugins_["microphone"] = { { "audio" }, {} };
+
+  const std::vector<std::string> expected = { "camera", "detector" };
+  EXPECT_EQ(mgr->takeLazyPublishers({ "faces" }), expected);
+
+  ASSERT_EQ(mgr->lazy_plugins_.size(), static_cast<size_t>(1));
+  EXPECT_EQ(mgr->lazy_plugins_.count("microphone"), static_cast<size_t>(1));
+
+  mgr->lazy_plugins_.clear();
+}
+
+TEST_F(TestFixture, bridge_exports_sense_messages)
+{
+  SoulSenseManagerParameters params(".", "Sense");
+  params.bridge_address = "unix:sense_bridge_test.sock";
+  params.bridge_topics = { "test1" };
+
+  soul::sense::SoulSenseHwManagerParameters hwparams;
+  hwparams.plugin_dir = ".";
+  hwparams.section_name = "SenseHw";
+
+  SoulSenseManager bridged(params, hwparams);
+  ASSERT_NE(bridged.bridge_, nullptr);
+
+  MessageBridgeClient client(params.bridge_address);
+  for (int i = 0; i < 5000 && bridged.bridge_->getClients() == 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  ASSERT_EQ(bridged.bridge_->getClients(), static_cast<size_t>(1));
+
+  // The dummy plugin's bare messages have no schema, so only the encoding makes it across.
+  bridged.msgman_.send("test1", "dummy_sense_plugin", std::make_shared<MessageInterface>());
+  bridged.msgman_.send("test1", "dummy_sense_plugin",
+                       std::make_shared<msg::FaceEncoding>(msg::Header(std::chrono::system_clock::now(), "camera"),
+                                                            std::vector<float>{ 1.0f, 2.0f }));
+  bridged.msgman_.notify();
+
+  BridgeMessage received;
+  ASSERT_TRUE(client.read(received, std::chrono::milliseconds(5000)));
+  EXPECT_EQ(received.msg_id, "test1");
+
+  const auto decoded = bridged.codecs_.makeCodec().decode(received.data.get(), received.size, received.data);
+  const auto* encoding = dynamic_cast<const msg::FaceEncoding*>(decoded.get());
+  ASSERT_NE(encoding, nullptr);
+  EXPECT_EQ(encoding->getEncoding(), std::vector<float>({ 1.0f, 2.0f }));
+  EXPECT_EQ(bridged.bridge_->getDropped(), static_cast<uint64_t>(1));
+}
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -117,5 +509,24 @@ TEST_F(TestFixture, hello)
   EXPECT_TRUE(true);  // add a test
 }
 
+TEST(PluginTopicsTest, read_manifest)
+{
+  const auto path = getPluginTopicsPath(std::experimental::filesystem::temp_directory_path().string(), "topics_test");
+
+  PluginTopics topics;
+  std::remove(path.c_str());
+  EXPECT_FALSE(readPluginTopics(path, topics));
+
+  std::ofstream(path) << "publish faces  # detections\n\n  subscribe frames\npublish landmarks\n";
+  ASSERT_TRUE(readPluginTopics(path, topics));
+  EXPECT_EQ(topics.publishes, std::vector<std::string>({ "faces", "landmarks" }));
+  EXPECT_EQ(topics.subscribes, std::vector<std::string>({ "frames" }));
+
+  std::ofstream(path) << "publish faces\nconsume frames\n";
+  EXPECT_THROW(readPluginTopics(path, topics), std::runtime_error);
+
+  std::remove(path.c_str());
+}
+
 }  // namespace sense
 }  // namespace soul
\ No newline at end of file
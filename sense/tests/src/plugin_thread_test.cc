@@ -0,0 +1,151 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Plugin worker thread test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/sense/plugin_thread.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(PluginThreadTest, tasks_run_in_order_on_the_thread)
+{
+  PluginThread worker("plugin", PluginThreadOptions());
+
+  std::vector<int> order;
+  std::vector<std::thread::id> ids;
+
+  for (int i = 0; i < 100; ++i)
+  {
+    worker.post([&order, &ids, i]() {
+      order.push_back(i);
+      ids.push_back(std::this_thread::get_id());
+    });
+  }
+
+  worker.drain();
+
+  ASSERT_EQ(order.size(), static_cast<size_t>(100));
+  for (int i = 0; i < 100; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+    EXPECT_EQ(ids[i], worker.getId());
+  }
+
+  EXPECT_NE(worker.getId(), std::this_thread::get_id());
+  EXPECT_EQ(worker.getName(), "plugin");
+}
+
+TEST(PluginThreadTest, destructor_finishes_queued_tasks)
+{
+  std::atomic<int> count(0);
+
+  {
+    PluginThread worker("plugin", PluginThreadOptions());
+
+    for (int i = 0; i < 50; ++i)
+      worker.post([&count]() { ++count; });
+  }
+
+  EXPECT_EQ(count.load(), 50);
+}
+
+TEST(PluginThreadTest, throwing_task_does_not_stop_the_thread)
+{
+  PluginThread worker("plugin", PluginThreadOptions());
+  bool ran = false;
+
+  worker.post([]() { throw std::runtime_error("detector failed"); });
+  worker.post([&ran]() { ran = true; });
+  worker.drain();
+
+  EXPECT_TRUE(ran);
+}
+
+TEST(PluginThreadTest, pending_tasks)
+{
+  PluginThread worker("plugin", PluginThreadOptions());
+  std::promise<void> release;
+  auto released = release.get_future().share();
+
+  // Hold the thread up so the rest pile up in the inbox.
+  worker.post([released]() { released.wait(); });
+  for (int i = 0; i < 3; ++i)
+    worker.post([]() {});
+
+  EXPECT_GE(worker.getPending(), unsigned(3));
+  EXPECT_GE(worker.getPendingMax(), unsigned(3));
+
+  release.set_value();
+  worker.drain();
+
+  EXPECT_EQ(worker.getPending(), unsigned(0));
+  EXPECT_GE(worker.getPendingMax(), unsigned(3));
+}
+
+TEST(PluginThreadTest, pinned_to_cpu)
+{
+  PluginThreadOptions options;
+  options.cpus = { 0 };
+
+  PluginThread worker("plugin", options);
+  int cpu = -1;
+
+  worker.post([&cpu]() { cpu = sched_getcpu(); });
+  worker.drain();
+
+  EXPECT_EQ(cpu, 0);
+}
+
+TEST(PluginThreadTest, invalid_cpu_throws)
+{
+  PluginThreadOptions options;
+  options.cpus = { -1 };
+
+  EXPECT_THROW(PluginThread("plugin", options), std::runtime_error);
+}
+
+TEST(PluginThreadTest, unprivileged_priority_still_runs)
+{
+  PluginThreadOptions options;
+  options.priority = 10;
+
+  PluginThread worker("plugin", options);
+  bool ran = false;
+
+  worker.post([&ran]() { ran = true; });
+  worker.drain();
+
+  EXPECT_TRUE(ran);
+}
+
+}  // namespace sense
+}  // namespace soul
@@ -13,6 +13,7 @@
 
 #include <soul/sense/msg/header.h>
 #include <soul/sense/msg/image.h>
+#include <soul/sense/msg/image_codec.h>
 #include <soul/sense/math/bounding_box.h>
 #include <soul/sense/msg/face_detection.h>
 #include <soul/sense/msg/face_encoding.h>
@@ -23,6 +24,9 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
 #include <string>
 
@@ -104,6 +108,160 @@ TEST(TestSenseMsgsInterfacesCompile, IfThisWorksSenseMsgsInterfacesCompiled)
 
   EXPECT_TRUE(true);
 }
+
+TEST(TestSenseMsgsTrace, DerivedMessagesKeepTheCaptureTime)
+{
+  using namespace soul::sense::math;
+
+  const auto capture = std::chrono::system_clock::now();
+  Header header(capture, "camera");
+
+  Image image(header, cv::Mat(), cv::Mat());
+  FaceDetection detection(image.getHeader(), image, BoundingBox(Point3i(0, 0, 0), Size3i(1, 1, 1)));
+  FaceEncoding encoding(detection.getHeader(), std::vector<float>(128, 0.f));
+
+  EXPECT_EQ(image.timestamp, capture);
+  EXPECT_EQ(detection.timestamp, capture);
+  EXPECT_EQ(encoding.timestamp, capture);
+
+  encoding.trace_id = 42;
+  soul::knowledge::msg::PersonState person(0, encoding, detection, FaceLandmarks(header, {}, {}),
+                                           BodyParts(header, {}, {}));
+
+  EXPECT_EQ(person.timestamp, capture);
+  EXPECT_EQ(person.trace_id, 42u);
+}
+
+TEST(TestSenseMsgsMove, MovedInDataIsNotCopied)
+{
+  using namespace soul::sense::math;
+
+  std::vector<float> encoding(128, 0.5f);
+  const auto* encoding_data = encoding.data();
+  FaceEncoding face_encoding_msg(Header(std::chrono::system_clock::now(), "test"), std::move(encoding));
+
+  std::vector<std::string> names = { "head" };
+  std::vector<Pose3f> poses = { Pose3f(Point3f(1, 1, 1), Quaternionf(0, 0, 0, 1)) };
+  const auto* names_data = names.data();
+  BodyParts body_parts_msg(Header(std::chrono::system_clock::now(), "test"), std::move(names), std::move(poses));
+
+  // Getters hand out the stored data.
+  EXPECT_EQ(face_encoding_msg.getEncoding().data(), encoding_data);
+  EXPECT_EQ(&face_encoding_msg.getEncoding(), &face_encoding_msg.getEncoding());
+  EXPECT_EQ(body_parts_msg.getNames().data(), names_data);
+
+  std::vector<FaceEncoding> items;
+  items.push_back(std::move(face_encoding_msg));
+  const auto* items_data = items.data();
+  FaceEncodingList list(std::move(items));
+
+  EXPECT_EQ(list.getItems().data(), items_data);
+  EXPECT_EQ(list.getItems().at(0).getEncoding().data(), encoding_data);
+}
+
+TEST(TestImageShmCodec, RoundTripsWithoutCopyingPixels)
+{
+  cv::Mat rgb(4, 6, CV_8UC3);
+  cv::Mat depth(4, 6, CV_16UC1);
+
+  for (int r = 0; r < rgb.rows; ++r)
+  {
+    for (int i = 0; i < rgb.cols * 3; ++i)
+      rgb.ptr(r)[i] = static_cast<uint8_t>(r * 31 + i);
+
+    for (int i = 0; i < depth.cols * 2; ++i)
+      depth.ptr(r)[i] = static_cast<uint8_t>(r * 17 + i);
+  }
+
+  const auto timestamp = std::chrono::system_clock::now();
+  Image image(Header(timestamp, "camera_left"), rgb, depth);
+
+  const auto codec = makeImageShmCodec();
+  const auto size = codec.size(image);
+  std::vector<uint8_t> slot(size);
+  codec.encode(image, slot.data());
+
+  // The lease must live exactly as long as the decoded message.
+  auto lease = std::make_shared<int>(0);
+  std::weak_ptr<int> lease_ref = lease;
+
+  auto msg = codec.decode(slot.data(), size, std::move(lease));
+  ASSERT_NE(msg, nullptr);
+  EXPECT_FALSE(lease_ref.expired());
+
+  const auto& decoded = static_cast<const Image&>(*msg);
+  EXPECT_EQ(decoded.getHeader().getFrameId(), "camera_left");
+  const auto skew = decoded.getHeader().getTimestamp() - timestamp;
+  EXPECT_EQ(std::chrono::duration_cast<std::chrono::microseconds>(skew).count(), 0);
+
+  const auto out_rgb = decoded.getImage();
+  const auto out_depth = decoded.getDepth();
+  ASSERT_EQ(out_rgb.rows, rgb.rows);
+  ASSERT_EQ(out_rgb.cols, rgb.cols);
+  ASSERT_EQ(out_rgb.type(), rgb.type());
+  ASSERT_EQ(out_depth.type(), depth.type());
+
+  // Pixels are read in place, at 64 byte aligned offsets.
+  EXPECT_GE(out_rgb.data, slot.data());
+  EXPECT_LT(out_rgb.data, slot.data() + size);
+  EXPECT_EQ((out_rgb.data - slot.data()) % 64, 0);
+  EXPECT_EQ((out_depth.data - slot.data()) % 64, 0);
+
+  for (int r = 0; r < rgb.rows; ++r)
+  {
+    EXPECT_EQ(std::memcmp(out_rgb.ptr(r), rgb.ptr(r), rgb.cols * 3), 0);
+    EXPECT_EQ(std::memcmp(out_depth.ptr(r), depth.ptr(r), depth.cols * 2), 0);
+  }
+
+  msg.reset();
+  EXPECT_TRUE(lease_ref.expired());
+}
+
+TEST(TestImageShmCodec, EmptyDepthStaysEmpty)
+{
+  Image image(Header(std::chrono::system_clock::now(), "camera"), cv::Mat(2, 2, CV_8UC1));
+
+  const auto codec = makeImageShmCodec();
+  std::vector<uint8_t> slot(codec.size(image));
+  codec.encode(image, slot.data());
+
+  auto msg = codec.decode(slot.data(), slot.size(), nullptr);
+  const auto& decoded = static_cast<const Image&>(*msg);
+  EXPECT_EQ(decoded.getImage().rows, 2);
+  EXPECT_EQ(decoded.getDepth().rows, 0);
+}
+
+TEST(TestImageShmCodec, RejectsLayoutOutsideSlot)
+{
+  Image image(Header(std::chrono::system_clock::now(), "camera"), cv::Mat(4, 4, CV_8UC3), cv::Mat(4, 4, CV_16UC1));
+
+  const auto codec = makeImageShmCodec();
+  std::vector<uint8_t> slot(codec.size(image));
+  codec.encode(image, slot.data());
+
+  ImageSlotHeader good;
+  std::memcpy(&good, slot.data(), sizeof(good));
+
+  // Each of these is something a broken producer process could leave in the slot.
+  std::vector<ImageSlotHeader> bad(6, good);
+  bad[0].frame_id_size = slot.size();
+  bad[1].image.offset = slot.size();
+  bad[2].depth.rows = 1 << 30;
+  bad[3].depth.cols = -1;
+  bad[4].image.type = -1;
+  bad[5].image.offset = slot.size() - 8;
+
+  for (const auto& header : bad)
+  {
+    std::memcpy(slot.data(), &header, sizeof(header));
+    EXPECT_THROW(codec.decode(slot.data(), slot.size(), nullptr), std::runtime_error);
+  }
+
+  EXPECT_THROW(codec.decode(slot.data(), sizeof(ImageSlotHeader) - 1, nullptr), std::runtime_error);
+
+  std::memcpy(slot.data(), &good, sizeof(good));
+  EXPECT_NE(codec.decode(slot.data(), slot.size(), nullptr), nullptr);
+}
 }  // namespace msg
 }  // namespace sense
 }  // namespace soul
\ No newline at end of file
@@ -0,0 +1,361 @@
+/*
+ * Copyright 2019 Hanson Robotics Limited. All Rights Reserved.
+ */
+
+/*
+ * Sense and knowledge message serialization test.
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+// INCLUDES                                                                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <soul/knowledge/msg/serialization.h>
+#include <soul/sense/math/serialization.h>
+#include <soul/sense/msg/serialization.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// NAMESPACES                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace soul
+{
+namespace sense
+{
+namespace msg
+{
+///////////////////////////////////////////////////////////////////////////////
+// CUSTOM DEFINITIONS                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+using namespace soul::sense::math;
+using knowledge::msg::PersonState;
+
+/**
+ * @brief Make a message header.
+ * @param frame_id Frame id.
+ * @return Header.
+ */
+Header makeHeader(const std::string& frame_id = "camera_color_optical_frame")
+{
+  return Header(std::chrono::system_clock::now(), frame_id);
+}
+
+/**
+ * @brief Make a Mat with a different value in every byte.
+ * @param rows Rows.
+ * @param cols Columns.
+ * @param type OpenCV type.
+ * @return Mat.
+ */
+cv::Mat makeMat(const int rows, const int cols, const int type)
+{
+  cv::Mat mat(rows, cols, type);
+  const std::size_t row_bytes = cols * mat.elemSize();
+
+  for (int r = 0; r < rows; ++r)
+    for (std::size_t c = 0; c < row_bytes; ++c)
+      mat.ptr(r)[c] = static_cast<std::uint8_t>(r * 31 + c);
+
+  return mat;
+}
+
+/**
+ * @brief Make a person state with every field filled in.
+ * @param id Person id.
+ * @return Person state.
+ */
+PersonState makePerson(const std::int64_t id)
+{
+  const BoundingBox bbox(Point3i(10, 20, 0), Size3i(8, 8, 0));
+
+  FaceEncoding encoding(makeHeader(), std::vector<float>(128, 0.25f));
+  FaceDetection detection(makeHeader(), Image(makeHeader(), makeMat(8, 8, CV_8UC3)), bbox);
+  FaceLandmarks landmarks(makeHeader(), { "nose_tip", "chin" }, { Point3i(1, 2, 3), Point3i(-4, 5, 6) });
+  BodyParts body_parts(makeHeader(), { "head" }, { Pose3f(Point3f(1, 2, 3), Quaternionf(0, 0, 0.5f, 1)) });
+
+  return PersonState(id, std::move(encoding), std::move(detection), std::move(landmarks), std::move(body_parts));
+}
+
+/**
+ * @brief Encode a message with a codec.
+ * @param codec Codec.
+ * @param msg Message.
+ * @param size Receives the encoded size.
+ * @return Encoded message, in a buffer aligned like the messaging system's.
+ */
+std::shared_ptr<std::vector<std::uint64_t>> encode(const MessageCodec& codec, const MessageInterface& msg,
+                                                   std::size_t& size)
+{
+  size = codec.size(msg);
+  auto buffer = std::make_shared<std::vector<std::uint64_t>>((size + 7) / 8);
+  codec.encode(msg, reinterpret_cast<std::uint8_t*>(buffer->data()));
+  return buffer;
+}
+
+/**
+ * @brief Encode then decode a message with its own codec.
+ * @param msg Message.
+ * @return Decoded message, holding on to the buffer it was decoded from.
+ */
+template <typename T>
+std::shared_ptr<const T> roundTrip(const T& msg)
+{
+  const auto codec = makeSerialCodec<T>();
+
+  std::size_t size = 0;
+  auto buffer = encode(codec, msg, size);
+  const auto* src = reinterpret_cast<const std::uint8_t*>(buffer->data());
+
+  return std::static_pointer_cast<const T>(codec.decode(src, size, std::move(buffer)));
+}
+
+/**
+ * @brief Compare two headers.
+ * @param a Header.
+ * @param b Header.
+ */
+void expectEqual(const Header& a, const Header& b)
+{
+  EXPECT_EQ(a.getTimestamp(), b.getTimestamp());
+  EXPECT_EQ(a.getFrameId(), b.getFrameId());
+}
+
+/**
+ * @brief Compare two Mats pixel by pixel.
+ * @param a Mat.
+ * @param b Mat.
+ */
+void expectEqual(const cv::Mat& a, const cv::Mat& b)
+{
+  ASSERT_EQ(a.rows, b.rows);
+  ASSERT_EQ(a.cols, b.cols);
+  ASSERT_EQ(a.type(), b.type());
+
+  for (int r = 0; r < a.rows; ++r)
+    EXPECT_EQ(std::memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()), 0) << r;
+}
+
+/**
+ * @brief Compare two person states field by field.
+ * @param a Person state.
+ * @param b Person state.
+ */
+void expectEqual(const PersonState& a, const PersonState& b)
+{
+  EXPECT_EQ(a.getId(), b.getId());
+
+  expectEqual(a.getFaceEncoding().getHeader(), b.getFaceEncoding().getHeader());
+  EXPECT_EQ(a.getFaceEncoding().getEncoding(), b.getFaceEncoding().getEncoding());
+
+  const auto& a_detection = a.getFaceDetection();
+  const auto& b_detection = b.getFaceDetection();
+  expectEqual(a_detection.getHeader(), b_detection.getHeader());
+  expectEqual(a_detection.getFaceImage().getHeader(), b_detection.getFaceImage().getHeader());
+  expectEqual(a_detection.getFaceImage().getImage(), b_detection.getFaceImage().getImage());
+  EXPECT_EQ(a_detection.getBoundingBox().getPoint().getY(), b_detection.getBoundingBox().getPoint().getY());
+  EXPECT_EQ(a_detection.getBoundingBox().getSize().getWidth(), b_detection.getBoundingBox().getSize().getWidth());
+
+  const auto& a_landmarks = a.getFaceLandmarks();
+  const auto& b_landmarks = b.getFaceLandmarks();
+  expectEqual(a_landmarks.getHeader(), b_landmarks.getHeader());
+  EXPECT_EQ(a_landmarks.getNames(), b_landmarks.getNames());
+  ASSERT_EQ(a_landmarks.getLandmarks().size(), b_landmarks.getLandmarks().size());
+
+  for (std::size_t i = 0; i < a_landmarks.getLandmarks().size(); ++i)
+  {
+    EXPECT_EQ(a_landmarks.getLandmarks()[i].getX(), b_landmarks.getLandmarks()[i].getX());
+    EXPECT_EQ(a_landmarks.getLandmarks()[i].getY(), b_landmarks.getLandmarks()[i].getY());
+    EXPECT_EQ(a_landmarks.getLandmarks()[i].getZ(), b_landmarks.getLandmarks()[i].getZ());
+  }
+
+  const auto& a_body = a.getBodyParts();
+  const auto& b_body = b.getBodyParts();
+  expectEqual(a_body.getHeader(), b_body.getHeader());
+  EXPECT_EQ(a_body.getNames(), b_body.getNames());
+  ASSERT_EQ(a_body.getPoses().size(), b_body.getPoses().size());
+
+  for (std::size_t i = 0; i < a_body.getPoses().size(); ++i)
+  {
+    EXPECT_EQ(a_body.getPoses()[i].getPosition().getZ(), b_body.getPoses()[i].getPosition().getZ());
+    EXPECT_EQ(a_body.getPoses()[i].getOrientation().getZ(), b_body.getPoses()[i].getOrientation().getZ());
+    EXPECT_EQ(a_body.getPoses()[i].getOrientation().getW(), b_body.getPoses()[i].getOrientation().getW());
+  }
+}
+
+}  // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// PUBLIC TESTS                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+TEST(SerializationTest, math_types_have_fixed_layout)
+{
+  const Pose3f pose(Point3f(1, 2, 3), Quaternionf(4, 5, 6, 7));
+  const BoundingBox bbox(Point3i(1, 2, 3), Size3i(4, 5, 6));
+
+  std::vector<std::uint8_t> buffer(7 * sizeof(float) + 6 * sizeof(std::int32_t) + 2 * sizeof(double));
+  SerialWriter writer(buffer.data());
+  math::serializeFields(writer, pose);
+  math::serializeFields(writer, bbox);
+  math::serializeFields(writer, Size2d(0.5, 1.5));
+  ASSERT_EQ(writer.size(), buffer.size());
+
+  float components[7];
+  std::memcpy(components, buffer.data(), sizeof(components));
+  for (int i = 0; i < 7; ++i)
+    EXPECT_EQ(components[i], i + 1.0f);
+
+  SerialReader reader(buffer.data(), buffer.size());
+  const auto read_pose = math::deserializeFields(reader, 1, SerialTag<Pose3f>());
+  const auto read_bbox = math::deserializeFields(reader, 1, SerialTag<BoundingBox>());
+  const auto read_size = math::deserializeFields(reader, 1, SerialTag<Size2d>());
+
+  EXPECT_EQ(read_pose.getPosition().getY(), 2.0f);
+  EXPECT_EQ(read_pose.getOrientation().getW(), 7.0f);
+  EXPECT_EQ(read_bbox.getPoint().getZ(), 3);
+  EXPECT_EQ(read_bbox.getSize().getDepth(), 6);
+  EXPECT_EQ(read_size.getHeight(), 1.5);
+  EXPECT_EQ(reader.remaining(), unsigned(0));
+}
+
+TEST(SerializationTest, images_keep_pixels_in_place)
+{
+  // The depth is an ROI, so it isn't continuous in memory.
+  const auto depth = makeMat(20, 30, CV_16UC1);
+  const Image image(makeHeader(), makeMat(12, 16, CV_8UC3), depth(cv::Rect(5, 4, 10, 8)));
+  ASSERT_FALSE(image.getDepth().isContinuous());
+
+  const auto codec = makeSerialCodec<Image>();
+
+  std::size_t size = 0;
+  auto buffer = encode(codec, image, size);
+  const auto* src = reinterpret_cast<const std::uint8_t*>(buffer->data());
+  std::weak_ptr<std::vector<std::uint64_t>> buffer_ref = buffer;
+
+  auto msg = codec.decode(src, size, std::move(buffer));
+  const auto& decoded = static_cast<const Image&>(*msg);
+
+  expectEqual(decoded.getHeader(), image.getHeader());
+  expectEqual(decoded.getImage(), image.getImage());
+  expectEqual(decoded.getDepth(), image.getDepth());
+
+  // Pixels are read where they lie, from aligned offsets, and keep the buffer alive.
+  for (const auto* mat : { &decoded.getImage(), &decoded.getDepth() })
+  {
+    EXPECT_GE(mat->data, src);
+    EXPECT_LT(mat->data, src + size);
+    EXPECT_EQ((mat->data - src) % serial_pixel_alignment_, 0) << (mat->data - src);
+  }
+
+  EXPECT_FALSE(buffer_ref.expired());
+  msg.reset();
+  EXPECT_TRUE(buffer_ref.expired());
+
+  // Images without depth, or without anything, too.
+  const auto rgb_only = roundTrip(Image(makeHeader(), makeMat(2, 3, CV_8UC3)));
+  EXPECT_EQ(rgb_only->getImage().cols, 3);
+  EXPECT_TRUE(rgb_only->getDepth().empty());
+  EXPECT_TRUE(roundTrip(Image(makeHeader(), cv::Mat()))->getImage().empty());
+}
+
+TEST(SerializationTest, messages_round_trip)
+{
+  const auto person = makePerson(42);
+
+  expectEqual(*roundTrip(person), person);
+
+  const auto encoding = roundTrip(person.getFaceEncoding());
+  EXPECT_EQ(encoding->getEncoding(), person.getFaceEncoding().getEncoding());
+
+  const auto detection = roundTrip(person.getFaceDetection());
+  expectEqual(detection->getFaceImage().getImage(), person.getFaceDetection().getFaceImage().getImage());
+
+  const auto landmarks = roundTrip(person.getFaceLandmarks());
+  EXPECT_EQ(landmarks->getNames(), person.getFaceLandmarks().getNames());
+  EXPECT_EQ(landmarks->getLandmarks()[1].getX(), -4);
+
+  const auto body_parts = roundTrip(person.getBodyParts());
+  EXPECT_EQ(body_parts->getNames(), person.getBodyParts().getNames());
+  EXPECT_EQ(body_parts->getPoses()[0].getOrientation().getZ(), 0.5f);
+}
+
+TEST(SerializationTest, lists_round_trip)
+{
+  const knowledge::msg::PersonStateList people({ makePerson(1), makePerson(2), makePerson(3) });
+
+  const auto decoded = roundTrip(people);
+  ASSERT_EQ(decoded->getItems().size(), unsigned(3));
+
+  for (std::size_t i = 0; i < people.getItems().size(); ++i)
+    expectEqual(decoded->getItems()[i], people.getItems()[i]);
+
+  EXPECT_TRUE(roundTrip(FaceEncodingList({}))->getItems().empty());
+}
+
+TEST(SerializationTest, truncated_messages_throw)
+{
+  const auto codec = makeSerialCodec<PersonState>();
+
+  std::size_t size = 0;
+  const auto buffer = encode(codec, makePerson(7), size);
+  const auto* src = reinterpret_cast<const std::uint8_t*>(buffer->data());
+
+  for (std::size_t cut = 0; cut < size; ++cut)
+    EXPECT_THROW(codec.decode(src, cut, nullptr), std::runtime_error) << cut;
+
+  EXPECT_NO_THROW(codec.decode(src, size, nullptr));
+}
+
+TEST(SerializationTest, registry_covers_every_type)
+{
+  SerialCodecRegistry registry;
+  addSenseSchemas(registry);
+  knowledge::msg::addKnowledgeSchemas(registry);
+
+  const auto codec = registry.makeCodec();
+  const auto person = makePerson(5);
+
+  const std::vector<std::shared_ptr<const MessageInterface>> msgs = {
+    std::make_shared<Image>(person.getFaceDetection().getFaceImage()),
+    std::make_shared<FaceDetection>(person.getFaceDetection()),
+    std::make_shared<FaceEncoding>(person.getFaceEncoding()),
+    std::make_shared<FaceLandmarks>(person.getFaceLandmarks()),
+    std::make_shared<BodyParts>(person.getBodyParts()),
+    std::make_shared<PersonState>(person),
+    std::make_shared<ListMessage<Image>>(std::vector<Image>{ person.getFaceDetection().getFaceImage() }),
+    std::make_shared<FaceDetectionList>(std::vector<FaceDetection>{ person.getFaceDetection() }),
+    std::make_shared<FaceEncodingList>(std::vector<FaceEncoding>{ person.getFaceEncoding() }),
+    std::make_shared<FaceLandmarksList>(std::vector<FaceLandmarks>{ person.getFaceLandmarks() }),
+    std::make_shared<BodyPartsList>(std::vector<BodyParts>{ person.getBodyParts() }),
+    std::make_shared<knowledge::msg::PersonStateList>(std::vector<PersonState>{ person }),
+  };
+
+  for (const auto& msg : msgs)
+  {
+    std::size_t size = 0;
+    auto buffer = encode(codec, *msg, size);
+    const auto* src = reinterpret_cast<const std::uint8_t*>(buffer->data());
+
+    const auto decoded = codec.decode(src, size, std::move(buffer));
+    EXPECT_EQ(typeid(*decoded), typeid(*msg));
+  }
+}
+
+}  // namespace msg
+}  // namespace sense
+}  // namespace soul